@@ -695,6 +695,7 @@ C_BaseAnimating::C_BaseAnimating() :
 
 	m_iMostRecentModelBoneCounter = 0xFFFFFFFF;
 	m_iMostRecentBoneSetupRequest = g_iPreviousBoneCounter - 1;
+	m_nBoneSetupJobDepth = 0;
 	m_flLastBoneSetupTime = -FLT_MAX;
 
 	m_vecPreRagdollMins = vec3_origin;
@@ -2739,18 +2740,24 @@ ConVar cl_warn_thread_contested_bone_setup("cl_warn_thread_contested_bone_setup"
 #endif
 
 // Marked this developmentonly because it currently crashes, and users are enabling it and complaining because of
-// course.  Once this actually works it should just be FCVAR_INTERNAL_USE.
+// course.  Once this actually works it should just be FCVAR_INTERNAL_USE.  Followers (weapons, wearables) are now
+// threaded too, after their parents, which needs the same soak before this is exposed.
 ConVar cl_threaded_bone_setup("cl_threaded_bone_setup", "0", FCVAR_DEVELOPMENTONLY | FCVAR_INTERNAL_USE,
                               "Enable parallel processing of C_BaseAnimating::SetupBones()" );
+ConVar cl_threaded_bone_setup_threads( "cl_threaded_bone_setup_threads", "4", FCVAR_ARCHIVE,
+                              "Maximum number of worker threads for parallel C_BaseAnimating::SetupBones(). Read when cl_threaded_bone_setup is first enabled." );
 
 //-----------------------------------------------------------------------------
 // Purpose: Do the default sequence blending rules as done in HL1
 //-----------------------------------------------------------------------------
 
+static IThreadPool *g_pBoneSetupThreadPool;
+static bool g_bBoneSetupThreadPoolInitialized;
+static int g_nBoneSetupJobDepth;
+
 static void SetupBonesOnBaseAnimating( C_BaseAnimating *&pBaseAnimating )
 {
-	if ( !pBaseAnimating->GetMoveParent() )
-		pBaseAnimating->SetupBones( NULL, -1, -1, gpGlobals->curtime );
+	pBaseAnimating->SetupBones( NULL, -1, -1, gpGlobals->curtime );
 }
 
 static void PreThreadedBoneSetup()
@@ -2766,26 +2773,134 @@ static void PostThreadedBoneSetup()
 static bool g_bInThreadedBoneSetup;
 static bool g_bDoThreadedBoneSetup;
 
+//-----------------------------------------------------------------------------
+// Purpose: Start the workers that ThreadedBoneSetup() runs on, so it doesn't
+//			compete with everything else queued on the shared thread pool.
+//			Done the first time threaded bone setup is enabled, rather than at
+//			client init, so the archived thread count has been read and no
+//			threads are started for users who never turn the feature on.
+//-----------------------------------------------------------------------------
 void C_BaseAnimating::InitBoneSetupThreadPool()
 {
+	if ( g_bBoneSetupThreadPoolInitialized )
+		return;
+
+	// only try once, falling back to the shared pool if we can't start ours
+	g_bBoneSetupThreadPoolInitialized = true;
+
+	// leave a core for the main thread
+	const CPUInformation &cpu = *GetCPUInformation();
+	int nThreads = MIN( (int)cpu.m_nPhysicalProcessors - 1, cl_threaded_bone_setup_threads.GetInt() );
+	if ( nThreads < 1 )
+		return;
+
+	g_pBoneSetupThreadPool = CreateThreadPool();
+
+	ThreadPoolStartParams_t startParams;
+	startParams.nThreads = nThreads;
+	if ( !g_pBoneSetupThreadPool->Start( startParams, "BoneSetup" ) )
+	{
+		DestroyThreadPool( g_pBoneSetupThreadPool );
+		g_pBoneSetupThreadPool = NULL;
+	}
 }
 
 void C_BaseAnimating::ShutdownBoneSetupThreadPool()
 {
+	if ( g_pBoneSetupThreadPool )
+	{
+		g_pBoneSetupThreadPool->Stop();
+		DestroyThreadPool( g_pBoneSetupThreadPool );
+		g_pBoneSetupThreadPool = NULL;
+	}
+
+	g_bBoneSetupThreadPoolInitialized = false;
 }
 
+int C_BaseAnimating::CompareBoneSetupJobDepth( C_BaseAnimating * const *ppLeft, C_BaseAnimating * const *ppRight )
+{
+	return (*ppLeft)->m_nBoneSetupJobDepth - (*ppRight)->m_nBoneSetupJobDepth;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Return true if ThreadedBoneSetup() has yet to set us up, or is doing
+//			so now, in which case other jobs must not wait on our lock.
+//-----------------------------------------------------------------------------
+bool C_BaseAnimating::IsBoneSetupJobPending() const
+{
+	return m_iMostRecentBoneSetupRequest == g_iPreviousBoneCounter && m_nBoneSetupJobDepth >= g_nBoneSetupJobDepth;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Set up the bones of the entities that asked for them last frame.
+//			Entities are set up after the entities they are attached to, one
+//			depth of the hierarchy at a time, since followers such as weapons
+//			and bone merged wearables read their parent's bones. Entities at
+//			the same depth are set up in parallel.
+//-----------------------------------------------------------------------------
 void C_BaseAnimating::ThreadedBoneSetup()
 {
 	g_bDoThreadedBoneSetup = cl_threaded_bone_setup.GetBool();
 	if ( g_bDoThreadedBoneSetup )
 	{
+		InitBoneSetupThreadPool();
+
 		int nCount = g_PreviousBoneSetups.Count();
 		if ( nCount > 1 )
 		{
+			VPROF_BUDGET( "C_BaseAnimating::ThreadedBoneSetup", VPROF_BUDGETGROUP_CLIENT_ANIMATION );
+
+			// depth is the number of ancestors that are also queued
+			for ( int i = 0; i < nCount; ++i )
+			{
+				C_BaseAnimating *pAnimating = g_PreviousBoneSetups[i];
+				pAnimating->m_nBoneSetupJobDepth = 0;
+
+				for ( C_BaseEntity *pParent = pAnimating->GetMoveParent(); pParent; pParent = pParent->GetMoveParent() )
+				{
+					C_BaseAnimating *pParentAnimating = pParent->GetBaseAnimating();
+					if ( pParentAnimating && pParentAnimating->m_iMostRecentBoneSetupRequest == g_iPreviousBoneCounter )
+					{
+						++pAnimating->m_nBoneSetupJobDepth;
+					}
+				}
+			}
+
+			g_PreviousBoneSetups.Sort( &CompareBoneSetupJobDepth );
+
+			// a NULL pool would run every job on this thread
+			IThreadPool *pThreadPool = g_pBoneSetupThreadPool ? g_pBoneSetupThreadPool : g_pThreadPool;
+
 			g_bInThreadedBoneSetup = true;
 
-			ParallelProcess( "C_BaseAnimating::ThreadedBoneSetup", g_PreviousBoneSetups.Base(), nCount, &SetupBonesOnBaseAnimating, &PreThreadedBoneSetup, &PostThreadedBoneSetup );
+			int iStart = 0;
+			while ( iStart < nCount )
+			{
+				g_nBoneSetupJobDepth = g_PreviousBoneSetups[iStart]->m_nBoneSetupJobDepth;
+
+				int iEnd = iStart + 1;
+				while ( iEnd < nCount && g_PreviousBoneSetups[iEnd]->m_nBoneSetupJobDepth == g_nBoneSetupJobDepth )
+				{
+					++iEnd;
+				}
+
+				if ( g_nBoneSetupJobDepth > 0 )
+				{
+					// Resolve the followers' transforms here, now that their parents' bones are set up,
+					// since computing them reads and may update the parent.
+					for ( int i = iStart; i < iEnd; ++i )
+					{
+						g_PreviousBoneSetups[i]->GetRenderOrigin();
+						g_PreviousBoneSetups[i]->GetRenderAngles();
+					}
+				}
+
+				ParallelProcess( "C_BaseAnimating::ThreadedBoneSetup", pThreadPool, g_PreviousBoneSetups.Base() + iStart, iEnd - iStart, &SetupBonesOnBaseAnimating, &PreThreadedBoneSetup, &PostThreadedBoneSetup );
 
+				iStart = iEnd;
+			}
+
+			g_nBoneSetupJobDepth = 0;
 			g_bInThreadedBoneSetup = false;
 		}
 	}
@@ -2846,7 +2961,14 @@ bool C_BaseAnimating::SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, i
 	{
 		if ( !m_BoneSetupLock.TryLock() )
 		{
-			return false;
+			// Ancestors are set up before their followers, so if we aren't a pending job,
+			// whoever holds the lock is just making sure our bones are set up - wait for them.
+			if ( IsBoneSetupJobPending() )
+			{
+				return false;
+			}
+
+			m_BoneSetupLock.Lock();
 		}
 	}
 
@@ -2894,7 +3016,7 @@ bool C_BaseAnimating::SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, i
 	}
 
 	int nBoneCount = m_CachedBoneData.Count();
-	if ( g_bDoThreadedBoneSetup && !g_bInThreadedBoneSetup && ( nBoneCount >= 16 ) && !GetMoveParent() && m_iMostRecentBoneSetupRequest != g_iPreviousBoneCounter )
+	if ( g_bDoThreadedBoneSetup && !g_bInThreadedBoneSetup && ( nBoneCount >= 16 ) && m_iMostRecentBoneSetupRequest != g_iPreviousBoneCounter )
 	{
 		m_iMostRecentBoneSetupRequest = g_iPreviousBoneCounter;
 		Assert( g_PreviousBoneSetups.Find( this ) == -1 );
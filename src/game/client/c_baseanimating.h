@@ -405,6 +405,8 @@ public:
 	static void						ThreadedBoneSetup();
 	static void						InitBoneSetupThreadPool();
 	static void						ShutdownBoneSetupThreadPool();
+	static int						CompareBoneSetupJobDepth( C_BaseAnimating * const *ppLeft, C_BaseAnimating * const *ppRight );
+	bool							IsBoneSetupJobPending() const;
 
 	// Invalidate bone caches so all SetupBones() calls force bone transforms to be regenerated.
 	static void						InvalidateBoneCaches();
@@ -517,6 +519,7 @@ protected:
 	// bone transformation matrix
 	unsigned long					m_iMostRecentModelBoneCounter;
 	unsigned long					m_iMostRecentBoneSetupRequest;
+	int								m_nBoneSetupJobDepth;		// number of queued ancestors, while in ThreadedBoneSetup()
 	int								m_iPrevBoneMask;
 	int								m_iAccumulatedBoneMask;
 
@@ -29,6 +29,8 @@
 ConVar rr_debugresponses( "rr_debugresponses", "0", FCVAR_NONE, "Show verbose matching output (1 for simple, 2 for rule scoring). If set to 3, it will only show response success/failure for npc_selected NPCs." );
 ConVar rr_debugrule( "rr_debugrule", "", FCVAR_NONE, "If set to the name of the rule, that rule's score will be shown whenever a concept is passed into the response rules system.");
 ConVar rr_dumpresponses( "rr_dumpresponses", "0", FCVAR_NONE, "Dump all response_rules.txt and rules (requires restart)" );
+ConVar rr_ruleindex( "rr_ruleindex", "1", FCVAR_CHEAT, "Only score the rules whose required criteria can match, using an index built when the rules are loaded." );
+ConVar rr_benchmark_record( "rr_benchmark_record", "0", FCVAR_CHEAT, "Record up to this many criteria sets per response system for rr_benchmark. Set to 0 to discard them." );
 
 static CUtlSymbolTable g_RS;
 
@@ -683,6 +685,13 @@ public:
 	float		LookupEnumeration( const char *name, bool& found );
 
 	int			FindBestMatchingRule( const AI_CriteriaSet& set, bool verbose );
+	void		FindBestMatchingRules( const AI_CriteriaSet& set, bool verbose, bool useIndex, CUtlVector< int >& bestrules );
+
+	bool		IsIndexableCriterion( Criteria *c );
+	void		BuildRuleIndex( void );
+	void		CollectCandidateRules( const AI_CriteriaSet& set, CUtlVector< int >& candidates );
+
+	void		BenchmarkRecordedCriteria( const char *pszName, int iterations );
 
 	float		ScoreCriteriaAgainstRule( const AI_CriteriaSet& set, int irule, bool verbose = false );
 	float		RecursiveScoreSubcriteriaAgainstRule( const AI_CriteriaSet& set, Criteria *parent, bool& exclude, bool verbose /*=false*/ );
@@ -710,6 +719,16 @@ public:
 	CUtlDict< Rule, short >	m_Rules;
 	CUtlDict< Enumeration, short > m_Enumerations;
 
+	// Each rule with a required criterion that is a plain string comparison is indexed by one of them,
+	// preferably "concept". The index maps "name=value" to a bucket of rules, in ascending order.
+	CUtlDict< int, int >		m_RuleIndex;
+	CUtlVector< CUtlVector< int > >	m_RuleIndexBuckets;
+	CUtlVector< const char * >	m_RuleIndexNames;		// distinct criterion names used as keys, point into m_Criteria
+	CUtlVector< int >			m_UnindexedRules;		// rules that always have to be scored
+	int			m_nIndexedRuleCount;					// m_Rules.Count() when the index was built, or -1
+
+	CUtlVector< AI_CriteriaSet >	m_RecordedCriteria;	// sets recorded for rr_benchmark
+
 	char		token[ 1204 ];
 
 	bool		m_bUnget;
@@ -762,6 +781,7 @@ CResponseSystem::CResponseSystem()
 	m_bUnget = false;
 	m_bPrecache = true;
 	m_bCustomManagable = false;
+	m_nIndexedRuleCount = -1;
 }
 
 //-----------------------------------------------------------------------------
@@ -817,6 +837,12 @@ void CResponseSystem::Clear()
 	m_Criteria.RemoveAll();
 	m_Rules.RemoveAll();
 	m_Enumerations.RemoveAll();
+
+	m_RuleIndex.Purge();
+	m_RuleIndexBuckets.Purge();
+	m_RuleIndexNames.Purge();
+	m_UnindexedRules.Purge();
+	m_nIndexedRuleCount = -1;
 }
 
 //-----------------------------------------------------------------------------
@@ -1676,22 +1702,161 @@ bool CResponseSystem::GetBestResponse( ResponseSearchResult& searchResult, Rule
 	return bret;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Is the criterion a required, plain string comparison, that rules can be indexed by?
+//-----------------------------------------------------------------------------
+bool CResponseSystem::IsIndexableCriterion( Criteria *c )
+{
+	if ( !c->required || c->IsSubCriteriaType() )
+		return false;
+
+	Matcher &m = c->matcher;
+	if ( !m.valid || m.isnumeric || m.notequal || m.usemin || m.usemax )
+		return false;
+
+	// an empty token matches criteria missing from the set
+	return m.GetToken()[0] != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Index each rule by one of its indexable criteria. A rule can only
+//			score if the set has the value its key criterion requires.
+//-----------------------------------------------------------------------------
+void CResponseSystem::BuildRuleIndex( void )
+{
+	m_RuleIndex.Purge();
+	m_RuleIndexBuckets.Purge();
+	m_RuleIndexNames.Purge();
+	m_UnindexedRules.Purge();
+
+	char key[ 256 ];
+
+	int c = m_Rules.Count();
+	for ( int irule = 0; irule < c; irule++ )
+	{
+		Rule *rule = &m_Rules[ irule ];
+
+		Criteria *keyCriterion = NULL;
+		for ( int i = 0; i < rule->m_Criteria.Count(); i++ )
+		{
+			Criteria *crit = &m_Criteria[ rule->m_Criteria[ i ] ];
+			if ( !IsIndexableCriterion( crit ) )
+				continue;
+
+			// concepts split the rules up the best
+			if ( !keyCriterion || !Q_stricmp( crit->name, "concept" ) )
+			{
+				keyCriterion = crit;
+			}
+		}
+
+		if ( !keyCriterion )
+		{
+			m_UnindexedRules.AddToTail( irule );
+			continue;
+		}
+
+		int iName;
+		for ( iName = 0; iName < m_RuleIndexNames.Count(); iName++ )
+		{
+			if ( !Q_stricmp( m_RuleIndexNames[ iName ], keyCriterion->name ) )
+				break;
+		}
+
+		if ( iName == m_RuleIndexNames.Count() )
+		{
+			m_RuleIndexNames.AddToTail( keyCriterion->name );
+		}
+
+		Q_snprintf( key, sizeof( key ), "%s=%s", keyCriterion->name, keyCriterion->matcher.GetToken() );
+
+		int idx = m_RuleIndex.Find( key );
+		if ( idx == m_RuleIndex.InvalidIndex() )
+		{
+			idx = m_RuleIndex.Insert( key, m_RuleIndexBuckets.AddToTail() );
+		}
+
+		m_RuleIndexBuckets[ m_RuleIndex[ idx ] ].AddToTail( irule );
+	}
+
+	m_nIndexedRuleCount = c;
+
+	DevMsg( 2, "CResponseSystem:  indexed %i rules by %i criteria, %i left unindexed\n",
+		c - m_UnindexedRules.Count(), m_RuleIndexNames.Count(), m_UnindexedRules.Count() );
+}
+
+static int __cdecl RuleIndexLessFunc( const int *lhs, const int *rhs )
+{
+	return *lhs - *rhs;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Gather the rules that could match the set, in ascending order
+//-----------------------------------------------------------------------------
+void CResponseSystem::CollectCandidateRules( const AI_CriteriaSet& set, CUtlVector< int >& candidates )
+{
+	// rules are only ever added or all cleared, so a change in count means the index is stale
+	if ( m_nIndexedRuleCount != m_Rules.Count() )
+	{
+		BuildRuleIndex();
+	}
+
+	candidates.AddVectorToTail( m_UnindexedRules );
+
+	char key[ 256 ];
+
+	for ( int iName = 0; iName < m_RuleIndexNames.Count(); iName++ )
+	{
+		const char *name = m_RuleIndexNames[ iName ];
+
+		int found = set.FindCriterionIndex( name );
+		if ( found == -1 )
+			continue;
+
+		Q_snprintf( key, sizeof( key ), "%s=%s", name, set.GetValue( found ) );
+
+		int idx = m_RuleIndex.Find( key );
+		if ( idx != m_RuleIndex.InvalidIndex() )
+		{
+			candidates.AddVectorToTail( m_RuleIndexBuckets[ m_RuleIndex[ idx ] ] );
+		}
+	}
+
+	// score them in the same order as a full scan, so ties are broken the same way
+	candidates.Sort( RuleIndexLessFunc );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : set - 
 //			verbose - 
-// Output : int
+//			useIndex - only score the rules the index says could match
+//			bestrules - the highest scoring rules, in ascending order
 //-----------------------------------------------------------------------------
-int CResponseSystem::FindBestMatchingRule( const AI_CriteriaSet& set, bool verbose )
+void CResponseSystem::FindBestMatchingRules( const AI_CriteriaSet& set, bool verbose, bool useIndex, CUtlVector< int >& bestrules )
 {
-	CUtlVector< int >	bestrules;
 	float bestscore = 0.001f;
 
-	int c = m_Rules.Count();
+	// debug output is expected for every rule
+	const char *pszDebugRule = rr_debugrule.GetString();
+	if ( verbose || ( pszDebugRule && pszDebugRule[0] ) )
+	{
+		useIndex = false;
+	}
+
+	CUtlVector< int > candidates;
+	if ( useIndex )
+	{
+		CollectCandidateRules( set, candidates );
+	}
+
+	int c = useIndex ? candidates.Count() : m_Rules.Count();
 	int i;
 	for ( i = 0; i < c; i++ )
 	{
-		float score = ScoreCriteriaAgainstRule( set, i, verbose );
+		int irule = useIndex ? candidates[ i ] : i;
+
+		float score = ScoreCriteriaAgainstRule( set, irule, verbose );
 		// Check equals so that we keep track of all matching rules
 		if ( score >= bestscore )
 		{
@@ -1703,9 +1868,21 @@ int CResponseSystem::FindBestMatchingRule( const AI_CriteriaSet& set, bool verbo
 			}
 
 			// Add to bucket
-			bestrules.AddToTail( i );
+			bestrules.AddToTail( irule );
 		}
 	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+// Input  : set - 
+//			verbose - 
+// Output : int
+//-----------------------------------------------------------------------------
+int CResponseSystem::FindBestMatchingRule( const AI_CriteriaSet& set, bool verbose )
+{
+	CUtlVector< int >	bestrules;
+	FindBestMatchingRules( set, verbose, rr_ruleindex.GetBool(), bestrules );
 
 	int bestCount = bestrules.Count();
 	if ( bestCount <= 0 )
@@ -1736,6 +1913,16 @@ bool CResponseSystem::FindBestResponse( const AI_CriteriaSet& set, AI_Response&
 	bool showRules = ( iDbgResponse == 2 );
 	bool showResult = ( iDbgResponse == 1 || iDbgResponse == 2 );
 
+	int nRecord = rr_benchmark_record.GetInt();
+	if ( m_RecordedCriteria.Count() < nRecord )
+	{
+		m_RecordedCriteria.AddToTail( set );
+	}
+	else if ( nRecord <= 0 && m_RecordedCriteria.Count() > 0 )
+	{
+		m_RecordedCriteria.Purge();
+	}
+
 	// Look for match. verbose mode used to be at level 2, but disabled because the writers don't actually care for that info.
 	int bestRule = FindBestMatchingRule( set, iDbgResponse == 3 ); 
 
@@ -2965,6 +3152,16 @@ public:
 
 	}
 
+	void BenchmarkAllResponseSystems( int iterations )
+	{
+		BenchmarkRecordedCriteria( GetScriptFile(), iterations );
+
+		for ( int i = 0; i < m_InstancedSystems.Count(); i++ )
+		{
+			m_InstancedSystems[ i ]->BenchmarkRecordedCriteria( m_InstancedSystems.GetElementName( i ), iterations );
+		}
+	}
+
 private:
 
 	void ClearInstanced()
@@ -3051,6 +3248,16 @@ CON_COMMAND( rr_reloadresponsesystems, "Reload all response system scripts." )
 #endif
 }
 
+CON_COMMAND_F( rr_benchmark, "Match the criteria sets recorded with rr_benchmark_record against the rules, with and without the rule index. Optional argument is the number of iterations.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	int iterations = ( args.ArgC() > 1 ) ? MAX( atoi( args[ 1 ] ), 1 ) : 10;
+
+	defaultresponsesytem.BenchmarkAllResponseSystems( iterations );
+}
+
 static short RESPONSESYSTEM_SAVE_RESTORE_VERSION = 1;
 
 // note:  this won't save/restore settings from instanced response systems.  Could add that with a CDefSaveRestoreOps implementation if needed
@@ -3351,6 +3558,65 @@ void DestroyCustomResponseSystems()
 	defaultresponsesytem.DestroyCustomResponseSystems();
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Match the recorded criteria sets against the rules with and without
+//			the rule index, and report the time taken and any differences
+//-----------------------------------------------------------------------------
+void CResponseSystem::BenchmarkRecordedCriteria( const char *pszName, int iterations )
+{
+	int nSets = m_RecordedCriteria.Count();
+	if ( nSets == 0 )
+		return;
+
+	CUtlVector< int > fullRules;
+	CUtlVector< int > indexedRules;
+
+	// build the index up front so it isn't timed
+	CollectCandidateRules( m_RecordedCriteria[ 0 ], indexedRules );
+
+	double flFullTime = 0.0;
+	double flIndexedTime = 0.0;
+	int nMismatches = 0;
+
+	for ( int iter = 0; iter < iterations; iter++ )
+	{
+		for ( int i = 0; i < nSets; i++ )
+		{
+			const AI_CriteriaSet &set = m_RecordedCriteria[ i ];
+
+			fullRules.RemoveAll();
+			double flStart = Plat_FloatTime();
+			FindBestMatchingRules( set, false, false, fullRules );
+			flFullTime += Plat_FloatTime() - flStart;
+
+			indexedRules.RemoveAll();
+			flStart = Plat_FloatTime();
+			FindBestMatchingRules( set, false, true, indexedRules );
+			flIndexedTime += Plat_FloatTime() - flStart;
+
+			if ( iter == 0 )
+			{
+				bool bSame = ( fullRules.Count() == indexedRules.Count() );
+				for ( int j = 0; bSame && j < fullRules.Count(); j++ )
+				{
+					bSame = ( fullRules[ j ] == indexedRules[ j ] );
+				}
+
+				if ( !bSame )
+				{
+					++nMismatches;
+				}
+			}
+		}
+	}
+
+	int nMatches = nSets * iterations;
+	Msg( "%s: %i rules, %i criteria sets x %i: full scan %.2f us/match, indexed %.2f us/match (%.1fx), %i mismatches\n",
+		pszName, m_Rules.Count(), nSets, iterations,
+		1000000.0 * flFullTime / nMatches, 1000000.0 * flIndexedTime / nMatches,
+		( flIndexedTime > 0.0 ) ? flFullTime / flIndexedTime : 0.0, nMismatches );
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 void CResponseSystem::DumpRules()
@@ -0,0 +1,184 @@
+// NextBotActionAllocator.cpp
+// Pooled storage for NextBot Actions
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#include "cbase.h"
+
+#include "NextBotActionAllocator.h"
+#include "mempool.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+// Every block starts with the index of its pool. Keeping the header the size of the 
+// alignment keeps the Action itself aligned.
+#define NEXTBOT_ACTION_ALIGNMENT		16
+#define NEXTBOT_ACTION_HEADER_SIZE		NEXTBOT_ACTION_ALIGNMENT
+
+// Roughly how much memory each pool grabs from the heap at a time
+#define NEXTBOT_ACTION_BLOB_SIZE		( 32 * 1024 )
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Singleton accessor.
+ */
+NextBotActionAllocator &TheNextBotActionAllocator( void )
+{
+	static NextBotActionAllocator allocator;
+	return allocator;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+NextBotActionAllocator::NextBotActionAllocator( void ) : m_poolIndexBySize( DefLessFunc( int ) )
+{
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+NextBotActionAllocator::~NextBotActionAllocator()
+{
+	FOR_EACH_VEC( m_poolVector, i )
+	{
+		delete m_poolVector[i].m_pool;
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Return the index of the pool for blocks of the given size, creating it if needed.
+ */
+int NextBotActionAllocator::FindOrCreatePool( int blockSize )
+{
+	unsigned short it = m_poolIndexBySize.Find( blockSize );
+	if ( it != m_poolIndexBySize.InvalidIndex() )
+	{
+		return m_poolIndexBySize[ it ];
+	}
+
+	int index = m_poolVector.AddToTail();
+	Pool &pool = m_poolVector[ index ];
+
+	pool.m_blockSize = blockSize;
+	pool.m_blocksPerBlob = clamp( NEXTBOT_ACTION_BLOB_SIZE / blockSize, 2, 64 );
+	pool.m_pool = new CUtlMemoryPool( blockSize, pool.m_blocksPerBlob, CUtlMemoryPool::GROW_SLOW, "NextBot Action pool", NEXTBOT_ACTION_ALIGNMENT );
+	pool.m_liveCount = 0;
+	pool.m_peakCount = 0;
+	pool.m_reservedCount = pool.m_blocksPerBlob;
+	pool.m_allocCount = 0;
+
+	m_poolIndexBySize.Insert( blockSize, index );
+
+	return index;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+void *NextBotActionAllocator::Alloc( size_t size )
+{
+	int blockSize = AlignValue( (int)size + NEXTBOT_ACTION_HEADER_SIZE, NEXTBOT_ACTION_ALIGNMENT );
+	int index = FindOrCreatePool( blockSize );
+	Pool &pool = m_poolVector[ index ];
+
+	if ( pool.m_liveCount >= pool.m_reservedCount )
+	{
+		// the pool is about to grab another blob from the heap
+		pool.m_reservedCount += pool.m_blocksPerBlob;
+	}
+
+	byte *block = (byte *)pool.m_pool->Alloc();
+	if ( !block )
+	{
+		Error( "NextBotActionAllocator: Out of memory allocating a %d byte Action\n", (int)size );
+	}
+
+	++pool.m_liveCount;
+	++pool.m_allocCount;
+	pool.m_peakCount = MAX( pool.m_peakCount, pool.m_liveCount );
+
+	*(int *)block = index;
+
+	return block + NEXTBOT_ACTION_HEADER_SIZE;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+void NextBotActionAllocator::Free( void *memory )
+{
+	if ( !memory )
+		return;
+
+	byte *block = (byte *)memory - NEXTBOT_ACTION_HEADER_SIZE;
+	int index = *(int *)block;
+
+	if ( !m_poolVector.IsValidIndex( index ) )
+	{
+		AssertMsg( false, "NextBotActionAllocator: Freeing memory that is not an Action" );
+		return;
+	}
+
+	Pool &pool = m_poolVector[ index ];
+	Assert( pool.m_liveCount > 0 );
+
+	pool.m_pool->Free( block );
+	--pool.m_liveCount;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Give the memory of idle pools back to the heap, so a map or game mode that used some
+ * large Actions heavily doesn't hold on to them forever.
+ */
+void NextBotActionAllocator::ReleaseUnused( void )
+{
+	FOR_EACH_VEC( m_poolVector, i )
+	{
+		Pool &pool = m_poolVector[i];
+
+		if ( pool.m_liveCount == 0 && pool.m_reservedCount > 0 )
+		{
+			pool.m_pool->Clear();
+			pool.m_reservedCount = 0;
+		}
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+void NextBotActionAllocator::DumpStats( void ) const
+{
+	int totalLive = 0;
+	int totalLiveBytes = 0;
+	int totalReservedBytes = 0;
+	unsigned int totalAllocs = 0;
+
+	Msg( "%10s %8s %8s %10s %12s\n", "block size", "live", "peak", "allocs", "reserved KB" );
+
+	FOR_EACH_MAP( m_poolIndexBySize, it )
+	{
+		const Pool &pool = m_poolVector[ m_poolIndexBySize[ it ] ];
+
+		Msg( "%10d %8d %8d %10u %12.1f\n", pool.m_blockSize, pool.m_liveCount, pool.m_peakCount, pool.m_allocCount, pool.m_reservedCount * pool.m_blockSize / 1024.0f );
+
+		totalLive += pool.m_liveCount;
+		totalLiveBytes += pool.m_liveCount * pool.m_blockSize;
+		totalReservedBytes += pool.m_reservedCount * pool.m_blockSize;
+		totalAllocs += pool.m_allocCount;
+	}
+
+	Msg( "%d pools, %d live Actions using %.1f KB of %.1f KB reserved, %u allocations\n", m_poolVector.Count(), totalLive, totalLiveBytes / 1024.0f, totalReservedBytes / 1024.0f, totalAllocs );
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+CON_COMMAND_F( nb_action_pool_stats, "Print the usage of the NextBot Action pools", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	TheNextBotActionAllocator().DumpStats();
+}
@@ -0,0 +1,58 @@
+// NextBotActionAllocator.h
+// Pooled storage for NextBot Actions
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#ifndef _NEXT_BOT_ACTION_ALLOCATOR_H_
+#define _NEXT_BOT_ACTION_ALLOCATOR_H_
+
+#include "utlmap.h"
+
+class CUtlMemoryPool;
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Actions are created and destroyed on every behavior transition, and whole behavior stacks
+ * are thrown away each time a bot dies or respawns. Rather than round-trip all of that through
+ * the global heap, Actions are carved out of free lists, one per (16 byte rounded) object size.
+ * Since each Action class has a single size, in practice each class gets its own free list,
+ * and the blocks released by one bot's stack are reused by the next bot that needs them.
+ *
+ * Each block is prefixed with the index of the pool it came from, so it can be returned
+ * without knowing the dynamic type of the Action being deleted.
+ *
+ * Actions are only created and destroyed on the main thread.
+ */
+class NextBotActionAllocator
+{
+public:
+	NextBotActionAllocator( void );
+	~NextBotActionAllocator();
+
+	void *Alloc( size_t size );
+	void Free( void *memory );
+
+	void ReleaseUnused( void );				// return the memory of pools with no live Actions to the heap
+	void DumpStats( void ) const;
+
+private:
+	struct Pool
+	{
+		CUtlMemoryPool *m_pool;
+		int m_blockSize;
+		int m_blocksPerBlob;
+		int m_liveCount;
+		int m_peakCount;
+		int m_reservedCount;				// blocks held by the pool since it was last released
+		unsigned int m_allocCount;			// total allocations, for measuring churn
+	};
+	CUtlVector< Pool > m_poolVector;
+	CUtlMap< int, int > m_poolIndexBySize;
+
+	int FindOrCreatePool( int blockSize );
+};
+
+extern NextBotActionAllocator &TheNextBotActionAllocator( void );
+
+
+#endif // _NEXT_BOT_ACTION_ALLOCATOR_H_
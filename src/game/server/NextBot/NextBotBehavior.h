@@ -10,6 +10,7 @@
 #include "NextBotEventResponderInterface.h"
 #include "NextBotContextualQueryInterface.h"
 #include "NextBotDebug.h"
+#include "NextBotActionAllocator.h"
 #include "tier0/vprof.h"
 
 
@@ -593,6 +594,12 @@ public:
 	Action( void );
 	virtual ~Action();
 
+	// Actions are recycled through NextBotActionAllocator instead of the global heap
+	void *operator new( size_t size )													{ return TheNextBotActionAllocator().Alloc( size ); }
+	void *operator new( size_t size, int nBlockUse, const char *pFileName, int nLine )	{ return TheNextBotActionAllocator().Alloc( size ); }
+	void operator delete( void *memory )												{ TheNextBotActionAllocator().Free( memory ); }
+	void operator delete( void *memory, int nBlockUse, const char *pFileName, int nLine )	{ TheNextBotActionAllocator().Free( memory ); }
+
 	virtual const char *GetName( void ) const = 0;		// return name of this action
 	virtual bool IsNamed( const char *name ) const;		// return true if given name matches the name of this Action
 	virtual const char *GetFullName( void ) const;		// return a temporary string showing the full lineage of this one action
@@ -48,6 +48,15 @@ public:
 	virtual void Update( void ) = 0;									// update internal state
 	virtual void Upkeep( void ) { }										// lightweight update guaranteed to occur every server tick
 
+	/**
+	 * Two-phase update support.
+	 * PrepareSense() is called on the main thread for bots scheduled to update this tick. It should
+	 * snapshot its inputs and queue any batched work (such as line-of-sight requests to the
+	 * visibility broker), returning true if it queued anything. The manager resolves the batched
+	 * work on worker threads, and Update() runs afterwards on the main thread and commits the results.
+	 */
+	virtual bool PrepareSense( void ) { return false; }
+
 	inline bool ComputeUpdateInterval();								// return false is no time has elapsed (interval is zero)
 	inline float GetUpdateInterval();
 
@@ -25,6 +25,22 @@ enum MoveToFailureType
 	FAIL_FELL_OFF,
 };
 
+//--------------------------------------------------------------------------------------------------------------------------
+/**
+ * The events a sleeping bot can subscribe to be woken up by (see INextBot::SleepUntil()).
+ * OnKilled() always wakes a sleeping bot.
+ */
+enum NextBotWakeEventType
+{
+	NEXTBOT_WAKE_ON_INJURED			= 0x0001,		// OnInjured(), OnIgnite()
+	NEXTBOT_WAKE_ON_CONTACT			= 0x0002,		// OnContact(), OnShoved(), OnBlinded()
+	NEXTBOT_WAKE_ON_SOUND			= 0x0004,		// OnSound(), OnWeaponFired() within vision range
+	NEXTBOT_WAKE_ON_OTHER_KILLED	= 0x0008,		// OnOtherKilled()
+	NEXTBOT_WAKE_ON_AREA_OCCUPANCY	= 0x0010,		// an enemy entered a nav area that is potentially visible from ours, within vision range
+
+	NEXTBOT_WAKE_ON_ANY				= 0xFFFF
+};
+
 //--------------------------------------------------------------------------------------------------------------------------
 /**
  * Events propagated to/between components.
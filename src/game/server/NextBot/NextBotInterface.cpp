@@ -19,6 +19,7 @@
 #include "tier0/memdbgon.h"
 
 // development only, off by default for 360
+ConVar nb_sleep( "nb_sleep", "1", FCVAR_CHEAT, "If zero, bots never sleep while waiting for something to happen" );
 ConVar NextBotDebugHistory( "nb_debug_history", IsX360() ? "0" : "1", FCVAR_CHEAT, "If true, each bot keeps a history of debug output in memory" );
 
 //----------------------------------------------------------------------------------------------------------------
@@ -35,6 +36,9 @@ INextBot::INextBot( void ) : m_debugHistory( MAX_NEXTBOT_DEBUG_HISTORY, 0 )	// C
 
 	m_currentPath = NULL;
 
+	m_isAsleep = false;
+	m_wakeEvents = 0;
+
 	// register with the manager
 	m_id = TheNextBots().Register( this );
 }
@@ -74,6 +78,8 @@ void INextBot::Reset( void )
 	m_immobileCheckTimer.Invalidate();
 	m_immobileAnchor = vec3_origin;
 
+	WakeUp();
+
 	for( INextBotComponent *comp = m_componentList; comp; comp = comp->m_nextComponent )
 	{
 		comp->Reset();
@@ -81,6 +87,92 @@ void INextBot::Reset( void )
 }
 
 
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Stop updating until one of the given NextBotWakeEventTypes occurs, or maxDuration elapses.
+ * Sleeps are always bounded so a bot can't miss something it didn't subscribe to forever.
+ */
+void INextBot::SleepUntil( unsigned int wakeEvents, float maxDuration )
+{
+	if ( !nb_sleep.GetBool() || maxDuration <= 0.0f )
+		return;
+
+	m_isAsleep = true;
+	m_wakeEvents = wakeEvents;
+	m_sleepTimer.Start( maxDuration );
+
+	if ( IsDebugging( NEXTBOT_BEHAVIOR ) )
+	{
+		DebugConColorMsg( NEXTBOT_BEHAVIOR, Color( 150, 150, 255, 255 ), "%3.2f: %s sleeping for up to %3.2f seconds (wake events 0x%X)\n", gpGlobals->curtime, GetDebugIdentifier(), maxDuration, wakeEvents );
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+void INextBot::OnInjured( const CTakeDamageInfo &info )
+{
+	OnWakeEvent( NEXTBOT_WAKE_ON_INJURED );
+	INextBotEventResponder::OnInjured( info );
+}
+
+void INextBot::OnKilled( const CTakeDamageInfo &info )
+{
+	WakeUp();
+	INextBotEventResponder::OnKilled( info );
+}
+
+void INextBot::OnIgnite( void )
+{
+	OnWakeEvent( NEXTBOT_WAKE_ON_INJURED );
+	INextBotEventResponder::OnIgnite();
+}
+
+void INextBot::OnContact( CBaseEntity *other, CGameTrace *result )
+{
+	OnWakeEvent( NEXTBOT_WAKE_ON_CONTACT );
+	INextBotEventResponder::OnContact( other, result );
+}
+
+void INextBot::OnShoved( CBaseEntity *pusher )
+{
+	OnWakeEvent( NEXTBOT_WAKE_ON_CONTACT );
+	INextBotEventResponder::OnShoved( pusher );
+}
+
+void INextBot::OnBlinded( CBaseEntity *blinder )
+{
+	OnWakeEvent( NEXTBOT_WAKE_ON_CONTACT );
+	INextBotEventResponder::OnBlinded( blinder );
+}
+
+void INextBot::OnSound( CBaseEntity *source, const Vector &pos, KeyValues *keys )
+{
+	// sounds are sent to every bot, so only wake for those nearby
+	if ( IsWokenBy( NEXTBOT_WAKE_ON_SOUND ) && IsRangeLessThan( pos, GetVisionInterface()->GetMaxVisionRange() ) )
+	{
+		WakeUp();
+	}
+
+	INextBotEventResponder::OnSound( source, pos, keys );
+}
+
+void INextBot::OnWeaponFired( CBaseCombatCharacter *whoFired, CBaseCombatWeapon *weapon )
+{
+	if ( IsWokenBy( NEXTBOT_WAKE_ON_SOUND ) && whoFired && IsRangeLessThan( whoFired, GetVisionInterface()->GetMaxVisionRange() ) )
+	{
+		WakeUp();
+	}
+
+	INextBotEventResponder::OnWeaponFired( whoFired, weapon );
+}
+
+void INextBot::OnOtherKilled( CBaseCombatCharacter *victim, const CTakeDamageInfo &info )
+{
+	OnWakeEvent( NEXTBOT_WAKE_ON_OTHER_KILLED );
+	INextBotEventResponder::OnOtherKilled( victim, info );
+}
+
+
 //----------------------------------------------------------------------------------------------------------------
 void INextBot::ResetDebugHistory( void )
 {
@@ -110,6 +202,24 @@ void INextBot::EndUpdate( void )
 	TheNextBots().NotifyEndUpdate( this );
 }
 
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Invoked by the NextBotManager on the main thread for each bot scheduled to update this tick.
+ * Return true if any component queued work for the sense phase.
+ */
+bool INextBot::PrepareSense( void )
+{
+	bool hasWork = false;
+
+	for( INextBotComponent *comp = m_componentList; comp; comp = comp->m_nextComponent )
+	{
+		hasWork |= comp->PrepareSense();
+	}
+
+	return hasWork;
+}
+
+
 //----------------------------------------------------------------------------------------------------------------
 void INextBot::Update( void )
 {
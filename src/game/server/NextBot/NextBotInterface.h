@@ -40,6 +40,8 @@ public:
 	bool BeginUpdate();
 	void EndUpdate();
 
+	bool PrepareSense( void );										// queue this tick's batched sense work, return true if there is any
+
 	virtual void Reset( void );										// (EXTEND) reset to initial state
 	virtual void Update( void );									// (EXTEND) update internal state
 	virtual void Upkeep( void );									// (EXTEND) lightweight update guaranteed to occur every server tick
@@ -115,6 +117,28 @@ public:
 	virtual void ClearImmobileStatus( void );		
 	virtual float GetImmobileSpeedThreshold( void ) const;	// return units/second below which this actor is considered "immobile"
 
+	/**
+	 * A sleeping bot is skipped by the NextBotManager until one of the given 
+	 * NextBotWakeEventTypes occurs, or the duration elapses. Behaviors that are
+	 * only waiting use this instead of polling a timer every update.
+	 * Events are still delivered to a sleeping bot's components as they happen.
+	 */
+	void SleepUntil( unsigned int wakeEvents, float maxDuration );
+	void WakeUp( void );
+	bool IsAsleep( void ) const;
+	bool IsWokenBy( unsigned int wakeEvent ) const;			// return true if we are asleep and the given event will wake us
+
+	// events that can wake us
+	virtual void OnInjured( const CTakeDamageInfo &info );
+	virtual void OnKilled( const CTakeDamageInfo &info );
+	virtual void OnIgnite( void );
+	virtual void OnContact( CBaseEntity *other, CGameTrace *result = NULL );
+	virtual void OnShoved( CBaseEntity *pusher );
+	virtual void OnBlinded( CBaseEntity *blinder );
+	virtual void OnSound( CBaseEntity *source, const Vector &pos, KeyValues *keys );
+	virtual void OnWeaponFired( CBaseCombatCharacter *whoFired, CBaseCombatWeapon *weapon );
+	virtual void OnOtherKilled( CBaseCombatCharacter *victim, const CTakeDamageInfo &info );
+
 	/**
 	 * Get the last PathFollower we followed. This method gives other interfaces a
 	 * single accessor to the most recent Path being followed by the myriad of 
@@ -168,6 +192,11 @@ private:
 	bool m_bFlaggedForUpdate;
 	int m_tickLastUpdate;
 
+	bool m_isAsleep;
+	unsigned int m_wakeEvents;
+	CountdownTimer m_sleepTimer;
+	void OnWakeEvent( unsigned int wakeEvent );
+
 	unsigned int m_debugType;
 	mutable int m_debugDisplayLine;
 
@@ -273,6 +302,30 @@ inline void INextBot::SetTickLastUpdate( int tick )
 	m_tickLastUpdate = tick;
 }
 
+inline bool INextBot::IsAsleep( void ) const
+{
+	return m_isAsleep && !m_sleepTimer.IsElapsed();
+}
+
+inline bool INextBot::IsWokenBy( unsigned int wakeEvent ) const
+{
+	return IsAsleep() && ( m_wakeEvents & wakeEvent );
+}
+
+inline void INextBot::WakeUp( void )
+{
+	m_isAsleep = false;
+	m_wakeEvents = 0;
+}
+
+inline void INextBot::OnWakeEvent( unsigned int wakeEvent )
+{
+	if ( IsWokenBy( wakeEvent ) )
+	{
+		WakeUp();
+	}
+}
+
 inline bool INextBot::IsImmobile( void ) const
 {
 	return m_immobileTimer.HasStarted();
@@ -6,6 +6,9 @@
 
 #include "NextBotManager.h"
 #include "NextBotInterface.h"
+#include "NextBotVisibilityBroker.h"
+#include "NextBotActionAllocator.h"
+#include "Path/NextBotPathSearch.h"
 
 #ifdef TERROR
 #include "ZombieBot/Infected/Infected.h"
@@ -14,6 +17,8 @@
 #endif
 
 #include "SharedFunctorUtils.h"
+#include "datacache/imdlcache.h"
+#include "tier0/vprof.h"
 //#include "../../common/blackbox_helper.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -25,6 +30,7 @@ ConVar nb_update_frequency( "nb_update_frequency", ".1", FCVAR_CHEAT );
 ConVar nb_update_framelimit( "nb_update_framelimit", ( IsDebug() ) ? "30" : "15", FCVAR_CHEAT );
 ConVar nb_update_maxslide( "nb_update_maxslide", "2", FCVAR_CHEAT );
 ConVar nb_update_debug( "nb_update_debug", "0", FCVAR_CHEAT );
+ConVar nb_update_threaded( "nb_update_threaded", "1", FCVAR_CHEAT, "If nonzero, resolve the batched sense phase work of scheduled NextBots on worker threads" );
 
 //---------------------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------------------
@@ -242,6 +248,13 @@ NextBotManager::NextBotManager( void )
 	m_selectedBot = NULL;
 	
 	m_iUpdateTickrate = 0;
+	m_senseCount = 0;
+	m_CurUpdateStartTime = 0.0;
+
+	for( int i=0; i<NUM_UPDATE_PHASES; ++i )
+	{
+		m_phaseBudget[i].Reset();
+	}
 }
 
 //---------------------------------------------------------------------------------------------
@@ -270,6 +283,10 @@ void NextBotManager::Reset( void )
 	}
 
 	m_selectedBot = NULL;
+
+	TheNextBotVisibility().Reset();
+	TheNextBotPathCache().Invalidate();
+	TheNextBotActionAllocator().ReleaseUnused();
 }
 
 
@@ -316,11 +333,18 @@ void NextBotManager::Update( void )
 	// schedule full updates
 	if ( m_botList.Count() )
 	{
+		float prevPhaseFrameTime[ NUM_UPDATE_PHASES ] = { 0.0f };
+
 		static int iCurFrame = -1;
 		if ( iCurFrame != gpGlobals->framecount )
 		{
 			iCurFrame = gpGlobals->framecount;
-			m_SumFrameTime = 0;
+
+			for( int p=0; p<NUM_UPDATE_PHASES; ++p )
+			{
+				prevPhaseFrameTime[p] = GetPhaseFrameTime( (UpdatePhaseType)p );
+				m_phaseBudget[p].m_frameTime = 0.0;
+			}
 		}
 		else
 		{
@@ -344,21 +368,26 @@ void NextBotManager::Update( void )
 		int nScheduled = 0;
 		int nNonResponsive = 0;
 		int nDead = 0;
+		int nAsleep = 0;
 		if ( m_iUpdateTickrate > 0 )
 		{
 			INextBot *pBot;
 
-			// Count dead bots, they won't update and balancing calculations should exclude them
+			// Count dead and sleeping bots, they won't update and balancing calculations should exclude them
 			for( i = m_botList.Head(); i != m_botList.InvalidIndex(); i = m_botList.Next( i ) )
 			{
 				if ( IsDead( m_botList[i] ) )
 				{
 					nDead++;
 				}
+				else if ( m_botList[i]->IsAsleep() )
+				{
+					nAsleep++;
+				}
 			}
 
 
-			int nTargetToRun = ceilf( (float)( m_botList.Count() - nDead ) / (float)m_iUpdateTickrate );
+			int nTargetToRun = ceilf( (float)( m_botList.Count() - nDead - nAsleep ) / (float)m_iUpdateTickrate );
 			int curtickcount = gpGlobals->tickcount;
 
 			for( i = m_botList.Head(); nTargetToRun && i != m_botList.InvalidIndex(); i = m_botList.Next( i ) )
@@ -377,7 +406,7 @@ void NextBotManager::Update( void )
 					{
 						break;
 					}
-					if ( !IsDead( pBot ) )
+					if ( !IsDead( pBot ) && !pBot->IsAsleep() )
 					{
 						pBot->FlagForUpdate();
 						nTargetToRun--;
@@ -391,6 +420,11 @@ void NextBotManager::Update( void )
 			nScheduled = m_botList.Count();
 		}
 
+		UpdateSensePhase();
+
+		// resume pathfinding that was too expensive to finish when it was requested
+		TheNextBotPathCache().Update();
+
 		if ( nb_update_debug.GetBool() )
 		{
 			int nIntentionalSliders = 0;
@@ -405,7 +439,11 @@ void NextBotManager::Update( void )
 				}
 			}
 
-			Msg( "Frame %8d/tick %8d: %3d run of %3d, %3d sliders, %3d blocked slides, scheduled %3d for next tick, %3d intentional sliders, %d nonresponsive, %d dead\n", gpGlobals->framecount - 1, gpGlobals->tickcount - 1, g_nRun, m_botList.Count() - nDead, g_nSlid, g_nBlockedSlides, nScheduled, nIntentionalSliders, nNonResponsive, nDead );
+			Msg( "Frame %8d/tick %8d: %3d run of %3d, %3d sliders, %3d blocked slides, scheduled %3d for next tick, %3d intentional sliders, %d nonresponsive, %d dead, %d asleep\n", gpGlobals->framecount - 1, gpGlobals->tickcount - 1, g_nRun, m_botList.Count() - nDead, g_nSlid, g_nBlockedSlides, nScheduled, nIntentionalSliders, nNonResponsive, nDead, nAsleep );
+			Msg( "Frame %8d/tick %8d: sense %.2fms (%.3fms/bot), commit %.2fms (%.3fms/bot), sensed %d for this tick in %.2fms\n", gpGlobals->framecount - 1, gpGlobals->tickcount - 1, 
+				 prevPhaseFrameTime[ UPDATE_PHASE_SENSE ], GetPhaseAverageBotTime( UPDATE_PHASE_SENSE ), 
+				 prevPhaseFrameTime[ UPDATE_PHASE_COMMIT ], GetPhaseAverageBotTime( UPDATE_PHASE_COMMIT ),
+				 m_senseCount, GetPhaseFrameTime( UPDATE_PHASE_SENSE ) );
 			g_nRun = g_nSlid = g_nBlockedSlides = 0;
 		}
 
@@ -413,29 +451,104 @@ void NextBotManager::Update( void )
 }
 
 //---------------------------------------------------------------------------------------------
+/**
+ * Fold the given phase time into this frame's total and the per-bot running average
+ */
+void NextBotManager::PhaseBudget::Accumulate( double frameTime, int botCount )
+{
+	m_frameTime += frameTime;
+
+	if ( botCount > 0 )
+	{
+		const double weight = 0.1;
+		double botTime = frameTime / botCount;
+
+		m_avgBotTime = ( m_avgBotTime > 0.0 ) ? ( 1.0 - weight ) * m_avgBotTime + weight * botTime : botTime;
+	}
+}
+
+
+//---------------------------------------------------------------------------------------------
+/**
+ * Run the sense phase for every bot flagged to update this tick. Each bot queues its
+ * line-of-sight requests, and the visibility broker then resolves them all as one batch.
+ * The results are committed later this frame by each bot's own Update() on the main thread.
+ */
+void NextBotManager::UpdateSensePhase( void )
+{
+	VPROF_BUDGET( "NextBotManager::UpdateSensePhase", "NextBot" );
+
+	double startTime = Plat_FloatTime();
+
+	m_senseCount = 0;
+
+	for( int i=m_botList.Head(); i != m_botList.InvalidIndex(); i = m_botList.Next( i ) )
+	{
+		INextBot *bot = m_botList[i];
+
+		if ( m_iUpdateTickrate > 0 && !bot->IsFlaggedForUpdate() )
+			continue;
+
+		if ( IsDead( bot ) || bot->IsAsleep() )
+			continue;
+
+		if ( bot->PrepareSense() )
+		{
+			++m_senseCount;
+		}
+	}
+
+	// resolve the line-of-sight requests made while preparing, as one batch
+	TheNextBotVisibility().Resolve();
+
+	m_phaseBudget[ UPDATE_PHASE_SENSE ].Accumulate( Plat_FloatTime() - startTime, m_senseCount );
+}
+
+
+//---------------------------------------------------------------------------------------------
+/**
+ * Return true if the given bot should run its full (commit phase) update now.
+ * The frame budget is the main thread time spent in all phases this frame. A scheduled bot
+ * only runs if its expected cost still fits within nb_update_framelimit.
+ */
 bool NextBotManager::ShouldUpdate( INextBot *bot )
 {
+	if ( bot->IsAsleep() )
+	{
+		return false;
+	}
+
 	if ( m_iUpdateTickrate < 1 )
 	{
 		return true;
 	}
 
 	float frameLimit = nb_update_framelimit.GetFloat();
-	float sumFrameTime = 0;
+
+	float usedFrameTime = 0.0f;
+	for( int p=0; p<NUM_UPDATE_PHASES; ++p )
+	{
+		usedFrameTime += GetPhaseFrameTime( (UpdatePhaseType)p );
+	}
+
 	if ( bot->IsFlaggedForUpdate() )
 	{
 		bot->FlagForUpdate( false );
-		sumFrameTime = m_SumFrameTime * 1000.0;
-		if ( frameLimit > 0.0f )
+
+		if ( frameLimit <= 0.0f )
 		{
-			if ( sumFrameTime < frameLimit )
-			{
-				return true;
-			}
-			else if ( nb_update_debug.GetBool() )
-			{
-				Msg( "Frame %8d/tick %8d: frame out of budget (%.2fms > %.2fms)\n", gpGlobals->framecount, gpGlobals->tickcount, sumFrameTime, frameLimit );
-			}
+			// no budget
+			return true;
+		}
+
+		float expectedFrameTime = usedFrameTime + GetPhaseAverageBotTime( UPDATE_PHASE_COMMIT );
+		if ( expectedFrameTime < frameLimit )
+		{
+			return true;
+		}
+		else if ( nb_update_debug.GetBool() )
+		{
+			Msg( "Frame %8d/tick %8d: frame out of budget (%.2fms used + %.2fms expected > %.2fms)\n", gpGlobals->framecount, gpGlobals->tickcount, usedFrameTime, GetPhaseAverageBotTime( UPDATE_PHASE_COMMIT ), frameLimit );
 		}
 	}
 
@@ -443,7 +556,7 @@ bool NextBotManager::ShouldUpdate( INextBot *bot )
 
 	if ( nTicksSlid >= nb_update_maxslide.GetInt() )
 	{
-		if ( frameLimit == 0.0 || sumFrameTime < nb_update_framelimit.GetFloat() * 2.0 )
+		if ( frameLimit <= 0.0f || usedFrameTime < frameLimit * 2.0f )
 		{
 			g_nBlockedSlides++;
 			return true;
@@ -480,7 +593,7 @@ void NextBotManager::NotifyBeginUpdate( INextBot *bot )
 void NextBotManager::NotifyEndUpdate( INextBot *bot )
 {
 	// This might be a good place to detect a particular bot had spiked [3/14/2008 tom]
-	m_SumFrameTime += Plat_FloatTime() - m_CurUpdateStartTime;
+	m_phaseBudget[ UPDATE_PHASE_COMMIT ].Accumulate( Plat_FloatTime() - m_CurUpdateStartTime, 1 );
 }
 
 //---------------------------------------------------------------------------------------------
@@ -690,6 +803,38 @@ void NextBotManager::OnWeaponFired( CBaseCombatCharacter *whoFired, CBaseCombatW
 }
 
 
+//---------------------------------------------------------------------------------------------
+/**
+ * Invoked when an actor enters a new nav area. Wake up the bots that are sleeping until 
+ * an enemy could come into view.
+ */
+void NextBotManager::OnAreaOccupancyChanged( CBaseCombatCharacter *who, CNavArea *area )
+{
+	if ( !who || !area )
+		return;
+
+	for( int i=m_botList.Head(); i != m_botList.InvalidIndex(); i = m_botList.Next( i ) )
+	{
+		INextBot *bot = m_botList[i];
+
+		if ( !bot->IsWokenBy( NEXTBOT_WAKE_ON_AREA_OCCUPANCY ) || !bot->IsEnemy( who ) )
+			continue;
+
+		CNavArea *botArea = bot->GetEntity()->GetLastKnownArea();
+		if ( botArea == NULL || botArea == area )
+		{
+			bot->WakeUp();
+			continue;
+		}
+
+		if ( botArea->IsPotentiallyVisible( area ) && bot->IsRangeLessThan( who, bot->GetVisionInterface()->GetMaxVisionRange() ) )
+		{
+			bot->WakeUp();
+		}
+	}
+}
+
+
 //---------------------------------------------------------------------------------------------
 /**
  * Add given entindex to the debug filter
@@ -8,6 +8,7 @@
 #include "NextBotInterface.h"
 
 class CTerrorPlayer;
+class CNavArea;
 
 //----------------------------------------------------------------------------------------------------------------
 /**
@@ -26,6 +27,21 @@ public:
 	void NotifyBeginUpdate( INextBot *bot );
 	void NotifyEndUpdate( INextBot *bot );
 
+	/**
+	 * Bot updates are split into a read-only "sense" phase, run for all scheduled bots
+	 * at the start of the frame (possibly on worker threads), and a "commit" phase
+	 * which is each bot's own Update() on the main thread.
+	 */
+	enum UpdatePhaseType
+	{
+		UPDATE_PHASE_SENSE,
+		UPDATE_PHASE_COMMIT,
+
+		NUM_UPDATE_PHASES
+	};
+	float GetPhaseFrameTime( UpdatePhaseType phase ) const;		// milliseconds of main thread time spent in the given phase this frame
+	float GetPhaseAverageBotTime( UpdatePhaseType phase ) const;	// running average milliseconds spent per bot in the given phase
+
 	int GetNextBotCount( void ) const;				// How many nextbots are alive right now?
 
 
@@ -109,6 +125,7 @@ public:
 	virtual void OnSound( CBaseEntity *source, const Vector &pos, KeyValues *keys );				// when an entity emits a sound
 	virtual void OnSpokeConcept( CBaseCombatCharacter *who, AIConcept_t concept, AI_Response *response );	// when an Actor speaks a concept
 	virtual void OnWeaponFired( CBaseCombatCharacter *whoFired, CBaseCombatWeapon *weapon );		// when someone fires a weapon
+	virtual void OnAreaOccupancyChanged( CBaseCombatCharacter *who, CNavArea *area );	// when an actor enters a new nav area
 
 	/**
 	 * Debugging
@@ -149,7 +166,24 @@ protected:
 
 	int m_iUpdateTickrate;
 	double m_CurUpdateStartTime;
-	double m_SumFrameTime;
+
+	void UpdateSensePhase( void );					// run the sense phase for all bots scheduled to update this tick
+	int m_senseCount;								// number of bots that queued sense work this tick
+
+	struct PhaseBudget
+	{
+		void Reset( void )
+		{
+			m_frameTime = 0.0;
+			m_avgBotTime = 0.0;
+		}
+
+		void Accumulate( double frameTime, int botCount );
+
+		double m_frameTime;							// seconds spent in this phase during the current frame
+		double m_avgBotTime;						// running average of seconds spent per bot in this phase
+	};
+	PhaseBudget m_phaseBudget[ NUM_UPDATE_PHASES ];
 
 	unsigned int m_debugType;						// debug flags
 
@@ -169,6 +203,16 @@ inline int NextBotManager::GetNextBotCount( void ) const
 	return m_botList.Count();
 }
 
+inline float NextBotManager::GetPhaseFrameTime( UpdatePhaseType phase ) const
+{
+	return m_phaseBudget[ phase ].m_frameTime * 1000.0;
+}
+
+inline float NextBotManager::GetPhaseAverageBotTime( UpdatePhaseType phase ) const
+{
+	return m_phaseBudget[ phase ].m_avgBotTime * 1000.0;
+}
+
 inline bool NextBotManager::IsDebugging( unsigned int type ) const
 {
 	if ( type & m_debugType )
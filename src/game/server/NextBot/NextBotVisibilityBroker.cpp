@@ -0,0 +1,387 @@
+// NextBotVisibilityBroker.cpp
+// Frame-level batching and caching of NextBot line-of-sight queries
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#include "cbase.h"
+
+#include "nav_mesh.h"
+#include "NextBot.h"
+#include "NextBotUtil.h"
+#include "NextBotVisibilityBroker.h"
+
+#include "datacache/imdlcache.h"
+#include "vstdlib/jobthread.h"
+#include "tier0/vprof.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+extern ConVar nb_update_threaded;
+
+ConVar nb_vision_los_cache_time( "nb_vision_los_cache_time", "0.25", FCVAR_CHEAT, "How long, in seconds, a NextBot line-of-sight result can be reused" );
+ConVar nb_vision_los_cache_tolerance( "nb_vision_los_cache_tolerance", "16", FCVAR_CHEAT, "How far either end of a cached NextBot line-of-sight result can move before it is discarded" );
+ConVar nb_vision_los_broker_debug( "nb_vision_los_broker_debug", "0", FCVAR_CHEAT, "Print per-frame statistics of the NextBot line-of-sight broker" );
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Singleton accessor.
+ */
+NextBotVisibilityBroker &TheNextBotVisibility( void )
+{
+	static NextBotVisibilityBroker broker;
+	return broker;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * The eye position used for both ends of a line of sight.
+ * Using the same spot whether an entity is the viewer or the subject
+ * is what lets us share one trace between symmetric pairs.
+ */
+static Vector GetVisibilityEyePosition( CBaseEntity *entity )
+{
+	INextBot *bot = entity->MyNextBotPointer();
+	if ( bot )
+	{
+		return bot->GetBodyInterface()->GetEyePosition();
+	}
+
+	return entity->EyePosition();
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+NextBotVisibilityBroker::NextBotVisibilityBroker( void )
+{
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+void NextBotVisibilityBroker::Reset( void )
+{
+	m_requestVector.RemoveAll();
+	m_pairVector.RemoveAll();
+	m_resultTable.RemoveAll();
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Queue a line-of-sight test from the viewer's eyes to the subject.
+ * This must be called on the main thread, before Resolve().
+ */
+void NextBotVisibilityBroker::AddRequest( INextBot *viewer, CBaseEntity *subject )
+{
+	if ( viewer == NULL || subject == NULL )
+		return;
+
+	Request &request = m_requestVector[ m_requestVector.AddToTail() ];
+	request.m_viewer = viewer;
+	request.m_subject = subject;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Trace the line(s) of sight of a single pair. Run on worker threads.
+ * Eye-to-eye is traced first since the answer is the same in both directions.
+ * Otherwise each needed direction falls back to the other entity's center and feet.
+ */
+void NextBotVisibilityBroker::ResolvePair( PairQuery &pair )
+{
+	// line of sight ignores all actors, so the pass entity only matters for non-actor subjects
+	int passIndex = pair.m_isNeeded[0] ? 1 : 0;
+	NextBotTraceFilterIgnoreActors eyeFilter( pair.m_entity[ passIndex ].Get(), COLLISION_GROUP_NONE );
+
+	trace_t eyeResult;
+	UTIL_TraceLine( pair.m_eye[0], pair.m_eye[1], MASK_BLOCKLOS_AND_NPCS|CONTENTS_IGNORE_NODRAW_OPAQUE, &eyeFilter, &eyeResult );
+
+	bool isEyeClear = ( eyeResult.fraction >= 1.0f && !eyeResult.startsolid );
+
+	for( int from=0; from<2; ++from )
+	{
+		if ( !pair.m_isNeeded[ from ] )
+			continue;
+
+		int to = 1 - from;
+
+		if ( isEyeClear )
+		{
+			pair.m_isClear[ from ] = true;
+			pair.m_visibleSpot[ from ] = pair.m_eye[ to ];
+			continue;
+		}
+
+		trace_t result;
+		NextBotTraceFilterIgnoreActors filter( pair.m_entity[ to ].Get(), COLLISION_GROUP_NONE );
+
+		UTIL_TraceLine( pair.m_eye[ from ], pair.m_center[ to ], MASK_BLOCKLOS_AND_NPCS|CONTENTS_IGNORE_NODRAW_OPAQUE, &filter, &result );
+		if ( result.DidHit() )
+		{
+			UTIL_TraceLine( pair.m_eye[ from ], pair.m_origin[ to ], MASK_BLOCKLOS_AND_NPCS|CONTENTS_IGNORE_NODRAW_OPAQUE, &filter, &result );
+		}
+
+		pair.m_isClear[ from ] = ( result.fraction >= 1.0f && !result.startsolid );
+		pair.m_visibleSpot[ from ] = result.endpos;
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+static void PreResolvePairs( void )
+{
+	mdlcache->BeginLock();
+}
+
+static void PostResolvePairs( void )
+{
+	mdlcache->EndLock();
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Resolve all pending requests. Requests with a usable cached result are skipped,
+ * requests between areas that cannot see each other are culled, and the rest are
+ * merged into unique entity pairs and traced in parallel.
+ */
+void NextBotVisibilityBroker::Resolve( void )
+{
+	VPROF_BUDGET( "NextBotVisibilityBroker::Resolve", "NextBot" );
+
+	PurgeExpiredResults();
+
+	int cachedCount = 0;
+	int culledCount = 0;
+	int mergedCount = 0;
+
+	m_pairVector.RemoveAll();
+
+	// map each unordered pair of entindexes to its index in m_pairVector
+	CUtlHashtable< uint32, int > pairIndexTable;
+
+	FOR_EACH_VEC( m_requestVector, it )
+	{
+		const Request &request = m_requestVector[ it ];
+
+		CBaseCombatCharacter *viewer = request.m_viewer->GetEntity();
+		CBaseEntity *subject = request.m_subject;
+
+		if ( viewer == NULL || subject == NULL || viewer == subject )
+			continue;
+
+		bool isClear;
+		if ( GetResult( request.m_viewer, subject, &isClear ) )
+		{
+			++cachedCount;
+			continue;
+		}
+
+		// use the nav mesh PVS to skip pairs that can't possibly see each other
+		CBaseCombatCharacter *combat = subject->MyCombatCharacterPointer();
+		if ( combat )
+		{
+			CNavArea *viewerArea = viewer->GetLastKnownArea();
+			CNavArea *subjectArea = combat->GetLastKnownArea();
+			if ( viewerArea && subjectArea && !viewerArea->IsPotentiallyVisible( subjectArea ) )
+			{
+				StoreResult( request.m_viewer, subject, false, GetVisibilityEyePosition( viewer ) );
+				++culledCount;
+				continue;
+			}
+		}
+
+		// merge repeated and symmetric requests into a single pair
+		CBaseEntity *lo = viewer;
+		CBaseEntity *hi = subject;
+		if ( lo->entindex() > hi->entindex() )
+		{
+			V_swap( lo, hi );
+		}
+
+		int from = ( lo == viewer ) ? 0 : 1;
+
+		uint32 pairKey = GetResultKey( lo, hi );
+		UtlHashHandle_t h = pairIndexTable.Find( pairKey );
+		if ( h != pairIndexTable.InvalidHandle() )
+		{
+			m_pairVector[ pairIndexTable.Element( h ) ].m_isNeeded[ from ] = true;
+			++mergedCount;
+			continue;
+		}
+
+		pairIndexTable.Insert( pairKey, m_pairVector.Count() );
+
+		PairQuery &pair = m_pairVector[ m_pairVector.AddToTail() ];
+		pair.m_entity[0] = lo;
+		pair.m_entity[1] = hi;
+
+		for( int i=0; i<2; ++i )
+		{
+			CBaseEntity *entity = pair.m_entity[i];
+			pair.m_eye[i] = GetVisibilityEyePosition( entity );
+			pair.m_center[i] = entity->WorldSpaceCenter();
+			pair.m_origin[i] = entity->GetAbsOrigin();
+			pair.m_isNeeded[i] = false;
+			pair.m_isClear[i] = false;
+			pair.m_visibleSpot[i] = pair.m_eye[i];
+		}
+
+		pair.m_isNeeded[ from ] = true;
+	}
+
+	int requestCount = m_requestVector.Count();
+	m_requestVector.RemoveAll();
+
+	if ( m_pairVector.Count() )
+	{
+		if ( nb_update_threaded.GetBool() )
+		{
+			ParallelProcess( "NextBotVisibilityBroker::Resolve", m_pairVector.Base(), m_pairVector.Count(), &ResolvePair, &PreResolvePairs, &PostResolvePairs );
+		}
+		else
+		{
+			FOR_EACH_VEC( m_pairVector, pit )
+			{
+				ResolvePair( m_pairVector[ pit ] );
+			}
+		}
+
+		// publish the results on the main thread
+		FOR_EACH_VEC( m_pairVector, pit )
+		{
+			const PairQuery &pair = m_pairVector[ pit ];
+
+			for( int from=0; from<2; ++from )
+			{
+				if ( !pair.m_isNeeded[ from ] )
+					continue;
+
+				CBaseEntity *viewer = pair.m_entity[ from ];
+				CBaseEntity *subject = pair.m_entity[ 1 - from ];
+				if ( viewer && subject )
+				{
+					StoreResult( viewer->MyNextBotPointer(), subject, pair.m_isClear[ from ], pair.m_visibleSpot[ from ] );
+				}
+			}
+		}
+	}
+
+	VPROF_INCREMENT_COUNTER( "NextBotVisibilityBroker requests", requestCount );
+	VPROF_INCREMENT_COUNTER( "NextBotVisibilityBroker traced pairs", m_pairVector.Count() );
+
+	if ( nb_vision_los_broker_debug.GetBool() && requestCount )
+	{
+		DevMsg( "%3.2f: NextBotVisibilityBroker: %d requests, %d cached, %d culled by PVS, %d merged, %d pairs traced\n",
+				gpGlobals->curtime, requestCount, cachedCount, culledCount, mergedCount, m_pairVector.Count() );
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * If there is a usable result for the line of sight from the viewer's eyes to the subject,
+ * return true and fill in 'isClear' and (optionally) 'visibleSpot'.
+ */
+bool NextBotVisibilityBroker::GetResult( const INextBot *viewer, const CBaseEntity *subject, bool *isClear, Vector *visibleSpot ) const
+{
+	if ( viewer == NULL || subject == NULL )
+		return false;
+
+	CBaseCombatCharacter *viewerEntity = viewer->GetEntity();
+	if ( viewerEntity == NULL || viewerEntity->entindex() < 0 || subject->entindex() < 0 )
+		return false;
+
+	UtlHashHandle_t h = m_resultTable.Find( GetResultKey( viewerEntity, subject ) );
+	if ( h == m_resultTable.InvalidHandle() )
+		return false;
+
+	const Result &result = m_resultTable.Element( h );
+
+	// make sure the entity slots haven't been reused
+	if ( result.m_viewer.Get() != viewerEntity || result.m_subject.Get() != subject )
+		return false;
+
+	if ( result.m_timestamp < gpGlobals->curtime )
+	{
+		if ( gpGlobals->curtime - result.m_timestamp > nb_vision_los_cache_time.GetFloat() )
+			return false;
+
+		// a result from an earlier frame is only good if neither end has moved much
+		float toleranceSq = nb_vision_los_cache_tolerance.GetFloat() * nb_vision_los_cache_tolerance.GetFloat();
+
+		if ( ( result.m_subjectCenter - subject->WorldSpaceCenter() ).LengthSqr() > toleranceSq )
+			return false;
+
+		if ( ( result.m_viewerEye - viewer->GetBodyInterface()->GetEyePosition() ).LengthSqr() > toleranceSq )
+			return false;
+	}
+
+	*isClear = result.m_isClear;
+
+	if ( visibleSpot )
+	{
+		*visibleSpot = result.m_visibleSpot;
+	}
+
+	return true;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * Cache a line-of-sight result computed elsewhere, so other queries this frame
+ * (and for a short while after) can reuse it
+ */
+void NextBotVisibilityBroker::StoreResult( const INextBot *viewer, const CBaseEntity *subject, bool isClear, const Vector &visibleSpot )
+{
+	if ( viewer == NULL || subject == NULL )
+		return;
+
+	CBaseCombatCharacter *viewerEntity = viewer->GetEntity();
+	if ( viewerEntity == NULL || viewerEntity->entindex() < 0 || subject->entindex() < 0 )
+		return;
+
+	Result result;
+	result.m_viewer = viewerEntity;
+	result.m_subject = subject;
+	result.m_viewerEye = viewer->GetBodyInterface()->GetEyePosition();
+	result.m_subjectCenter = subject->WorldSpaceCenter();
+	result.m_visibleSpot = visibleSpot;
+	result.m_timestamp = gpGlobals->curtime;
+	result.m_isClear = isClear;
+
+	uint32 key = GetResultKey( viewerEntity, subject );
+	UtlHashHandle_t h = m_resultTable.Find( key );
+	if ( h == m_resultTable.InvalidHandle() )
+	{
+		m_resultTable.Insert( key, result );
+	}
+	else
+	{
+		m_resultTable.Element( h ) = result;
+	}
+}
+
+
+//----------------------------------------------------------------------------------------------------------------
+void NextBotVisibilityBroker::PurgeExpiredResults( void )
+{
+	float maxAge = nb_vision_los_cache_time.GetFloat();
+
+	UtlHashHandle_t h = m_resultTable.FirstHandle();
+	while( h != m_resultTable.InvalidHandle() )
+	{
+		if ( gpGlobals->curtime - m_resultTable.Element( h ).m_timestamp > maxAge )
+		{
+			h = m_resultTable.RemoveAndAdvance( h );
+		}
+		else
+		{
+			h = m_resultTable.NextHandle( h );
+		}
+	}
+}
@@ -0,0 +1,92 @@
+// NextBotVisibilityBroker.h
+// Frame-level batching and caching of NextBot line-of-sight queries
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#ifndef _NEXT_BOT_VISIBILITY_BROKER_H_
+#define _NEXT_BOT_VISIBILITY_BROKER_H_
+
+#include "utlhashtable.h"
+
+class INextBot;
+
+
+//----------------------------------------------------------------------------------------------------------------
+/**
+ * The visibility broker collects the line-of-sight requests of every bot for the current
+ * frame during the NextBot sense phase. It culls them with the nav mesh PVS, merges repeated
+ * and symmetric (A sees B, B sees A) pairs, and traces the survivors as a single parallel batch.
+ *
+ * Results are kept in a table keyed by (viewer, subject) and are reused by later queries
+ * until they expire or either entity moves too far, so bots can scan more often
+ * without paying for more traces.
+ */
+class NextBotVisibilityBroker
+{
+public:
+	NextBotVisibilityBroker( void );
+
+	void Reset( void );											// discard all pending requests and cached results
+
+	void AddRequest( INextBot *viewer, CBaseEntity *subject );	// queue a line-of-sight test to be resolved by the next Resolve()
+	void Resolve( void );										// resolve all pending requests as one batch
+
+	/**
+	 * If there is a usable result for the line of sight from the viewer's eyes to the subject,
+	 * return true and fill in 'isClear' and (optionally) 'visibleSpot'.
+	 */
+	bool GetResult( const INextBot *viewer, const CBaseEntity *subject, bool *isClear, Vector *visibleSpot = NULL ) const;
+	void StoreResult( const INextBot *viewer, const CBaseEntity *subject, bool isClear, const Vector &visibleSpot );	// cache a result computed elsewhere
+
+private:
+	struct Request
+	{
+		INextBot *m_viewer;
+		CHandle< CBaseEntity > m_subject;
+	};
+	CUtlVector< Request > m_requestVector;
+
+	// a pair of entities, with the line of sight needed in one or both directions
+	struct PairQuery
+	{
+		CHandle< CBaseEntity > m_entity[2];
+		Vector m_eye[2];
+		Vector m_center[2];
+		Vector m_origin[2];
+
+		bool m_isNeeded[2];								// [i] is the line of sight from m_entity[i] to the other entity
+		bool m_isClear[2];
+		Vector m_visibleSpot[2];
+	};
+	CUtlVector< PairQuery > m_pairVector;
+	static void ResolvePair( PairQuery &pair );
+
+	struct Result
+	{
+		CHandle< CBaseEntity > m_viewer;
+		CHandle< CBaseEntity > m_subject;
+		Vector m_viewerEye;								// where the line of sight was traced from and to
+		Vector m_subjectCenter;
+		Vector m_visibleSpot;
+		float m_timestamp;
+		bool m_isClear;
+	};
+	CUtlHashtable< uint32, Result > m_resultTable;
+	void PurgeExpiredResults( void );
+
+	static uint32 GetResultKey( const CBaseEntity *viewer, const CBaseEntity *subject );
+};
+
+
+//----------------------------------------------------------------------------------------------------------------
+inline uint32 NextBotVisibilityBroker::GetResultKey( const CBaseEntity *viewer, const CBaseEntity *subject )
+{
+	// entindex is less than MAX_EDICTS, which fits easily in 16 bits
+	return ( (uint32)viewer->entindex() << 16 ) | (uint32)subject->entindex();
+}
+
+
+// singleton accessor
+extern NextBotVisibilityBroker &TheNextBotVisibility( void );
+
+
+#endif // _NEXT_BOT_VISIBILITY_BROKER_H_
@@ -12,6 +12,7 @@
 #include "NextBotVisionInterface.h"
 #include "NextBotBodyInterface.h"
 #include "NextBotUtil.h"
+#include "NextBotVisibilityBroker.h"
 
 #ifdef TERROR
 #include "querycache.h"
@@ -42,10 +43,13 @@ void IVision::Reset( void )
 {
 	INextBotComponent::Reset();
 
-	m_knownEntityVector.RemoveAll();
+	ClearKnownEntityTable();
 	m_lastVisionUpdateTimestamp = 0.0f;
 	m_primaryThreat = NULL;
 
+	m_sensePotentiallyVisibleVector.RemoveAll();
+	m_senseTick = -1;
+
 	m_FOV = GetDefaultFieldOfView();
 	m_cosHalfFOV = cos( 0.5f * m_FOV * M_PI / 180.0f );
 	
@@ -56,6 +60,90 @@ void IVision::Reset( void )
 }
 
 
+//------------------------------------------------------------------------------------------
+/**
+ * Return the index of the given entity in m_knownEntityVector, or -1 if we don't know of it
+ */
+int IVision::FindKnownEntity( const CBaseEntity *entity ) const
+{
+	if ( entity == NULL )
+		return -1;
+
+	int entry = entity->GetRefEHandle().GetEntryIndex();
+	if ( !m_isKnownEntry.IsBitSet( entry ) )
+		return -1;
+
+	int i = m_knownEntitySlot[ entry ];
+
+	// the element may be left over from a deleted entity that used the same entry
+	if ( m_knownEntityVector[i].GetEntity() != entity )
+		return -1;
+
+	return i;
+}
+
+
+//------------------------------------------------------------------------------------------
+/**
+ * Add an element for the given entity, which must not already be known, and return its index
+ */
+int IVision::AddKnownEntityToTable( CBaseEntity *entity )
+{
+	CKnownEntity known( entity );
+
+	int entry = entity->GetRefEHandle().GetEntryIndex();
+	if ( m_isKnownEntry.IsBitSet( entry ) )
+	{
+		// reuse the element left over from a deleted entity that used the same entry
+		int i = m_knownEntitySlot[ entry ];
+		Assert( m_knownEntityVector[i].GetEntity() != entity );
+
+		m_knownEntityVector[i] = known;
+		return i;
+	}
+
+	int i = m_knownEntityVector.AddToTail( known );
+	m_knownEntityEntry.AddToTail( entry );
+
+	m_knownEntitySlot[ entry ] = i;
+	m_isKnownEntry.Set( entry );
+
+	return i;
+}
+
+
+//------------------------------------------------------------------------------------------
+/**
+ * Remove the i'th element of m_knownEntityVector. The last element takes its place.
+ */
+void IVision::RemoveKnownEntityFromTable( int i )
+{
+	m_isKnownEntry.Clear( m_knownEntityEntry[i] );
+
+	int last = m_knownEntityVector.Count()-1;
+	if ( i != last )
+	{
+		m_knownEntitySlot[ m_knownEntityEntry[ last ] ] = i;
+	}
+
+	m_knownEntityVector.FastRemove( i );
+	m_knownEntityEntry.FastRemove( i );
+}
+
+
+//------------------------------------------------------------------------------------------
+void IVision::ClearKnownEntityTable( void )
+{
+	FOR_EACH_VEC( m_knownEntityEntry, it )
+	{
+		m_isKnownEntry.Clear( m_knownEntityEntry[ it ] );
+	}
+
+	m_knownEntityVector.RemoveAll();
+	m_knownEntityEntry.RemoveAll();
+}
+
+
 //------------------------------------------------------------------------------------------
 /**
  * Ask the current behavior to select the most dangerous threat from
@@ -189,20 +277,11 @@ const CKnownEntity *IVision::GetClosestKnown( const INextBotEntityFilter &filter
  */
 const CKnownEntity *IVision::GetKnown( const CBaseEntity *entity ) const
 {
-	if ( entity == NULL )
+	int i = FindKnownEntity( entity );
+	if ( i < 0 || m_knownEntityVector[i].IsObsolete() )
 		return NULL;
 
-	for( int i=0; i < m_knownEntityVector.Count(); ++i )
-	{
-		const CKnownEntity &known = m_knownEntityVector[i];
-
-		if ( known.GetEntity() && known.GetEntity()->entindex() == entity->entindex() && !known.IsObsolete() )
-		{
-			return &known;
-		}
-	}
-
-	return NULL;
+	return &m_knownEntityVector[i];
 }
 
 
@@ -220,33 +299,44 @@ void IVision::AddKnownEntity( CBaseEntity *entity )
 		return;
 	}
 
-	CKnownEntity known( entity );
-
 	// only add it if we don't already know of it
-	if ( m_knownEntityVector.Find( known ) == m_knownEntityVector.InvalidIndex() )
+	if ( FindKnownEntity( entity ) < 0 )
 	{
-		m_knownEntityVector.AddToTail( known );
+		AddKnownEntityToTable( entity );
 	}
 }
 
 
 //------------------------------------------------------------------------------------------
-// Remove the given entity from our awareness (whether we know if it or not)
-// Useful if we've moved to where we last saw the entity, but it's not there any longer.
-void IVision::ForgetEntity( CBaseEntity *forgetMe )
+void IVision::AddVisibleEntity( CBaseEntity *entity )
 {
-	if ( !forgetMe )
+	if ( entity == NULL || entity->IsWorld() )
+	{
 		return;
+	}
 
-	FOR_EACH_VEC( m_knownEntityVector, it )
+	int i = FindKnownEntity( entity );
+	if ( i < 0 )
 	{
-		const CKnownEntity &known = m_knownEntityVector[ it ];
+		i = AddKnownEntityToTable( entity );
+	}
 
-		if ( known.GetEntity() && known.GetEntity()->entindex() == forgetMe->entindex() )
-		{
-			m_knownEntityVector.FastRemove( it );
-			return;
-		}
+	m_knownEntityVector[i].UpdatePosition();
+	m_knownEntityVector[i].UpdateVisibilityStatus( true );
+
+	m_notVisibleTimer[ entity->GetTeamNumber() ].Start();
+}
+
+
+//------------------------------------------------------------------------------------------
+// Remove the given entity from our awareness (whether we know if it or not)
+// Useful if we've moved to where we last saw the entity, but it's not there any longer.
+void IVision::ForgetEntity( CBaseEntity *forgetMe )
+{
+	int i = FindKnownEntity( forgetMe );
+	if ( i >= 0 )
+	{
+		RemoveKnownEntityFromTable( i );
 	}
 }
 
@@ -254,7 +344,7 @@ void IVision::ForgetEntity( CBaseEntity *forgetMe )
 //------------------------------------------------------------------------------------------
 void IVision::ForgetAllKnownEntities( void )
 {
-	m_knownEntityVector.RemoveAll();
+	ClearKnownEntityTable();
 }
 
 
@@ -341,6 +431,7 @@ public:
 			 m_vision->IsAbleToSee( entity, IVision::USE_FOV ) )
 		{
 			m_recognized.AddToTail( entity );	
+			m_isRecognized.Set( entity->GetRefEHandle().GetEntryIndex() );
 		}
 			
 		return true;
@@ -348,18 +439,21 @@ public:
 	
 	bool Contains( CBaseEntity *entity ) const
 	{
-		for( int i=0; i < m_recognized.Count(); ++i )
+		return m_isRecognized.IsBitSet( entity->GetRefEHandle().GetEntryIndex() );
+	}
+
+	void Add( CBaseEntity *entity )						// count the entity as visible without checking
+	{
+		if ( entity && !Contains( entity ) )
 		{
-			if ( entity->entindex() == m_recognized[ i ]->entindex() )
-			{
-				return true;
-			}
+			m_recognized.AddToTail( entity );
+			m_isRecognized.Set( entity->GetRefEHandle().GetEntryIndex() );
 		}
-		return false;
 	}
 	
 	IVision *m_vision;
 	CUtlVector< CBaseEntity * > m_recognized;
+	CBitVec< NUM_ENT_ENTRIES > m_isRecognized;		// handle entries of m_recognized
 };
 
 
@@ -370,7 +464,22 @@ void IVision::UpdateKnownEntities( void )
 
 	// construct set of potentially visible objects
 	CUtlVector< CBaseEntity * > potentiallyVisible;
-	CollectPotentiallyVisibleEntities( &potentiallyVisible );
+	if ( m_senseTick == gpGlobals->tickcount )
+	{
+		// reuse the set we collected for this tick's sense phase
+		FOR_EACH_VEC( m_sensePotentiallyVisibleVector, sit )
+		{
+			CBaseEntity *entity = m_sensePotentiallyVisibleVector[ sit ];
+			if ( entity )
+			{
+				potentiallyVisible.AddToTail( entity );
+			}
+		}
+	}
+	else
+	{
+		CollectPotentiallyVisibleEntities( &potentiallyVisible );
+	}
 
 	// collect set of visible and recognized entities at this moment
 	CollectVisible visibleNow( this );
@@ -381,22 +490,53 @@ void IVision::UpdateKnownEntities( void )
 		if ( visibleNow( potentiallyVisible[ pit ] ) == false )
 			break;
 	}
+
+	// include what others have seen for us, so we don't lose sight of it just to see it again
+	CUtlVector< CBaseEntity * > sharedVisible;
+	CollectSharedVisibleEntities( &sharedVisible );
+	FOR_EACH_VEC( sharedVisible, sit )
+	{
+		visibleNow.Add( sharedVisible[ sit ] );
+	}
 	
+	// clear out obsolete knowledge, keeping the rest in order
+	{
+		int keep = 0;
+		for( int i=0; i < m_knownEntityVector.Count(); ++i )
+		{
+			const CKnownEntity &known = m_knownEntityVector[i];
+			int entry = m_knownEntityEntry[i];
+
+			if ( known.GetEntity() == NULL || known.IsObsolete() )
+			{
+				m_isKnownEntry.Clear( entry );
+				continue;
+			}
+
+			if ( keep != i )
+			{
+				m_knownEntityVector[ keep ] = known;
+				m_knownEntityEntry[ keep ] = entry;
+				m_knownEntitySlot[ entry ] = keep;
+			}
+
+			++keep;
+		}
+
+		m_knownEntityVector.RemoveMultipleFromTail( m_knownEntityVector.Count() - keep );
+		m_knownEntityEntry.RemoveMultipleFromTail( m_knownEntityEntry.Count() - keep );
+	}
+
 	// update known set with new data
 	{	VPROF_BUDGET( "IVision::UpdateKnownEntities( update status )", "NextBot" );
 
-		int i;
-		for( i=0; i < m_knownEntityVector.Count(); ++i )
+		for( int i=0; i < m_knownEntityVector.Count(); ++i )
 		{
 			CKnownEntity &known = m_knownEntityVector[i];
 
-			// clear out obsolete knowledge
-			if ( known.GetEntity() == NULL || known.IsObsolete() )
-			{
-				m_knownEntityVector.Remove( i );
-				--i;
+			// an event handler may have deleted the entity
+			if ( known.GetEntity() == NULL )
 				continue;
-			}
 			
 			if ( visibleNow.Contains( known.GetEntity() ) )
 			{
@@ -460,24 +600,14 @@ void IVision::UpdateKnownEntities( void )
 	// check for new recognizes that were not in the known set
 	{	VPROF_BUDGET( "IVision::UpdateKnownEntities( new recognizes )", "NextBot" );
 
-		int i, j;
-		for( i=0; i < visibleNow.m_recognized.Count(); ++i )
+		for( int i=0; i < visibleNow.m_recognized.Count(); ++i )
 		{	
-			for( j=0; j < m_knownEntityVector.Count(); ++j )
-			{
-				if ( visibleNow.m_recognized[i] == m_knownEntityVector[j].GetEntity() )
-				{
-					break;
-				}
-			}
-			
-			if ( j == m_knownEntityVector.Count() )
+			if ( FindKnownEntity( visibleNow.m_recognized[i] ) < 0 )
 			{
 				// recognized a previously unknown entity (emit OnSight() event after reaction time has passed)
-				CKnownEntity known( visibleNow.m_recognized[i] );
+				CKnownEntity &known = m_knownEntityVector[ AddKnownEntityToTable( visibleNow.m_recognized[i] ) ];
 				known.UpdatePosition();
 				known.UpdateVisibilityStatus( true );
-				m_knownEntityVector.AddToTail( known );
 			}
 		}
 	}
@@ -554,7 +684,7 @@ void IVision::Update( void )
 
 	if ( nb_blind.GetBool() )
 	{
-		m_knownEntityVector.RemoveAll();
+		ClearKnownEntityTable();
 		return;
 	}
 
@@ -565,10 +695,57 @@ void IVision::Update( void )
 
 
 //------------------------------------------------------------------------------------------
-bool IVision::IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV, Vector *visibleSpot ) const
+/**
+ * Main thread half of the two-phase update.
+ * Collect the entities we could see this tick and submit a line-of-sight request
+ * to the visibility broker for each one that passes the cheap visibility tests.
+ * The broker resolves every bot's requests together before any bot's Update() runs.
+ */
+bool IVision::PrepareSense( void )
 {
-	VPROF_BUDGET( "IVision::IsAbleToSee", "NextBotExpensive" );
+	m_sensePotentiallyVisibleVector.RemoveAll();
+	m_senseTick = -1;
+
+	bool hasRequests = false;
+
+#ifndef TERROR	// line-of-sight queries are serviced by the querycache
+	if ( nb_blind.GetBool() )
+	{
+		return false;
+	}
+
+	CUtlVector< CBaseEntity * > potentiallyVisible;
+	CollectPotentiallyVisibleEntities( &potentiallyVisible );
+
+	FOR_EACH_VEC( potentiallyVisible, it )
+	{
+		CBaseEntity *subject = potentiallyVisible[ it ];
+
+		m_sensePotentiallyVisibleVector.AddToTail( subject );
+
+		if ( subject == NULL || !subject->IsAlive() || subject == GetBot()->GetEntity() || IsIgnored( subject ) )
+			continue;
 
+		if ( IsPotentiallyAbleToSee( subject, USE_FOV ) )
+		{
+			TheNextBotVisibility().AddRequest( GetBot(), subject );
+			hasRequests = true;
+		}
+	}
+
+	m_senseTick = gpGlobals->tickcount;
+#endif
+
+	return hasRequests;
+}
+
+
+//------------------------------------------------------------------------------------------
+/**
+ * Return true if the subject passes all of the IsAbleToSee() tests except the line-of-sight trace
+ */
+bool IVision::IsPotentiallyAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV ) const
+{
 	if ( GetBot()->IsRangeGreaterThan( subject, GetMaxVisionRange() ) )
 	{
 		return false;
@@ -601,6 +778,20 @@ bool IVision::IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV,
 		}
 	}
 
+	return true;
+}
+
+
+//------------------------------------------------------------------------------------------
+bool IVision::IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV, Vector *visibleSpot ) const
+{
+	VPROF_BUDGET( "IVision::IsAbleToSee", "NextBotExpensive" );
+
+	if ( !IsPotentiallyAbleToSee( subject, checkFOV ) )
+	{
+		return false;
+	}
+
 	// do actual line-of-sight trace
 	if ( !IsLineOfSightClearToEntity( subject ) )
 	{
@@ -749,6 +940,13 @@ bool IVision::IsLineOfSightClearToEntity( const CBaseEntity *subject, Vector *vi
 	// TODO: Use plain-old traces until querycache/etc gets integrated
 	VPROF_BUDGET( "IVision::IsLineOfSightClearToEntity", "NextBot" );
 
+	// use the visibility broker's result, if it has a recent one
+	bool isClear;
+	if ( TheNextBotVisibility().GetResult( GetBot(), subject, &isClear, visibleSpot ) )
+	{
+		return isClear;
+	}
+
 	trace_t result;
 	NextBotTraceFilterIgnoreActors filter( subject, COLLISION_GROUP_NONE );
 
@@ -768,7 +966,11 @@ bool IVision::IsLineOfSightClearToEntity( const CBaseEntity *subject, Vector *vi
 		*visibleSpot = result.endpos;
 	}
 
-	return ( result.fraction >= 1.0f && !result.startsolid );
+	isClear = ( result.fraction >= 1.0f && !result.startsolid );
+
+	TheNextBotVisibility().StoreResult( GetBot(), subject, isClear, result.endpos );
+
+	return isClear;
 
 #endif
 }
@@ -26,6 +26,8 @@ public:
 	virtual void Reset( void );									// reset to initial state
 	virtual void Update( void );								// update internal state
 
+	virtual bool PrepareSense( void );							// submit this tick's line-of-sight queries to the visibility broker
+
 	//-- attention/short term memory interface follows ------------------------------------------
 
 	//
@@ -61,6 +63,10 @@ public:
 	// of known entities by being told about them, hearing them, etc.
 	virtual void AddKnownEntity( CBaseEntity *entity );
 
+	// Mark the given entity as visible to us right now without doing our own line-of-sight check,
+	// for when a nearby ally has just seen it. This does not emit OnSight().
+	virtual void AddVisibleEntity( CBaseEntity *entity );
+
 	virtual void ForgetEntity( CBaseEntity *forgetMe );			// remove the given entity from our awareness (whether we know if it or not)
 	virtual void ForgetAllKnownEntities( void );
 
@@ -72,6 +78,12 @@ public:
 	 */
 	virtual void CollectPotentiallyVisibleEntities( CUtlVector< CBaseEntity * > *potentiallyVisible );
 
+	/**
+	 * Populate "sharedVisible" with entities others have just seen for us. IVision::Update() treats them
+	 * as visible along with the ones it saw itself, before deciding which known entities we lost sight of.
+	 */
+	virtual void CollectSharedVisibleEntities( CUtlVector< CBaseEntity * > *sharedVisible ) { }
+
 	virtual float GetMaxVisionRange( void ) const;				// return maximum distance vision can reach
 	virtual float GetMinRecognizeTime( void ) const;			// return VISUAL reaction time
 
@@ -83,6 +95,7 @@ public:
 	enum FieldOfViewCheckType { USE_FOV, DISREGARD_FOV };
 	virtual bool IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV, Vector *visibleSpot = NULL ) const;
 	virtual bool IsAbleToSee( const Vector &pos, FieldOfViewCheckType checkFOV ) const;
+	bool IsPotentiallyAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV ) const;	// IsAbleToSee() without the line-of-sight trace
 
 	virtual bool IsIgnored( CBaseEntity *subject ) const;		// return true to completely ignore this entity (may not be in sight when this is called)
 	virtual bool IsVisibleEntityNoticed( CBaseEntity *subject ) const;		// return true if we 'notice' the subject, even though we have LOS to it
@@ -115,12 +128,26 @@ private:
 	float m_cosHalfFOV;					// the cosine of FOV/2
 	
 	CUtlVector< CKnownEntity > m_knownEntityVector;		// the set of enemies/friends we are aware of
+
+	// m_knownEntityVector indexed by entity handle entry, so lookups don't search the vector
+	CBitVec< NUM_ENT_ENTRIES > m_isKnownEntry;			// set if the entry has an element in m_knownEntityVector
+	unsigned short m_knownEntitySlot[ NUM_ENT_ENTRIES ];	// index of the element for each set entry of m_isKnownEntry
+	CUtlVector< unsigned short > m_knownEntityEntry;	// entry of each element of m_knownEntityVector, which remains valid after its entity is deleted
+
+	int FindKnownEntity( const CBaseEntity *entity ) const;	// return index of the entity in m_knownEntityVector, or -1
+	int AddKnownEntityToTable( CBaseEntity *entity );		// return index of the new element for the entity, replacing any stale element for its entry
+	void RemoveKnownEntityFromTable( int i );
+	void ClearKnownEntityTable( void );
+
 	void UpdateKnownEntities( void );
 	bool IsAwareOf( const CKnownEntity &known ) const;	// return true if our reaction time has passed for this entity
 	mutable CHandle< CBaseEntity > m_primaryThreat;
 
 	float m_lastVisionUpdateTimestamp;
 	IntervalTimer m_notVisibleTimer[ MAX_TEAMS ];		// for tracking interval since last saw a member of the given team
+
+	CUtlVector< CHandle< CBaseEntity > > m_sensePotentiallyVisibleVector;	// potentially visible set collected during the sense phase of m_senseTick
+	int m_senseTick;
 };
 
 inline void IVision::CollectKnownEntities( CUtlVector< CKnownEntity > *knownVector )
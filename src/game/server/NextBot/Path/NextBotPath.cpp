@@ -22,6 +22,7 @@
 ConVar NextBotPathDrawIncrement( "nb_path_draw_inc", "100", FCVAR_CHEAT );
 ConVar NextBotPathDrawSegmentCount( "nb_path_draw_segment_count", "100", FCVAR_CHEAT );
 ConVar NextBotPathSegmentInfluenceRadius( "nb_path_segment_influence_radius", "100", FCVAR_CHEAT );
+ConVar NextBotPathCorridorRefineRange( "nb_path_corridor_refine_range", "750", FCVAR_CHEAT, "Refine a partial corridor path when the bot is this close to its end" );
 
 //--------------------------------------------------------------------------------------------------------------
 Path::Path( void )
@@ -33,6 +34,7 @@ Path::Path( void )
 	m_cursorData.segmentPrior = NULL;
 	m_ageTimer.Invalidate();
 	m_subject = NULL;
+	m_corridorCost = NULL;
 }
 
 
@@ -452,6 +454,202 @@ bool Path::BuildTrivialPath( INextBot *bot, const Vector &goal )
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * If the cost function can be shared between bots, get the areas along the path from the path cache.
+ * Returns NULL if the path can't be cached, in which case the caller searches for it as usual.
+ * If the search is long and we already have a path to the same goal area, the search may be
+ * finished over the next few frames, in which case NULL is returned and 'isDeferred' is set.
+ */
+const NextBotPathCache::Entry *Path::ComputeCachedAreaPath( INextBot *bot, CNavArea *startArea, CNavArea *goalArea, const Vector &goalPos, const IPathCost *costFunc, float maxPathLength, bool *isDeferred )
+{
+	*isDeferred = false;
+
+	if ( costFunc == NULL || goalArea == NULL || maxPathLength > 0.0f || !TheNextBotPathCache().IsEnabled() )
+		return NULL;
+
+	NextBotPathCache::Key key;
+	key.m_costKind = costFunc->GetCacheKind();
+	if ( key.m_costKind == 0 )
+		return NULL;
+
+	key.m_startArea = startArea;
+	key.m_goalArea = goalArea;
+	key.m_teamID = bot->GetEntity()->GetTeamNumber();
+
+	const Segment *last = LastSegment();
+	bool canDefer = ( last && last->area == goalArea );
+
+	const NextBotPathCache::Entry *cachedPath = TheNextBotPathCache().Compute( key, goalPos, *costFunc, bot->GetEntity(), canDefer );
+
+	*isDeferred = ( cachedPath == NULL );
+
+	return cachedPath;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * If the nav mesh can find a corridor to the distant goal, build this path along the first part of it.
+ * We keep a copy of the cost function so the rest can be computed as we approach the end of this path.
+ * Returns false if the corridor can't be used, in which case the caller searches for the path as usual.
+ */
+bool Path::ComputeCorridorAreaPath( INextBot *bot, CNavArea *startArea, CNavArea *goalArea, const Vector &goalPos, const IPathCost *costFunc, float maxPathLength, bool *pathResult )
+{
+	if ( costFunc == NULL || goalArea == NULL || maxPathLength > 0.0f )
+		return false;
+
+	// The cluster route is chosen by portal distance alone, so it would override costs that vary
+	// from bot to bot or over time (route preferences, danger avoidance, etc). Only costs that
+	// depend on the areas alone, which are the ones the path cache can share, may use it.
+	if ( costFunc->GetCacheKind() == 0 )
+		return false;
+
+	// don't pay for copying the cost function and searching for a corridor on short paths
+	if ( !TheNavMesh->IsCorridorPathWorthwhile( startArea, goalArea ) )
+		return false;
+
+	// without our own copy of the cost function we couldn't finish the path later
+	IPathCost *corridorCost = costFunc->Clone();
+	if ( corridorCost == NULL )
+		return false;
+
+	CUtlVector< NavPathArea > areaVector;
+	bool reachesGoal;
+	if ( !TheNavMesh->ComputeCorridorPath( startArea, goalArea, *costFunc, bot->GetEntity()->GetTeamNumber(), &areaVector, &reachesGoal ) || areaVector.Count() == 0 )
+	{
+		delete corridorCost;
+		return false;
+	}
+
+	Invalidate();
+
+	if ( reachesGoal )
+	{
+		delete corridorCost;
+
+		// make sure path end position is on the ground
+		Vector pathEndPosition = goalPos;
+		pathEndPosition.z = goalArea->GetZ( pathEndPosition );
+
+		*pathResult = AssembleAreaPath( bot, areaVector, true, pathEndPosition, true );
+		return true;
+	}
+
+	// the path ends where the corridor enters the next cluster, so it is reported as partial, and IsCorridorPartial() is
+	// true until it has been refined. The corridor search found the goal reachable, so Compute() still succeeds.
+	AssembleAreaPath( bot, areaVector, false, areaVector.Tail().area->GetCenter(), true );
+	*pathResult = IsValid();
+
+	if ( *pathResult )
+	{
+		m_corridorCost = corridorCost;
+		m_corridorGoal = goalPos;
+	}
+	else
+	{
+		delete corridorCost;
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Recompute the path from our position to the goal of its corridor
+ */
+bool Path::RefineCorridorPath( INextBot *bot )
+{
+	VPROF_BUDGET( "Path::RefineCorridorPath", "NextBot" );
+
+	if ( m_corridorCost == NULL )
+		return false;
+
+	// take ownership, since recomputing invalidates the path
+	IPathCost *corridorCost = m_corridorCost;
+	m_corridorCost = NULL;
+
+	Vector goal = m_corridorGoal;
+	bool result = Compute( bot, goal, *corridorCost );
+
+	delete corridorCost;
+
+	return result;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Determine if the path should be refined now: only partial corridor paths whose end is near
+ */
+bool Path::IsTimeToRefineCorridor( INextBot *bot ) const
+{
+	if ( !IsCorridorPartial() || !IsValid() )
+		return false;
+
+	return ( LastSegment()->pos - bot->GetPosition() ).IsLengthLessThan( NextBotPathCorridorRefineRange.GetFloat() );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Build this path from a sequence of areas found by a search, the same way Compute() does from the parent links
+ */
+bool Path::AssembleAreaPath( INextBot *bot, const CUtlVector< NavPathArea > &areaVector, bool isComplete, const Vector &goalPos, bool includeGoalIfPathFails )
+{
+	VPROF_BUDGET( "Path::AssembleAreaPath", "NextBot" );
+
+	bool pathResult = isComplete;
+
+	// save room for endpoint - if the path is too long, keep the end nearest the goal
+	int count = MIN( areaVector.Count(), MAX_PATH_SEGMENTS-1 );
+	if ( count <= 1 )
+	{
+		BuildTrivialPath( bot, goalPos );
+		return pathResult;
+	}
+
+	// assemble path
+	int first = areaVector.Count() - count;
+	m_segmentCount = count;
+	for( int i=0; i<count; ++i )
+	{
+		m_path[ i ].area = areaVector[ first + i ].area;
+		m_path[ i ].how = areaVector[ first + i ].how;
+		m_path[ i ].type = ON_GROUND;
+	}
+
+	if ( pathResult || includeGoalIfPathFails )
+	{
+		// append actual goal position
+		m_path[ m_segmentCount ].area = areaVector.Tail().area;
+		m_path[ m_segmentCount ].pos = goalPos;
+		m_path[ m_segmentCount ].ladder = NULL;
+		m_path[ m_segmentCount ].how = NUM_TRAVERSE_TYPES;
+		m_path[ m_segmentCount ].type = ON_GROUND;
+		++m_segmentCount;
+	}
+
+	// compute path positions
+	if ( ComputePathDetails( bot, bot->GetPosition() ) == false )
+	{
+		Invalidate();
+		OnPathChanged( bot, NO_PATH );
+		return false;
+	}
+
+	// remove redundant nodes and clean up path
+	Optimize( bot );
+
+	PostProcess();
+
+	OnPathChanged( bot, pathResult ? COMPLETE_PATH : PARTIAL_PATH );
+
+	return pathResult;
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Draw the path for debugging.
@@ -853,7 +1051,13 @@ void Path::Copy( INextBot *bot, const Path &path )
 	}
 	m_segmentCount = path.m_segmentCount;
 
-	OnPathChanged( bot, COMPLETE_PATH );
+	if ( path.m_corridorCost )
+	{
+		m_corridorCost = path.m_corridorCost->Clone();
+		m_corridorGoal = path.m_corridorGoal;
+	}
+
+	OnPathChanged( bot, IsCorridorPartial() ? PARTIAL_PATH : COMPLETE_PATH );
 }
 
 
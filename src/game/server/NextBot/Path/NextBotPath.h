@@ -7,6 +7,7 @@
 #define _NEXT_BOT_PATH_H_
 
 #include "NextBotInterface.h"
+#include "NextBotPathSearch.h"
 
 #include "tier0/vprof.h"
 
@@ -26,9 +27,26 @@ class CNavLadder;
 class IPathCost
 {
 public:
+	virtual ~IPathCost() { }
+
 	virtual float operator()( CNavArea *area, CNavArea *fromArea, const CNavLadder *ladder, const CFuncElevator *elevator, float length ) const = 0;
+
+	/**
+	 * Return a nonzero value identifying this cost function if its costs depend only on the
+	 * areas involved and on whatever the value encodes (team, movement limits, etc), so paths
+	 * computed with it can be shared with other bots through the path cache.
+	 * Return zero if the costs are unique to this bot or change over time.
+	 */
+	virtual uint32 GetCacheKind( void ) const { return 0; }
+
+	// return a new copy of this cost function for a search resumed in later frames, or NULL if it can't outlive the caller's
+	virtual IPathCost *Clone( void ) const { return NULL; }
 };
 
+// pick out cost functors derived from IPathCost, since only those can use the path cache and corridor paths
+inline const IPathCost *GetPathCostInterface( const IPathCost *costFunc )	{ return costFunc; }
+inline const IPathCost *GetPathCostInterface( const void *costFunc )		{ return NULL; }
+
 
 //---------------------------------------------------------------------------------------------------------------
 /**
@@ -52,7 +70,7 @@ class Path
 {
 public:
 	Path( void );
-	virtual ~Path() { }
+	virtual ~Path() { delete m_corridorCost; }
 	
 	enum SegmentType
 	{
@@ -126,6 +144,10 @@ public:
 	virtual bool IsValid( void ) const;
 	virtual void Invalidate( void );					// make path invalid (clear it)
 
+	bool IsCorridorPartial( void ) const;				// return true if the path ends part way along a corridor to its goal, and should be refined before reaching its end
+	bool IsTimeToRefineCorridor( INextBot *bot ) const;	// return true if the path is partial and the bot is near its end
+	bool RefineCorridorPath( INextBot *bot );			// recompute the path from our position to the goal of its corridor
+
 	virtual void Draw( const Path::Segment *start = NULL ) const;	// draw the path for debugging
 	virtual void DrawInterpolated( float from, float to );	// draw the path for debugging - MODIFIES cursor position
 
@@ -157,28 +179,42 @@ public:
 	{
 		VPROF_BUDGET( "Path::Compute(subject)", "NextBot" );
 
+		const Vector &start = bot->GetPosition();
+		
+		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
+		CNavArea *subjectArea = subject->GetLastKnownArea();
+		Vector subjectPos = subject->GetAbsOrigin();
+
+		// share the search with other bots if we can
+		const NextBotPathCache::Entry *cachedPath = NULL;
+		if ( startArea && subjectArea && startArea != subjectArea )
+		{
+			bool isDeferred;
+			cachedPath = ComputeCachedAreaPath( bot, startArea, subjectArea, subjectPos, GetPathCostInterface( &costFunc ), maxPathLength, &isDeferred );
+			if ( isDeferred )
+			{
+				// keep following our current path until the search is finished
+				m_subject = subject;
+				return true;
+			}
+		}
+
 		Invalidate();
 
 		m_subject = subject;
 		
-		const Vector &start = bot->GetPosition();
-		
-		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
 		if ( !startArea )
 		{
 			OnPathChanged( bot, NO_PATH );
 			return false;
 		}
 
-		CNavArea *subjectArea = subject->GetLastKnownArea();
 		if ( !subjectArea )
 		{
 			OnPathChanged( bot, NO_PATH );
 			return false;
 		}
 
-		Vector subjectPos = subject->GetAbsOrigin();
-		
 		// if we are already in the subject area, build trivial path
 		if ( startArea == subjectArea )
 		{
@@ -186,6 +222,11 @@ public:
 			return true;
 		}
 
+		if ( cachedPath )
+		{
+			return AssembleAreaPath( bot, cachedPath->m_areaVector, cachedPath->m_isComplete, subjectPos, includeGoalIfPathFails );
+		}
+
 		//
 		// Compute shortest path to subject
 		//
@@ -274,13 +315,12 @@ public:
 	{
 		VPROF_BUDGET( "Path::Compute(goal)", "NextBotSpiky" );
 
-		Invalidate();
-		
 		const Vector &start = bot->GetPosition();
 		
 		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
 		if ( !startArea )
 		{
+			Invalidate();
 			OnPathChanged( bot, NO_PATH );
 			return false;
 		}
@@ -299,10 +339,29 @@ public:
 		// if we are already in the goal area, build trivial path
 		if ( startArea == goalArea )
 		{
+			Invalidate();
 			BuildTrivialPath( bot, goal );
 			return true;
 		}
 
+		// distant goals can be reached through the nav mesh's coarse graph, searching the areas a part at a time
+		bool corridorResult;
+		if ( ComputeCorridorAreaPath( bot, startArea, goalArea, goal, GetPathCostInterface( &costFunc ), maxPathLength, &corridorResult ) )
+		{
+			return corridorResult;
+		}
+
+		// share the search with other bots if we can
+		bool isDeferred;
+		const NextBotPathCache::Entry *cachedPath = ComputeCachedAreaPath( bot, startArea, goalArea, goal, GetPathCostInterface( &costFunc ), maxPathLength, &isDeferred );
+		if ( isDeferred )
+		{
+			// keep following our current path until the search is finished
+			return true;
+		}
+
+		Invalidate();
+
 		// make sure path end position is on the ground
 		Vector pathEndPosition = goal;
 		if ( goalArea )
@@ -314,6 +373,11 @@ public:
 			TheNavMesh->GetGroundHeight( pathEndPosition, &pathEndPosition.z );
 		}
 
+		if ( cachedPath )
+		{
+			return AssembleAreaPath( bot, cachedPath->m_areaVector, cachedPath->m_isComplete, pathEndPosition, includeGoalIfPathFails );
+		}
+
 		//
 		// Compute shortest path to goal
 		//
@@ -586,6 +650,9 @@ public:
 	 */
 	virtual void ComputeAreaCrossing( INextBot *bot, const CNavArea *from, const Vector &fromPos, const CNavArea *to, NavDirType dir, Vector *crossPos ) const;
 
+	// build this path from a sequence of areas found by a search, such as a cached or refined path
+	bool AssembleAreaPath( INextBot *bot, const CUtlVector< NavPathArea > &areaVector, bool isComplete, const Vector &goalPos, bool includeGoalIfPathFails );
+
 
 private:
 	enum { MAX_PATH_SEGMENTS = 256 };
@@ -594,6 +661,16 @@ private:
 
 	bool ComputePathDetails( INextBot *bot, const Vector &start );		// determine actual path positions 
 
+	const NextBotPathCache::Entry *ComputeCachedAreaPath( INextBot *bot, CNavArea *startArea, CNavArea *goalArea, const Vector &goalPos, const IPathCost *costFunc, float maxPathLength, bool *isDeferred );
+	bool ComputeCorridorAreaPath( INextBot *bot, CNavArea *startArea, CNavArea *goalArea, const Vector &goalPos, const IPathCost *costFunc, float maxPathLength, bool *pathResult );
+
+	IPathCost *m_corridorCost;					// if this path only reaches part way along a corridor, our copy of the cost function to compute the rest of it with
+	Vector m_corridorGoal;
+
+	// not copyable, since we own m_corridorCost - use Copy() instead
+	Path( const Path &path );
+	Path &operator=( const Path &path );
+
 	void Optimize( INextBot *bot );
 	void PostProcess( void );
 	int FindNextOccludedNode( INextBot *bot, int anchor );	// used by Optimize()
@@ -757,6 +834,15 @@ inline void Path::Invalidate( void )
 	m_isCursorDataDirty = true;
 
 	m_subject = NULL;
+
+	delete m_corridorCost;
+	m_corridorCost = NULL;
+}
+
+
+inline bool Path::IsCorridorPartial( void ) const
+{
+	return m_corridorCost != NULL;
 }
 
 inline const Path::Segment *Path::FirstSegment( void ) const
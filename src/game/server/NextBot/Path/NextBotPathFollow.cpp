@@ -585,6 +585,15 @@ void PathFollower::Update( INextBot *bot )
 		return;
 	}
 
+	if ( IsTimeToRefineCorridor( bot ) )
+	{
+		// we're nearing the end of a path along part of a corridor - extend it towards the goal
+		if ( !RefineCorridorPath( bot ) || !IsValid() || m_goal == NULL )
+		{
+			return;
+		}
+	}
+
 	if ( !m_waitTimer.IsElapsed() )
 	{
 		// still waiting
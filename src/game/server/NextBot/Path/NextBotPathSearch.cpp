@@ -0,0 +1,717 @@
+// NextBotPathSearch.cpp
+// Re-entrant, time-sliced A* search over the nav mesh, and a cache of its results shared between bots
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#include "cbase.h"
+
+#include "nav_mesh.h"
+#include "NextBotPath.h"
+#include "NextBotPathSearch.h"
+
+#include "tier0/vprof.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+ConVar nb_path_cache( "nb_path_cache", "1", FCVAR_CHEAT, "If nonzero, NextBots share computed paths with the same start, goal, team, and cost" );
+ConVar nb_path_cache_time( "nb_path_cache_time", "2", FCVAR_CHEAT, "How long, in seconds, a cached NextBot path can be reused" );
+ConVar nb_path_search_max_expansions( "nb_path_search_max_expansions", "1500", FCVAR_CHEAT, "A NextBot repath that expands more areas than this is deferred to later frames while the bot follows its current path (0 = never defer)" );
+ConVar nb_path_search_frame_expansions( "nb_path_search_frame_expansions", "1000", FCVAR_CHEAT, "The number of areas deferred NextBot path searches may expand each frame" );
+ConVar nb_path_cache_debug( "nb_path_cache_debug", "0", FCVAR_CHEAT, "Print NextBot path cache activity" );
+
+
+//---------------------------------------------------------------------------------------------------------------
+NextBotPathSearch::NextBotPathSearch( void ) : m_openList( 0, 0, IsLowerPriority )
+{
+	m_startArea = NULL;
+	m_goalArea = NULL;
+	m_goalPos = vec3_origin;
+	m_teamID = TEAM_ANY;
+	m_maxPathLength = 0.0f;
+	m_ignoreNavBlockers = false;
+	m_filter = NULL;
+	m_status = SEARCH_FAILED;
+	m_closestNode = -1;
+	m_closestNodeDist = FLT_MAX;
+	m_expansionCount = 0;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * The open list pops the entry with the lowest total cost first
+ */
+bool NextBotPathSearch::IsLowerPriority( const OpenEntry &lhs, const OpenEntry &rhs )
+{
+	return lhs.m_totalCost > rhs.m_totalCost;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+int NextBotPathSearch::FindOrAddNode( CNavArea *area, bool *isNew )
+{
+	UtlHashHandle_t h = m_nodeTable.Find( area );
+	if ( h != m_nodeTable.InvalidHandle() )
+	{
+		*isNew = false;
+		return m_nodeTable.Element( h );
+	}
+
+	int i = m_nodeVector.AddToTail();
+	Node &node = m_nodeVector[i];
+	node.m_area = area;
+	node.m_parent = -1;
+	node.m_how = NUM_TRAVERSE_TYPES;
+	node.m_costSoFar = 0.0f;
+	node.m_totalCost = 0.0f;
+	node.m_lengthSoFar = 0.0f;
+	node.m_isOpen = false;
+	node.m_isClosed = false;
+
+	m_nodeTable.Insert( area, i );
+
+	*isNew = true;
+	return i;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Start a new search, discarding any previous one.
+ * This mirrors the setup done by NavAreaBuildPath().
+ */
+void NextBotPathSearch::Begin( CNavArea *startArea, CNavArea *goalArea, const Vector &goalPos, const IPathCost &costFunc, int teamID, float maxPathLength, bool ignoreNavBlockers )
+{
+	m_nodeVector.RemoveAll();
+	m_nodeTable.RemoveAll();
+	m_openList.RemoveAll();
+
+	m_startArea = startArea;
+	m_goalArea = goalArea;
+	m_goalPos = goalPos;
+	m_teamID = teamID;
+	m_maxPathLength = maxPathLength;
+	m_ignoreNavBlockers = ignoreNavBlockers;
+	m_closestNode = -1;
+	m_closestNodeDist = FLT_MAX;
+	m_expansionCount = 0;
+	m_status = SEARCH_FAILED;
+
+	if ( startArea == NULL )
+		return;
+
+	bool isNew;
+	int startNode = FindOrAddNode( startArea, &isNew );
+	m_closestNode = startNode;
+
+	if ( m_goalArea && m_goalArea->IsBlocked( m_teamID, m_ignoreNavBlockers ) )
+		m_goalArea = NULL;
+
+	if ( startArea == m_goalArea )
+	{
+		m_status = SEARCH_SUCCEEDED;
+		return;
+	}
+
+	float initCost = costFunc( startArea, NULL, NULL, NULL, -1.0f );
+	if ( initCost < 0.0f )
+		return;
+
+	Node &node = m_nodeVector[ startNode ];
+	node.m_costSoFar = initCost;
+	node.m_totalCost = ( startArea->GetCenter() - m_goalPos ).Length();
+	node.m_isOpen = true;
+
+	m_closestNodeDist = node.m_totalCost;
+
+	OpenEntry entry;
+	entry.m_totalCost = node.m_totalCost;
+	entry.m_node = startNode;
+	m_openList.Insert( entry );
+
+	m_status = SEARCH_IN_PROGRESS;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Continue the search, expanding at most 'maxExpansions' areas.
+ */
+NextBotPathSearch::StatusType NextBotPathSearch::Step( const IPathCost &costFunc, int maxExpansions )
+{
+	VPROF_BUDGET( "NextBotPathSearch::Step", "NextBotSpiky" );
+
+	int expansions = 0;
+
+	while( m_status == SEARCH_IN_PROGRESS )
+	{
+		if ( m_openList.Count() == 0 )
+		{
+			m_status = SEARCH_FAILED;
+			break;
+		}
+
+		if ( maxExpansions > 0 && expansions >= maxExpansions )
+			break;
+
+		OpenEntry entry = m_openList.ElementAtHead();
+		m_openList.RemoveAtHead();
+
+		Node &node = m_nodeVector[ entry.m_node ];
+
+		// skip entries left behind when a node's cost improved
+		if ( !node.m_isOpen || entry.m_totalCost != node.m_totalCost )
+			continue;
+
+		node.m_isOpen = false;
+
+		// don't consider blocked areas
+		if ( node.m_area->IsBlocked( m_teamID, m_ignoreNavBlockers ) )
+			continue;
+
+		// check if we have found the goal area or position
+		if ( node.m_area == m_goalArea || ( m_goalArea == NULL && node.m_area->Contains( m_goalPos ) ) )
+		{
+			m_closestNode = entry.m_node;
+			m_status = SEARCH_SUCCEEDED;
+			break;
+		}
+
+		ExpandNode( entry.m_node, costFunc );
+
+		m_nodeVector[ entry.m_node ].m_isClosed = true;
+
+		++expansions;
+		++m_expansionCount;
+	}
+
+	return m_status;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Search the areas adjacent to the given node, in the same order as NavAreaBuildPath()
+ */
+void NextBotPathSearch::ExpandNode( int nodeIndex, const IPathCost &costFunc )
+{
+	CNavArea *area = m_nodeVector[ nodeIndex ].m_area;
+	const int parentIndex = m_nodeVector[ nodeIndex ].m_parent;
+	const float costSoFar = m_nodeVector[ nodeIndex ].m_costSoFar;
+	const float lengthSoFar = m_nodeVector[ nodeIndex ].m_lengthSoFar;
+	CNavArea *parentArea = ( parentIndex >= 0 ) ? m_nodeVector[ parentIndex ].m_area : NULL;
+
+	// cost functors build on the cost of the area they come from
+	area->SetCostSoFar( costSoFar );
+
+	enum SearchType
+	{
+		SEARCH_FLOOR, SEARCH_LADDERS, SEARCH_ELEVATORS
+	};
+	SearchType searchWhere = SEARCH_FLOOR;
+	int searchIndex = 0;
+
+	int dir = NORTH;
+	const NavConnectVector *floorList = area->GetAdjacentAreas( NORTH );
+
+	bool ladderUp = true;
+	const NavLadderConnectVector *ladderList = NULL;
+	enum { AHEAD = 0, LEFT, RIGHT, BEHIND, NUM_TOP_DIRECTIONS };
+	int ladderTopDir = AHEAD;
+	const bool bHaveMaxPathLength = ( m_maxPathLength > 0.0f );
+	float length = -1;
+
+	while( true )
+	{
+		CNavArea *newArea = NULL;
+		NavTraverseType how;
+		const CNavLadder *ladder = NULL;
+		const CFuncElevator *elevator = NULL;
+
+		//
+		// Get next adjacent area - either on floor or via ladder
+		//
+		if ( searchWhere == SEARCH_FLOOR )
+		{
+			// if exhausted adjacent connections in current direction, begin checking next direction
+			if ( searchIndex >= floorList->Count() )
+			{
+				++dir;
+
+				if ( dir == NUM_DIRECTIONS )
+				{
+					// checked all directions on floor - check ladders next
+					searchWhere = SEARCH_LADDERS;
+
+					ladderList = area->GetLadders( CNavLadder::LADDER_UP );
+					searchIndex = 0;
+					ladderTopDir = AHEAD;
+				}
+				else
+				{
+					// start next direction
+					floorList = area->GetAdjacentAreas( (NavDirType)dir );
+					searchIndex = 0;
+				}
+
+				continue;
+			}
+
+			const NavConnect &floorConnect = floorList->Element( searchIndex );
+			newArea = floorConnect.area;
+			length = floorConnect.length;
+			how = (NavTraverseType)dir;
+			++searchIndex;
+		}
+		else if ( searchWhere == SEARCH_LADDERS )
+		{
+			if ( searchIndex >= ladderList->Count() )
+			{
+				if ( !ladderUp )
+				{
+					// checked both ladder directions - check elevators next
+					searchWhere = SEARCH_ELEVATORS;
+					searchIndex = 0;
+					ladder = NULL;
+				}
+				else
+				{
+					// check down ladders
+					ladderUp = false;
+					ladderList = area->GetLadders( CNavLadder::LADDER_DOWN );
+					searchIndex = 0;
+				}
+				continue;
+			}
+
+			if ( ladderUp )
+			{
+				ladder = ladderList->Element( searchIndex ).ladder;
+
+				// do not use BEHIND connection, as its very hard to get to when going up a ladder
+				if ( ladderTopDir == AHEAD )
+				{
+					newArea = ladder->m_topForwardArea;
+				}
+				else if ( ladderTopDir == LEFT )
+				{
+					newArea = ladder->m_topLeftArea;
+				}
+				else if ( ladderTopDir == RIGHT )
+				{
+					newArea = ladder->m_topRightArea;
+				}
+				else
+				{
+					++searchIndex;
+					ladderTopDir = AHEAD;
+					continue;
+				}
+
+				how = GO_LADDER_UP;
+				++ladderTopDir;
+			}
+			else
+			{
+				newArea = ladderList->Element( searchIndex ).ladder->m_bottomArea;
+				how = GO_LADDER_DOWN;
+				ladder = ladderList->Element( searchIndex ).ladder;
+				++searchIndex;
+			}
+
+			if ( newArea == NULL )
+				continue;
+
+			length = -1.0f;
+		}
+		else // if ( searchWhere == SEARCH_ELEVATORS )
+		{
+			const NavConnectVector &elevatorAreas = area->GetElevatorAreas();
+
+			elevator = area->GetElevator();
+
+			if ( elevator == NULL || searchIndex >= elevatorAreas.Count() )
+			{
+				// done searching connected areas
+				break;
+			}
+
+			newArea = elevatorAreas[ searchIndex++ ].area;
+			if ( newArea->GetCenter().z > area->GetCenter().z )
+			{
+				how = GO_ELEVATOR_UP;
+			}
+			else
+			{
+				how = GO_ELEVATOR_DOWN;
+			}
+
+			length = -1.0f;
+		}
+
+		// don't backtrack
+		Assert( newArea );
+		if ( newArea == parentArea )
+			continue;
+		if ( newArea == area ) // self neighbor?
+			continue;
+
+		// don't consider blocked areas
+		if ( newArea->IsBlocked( m_teamID, m_ignoreNavBlockers ) )
+			continue;
+
+		if ( m_filter && !m_filter->IsAllowed( newArea ) )
+			continue;
+
+		float newCostSoFar = costFunc( newArea, area, ladder, elevator, length );
+
+		if ( IS_NAN( newCostSoFar ) )
+			newCostSoFar = 1e30f;
+
+		// check if cost functor says this area is a dead-end
+		if ( newCostSoFar < 0.0f )
+			continue;
+
+		// make sure that any jump to a new area incurs some pathfinding cost (see NavAreaBuildPath)
+		float minNewCostSoFar = costSoFar * 1.00001f + 0.00001f;
+		newCostSoFar = Max( newCostSoFar, minNewCostSoFar );
+
+		// stop if path length limit reached
+		float newLengthSoFar = 0.0f;
+		if ( bHaveMaxPathLength )
+		{
+			newLengthSoFar = lengthSoFar + ( newArea->GetCenter() - area->GetCenter() ).Length();
+			if ( newLengthSoFar > m_maxPathLength )
+				continue;
+		}
+
+		bool isNew;
+		int newIndex = FindOrAddNode( newArea, &isNew );
+		Node &newNode = m_nodeVector[ newIndex ];
+
+		if ( ( newNode.m_isOpen || newNode.m_isClosed ) && newNode.m_costSoFar <= newCostSoFar )
+		{
+			// this is a worse path - skip it
+			continue;
+		}
+
+		// compute estimate of distance left to go
+		float distSq = ( newArea->GetCenter() - m_goalPos ).LengthSqr();
+		float newCostRemaining = ( distSq > 0.0 ) ? FastSqrt( distSq ) : 0.0f;
+
+		// track closest area to goal in case path fails
+		if ( newCostRemaining < m_closestNodeDist )
+		{
+			m_closestNode = newIndex;
+			m_closestNodeDist = newCostRemaining;
+		}
+
+		newNode.m_costSoFar = newCostSoFar;
+		newNode.m_totalCost = newCostSoFar + newCostRemaining;
+		newNode.m_lengthSoFar = newLengthSoFar;
+		newNode.m_parent = nodeIndex;
+		newNode.m_how = how;
+		newNode.m_isClosed = false;
+		newNode.m_isOpen = true;
+
+		OpenEntry entry;
+		entry.m_totalCost = newNode.m_totalCost;
+		entry.m_node = newIndex;
+		m_openList.Insert( entry );
+	}
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+CNavArea *NextBotPathSearch::GetClosestArea( void ) const
+{
+	return ( m_closestNode >= 0 ) ? m_nodeVector[ m_closestNode ].m_area : NULL;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Fill in the areas from the start area to the closest area found by the search.
+ */
+void NextBotPathSearch::BuildAreaPath( CUtlVector< NavPathArea > *areaVector ) const
+{
+	areaVector->RemoveAll();
+
+	// count first, so we can fill in the areas in order
+	int count = 0;
+	for( int i = m_closestNode; i >= 0; i = m_nodeVector[i].m_parent )
+	{
+		++count;
+
+		if ( m_nodeVector[i].m_area == m_startArea )
+			break;
+	}
+
+	areaVector->SetCount( count );
+
+	for( int i = m_closestNode; i >= 0 && count > 0; i = m_nodeVector[i].m_parent )
+	{
+		--count;
+		NavPathArea &pathArea = areaVector->Element( count );
+		pathArea.area = m_nodeVector[i].m_area;
+		pathArea.how = m_nodeVector[i].m_how;
+	}
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Singleton accessor.
+ */
+NextBotPathCache &TheNextBotPathCache( void )
+{
+	static NextBotPathCache cache;
+	return cache;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+unsigned int NextBotPathCache::KeyHash::operator()( const Key &key ) const
+{
+	unsigned int hash = PointerHashFunctor()( key.m_startArea );
+	hash = hash * 31 + PointerHashFunctor()( key.m_goalArea );
+	hash = hash * 31 + Mix32HashFunctor()( (uint32)key.m_teamID );
+	hash = hash * 31 + key.m_costKind;
+	return hash;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+NextBotPathCache::NextBotPathCache( void )
+{
+	m_navAreaCount = 0;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+NextBotPathCache::~NextBotPathCache()
+{
+	Invalidate();
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+bool NextBotPathCache::IsEnabled( void ) const
+{
+	return nb_path_cache.GetBool();
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+void NextBotPathCache::Invalidate( void )
+{
+	FOR_EACH_HASHTABLE( m_entryTable, it )
+	{
+		delete m_entryTable.Element( it );
+	}
+	m_entryTable.RemoveAll();
+
+	while( m_pendingVector.Count() )
+	{
+		RemovePendingSearch( m_pendingVector.Count()-1 );
+	}
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Cached paths hold pointers to nav areas, so throw everything away if the mesh was rebuilt
+ */
+void NextBotPathCache::CheckMesh( void )
+{
+	if ( m_navAreaCount != TheNavAreas.Count() )
+	{
+		Invalidate();
+		m_navAreaCount = TheNavAreas.Count();
+	}
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+int NextBotPathCache::FindPendingSearch( const Key &key ) const
+{
+	FOR_EACH_VEC( m_pendingVector, i )
+	{
+		if ( m_pendingVector[i]->m_key == key )
+			return i;
+	}
+
+	return m_pendingVector.InvalidIndex();
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+void NextBotPathCache::RemovePendingSearch( int i )
+{
+	delete m_pendingVector[i]->m_costFunc;
+	delete m_pendingVector[i];
+	m_pendingVector.Remove( i );
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+const NextBotPathCache::Entry *NextBotPathCache::Find( const Key &key ) const
+{
+	UtlHashHandle_t h = m_entryTable.Find( key );
+	if ( h == m_entryTable.InvalidHandle() )
+		return NULL;
+
+	const Entry *entry = m_entryTable.Element( h );
+	if ( gpGlobals->curtime - entry->m_timestamp > nb_path_cache_time.GetFloat() )
+		return NULL;
+
+	return entry;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+NextBotPathCache::Entry *NextBotPathCache::StoreResult( const Key &key, const NextBotPathSearch &search )
+{
+	Entry *entry;
+
+	UtlHashHandle_t h = m_entryTable.Find( key );
+	if ( h == m_entryTable.InvalidHandle() )
+	{
+		entry = new Entry;
+		m_entryTable.Insert( key, entry );
+	}
+	else
+	{
+		entry = m_entryTable.Element( h );
+	}
+
+	search.BuildAreaPath( &entry->m_areaVector );
+	entry->m_isComplete = ( search.GetStatus() == NextBotPathSearch::SEARCH_SUCCEEDED );
+	entry->m_timestamp = gpGlobals->curtime;
+
+	return entry;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+const NextBotPathCache::Entry *NextBotPathCache::Compute( const Key &key, const Vector &goalPos, const IPathCost &costFunc, CBaseEntity *owner, bool canDefer )
+{
+	VPROF_BUDGET( "NextBotPathCache::Compute", "NextBotSpiky" );
+
+	CheckMesh();
+
+	const Entry *entry = Find( key );
+	if ( entry )
+	{
+		if ( nb_path_cache_debug.GetBool() )
+		{
+			DevMsg( "%3.2f: Path cache hit (%d -> %d, team %d)\n", gpGlobals->curtime, key.m_startArea->GetID(), key.m_goalArea->GetID(), key.m_teamID );
+		}
+
+		return entry;
+	}
+
+	int pending = FindPendingSearch( key );
+	if ( pending != m_pendingVector.InvalidIndex() )
+	{
+		if ( canDefer )
+		{
+			// someone is already searching for this path - wait for it
+			return NULL;
+		}
+
+		// the caller needs the path now, so finish the shared search
+		PendingSearch *search = m_pendingVector[ pending ];
+		search->m_search.Step( costFunc );
+		entry = StoreResult( key, search->m_search );
+		RemovePendingSearch( pending );
+
+		return entry;
+	}
+
+	const int maxExpansions = canDefer ? nb_path_search_max_expansions.GetInt() : 0;
+	IPathCost *deferredCostFunc = ( maxExpansions > 0 ) ? costFunc.Clone() : NULL;
+
+	PendingSearch *search = new PendingSearch;
+	search->m_key = key;
+	search->m_costFunc = NULL;
+	search->m_search.Begin( (CNavArea *)key.m_startArea, (CNavArea *)key.m_goalArea, goalPos, costFunc, key.m_teamID );
+	search->m_search.Step( costFunc, deferredCostFunc ? maxExpansions : 0 );
+
+	if ( !search->m_search.IsDone() )
+	{
+		// too expensive to finish now - resume it over the next few frames
+		search->m_costFunc = deferredCostFunc;
+		search->m_owner = owner;
+		m_pendingVector.AddToTail( search );
+
+		if ( nb_path_cache_debug.GetBool() )
+		{
+			DevMsg( "%3.2f: Path search deferred (%d -> %d, team %d) after %d areas\n", gpGlobals->curtime, key.m_startArea->GetID(), key.m_goalArea->GetID(), key.m_teamID, search->m_search.GetExpansionCount() );
+		}
+
+		return NULL;
+	}
+
+	entry = StoreResult( key, search->m_search );
+
+	delete deferredCostFunc;
+	delete search;
+
+	return entry;
+}
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Resume deferred searches within this frame's budget, and discard expired paths
+ */
+void NextBotPathCache::Update( void )
+{
+	VPROF_BUDGET( "NextBotPathCache::Update", "NextBot" );
+
+	CheckMesh();
+
+	int budget = nb_path_search_frame_expansions.GetInt();
+
+	while( m_pendingVector.Count() && budget > 0 )
+	{
+		PendingSearch *search = m_pendingVector[0];
+
+		if ( search->m_owner == NULL || !search->m_owner->IsAlive() )
+		{
+			// the cost functor may refer to its owner, so we can't continue
+			RemovePendingSearch( 0 );
+			continue;
+		}
+
+		int before = search->m_search.GetExpansionCount();
+		search->m_search.Step( *search->m_costFunc, budget );
+		budget -= Max( search->m_search.GetExpansionCount() - before, 1 );
+
+		if ( search->m_search.IsDone() )
+		{
+			StoreResult( search->m_key, search->m_search );
+			RemovePendingSearch( 0 );
+		}
+	}
+
+	const float maxAge = nb_path_cache_time.GetFloat();
+
+	UtlHashHandle_t it = m_entryTable.FirstHandle();
+	while( it != m_entryTable.InvalidHandle() )
+	{
+		Entry *entry = m_entryTable.Element( it );
+		if ( gpGlobals->curtime - entry->m_timestamp > maxAge )
+		{
+			delete entry;
+			it = m_entryTable.RemoveAndAdvance( it );
+		}
+		else
+		{
+			it = m_entryTable.NextHandle( it );
+		}
+	}
+}
@@ -0,0 +1,197 @@
+// NextBotPathSearch.h
+// Re-entrant, time-sliced A* search over the nav mesh, and a cache of its results shared between bots
+//========= Copyright Valve Corporation, All rights reserved. ============//
+
+#ifndef _NEXT_BOT_PATH_SEARCH_H_
+#define _NEXT_BOT_PATH_SEARCH_H_
+
+#include "nav.h"
+#include "utlhashtable.h"
+#include "utlpriorityqueue.h"
+
+class CNavArea;
+class IPathCost;
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * One area along a path found by a search, in order from the start area.
+ */
+struct NavPathArea
+{
+	CNavArea *area;
+	NavTraverseType how;								// how to enter this area from the previous one
+};
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Restricts a search to a subset of the mesh, such as a corridor of areas found by a coarser search.
+ */
+class IPathSearchFilter
+{
+public:
+	virtual bool IsAllowed( const CNavArea *area ) const = 0;	// return true if the search may enter the given area
+};
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * An A* search with the same rules as NavAreaBuildPath(), but which keeps all of its
+ * state (open list, costs, parents) to itself instead of in the nav areas. Several searches
+ * can therefore be alive at once, and a search can be suspended after a number of area
+ * expansions and resumed on a later tick.
+ *
+ * NOTE: Cost functors add their cost to fromArea->GetCostSoFar(), so the search writes its own
+ * cost for an area into the area just before expanding it. This is safe as long as
+ * searches and NavAreaBuildPath() are only ever run on the main thread.
+ */
+class NextBotPathSearch
+{
+public:
+	NextBotPathSearch( void );
+
+	enum StatusType
+	{
+		SEARCH_IN_PROGRESS,
+		SEARCH_SUCCEEDED,								// reached the goal
+		SEARCH_FAILED									// open list exhausted - the closest area is the best we can do
+	};
+
+	void Begin( CNavArea *startArea, CNavArea *goalArea, const Vector &goalPos, const IPathCost &costFunc, int teamID = TEAM_ANY, float maxPathLength = 0.0f, bool ignoreNavBlockers = false );
+	StatusType Step( const IPathCost &costFunc, int maxExpansions = 0 );	// expand up to maxExpansions areas (0 = no limit) and return the resulting status
+
+	void SetFilter( const IPathSearchFilter *filter )	{ m_filter = filter; }	// only enter areas allowed by the filter (NULL for no filter) - must outlive the search
+
+	StatusType GetStatus( void ) const			{ return m_status; }
+	bool IsDone( void ) const					{ return m_status != SEARCH_IN_PROGRESS; }
+	int GetExpansionCount( void ) const			{ return m_expansionCount; }
+
+	CNavArea *GetStartArea( void ) const		{ return m_startArea; }
+	CNavArea *GetGoalArea( void ) const			{ return m_goalArea; }
+	CNavArea *GetClosestArea( void ) const;		// the goal area if found, otherwise the searched area closest to the goal
+
+	void BuildAreaPath( CUtlVector< NavPathArea > *areaVector ) const;	// fill in the areas from the start to the closest area
+
+private:
+	struct Node
+	{
+		CNavArea *m_area;
+		int m_parent;									// index of parent node, or -1
+		NavTraverseType m_how;
+		float m_costSoFar;
+		float m_totalCost;
+		float m_lengthSoFar;
+		bool m_isOpen;
+		bool m_isClosed;
+	};
+	CUtlVector< Node > m_nodeVector;
+	CUtlHashtable< const void *, int, PointerHashFunctor, PointerEqualFunctor > m_nodeTable;	// area -> index into m_nodeVector
+
+	int FindOrAddNode( CNavArea *area, bool *isNew );
+
+	// the open list may hold stale entries for nodes whose cost has since improved - these are skipped when popped
+	struct OpenEntry
+	{
+		float m_totalCost;
+		int m_node;
+	};
+	CUtlPriorityQueue< OpenEntry > m_openList;
+	static bool IsLowerPriority( const OpenEntry &lhs, const OpenEntry &rhs );
+
+	void ExpandNode( int nodeIndex, const IPathCost &costFunc );
+
+	CNavArea *m_startArea;
+	CNavArea *m_goalArea;
+	Vector m_goalPos;
+	int m_teamID;
+	float m_maxPathLength;
+	bool m_ignoreNavBlockers;
+	const IPathSearchFilter *m_filter;
+
+	StatusType m_status;
+	int m_closestNode;
+	float m_closestNodeDist;
+	int m_expansionCount;
+};
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Caches the areas of recently computed paths keyed by (start area, goal area, team, cost kind),
+ * so bots that want the same route - such as a wave of robots heading for the bomb hatch - share
+ * one search. Only cost functors that report a nonzero IPathCost::GetCacheKind() are cached.
+ *
+ * Searches that run too long when the bot still has a usable path can be deferred. They are resumed
+ * each frame within a budget, and their result is cached for the next repath.
+ */
+class NextBotPathCache
+{
+public:
+	NextBotPathCache( void );
+	~NextBotPathCache();
+
+	struct Key
+	{
+		const CNavArea *m_startArea;
+		const CNavArea *m_goalArea;
+		int m_teamID;
+		uint32 m_costKind;
+
+		bool operator==( const Key &other ) const
+		{
+			return m_startArea == other.m_startArea && m_goalArea == other.m_goalArea && m_teamID == other.m_teamID && m_costKind == other.m_costKind;
+		}
+	};
+
+	struct Entry
+	{
+		CUtlVector< NavPathArea > m_areaVector;			// from the start area to the goal, or to the closest area if the search failed
+		bool m_isComplete;								// true if the path reaches the goal area
+		float m_timestamp;
+	};
+
+	/**
+	 * Return the cached path for the key, searching for it if necessary.
+	 * If 'canDefer' is true and the search doesn't finish within nb_path_search_max_expansions,
+	 * it is suspended and resumed in later frames, and NULL is returned. 'owner' is the entity
+	 * whose cost functor is used by the suspended search.
+	 */
+	const Entry *Compute( const Key &key, const Vector &goalPos, const IPathCost &costFunc, CBaseEntity *owner, bool canDefer );
+
+	bool IsEnabled( void ) const;
+	const Entry *Find( const Key &key ) const;			// return the cached path for the key, or NULL
+
+	void Update( void );								// resume deferred searches and discard expired paths - invoked each frame
+	void Invalidate( void );							// discard all cached paths and deferred searches, such as when blocked areas change
+
+private:
+	struct KeyHash
+	{
+		unsigned int operator()( const Key &key ) const;
+	};
+	CUtlHashtable< Key, Entry *, KeyHash > m_entryTable;
+
+	struct PendingSearch
+	{
+		Key m_key;
+		NextBotPathSearch m_search;
+		IPathCost *m_costFunc;							// our own copy of the cost functor, since the caller's is gone by the next frame
+		CHandle< CBaseEntity > m_owner;					// the cost functor may refer to its owner, so stop if it goes away
+	};
+	CUtlVector< PendingSearch * > m_pendingVector;
+	int FindPendingSearch( const Key &key ) const;
+	void RemovePendingSearch( int i );
+
+	Entry *StoreResult( const Key &key, const NextBotPathSearch &search );
+
+	int m_navAreaCount;									// the mesh size when the cached paths were computed, to catch the mesh being rebuilt
+	void CheckMesh( void );
+};
+
+
+// singleton accessor
+extern NextBotPathCache &TheNextBotPathCache( void );
+
+
+#endif // _NEXT_BOT_PATH_SEARCH_H_
@@ -3766,3 +3766,111 @@ CStudioHdr *CBaseAnimating::OnNewModel()
 
 	return hdr;
 }
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Pose the given sequence, or every sequence if it is -1, blended with
+//			the next one into pos and q. Returns the number of poses computed.
+//-----------------------------------------------------------------------------
+static int BenchmarkBoneSetupPass( CStudioHdr *pStudioHdr, const float poseParameter[], int sequence, int iterations, Vector pos[], Quaternion q[] )
+{
+	int numSeq = pStudioHdr->GetNumSeq();
+	int count = 0;
+
+	for ( int it = 0; it < iterations; ++it )
+	{
+		float cycle = (float)( it % 16 ) / 16.0f;
+
+		for ( int i = 0; i < numSeq; ++i )
+		{
+			if ( sequence >= 0 && i != sequence )
+				continue;
+
+			IBoneSetup boneSetup( pStudioHdr, BONE_USED_BY_ANYTHING, poseParameter );
+			boneSetup.InitPose( pos, q );
+			boneSetup.AccumulatePose( pos, q, i, cycle, 1.0f, gpGlobals->curtime, NULL );
+			boneSetup.AccumulatePose( pos, q, ( i + 1 ) % numSeq, cycle, 0.5f, gpGlobals->curtime, NULL );
+			++count;
+		}
+	}
+
+	return count;
+}
+
+CON_COMMAND_F( anim_benchmark_bones, "Time posing every sequence of a model with anim_simd_blend 0 and 1, and report the largest difference between the results. Arguments are the model (default models/player/heavy.mdl) and the number of iterations.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	const char *pszModel = ( args.ArgC() > 1 ) ? args[ 1 ] : "models/player/heavy.mdl";
+	int iterations = ( args.ArgC() > 2 ) ? MAX( atoi( args[ 2 ] ), 1 ) : 20;
+
+	int modelIndex = modelinfo->GetModelIndex( pszModel );
+	if ( modelIndex < 0 )
+	{
+		Warning( "anim_benchmark_bones: %s is not precached\n", pszModel );
+		return;
+	}
+
+	MDLCACHE_CRITICAL_SECTION();
+
+	CStudioHdr studioHdr( modelinfo->GetStudiomodel( modelinfo->GetModel( modelIndex ) ), mdlcache );
+	if ( !studioHdr.IsValid() || studioHdr.GetNumSeq() == 0 )
+	{
+		Warning( "anim_benchmark_bones: %s has no sequences\n", pszModel );
+		return;
+	}
+
+	// the middle of every pose parameter's range, so blended sequences mix their animations
+	float poseParameter[ MAXSTUDIOPOSEPARAM ];
+	for ( int i = 0; i < MAXSTUDIOPOSEPARAM; ++i )
+	{
+		poseParameter[i] = 0.5f;
+	}
+
+	ConVarRef anim_simd_blend( "anim_simd_blend" );
+	int oldValue = anim_simd_blend.GetInt();
+
+	Vector pos[2][ MAXSTUDIOBONES ];
+	Quaternion q[2][ MAXSTUDIOBONES ];
+
+	// compare the results of the two modes on every sequence
+	float maxAngle = 0.0f;
+	float maxDistance = 0.0f;
+
+	for ( int i = 0; i < studioHdr.GetNumSeq(); ++i )
+	{
+		for ( int mode = 0; mode < 2; ++mode )
+		{
+			anim_simd_blend.SetValue( mode );
+			BenchmarkBoneSetupPass( &studioHdr, poseParameter, i, 1, pos[ mode ], q[ mode ] );
+		}
+
+		for ( int b = 0; b < studioHdr.numbones(); ++b )
+		{
+			float dot = fabs( QuaternionDotProduct( q[0][b], q[1][b] ) );
+			maxAngle = MAX( maxAngle, RAD2DEG( 2.0f * acos( MIN( dot, 1.0f ) ) ) );
+			maxDistance = MAX( maxDistance, pos[0][b].DistTo( pos[1][b] ) );
+		}
+	}
+
+	// time the two modes
+	double duration[2];
+	int count = 0;
+
+	for ( int mode = 0; mode < 2; ++mode )
+	{
+		anim_simd_blend.SetValue( mode );
+
+		double start = Plat_FloatTime();
+		count = BenchmarkBoneSetupPass( &studioHdr, poseParameter, -1, iterations, pos[ mode ], q[ mode ] );
+		duration[ mode ] = Plat_FloatTime() - start;
+	}
+
+	anim_simd_blend.SetValue( oldValue );
+
+	Msg( "anim_benchmark_bones: %s, %d bones, %d poses\n", pszModel, studioHdr.numbones(), count );
+	Msg( "  scalar: %.3f ms total, %.2f us per pose\n", duration[0] * 1000.0, duration[0] * 1000000.0 / count );
+	Msg( "  SIMD:   %.3f ms total, %.2f us per pose\n", duration[1] * 1000.0, duration[1] * 1000000.0 / count );
+	Msg( "  largest difference: %.4f degrees, %.4f units\n", maxAngle, maxDistance );
+}
@@ -3499,6 +3499,9 @@ void CBaseCombatCharacter::UpdateLastKnownArea( void )
 
 		OnNavAreaChanged( area, m_lastNavArea );
 
+		// wake bots that are sleeping until an enemy might come into view
+		TheNextBots().OnAreaOccupancyChanged( this, area );
+
 		m_lastNavArea = area;
 	}
 #endif
@@ -12,7 +12,9 @@
 #endif
 
 class CBasePlayer;
+class CBaseAnimatingOverlay;
 class CUserCmd;
+class Vector;
 
 //-----------------------------------------------------------------------------
 // Purpose: This is also an IServerSystem
@@ -22,8 +24,16 @@ abstract_class ILagCompensationManager
 public:
 	// Called during player movement to set up/restore after lag compensation
 	virtual void	StartLagCompensation( CBasePlayer *player, CUserCmd *cmd ) = 0;
+	// As above, for a shot fired from vecSrc along vecDir that can hit nothing beyond flRange, and strays at most
+	// flMaxSpread units along each of its right and up axes per unit forward. Only players it could hit are moved.
+	virtual void	StartLagCompensationForShot( CBasePlayer *player, CUserCmd *cmd, const Vector &vecSrc, const Vector &vecDir, float flMaxSpread, float flRange ) = 0;
 	virtual void	FinishLagCompensation( CBasePlayer *player ) = 0;
 	virtual bool	IsCurrentlyDoingLagCompensation() const = 0;
+
+	// Non-player entities, such as NextBot NPCs, that players' shots should be lag compensated against.
+	// Entities must remove themselves before they are deleted.
+	virtual void	AddAdditionalEntity( CBaseAnimatingOverlay *pEntity ) = 0;
+	virtual void	RemoveAdditionalEntity( CBaseAnimatingOverlay *pEntity ) = 0;
 };
 
 extern ILagCompensationManager *lagcompensation;
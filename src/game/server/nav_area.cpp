@@ -807,6 +807,8 @@ void CNavArea::ConnectTo( CNavArea *area, NavDirType dir )
 	m_connect[ dir ].AddToTail( con );
 	m_incomingConnect[ dir ].FindAndRemove( con );
 
+	TheNavMesh->OnEditConnectNotify( this );
+
 	NavDirType dirOpposite = OppositeDirection( dir );
 	con.area = this;
 	if ( area->m_connect[ dirOpposite ].Find( con ) == area->m_connect[ dirOpposite ].InvalidIndex() )
@@ -837,6 +839,8 @@ void CNavArea::ConnectTo( CNavLadder *ladder )
 	{
 		AddLadderUp( ladder );
 	}
+
+	TheNavMesh->OnEditConnectNotify( this );
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -865,6 +869,8 @@ void CNavArea::Disconnect( CNavArea *area )
 				connect.area = this;
 				area->m_incomingConnect[ dirOpposite ].FindAndRemove( connect );
 			}
+
+			TheNavMesh->OnEditConnectNotify( this );
 		}		
 	}
 }
@@ -881,7 +887,10 @@ void CNavArea::Disconnect( CNavLadder *ladder )
 
 	for( int i=0; i<CNavLadder::NUM_LADDER_DIRECTIONS; ++i )
 	{
-		m_ladder[i].FindAndRemove( con );
+		if ( m_ladder[i].FindAndRemove( con ) )
+		{
+			TheNavMesh->OnEditConnectNotify( this );
+		}
 	}
 }
 
@@ -5722,6 +5731,14 @@ bool CNavArea::IsPotentiallyVisible( const CNavArea *viewedArea ) const
 		return true;
 	}
 
+	// use the bitset copy of our visible set, if it is current
+	CNavVisibilityIndex *visIndex = TheNavMesh->GetVisibilityIndex();
+	bool isVisible;
+	if ( visIndex && visIndex->IsVisible( this, viewedArea, false, &isVisible ) )
+	{
+		return isVisible;
+	}
+
 	// normal visibility check
 	for ( int i=0; i<m_potentiallyVisibleAreas.Count(); ++i )
 	{
@@ -5767,6 +5784,14 @@ bool CNavArea::IsCompletelyVisible( const CNavArea *viewedArea ) const
 		return true;
 	}
 
+	// use the bitset copy of our visible set, if it is current
+	CNavVisibilityIndex *visIndex = TheNavMesh->GetVisibilityIndex();
+	bool isVisible;
+	if ( visIndex && visIndex->IsVisible( this, viewedArea, true, &isVisible ) )
+	{
+		return isVisible;
+	}
+
 	// normal visibility check
 	for ( int i=0; i<m_potentiallyVisibleAreas.Count(); ++i )
 	{
@@ -5803,6 +5828,14 @@ bool CNavArea::IsPotentiallyVisibleToTeam( int teamIndex ) const
 {
 	VPROF_BUDGET( "CNavArea::IsPotentiallyVisibleToTeam", "NextBot" );
 
+	// use the union of the visible sets of the team's areas for this tick, if it is current
+	CNavVisibilityIndex *visIndex = TheNavMesh->GetVisibilityIndex();
+	bool isVisible;
+	if ( visIndex && visIndex->IsVisibleToTeam( this, teamIndex, false, &isVisible ) )
+	{
+		return isVisible;
+	}
+
 	CTeam *team = GetGlobalTeam( teamIndex );
 
 	for( int i = 0; i < team->GetNumPlayers(); ++i )
@@ -5830,6 +5863,14 @@ bool CNavArea::IsCompletelyVisibleToTeam( int teamIndex ) const
 {
 	VPROF_BUDGET( "CNavArea::IsCompletelyVisibleToTeam", "NextBot" );
 
+	// use the union of the visible sets of the team's areas for this tick, if it is current
+	CNavVisibilityIndex *visIndex = TheNavMesh->GetVisibilityIndex();
+	bool isVisible;
+	if ( visIndex && visIndex->IsVisibleToTeam( this, teamIndex, true, &isVisible ) )
+	{
+		return isVisible;
+	}
+
 	CTeam *team = GetGlobalTeam( teamIndex );
 
 	for( int i = 0; i < team->GetNumPlayers(); ++i )
@@ -642,6 +642,8 @@ public:
 
 private:
 	friend class CNavMesh;
+	friend class CNavGridIndex;
+	friend class CNavVisibilityIndex;
 	friend class CNavLadder;
 	friend class CCSNavArea;									// allow CS load code to complete replace our default load behavior
 
@@ -474,6 +474,7 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 
 	// load number of hiding spots
 	unsigned char hidingSpotCount = fileBuffer.GetUnsignedChar();
+	m_hidingSpots.EnsureCapacity( hidingSpotCount );
 
 	if (version == 1)
 	{
@@ -555,6 +556,7 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 		return NAV_OK;
 	}
 
+	m_spotEncounters.EnsureCapacity( count );
 	for( unsigned int e=0; e<count; ++e )
 	{
 		SpotEncounter *encounter = new SpotEncounter;
@@ -571,6 +573,7 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 
 		// read list of spots along this path
 		unsigned char spotCount = fileBuffer.GetUnsignedChar();
+		encounter->spots.EnsureCapacity( spotCount );
 	
 		SpotOrder order;
 		for( int s=0; s<spotCount; ++s )
@@ -719,7 +722,7 @@ NavErrorType CNavArea::PostLoad( void )
 
 			// convert connect ID into an actual area
 			unsigned int id = connect->id;
-			connect->area = TheNavMesh->GetNavAreaByID( id );
+			connect->area = TheNavMesh->GetLoadedNavAreaByID( id );
 			if (id && connect->area == NULL)
 			{
 				Msg( "CNavArea::PostLoad: Corrupt navigation data. Cannot connect Navigation Areas.\n" );
@@ -735,14 +738,14 @@ NavErrorType CNavArea::PostLoad( void )
 	{
 		e = m_spotEncounters[ it ];
 
-		e->from.area = TheNavMesh->GetNavAreaByID( e->from.id );
+		e->from.area = TheNavMesh->GetLoadedNavAreaByID( e->from.id );
 		if (e->from.area == NULL)
 		{
 			Msg( "CNavArea::PostLoad: Corrupt navigation data. Missing \"from\" Navigation Area for Encounter Spot.\n" );
 			error = NAV_CORRUPT_DATA;
 		}
 
-		e->to.area = TheNavMesh->GetNavAreaByID( e->to.id );
+		e->to.area = TheNavMesh->GetLoadedNavAreaByID( e->to.id );
 		if (e->to.area == NULL)
 		{
 			Msg( "CNavArea::PostLoad: Corrupt navigation data. Missing \"to\" Navigation Area for Encounter Spot.\n" );
@@ -766,7 +769,7 @@ NavErrorType CNavArea::PostLoad( void )
 		{
 			SpotOrder *order = &e->spots[ sit ];
 
-			order->spot = GetHidingSpotByID( order->id );
+			order->spot = TheNavMesh->GetLoadedHidingSpotByID( order->id );
 			if (order->spot == NULL)
 			{
 				Msg( "CNavArea::PostLoad: Corrupt navigation data. Missing Hiding Spot\n" );
@@ -780,14 +783,14 @@ NavErrorType CNavArea::PostLoad( void )
 	{
 		AreaBindInfo &info = m_potentiallyVisibleAreas[ it ];
 
-		info.area = TheNavMesh->GetNavAreaByID( info.id );
+		info.area = TheNavMesh->GetLoadedNavAreaByID( info.id );
 		if ( info.area == NULL )
 		{
 			Warning( "Invalid area in visible set for area #%d\n", GetID() );
 		}		
 	}
 
-	m_inheritVisibilityFrom.area = TheNavMesh->GetNavAreaByID( m_inheritVisibilityFrom.id );
+	m_inheritVisibilityFrom.area = TheNavMesh->GetLoadedNavAreaByID( m_inheritVisibilityFrom.id );
 	Assert( m_inheritVisibilityFrom.area != this );
 
 	// remove any invalid areas from the list
@@ -1609,6 +1612,91 @@ NavErrorType CNavMesh::Load( void )
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Index the freshly loaded areas and hiding spots by ID, so binding the thousands of IDs
+ * stored in the file doesn't walk the ID hash chains and the hiding spot list for each one.
+ * IDs are normally dense, since they are compressed on save. If they aren't, the tables
+ * are skipped and lookups fall back to the regular searches.
+ */
+void CNavMesh::BuildLoadLookupTables( void )
+{
+	ClearLoadLookupTables();
+
+	unsigned int maxID = 0;
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		maxID = MAX( maxID, TheNavAreas[ it ]->GetID() );
+	}
+
+	if ( maxID <= 4 * (unsigned int)TheNavAreas.Count() + 1024 )
+	{
+		m_loadAreaByID.SetCount( maxID + 1 );
+		V_memset( m_loadAreaByID.Base(), 0, m_loadAreaByID.Count() * sizeof( CNavArea * ) );
+
+		FOR_EACH_VEC( TheNavAreas, it )
+		{
+			CNavArea *area = TheNavAreas[ it ];
+			m_loadAreaByID[ area->GetID() ] = area;
+		}
+	}
+
+	maxID = 0;
+	FOR_EACH_VEC( TheHidingSpots, it )
+	{
+		maxID = MAX( maxID, TheHidingSpots[ it ]->GetID() );
+	}
+
+	if ( maxID <= 4 * (unsigned int)TheHidingSpots.Count() + 1024 )
+	{
+		m_loadHidingSpotByID.SetCount( maxID + 1 );
+		V_memset( m_loadHidingSpotByID.Base(), 0, m_loadHidingSpotByID.Count() * sizeof( HidingSpot * ) );
+
+		// GetHidingSpotByID() returns the first spot with a given ID, so keep the first one here, too
+		FOR_EACH_VEC_BACK( TheHidingSpots, it )
+		{
+			HidingSpot *spot = TheHidingSpots[ it ];
+			m_loadHidingSpotByID[ spot->GetID() ] = spot;
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavMesh::ClearLoadLookupTables( void )
+{
+	m_loadAreaByID.Purge();
+	m_loadHidingSpotByID.Purge();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavArea *CNavMesh::GetLoadedNavAreaByID( unsigned int id ) const
+{
+	if ( m_loadAreaByID.Count() == 0 )
+		return GetNavAreaByID( id );
+
+	if ( id == 0 || id >= (unsigned int)m_loadAreaByID.Count() )
+		return NULL;
+
+	return m_loadAreaByID[ id ];
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+HidingSpot *CNavMesh::GetLoadedHidingSpotByID( unsigned int id ) const
+{
+	if ( m_loadHidingSpotByID.Count() == 0 )
+		return GetHidingSpotByID( id );
+
+	if ( id >= (unsigned int)m_loadHidingSpotByID.Count() )
+		return NULL;
+
+	return m_loadHidingSpotByID[ id ];
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
 struct OneWayLink_t
 {
 	CNavArea *destArea;
@@ -1633,12 +1721,19 @@ struct OneWayLink_t
 NavErrorType CNavMesh::PostLoad( unsigned int version )
 {
 	// allow areas to connect to each other, etc
+	BuildLoadLookupTables();
+
 	FOR_EACH_VEC( TheNavAreas, pit )
 	{
 		CNavArea *area = TheNavAreas[ pit ];
 		area->PostLoad();
 	}
 
+	ClearLoadLookupTables();
+
+	// visibility lists now point at actual areas
+	m_isVisibilityIndexDirty = true;
+
 	// allow hiding spots to compute information
 	FOR_EACH_VEC( TheHidingSpots, hit )
 	{
@@ -17,6 +17,8 @@
 #include "viewport_panel_names.h"
 //#include "terror/TerrorShared.h"
 #include "fmtstr.h"
+#include "datacache/imdlcache.h"
+#include "vstdlib/jobthread.h"
 
 #ifdef TERROR
 #include "func_simpleladder.h"
@@ -43,6 +45,7 @@ ConVar nav_generate_jump_connections( "nav_generate_jump_connections", "1", FCVA
 ConVar nav_generate_incremental_range( "nav_generate_incremental_range", "2000", FCVAR_CHEAT );
 ConVar nav_generate_incremental_tolerance( "nav_generate_incremental_tolerance", "0", FCVAR_CHEAT, "Z tolerance for adding new nav areas." );
 ConVar nav_area_max_size( "nav_area_max_size", "50", FCVAR_CHEAT, "Max area size created in nav generation" );
+ConVar nav_generate_threaded( "nav_generate_threaded", "1", FCVAR_CHEAT, "Trace the walkable space samples on multiple threads. The generated mesh is the same either way. 2 also samples again on one thread afterwards and reports any nodes that differ." );
 
 // Common bounding box for traces
 Vector NavTraceMins( -0.45, -0.45, 0 );
@@ -3480,8 +3483,23 @@ void CNavMesh::BeginGeneration( bool incremental )
 	// initialize seed list index
 	m_seedIdx = 0;
 
+	// sample on multiple threads for the whole run, or not at all
+	m_isGenerationThreaded = nav_generate_threaded.GetBool();
+	m_isValidatingThreadedSampling = ( nav_generate_threaded.GetInt() == 2 );
+	m_threadedSampleRecord.Purge();
+	m_sampleProbeCache.Purge();
+	m_sampleProbeCount = 0;
+	m_sampleProbeWasted = 0;
+	m_crouchCheckNodes.RemoveAll();
+	m_crouchCheckNodeSet.RemoveAll();
+
 	Msg( "Generating Navigation Mesh...\n" );
 	m_generationStartTime = Plat_FloatTime();
+
+	for( int i=0; i<NUM_GENERATION_STATES; ++i )
+	{
+		m_generationStateTime[i].Init();
+	}
 }
 
 
@@ -3549,6 +3567,11 @@ void CNavMesh::BeginAnalysis( bool quitWhenFinished )
 	m_bQuitWhenFinished = quitWhenFinished;
 	lastMsgTime = 0.0f;
 	m_generationStartTime = Plat_FloatTime();
+
+	for( int i=0; i<NUM_GENERATION_STATES; ++i )
+	{
+		m_generationStateTime[i].Init();
+	}
 }
 
 
@@ -3642,6 +3665,8 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 
 	static ConVarRef host_thread_mode( "host_thread_mode" );
 
+	CTimeAdder stateTimer( &m_generationStateTime[ m_generationState ] );
+
 	switch( m_generationState )
 	{
 		//---------------------------------------------------------------------------
@@ -3658,6 +3683,23 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 				}
 			}
 
+			if ( m_isGenerationThreaded )
+			{
+				CheckCrouchOfSampledNodes();
+
+				if ( m_isValidatingThreadedSampling )
+				{
+					// keep what threaded sampling found, and do it all again on this thread to compare
+					RecordSampledNodes();
+					RestartSamplingSerially();
+					return true;
+				}
+			}
+			else if ( m_isValidatingThreadedSampling )
+			{
+				CompareSampledNodes();
+			}
+
 			// sampling is complete, now build nav areas
 			m_generationState = CREATE_AREAS_FROM_SAMPLES;
 
@@ -4001,6 +4043,8 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			// generation complete!
 			float generationTime = Plat_FloatTime() - m_generationStartTime;
 			Msg( "Generation complete!  %0.1f seconds elapsed.\n", generationTime );
+			stateTimer.End();
+			ReportGenerationTimes();
 			bool restart = m_generationMode != GENERATE_INCREMENTAL;
 			m_generationMode = GENERATE_NONE;
 			m_isLoaded = true;
@@ -4055,6 +4099,40 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 	return false;
 }
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Print how long each generation state took
+ */
+void CNavMesh::ReportGenerationTimes( void ) const
+{
+	static const char *stateName[] =
+	{
+		"Sample walkable space",
+		"Create areas from samples",
+		"Find hiding spots",
+		"Find encounter spots",
+		"Find sniper spots",
+		"Find earliest occupy times",
+		"Find light intensity",
+		"Compute mesh visibility",
+		"Custom",
+		"Save nav mesh",
+	};
+	COMPILE_TIME_ASSERT( ARRAYSIZE( stateName ) == NUM_GENERATION_STATES );
+
+	Msg( "Generation time by phase:\n" );
+
+	for( int i=0; i<NUM_GENERATION_STATES; ++i )
+	{
+		if ( m_generationStateTime[i].GetLongCycles() == 0 )
+			continue;
+
+		bool isThreaded = ( i == SAMPLE_WALKABLE_SPACE && m_isGenerationThreaded );
+		Msg( "  %-28s %8.2f seconds%s\n", stateName[i], m_generationStateTime[i].GetSeconds(), isThreaded ? " (threaded)" : "" );
+	}
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Define the name of player spawn entities
@@ -4127,7 +4205,19 @@ CNavNode *CNavMesh::AddNode( const Vector &destPos, const Vector &normal, NavDir
 		m_currentNode = node;
 	}
 
-	node->CheckCrouch();
+	if ( m_isGenerationThreaded )
+	{
+		// the crouch check only depends on the node's position, so do them all in parallel when sampling is done
+		if ( !m_crouchCheckNodeSet.HasElement( node ) )
+		{
+			m_crouchCheckNodeSet.Insert( node );
+			m_crouchCheckNodes.AddToTail( node );
+		}
+	}
+	else
+	{
+		node->CheckCrouch();
+	}
 
 	// determine if there's a cliff nearby and set an attribute on this node
 	for ( int i = 0; i < NUM_DIRECTIONS; i++ )
@@ -4350,6 +4440,479 @@ static bool IsNodeOverlapped( const Vector& pos, const Vector& offset )
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Trace one sampling step from the given node in the given direction.
+ * Returns true and fills in 'probe' if a node should be added there.
+ *
+ * This only reads the world, the sampling parameters and any existing nav areas, none of which 
+ * change while sampling, so it can run in parallel and ahead of the search that uses it.
+ */
+bool CNavMesh::ProbeSampleStep( const CNavNode *node, NavDirType dir, SampleProbe *probe ) const
+{
+	probe->m_isValid = false;
+
+	// start at node position
+	Vector pos = *node->GetPosition();
+
+	// snap to grid
+	int cx = SnapToGrid( pos.x );
+	int cy = SnapToGrid( pos.y );
+
+	// attempt to move to adjacent node
+	switch( dir )
+	{
+		case NORTH:		cy -= GenerationStepSize; break;
+		case SOUTH:		cy += GenerationStepSize; break;
+		case EAST:		cx += GenerationStepSize; break;
+		case WEST:		cx -= GenerationStepSize; break;
+	}
+
+	pos.x = cx;
+	pos.y = cy;
+
+	// sanity check to not generate across the world for incremental generation
+	const float incrementalRange = nav_generate_incremental_range.GetFloat();
+	if ( m_generationMode == GENERATE_INCREMENTAL && incrementalRange > 0 )
+	{
+		bool inRange = false;
+		for ( int i=0; i<m_walkableSeeds.Count(); ++i )
+		{
+			const Vector &seedPos = m_walkableSeeds[i].pos;
+			if ( (seedPos - pos).IsLengthLessThan( incrementalRange ) )
+			{
+				inRange = true;
+				break;
+			}
+		}
+
+		if ( !inRange )
+		{
+			return false;
+		}
+	}
+
+	if ( m_generationMode == GENERATE_SIMPLIFY )
+	{
+		if ( !m_simplifyGenerationExtent.Contains( pos ) )
+		{
+			return false;
+		}
+	}
+
+	// test if we can move to new position
+	trace_t result;
+	Vector from( *node->GetPosition() );
+	CTraceFilterWalkableEntities filter( NULL, COLLISION_GROUP_NONE, WALK_THRU_EVERYTHING );
+	Vector to = vec3_origin, toNormal = vec3_origin;
+	float obstacleHeight = 0, obstacleStartDist = 0, obstacleEndDist = GenerationStepSize;
+	if ( TraceAdjacentNode( 0, from, pos, &result ) )
+	{
+		to = result.endpos;
+		toNormal = result.plane.normal;
+	}
+	else
+	{
+		// test going up ClimbUpHeight
+		bool success = false;
+		for ( float height = StepHeight; height <= ClimbUpHeight; height += 1.0f )
+		{						
+			trace_t tr;
+			Vector start( from );
+			Vector end( pos );
+			start.z += height;
+			end.z += height;
+			UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+			if ( !tr.startsolid && tr.fraction == 1.0f )
+			{
+				if ( !StayOnFloor( &tr ) )
+				{
+					break;
+				}
+
+				to = tr.endpos;
+				toNormal = tr.plane.normal;
+
+				start = end = from;
+				end.z += height;
+				UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+				if ( tr.fraction < 1.0f )
+				{
+					break;
+				}
+
+				// keep track of far up we had to go to find a path to the next node
+				obstacleHeight = height;
+				success = true;
+				break;
+			}
+			else
+			{
+				// Could not trace from node to node at this height, something is in the way.
+				// Trace in the other direction to see if we hit something
+				Vector vecToObstacleStart = tr.endpos - start;
+				Assert( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) );
+				if ( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) )
+				{
+					UTIL_TraceHull( end, start, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+					if ( !tr.startsolid && tr.fraction < 1.0 )
+					{
+						// We hit something going the other direction.  There is some obstacle between the two nodes.
+						Vector vecToObstacleEnd = tr.endpos - start;
+						Assert( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize ) );
+						if ( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize )  )
+						{
+							// Remember the distances to start and end of the obstacle (with respect to the "from" node).
+							// Keep track of the last distances to obstacle as we keep increasing the height we do a trace for.
+							// If we do eventually clear the obstacle, these values will be the start and end distance to the
+							// very tip of the obstacle.
+							obstacleStartDist = vecToObstacleStart.Length();
+							obstacleEndDist = vecToObstacleEnd.Length();
+							if ( obstacleEndDist == 0 )
+							{
+								obstacleEndDist = GenerationStepSize;
+							}
+						}								
+					}
+				}
+			}
+		}
+
+		if ( !success )
+		{
+			return false;
+		}
+	}
+
+	// Don't generate nodes if we spill off the end of the world onto skybox
+	if ( result.surface.flags & ( SURF_SKY|SURF_SKY2D ) )
+	{
+		return false;
+	}
+
+	// If we're incrementally generating, don't overlap existing nav areas.
+	Vector testPos( to );
+	bool overlapSE = IsNodeOverlapped( testPos, Vector(  1,  1, HalfHumanHeight ) );
+	bool overlapSW = IsNodeOverlapped( testPos, Vector( -1,  1, HalfHumanHeight ) );
+	bool overlapNE = IsNodeOverlapped( testPos, Vector(  1, -1, HalfHumanHeight ) );
+	bool overlapNW = IsNodeOverlapped( testPos, Vector( -1, -1, HalfHumanHeight ) );
+	if ( overlapSE && overlapSW && overlapNE && overlapNW && m_generationMode != GENERATE_SIMPLIFY )
+	{
+		return false;
+	}
+
+	int nTolerance = nav_generate_incremental_tolerance.GetInt();
+	if ( nTolerance > 0 && m_generationMode == GENERATE_INCREMENTAL )
+	{
+		bool bValid = false;
+		int zPos = to.z;
+		for ( int i=0; i<m_walkableSeeds.Count(); ++i )
+		{
+			const Vector &seedPos = m_walkableSeeds[i].pos;
+			int zMin = seedPos.z - nTolerance;
+			int zMax = seedPos.z + nTolerance;
+
+			if ( zPos >= zMin && zPos <= zMax )
+			{
+				bValid = true;
+				break;
+			}
+		}
+
+		if ( !bValid )
+			return false;
+	}
+
+
+	bool isOnDisplacement = result.IsDispSurface();
+
+	if ( nav_displacement_test.GetInt() > 0 )
+	{
+		// Test for nodes under displacement surfaces.
+		// This happens during development, and is a pain because the space underneath a displacement
+		// is not 'solid'.
+		Vector start = to + Vector( 0, 0, 0 );
+		Vector end = start + Vector( 0, 0, nav_displacement_test.GetInt() );
+		UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
+
+		if ( result.fraction > 0 )
+		{
+			end = start;
+			start = result.endpos;
+			UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
+			if ( result.fraction < 1 )
+			{
+				// if we made it down to within StepHeight, maybe we're on a static prop
+				if ( result.endpos.z > to.z + StepHeight )
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	float deltaZ = to.z - node->GetPosition()->z;
+	// If there's an obstacle in the way and it's traversable, or the obstacle is not higher than the destination node itself minus a small epsilon
+	// (meaning the obstacle was just the height change to get to the destination node, no extra obstacle between the two), clear obstacle height
+	// and distances
+	if ( ( obstacleHeight < MaxTraversableHeight ) || ( deltaZ > ( obstacleHeight - 2.0f ) ) )
+	{
+		obstacleHeight = 0;
+		obstacleStartDist = 0;
+		obstacleEndDist = GenerationStepSize;
+	}
+
+	probe->m_isValid = true;
+	probe->m_isOnDisplacement = isOnDisplacement;
+	probe->m_to = to;
+	probe->m_toNormal = toNormal;
+	probe->m_obstacleHeight = obstacleHeight;
+	probe->m_obstacleStartDist = obstacleStartDist;
+	probe->m_obstacleEndDist = obstacleEndDist;
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+static int CountSampleProbes( int dirBits )
+{
+	int count = 0;
+	for( int d=0; d<NUM_DIRECTIONS; ++d )
+	{
+		if ( dirBits & ( 1 << d ) )
+			++count;
+	}
+	return count;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+static void PreGenerationJobs( void )
+{
+	mdlcache->BeginLock();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+static void PostGenerationJobs( void )
+{
+	mdlcache->EndLock();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavMesh::ProbeSampleStepJob( SampleProbeJob &job )
+{
+	TheNavMesh->ProbeSampleStep( job.m_node, job.m_dir, job.m_probe );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the result of a sampling step from the given node in the given direction.
+ * When threaded, the first request for a node traces every direction that hasn't been searched
+ * from it yet in parallel, and keeps the rest for when the search comes back to the node.
+ * Since probes don't depend on the search order, the mesh is identical either way.
+ */
+void CNavMesh::GetSampleProbe( CNavNode *node, NavDirType dir, SampleProbe *probe )
+{
+	++m_sampleProbeCount;
+
+	if ( !m_isGenerationThreaded )
+	{
+		ProbeSampleStep( node, dir, probe );
+		return;
+	}
+
+	UtlHashHandle_t h = m_sampleProbeCache.Find( node );
+	if ( h == m_sampleProbeCache.InvalidHandle() )
+	{
+		SampleProbeSet probeSet;
+		probeSet.m_pendingDirs = 0;
+
+		SampleProbeJob jobs[ NUM_DIRECTIONS ];
+		int jobCount = 0;
+
+		for( int d=0; d<NUM_DIRECTIONS; ++d )
+		{
+			if ( d == dir || !node->HasVisited( (NavDirType)d ) )
+			{
+				jobs[ jobCount ].m_node = node;
+				jobs[ jobCount ].m_dir = (NavDirType)d;
+				jobs[ jobCount ].m_probe = &probeSet.m_probe[d];
+				++jobCount;
+
+				probeSet.m_pendingDirs |= ( 1 << d );
+			}
+		}
+
+		ParallelProcess( "CNavMesh::ProbeSampleStep", jobs, jobCount, &ProbeSampleStepJob, &PreGenerationJobs, &PostGenerationJobs );
+
+		h = m_sampleProbeCache.Insert( node, probeSet );
+	}
+
+	SampleProbeSet &probeSet = m_sampleProbeCache.Element( h );
+
+	*probe = probeSet.m_probe[ dir ];
+	probeSet.m_pendingDirs &= ~( 1 << dir );
+
+	if ( probeSet.m_pendingDirs == 0 )
+	{
+		m_sampleProbeCache.RemoveByHandle( h );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavMesh::CheckNodeCrouchJob( CNavNode *&node )
+{
+	node->CheckCrouch();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Finish threaded sampling by doing the crouch checks that AddNode() deferred
+ */
+void CNavMesh::CheckCrouchOfSampledNodes( void )
+{
+	ParallelProcess( "CNavNode::CheckCrouch", m_crouchCheckNodes.Base(), m_crouchCheckNodes.Count(), &CheckNodeCrouchJob, &PreGenerationJobs, &PostGenerationJobs );
+
+	FOR_EACH_HASHTABLE( m_sampleProbeCache, h )
+	{
+		m_sampleProbeWasted += CountSampleProbes( m_sampleProbeCache.Element( h ).m_pendingDirs );
+	}
+
+	Msg( "Sampling used %d steps, and traced %d more ahead of the search that were not needed.\n", m_sampleProbeCount, m_sampleProbeWasted );
+
+	m_sampleProbeCache.Purge();
+	m_crouchCheckNodes.Purge();
+	m_crouchCheckNodeSet.Purge();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Copy the sampled nodes into m_threadedSampleRecord, indexed by node ID.
+ * Single-threaded sampling creates the same nodes in the same order, so the IDs match.
+ */
+void CNavMesh::RecordSampledNodes( void )
+{
+	m_threadedSampleRecord.SetCount( CNavNode::GetListLength() + 1 );
+	V_memset( m_threadedSampleRecord.Base(), 0, m_threadedSampleRecord.Count() * sizeof( SampledNodeRecord ) );
+
+	for( CNavNode *node = CNavNode::GetFirst(); node; node = node->GetNext() )
+	{
+		if ( node->GetID() >= (unsigned int)m_threadedSampleRecord.Count() )
+			continue;
+
+		SampledNodeRecord &record = m_threadedSampleRecord[ node->GetID() ];
+
+		record.m_isValid = true;
+		record.m_pos = *node->GetPosition();
+		record.m_attributes = node->GetAttributes();
+
+		for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+		{
+			record.m_to[ dir ] = node->m_to[ dir ] ? node->m_to[ dir ]->GetID() : 0;
+			record.m_obstacleHeight[ dir ] = node->m_obstacleHeight[ dir ];
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Throw away the sampled nodes and sample again from the first seed, on this thread
+ */
+void CNavMesh::RestartSamplingSerially( void )
+{
+	Msg( "Sampling again on one thread to validate %d threaded nodes...\n", m_threadedSampleRecord.Count() - 1 );
+
+	CNavNode::CleanupGeneration();
+
+	m_currentNode = NULL;
+	m_seedIdx = 0;
+	m_isGenerationThreaded = false;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Report each node of single-threaded sampling that differs from what threaded sampling recorded
+ */
+void CNavMesh::CompareSampledNodes( void )
+{
+	const int maxReports = 20;
+	int differenceCount = 0;
+	int nodeCount = 0;
+
+	for( CNavNode *node = CNavNode::GetFirst(); node; node = node->GetNext() )
+	{
+		++nodeCount;
+
+		const char *difference = NULL;
+
+		if ( node->GetID() >= (unsigned int)m_threadedSampleRecord.Count() || !m_threadedSampleRecord[ node->GetID() ].m_isValid )
+		{
+			difference = "missing from threaded sampling";
+		}
+		else
+		{
+			const SampledNodeRecord &record = m_threadedSampleRecord[ node->GetID() ];
+
+			if ( record.m_pos != *node->GetPosition() )
+			{
+				difference = "position";
+			}
+			else if ( record.m_attributes != node->GetAttributes() )
+			{
+				difference = "attributes";
+			}
+			else
+			{
+				for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+				{
+					unsigned int to = node->m_to[ dir ] ? node->m_to[ dir ]->GetID() : 0;
+					if ( record.m_to[ dir ] != to || record.m_obstacleHeight[ dir ] != node->m_obstacleHeight[ dir ] )
+					{
+						difference = "connections";
+						break;
+					}
+				}
+			}
+		}
+
+		if ( difference )
+		{
+			if ( differenceCount < maxReports )
+			{
+				Warning( "Threaded sampling differs at node #%d (%.1f, %.1f, %.1f): %s\n", node->GetID(), node->GetPosition()->x, node->GetPosition()->y, node->GetPosition()->z, difference );
+			}
+			++differenceCount;
+		}
+	}
+
+	if ( nodeCount != m_threadedSampleRecord.Count() - 1 )
+	{
+		Warning( "Threaded sampling made %d nodes, single-threaded sampling made %d\n", m_threadedSampleRecord.Count() - 1, nodeCount );
+		++differenceCount;
+	}
+
+	if ( differenceCount )
+	{
+		Warning( "Threaded sampling validation FAILED: %d differences\n", differenceCount );
+	}
+	else
+	{
+		Msg( "Threaded sampling validation passed: all %d nodes match\n", nodeCount );
+	}
+
+	m_threadedSampleRecord.Purge();
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Search the world and build a map of possible movements.
@@ -4407,231 +4970,34 @@ bool CNavMesh::SampleStep( void )
 			if (!m_currentNode->HasVisited( (NavDirType)dir ))
 			{
 				// have not searched in this direction yet
-
-				// start at current node position
-				Vector pos = *m_currentNode->GetPosition();
-
-				// snap to grid
-				int cx = SnapToGrid( pos.x );
-				int cy = SnapToGrid( pos.y );
-
-				// attempt to move to adjacent node
-				switch( dir )
-				{
-					case NORTH:		cy -= GenerationStepSize; break;
-					case SOUTH:		cy += GenerationStepSize; break;
-					case EAST:		cx += GenerationStepSize; break;
-					case WEST:		cx -= GenerationStepSize; break;
-				}
-
-				pos.x = cx;
-				pos.y = cy;
-
 				m_generationDir = (NavDirType)dir;
 
 				// mark direction as visited
 				m_currentNode->MarkAsVisited( m_generationDir );
 
-				// sanity check to not generate across the world for incremental generation
-				const float incrementalRange = nav_generate_incremental_range.GetFloat();
-				if ( m_generationMode == GENERATE_INCREMENTAL && incrementalRange > 0 )
-				{
-					bool inRange = false;
-					for ( int i=0; i<m_walkableSeeds.Count(); ++i )
-					{
-						const Vector &seedPos = m_walkableSeeds[i].pos;
-						if ( (seedPos - pos).IsLengthLessThan( incrementalRange ) )
-						{
-							inRange = true;
-							break;
-						}
-					}
-
-					if ( !inRange )
-					{
-						return true;
-					}
-				}
-
-				if ( m_generationMode == GENERATE_SIMPLIFY )
-				{
-					if ( !m_simplifyGenerationExtent.Contains( pos ) )
-					{
-						return true;
-					}
-				}
-
-				// test if we can move to new position
-				trace_t result;
-				Vector from( *m_currentNode->GetPosition() );
-				CTraceFilterWalkableEntities filter( NULL, COLLISION_GROUP_NONE, WALK_THRU_EVERYTHING );
-				Vector to = vec3_origin, toNormal = vec3_origin;
-				float obstacleHeight = 0, obstacleStartDist = 0, obstacleEndDist = GenerationStepSize;
-				if ( TraceAdjacentNode( 0, from, pos, &result ) )
-				{
-					to = result.endpos;
-					toNormal = result.plane.normal;
-				}
-				else
-				{
-					// test going up ClimbUpHeight
-					bool success = false;
-					for ( float height = StepHeight; height <= ClimbUpHeight; height += 1.0f )
-					{						
-						trace_t tr;
-						Vector start( from );
-						Vector end( pos );
-						start.z += height;
-						end.z += height;
-						UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-						if ( !tr.startsolid && tr.fraction == 1.0f )
-						{
-							if ( !StayOnFloor( &tr ) )
-							{
-								break;
-							}
-
-							to = tr.endpos;
-							toNormal = tr.plane.normal;
-
-							start = end = from;
-							end.z += height;
-							UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-							if ( tr.fraction < 1.0f )
-							{
-								break;
-							}
-
-							// keep track of far up we had to go to find a path to the next node
-							obstacleHeight = height;
-							success = true;
-							break;
-						}
-						else
-						{
-							// Could not trace from node to node at this height, something is in the way.
-							// Trace in the other direction to see if we hit something
-							Vector vecToObstacleStart = tr.endpos - start;
-							Assert( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) );
-							if ( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) )
-							{
-								UTIL_TraceHull( end, start, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-								if ( !tr.startsolid && tr.fraction < 1.0 )
-								{
-									// We hit something going the other direction.  There is some obstacle between the two nodes.
-									Vector vecToObstacleEnd = tr.endpos - start;
-									Assert( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize ) );
-									if ( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize )  )
-									{
-										// Remember the distances to start and end of the obstacle (with respect to the "from" node).
-										// Keep track of the last distances to obstacle as we keep increasing the height we do a trace for.
-										// If we do eventually clear the obstacle, these values will be the start and end distance to the
-										// very tip of the obstacle.
-										obstacleStartDist = vecToObstacleStart.Length();
-										obstacleEndDist = vecToObstacleEnd.Length();
-										if ( obstacleEndDist == 0 )
-										{
-											obstacleEndDist = GenerationStepSize;
-										}
-									}								
-								}
-							}
-						}
-					}
-
-					if ( !success )
-					{
-						return true;
-					}
-				}
-
-				// Don't generate nodes if we spill off the end of the world onto skybox
-				if ( result.surface.flags & ( SURF_SKY|SURF_SKY2D ) )
-				{
-					return true;
-				}
+				SampleProbe probe;
+				GetSampleProbe( m_currentNode, m_generationDir, &probe );
 
-				// If we're incrementally generating, don't overlap existing nav areas.
-				Vector testPos( to );
-				bool overlapSE = IsNodeOverlapped( testPos, Vector(  1,  1, HalfHumanHeight ) );
-				bool overlapSW = IsNodeOverlapped( testPos, Vector( -1,  1, HalfHumanHeight ) );
-				bool overlapNE = IsNodeOverlapped( testPos, Vector(  1, -1, HalfHumanHeight ) );
-				bool overlapNW = IsNodeOverlapped( testPos, Vector( -1, -1, HalfHumanHeight ) );
-				if ( overlapSE && overlapSW && overlapNE && overlapNW && m_generationMode != GENERATE_SIMPLIFY )
+				if ( probe.m_isValid )
 				{
-					return true;
+					// we can move here
+					// create a new navigation node, and update current node pointer
+					AddNode( probe.m_to, probe.m_toNormal, m_generationDir, m_currentNode, probe.m_isOnDisplacement, probe.m_obstacleHeight, probe.m_obstacleStartDist, probe.m_obstacleEndDist );
 				}
 
-				int nTolerance = nav_generate_incremental_tolerance.GetInt();
-				if ( nTolerance > 0 && m_generationMode == GENERATE_INCREMENTAL )
-				{
-					bool bValid = false;
-					int zPos = to.z;
-					for ( int i=0; i<m_walkableSeeds.Count(); ++i )
-					{
-						const Vector &seedPos = m_walkableSeeds[i].pos;
-						int zMin = seedPos.z - nTolerance;
-						int zMax = seedPos.z + nTolerance;
-
-						if ( zPos >= zMin && zPos <= zMax )
-						{
-							bValid = true;
-							break;
-						}
-					}
-
-					if ( !bValid )
-						return true;
-				}
-
-
-				bool isOnDisplacement = result.IsDispSurface();
-
-				if ( nav_displacement_test.GetInt() > 0 )
-				{
-					// Test for nodes under displacement surfaces.
-					// This happens during development, and is a pain because the space underneath a displacement
-					// is not 'solid'.
-					Vector start = to + Vector( 0, 0, 0 );
-					Vector end = start + Vector( 0, 0, nav_displacement_test.GetInt() );
-					UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
-
-					if ( result.fraction > 0 )
-					{
-						end = start;
-						start = result.endpos;
-						UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
-						if ( result.fraction < 1 )
-						{
-							// if we made it down to within StepHeight, maybe we're on a static prop
-							if ( result.endpos.z > to.z + StepHeight )
-							{
-								return true;
-							}
-						}
-					}
-				}
-
-				float deltaZ = to.z - m_currentNode->GetPosition()->z;
-				// If there's an obstacle in the way and it's traversable, or the obstacle is not higher than the destination node itself minus a small epsilon
-				// (meaning the obstacle was just the height change to get to the destination node, no extra obstacle between the two), clear obstacle height
-				// and distances
-				if ( ( obstacleHeight < MaxTraversableHeight ) || ( deltaZ > ( obstacleHeight - 2.0f ) ) )
-				{
-					obstacleHeight = 0;
-					obstacleStartDist = 0;
-					obstacleEndDist = GenerationStepSize;
-				}
-
-				// we can move here
-				// create a new navigation node, and update current node pointer
-				AddNode( to, toNormal, m_generationDir, m_currentNode, isOnDisplacement, obstacleHeight, obstacleStartDist, obstacleEndDist );
-
 				return true;
 			}
 		}
 
 		// all directions have been searched from this node - pop back to its parent and continue
+		UtlHashHandle_t h = m_sampleProbeCache.Find( m_currentNode );
+		if ( h != m_sampleProbeCache.InvalidHandle() )
+		{
+			// some directions were reached from a neighbor before we got to them
+			m_sampleProbeWasted += CountSampleProbes( m_sampleProbeCache.Element( h ).m_pendingDirs );
+			m_sampleProbeCache.RemoveByHandle( h );
+		}
+
 		m_currentNode = m_currentNode->GetParent();
 	}
 }
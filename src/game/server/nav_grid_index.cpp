@@ -0,0 +1,215 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_grid_index.cpp
+// Flat, cache friendly copy of the nav mesh grid for fast spatial queries
+
+#include "cbase.h"
+#include "nav_mesh.h"
+#include "nav_grid_index.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavGridIndex::CNavGridIndex( void )
+{
+	Reset();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavGridIndex::Reset( void )
+{
+	m_cellStart.RemoveAll();
+	m_cellStart.AddToTail( 0 );
+
+	m_area.RemoveAll();
+	m_loX.RemoveAll();
+	m_loY.RemoveAll();
+	m_loZ.RemoveAll();
+	m_hiX.RemoveAll();
+	m_hiY.RemoveAll();
+	m_hiZ.RemoveAll();
+	m_centerX.RemoveAll();
+	m_centerY.RemoveAll();
+	m_centerZ.RemoveAll();
+	m_invDx.RemoveAll();
+	m_invDy.RemoveAll();
+	m_nwZ.RemoveAll();
+	m_neZ.RemoveAll();
+	m_swZ.RemoveAll();
+	m_seZ.RemoveAll();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Copy the given grid
+ */
+void CNavGridIndex::Build( const CUtlVector< NavAreaVector > &grid )
+{
+	VPROF_BUDGET( "CNavGridIndex::Build", "NextBot" );
+
+	Reset();
+
+	int entryCount = PAD_COUNT;
+	FOR_EACH_VEC( grid, c )
+	{
+		entryCount += grid[c].Count();
+	}
+
+	m_cellStart.EnsureCapacity( grid.Count() + 1 );
+	m_area.EnsureCapacity( entryCount );
+	m_loX.EnsureCapacity( entryCount );
+	m_loY.EnsureCapacity( entryCount );
+	m_loZ.EnsureCapacity( entryCount );
+	m_hiX.EnsureCapacity( entryCount );
+	m_hiY.EnsureCapacity( entryCount );
+	m_hiZ.EnsureCapacity( entryCount );
+	m_centerX.EnsureCapacity( entryCount );
+	m_centerY.EnsureCapacity( entryCount );
+	m_centerZ.EnsureCapacity( entryCount );
+	m_invDx.EnsureCapacity( entryCount );
+	m_invDy.EnsureCapacity( entryCount );
+	m_nwZ.EnsureCapacity( entryCount );
+	m_neZ.EnsureCapacity( entryCount );
+	m_swZ.EnsureCapacity( entryCount );
+	m_seZ.EnsureCapacity( entryCount );
+
+	FOR_EACH_VEC( grid, c )
+	{
+		const NavAreaVector &areaVector = grid[c];
+
+		FOR_EACH_VEC( areaVector, it )
+		{
+			AddEntry( areaVector[ it ] );
+		}
+
+		m_cellStart.AddToTail( m_area.Count() );
+	}
+
+	AddPadding();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavGridIndex::AddEntry( CNavArea *area )
+{
+	Extent extent;
+	area->GetExtent( &extent );
+
+	m_area.AddToTail( area );
+
+	m_loX.AddToTail( extent.lo.x );
+	m_loY.AddToTail( extent.lo.y );
+	m_loZ.AddToTail( extent.lo.z );
+	m_hiX.AddToTail( extent.hi.x );
+	m_hiY.AddToTail( extent.hi.y );
+	m_hiZ.AddToTail( extent.hi.z );
+
+	const Vector &center = area->GetCenter();
+	m_centerX.AddToTail( center.x );
+	m_centerY.AddToTail( center.y );
+	m_centerZ.AddToTail( center.z );
+
+	m_invDx.AddToTail( area->m_invDxCorners );
+	m_invDy.AddToTail( area->m_invDyCorners );
+	m_nwZ.AddToTail( area->m_nwCorner.z );
+	m_neZ.AddToTail( area->m_neZ );
+	m_swZ.AddToTail( area->m_swZ );
+	m_seZ.AddToTail( area->m_seCorner.z );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Four wide loads of the last entries read up to three entries past the end. The lanes
+ * are masked off, but keep the reads in bounds with entries that overlap nothing.
+ */
+void CNavGridIndex::AddPadding( void )
+{
+	for( int i=0; i<PAD_COUNT; ++i )
+	{
+		m_area.AddToTail( NULL );
+
+		m_loX.AddToTail( FLT_MAX );
+		m_loY.AddToTail( FLT_MAX );
+		m_loZ.AddToTail( FLT_MAX );
+		m_hiX.AddToTail( -FLT_MAX );
+		m_hiY.AddToTail( -FLT_MAX );
+		m_hiZ.AddToTail( -FLT_MAX );
+
+		m_centerX.AddToTail( FLT_MAX );
+		m_centerY.AddToTail( FLT_MAX );
+		m_centerZ.AddToTail( FLT_MAX );
+
+		m_invDx.AddToTail( 0.0f );
+		m_invDy.AddToTail( 0.0f );
+		m_nwZ.AddToTail( 0.0f );
+		m_neZ.AddToTail( 0.0f );
+		m_swZ.AddToTail( 0.0f );
+		m_seZ.AddToTail( 0.0f );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the highest area in the given cell that overlaps (x,y) and whose surface at (x,y) is within [minZ, maxZ]
+ */
+CNavArea *CNavGridIndex::GetHighestArea( int cell, float x, float y, float minZ, float maxZ, bool skipBlocked, int teamID, float *areaZ ) const
+{
+	const int end = m_cellStart[ cell+1 ];
+
+	const fltx4 posX = ReplicateX4( x );
+	const fltx4 posY = ReplicateX4( y );
+
+	CNavArea *use = NULL;
+	float useZ = -99999999.9f;
+
+	for( int i = m_cellStart[ cell ]; i < end; i += 4 )
+	{
+		// 2D overlap, as CNavArea::IsOverlapping( pos )
+		fltx4 overlap = AndSIMD( CmpGeSIMD( posX, LoadUnalignedSIMD( &m_loX[i] ) ), CmpLeSIMD( posX, LoadUnalignedSIMD( &m_hiX[i] ) ) );
+		overlap = AndSIMD( overlap, AndSIMD( CmpGeSIMD( posY, LoadUnalignedSIMD( &m_loY[i] ) ), CmpLeSIMD( posY, LoadUnalignedSIMD( &m_hiY[i] ) ) ) );
+
+		int mask = TestSignSIMD( overlap ) & GetLaneMask( end - i );
+
+		for( int lane = 0; mask; ++lane, mask >>= 1 )
+		{
+			if ( !( mask & 1 ) )
+				continue;
+
+			const int entry = i + lane;
+
+			// don't consider blocked areas
+			if ( skipBlocked && m_area[ entry ]->IsBlocked( teamID ) )
+				continue;
+
+			float z = GetZ( entry, x, y );
+
+			if ( z > maxZ || z < minZ )
+				continue;
+
+			// if area is higher than the one we have, use this instead
+			if ( z > useZ )
+			{
+				use = m_area[ entry ];
+				useZ = z;
+			}
+		}
+	}
+
+	if ( areaZ )
+	{
+		*areaZ = useZ;
+	}
+
+	return use;
+}
@@ -0,0 +1,177 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_grid_index.h
+// Flat, cache friendly copy of the nav mesh grid for fast spatial queries
+
+#ifndef _NAV_GRID_INDEX_H_
+#define _NAV_GRID_INDEX_H_
+
+#include "mathlib/ssemath.h"
+
+#include "nav.h"
+
+class CNavArea;
+typedef CUtlVector< CNavArea * > NavAreaVector;
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A read-only copy of CNavMesh::m_grid in compressed sparse row form. The areas of all cells are stored
+ * back to back, and cell i owns entries [ m_cellStart[i], m_cellStart[i+1] ). For each entry, the area's
+ * extent, center, and corner heights are stored in separate arrays, so the extent tests for a cell
+ * read a few contiguous cache lines and test four areas at a time instead of visiting every area.
+ *
+ * The index is rebuilt from the grid by CNavMesh whenever the grid changes.
+ */
+class CNavGridIndex
+{
+public:
+	CNavGridIndex( void );
+
+	void Build( const CUtlVector< NavAreaVector > &grid );		// copy the given grid
+	void Reset( void );
+
+	int GetCellCount( void ) const		{ return m_cellStart.Count() - 1; }
+
+	/**
+	 * Return the highest area in the given cell that overlaps (x,y) and whose surface at (x,y) is
+	 * within [minZ, maxZ], or NULL. If 'skipBlocked' is true, areas blocked for the given team are skipped.
+	 * This gives the same result as testing each area in the cell with IsOverlapping() and GetZ().
+	 */
+	CNavArea *GetHighestArea( int cell, float x, float y, float minZ, float maxZ, bool skipBlocked = false, int teamID = TEAM_ANY, float *areaZ = NULL ) const;
+
+	/**
+	 * Invoke func( CNavArea *area ) for each area in the cell whose extent overlaps the given extent,
+	 * as Extent::IsOverlapping() would. If functor returns false, stop processing and return false.
+	 */
+	template < typename Functor >
+	bool ForEachAreaOverlapping( int cell, const Extent &extent, Functor &func ) const;
+
+	/**
+	 * Invoke func( CNavArea *area ) for each area in the cell whose center is within the given radius
+	 * of 'pos' (a radius of zero means all areas). If functor returns false, stop processing and return false.
+	 */
+	template < typename Functor >
+	bool ForEachAreaInRadius( int cell, const Vector &pos, float radius, Functor &func ) const;
+
+private:
+	CUtlVector< int > m_cellStart;								// cell count + 1 offsets into the entry arrays
+
+	// entry arrays, padded so four wide loads never read past the end
+	CUtlVector< CNavArea * > m_area;
+	CUtlVector< float > m_loX, m_loY, m_loZ;					// 3D extent, as from CNavArea::GetExtent()
+	CUtlVector< float > m_hiX, m_hiY, m_hiZ;
+	CUtlVector< float > m_centerX, m_centerY, m_centerZ;
+	CUtlVector< float > m_invDx, m_invDy;						// corner heights for computing the surface Z, as in CNavArea::GetZ()
+	CUtlVector< float > m_nwZ, m_neZ, m_swZ, m_seZ;
+
+	enum { PAD_COUNT = 3 };
+	void AddEntry( CNavArea *area );
+	void AddPadding( void );
+
+	float GetZ( int entry, float x, float y ) const;
+
+	// mask of the first 'count' lanes, for a block of four entries that runs past the end of a cell
+	static int GetLaneMask( int count )		{ return ( count >= 4 ) ? 0xF : ( 1 << count ) - 1; }
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavGridIndex::GetZ( int entry, float x, float y ) const
+{
+	// guard against division by zero due to degenerate areas
+	if ( m_invDx[ entry ] == 0.0f || m_invDy[ entry ] == 0.0f )
+		return m_neZ[ entry ];
+
+	float u = ( x - m_loX[ entry ] ) * m_invDx[ entry ];
+	float v = ( y - m_loY[ entry ] ) * m_invDy[ entry ];
+
+	// clamp Z values to (x,y) volume
+	u = fsel( u, u, 0 );			// u >= 0 ? u : 0
+	u = fsel( u - 1.0f, 1.0f, u );	// u >= 1 ? 1 : u
+
+	v = fsel( v, v, 0 );			// v >= 0 ? v : 0
+	v = fsel( v - 1.0f, 1.0f, v );	// v >= 1 ? 1 : v
+
+	float northZ = m_nwZ[ entry ] + u * ( m_neZ[ entry ] - m_nwZ[ entry ] );
+	float southZ = m_swZ[ entry ] + u * ( m_seZ[ entry ] - m_swZ[ entry ] );
+
+	return northZ + v * ( southZ - northZ );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+template < typename Functor >
+inline bool CNavGridIndex::ForEachAreaOverlapping( int cell, const Extent &extent, Functor &func ) const
+{
+	const int end = m_cellStart[ cell+1 ];
+
+	const fltx4 extentLoX = ReplicateX4( extent.lo.x );
+	const fltx4 extentLoY = ReplicateX4( extent.lo.y );
+	const fltx4 extentLoZ = ReplicateX4( extent.lo.z );
+	const fltx4 extentHiX = ReplicateX4( extent.hi.x );
+	const fltx4 extentHiY = ReplicateX4( extent.hi.y );
+	const fltx4 extentHiZ = ReplicateX4( extent.hi.z );
+
+	for( int i = m_cellStart[ cell ]; i < end; i += 4 )
+	{
+		fltx4 overlap = AndSIMD( CmpLeSIMD( extentLoX, LoadUnalignedSIMD( &m_hiX[i] ) ), CmpGeSIMD( extentHiX, LoadUnalignedSIMD( &m_loX[i] ) ) );
+		overlap = AndSIMD( overlap, AndSIMD( CmpLeSIMD( extentLoY, LoadUnalignedSIMD( &m_hiY[i] ) ), CmpGeSIMD( extentHiY, LoadUnalignedSIMD( &m_loY[i] ) ) ) );
+		overlap = AndSIMD( overlap, AndSIMD( CmpLeSIMD( extentLoZ, LoadUnalignedSIMD( &m_hiZ[i] ) ), CmpGeSIMD( extentHiZ, LoadUnalignedSIMD( &m_loZ[i] ) ) ) );
+
+		int mask = TestSignSIMD( overlap ) & GetLaneMask( end - i );
+
+		for( int lane = 0; mask; ++lane, mask >>= 1 )
+		{
+			if ( ( mask & 1 ) && func( m_area[ i + lane ] ) == false )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+template < typename Functor >
+inline bool CNavGridIndex::ForEachAreaInRadius( int cell, const Vector &pos, float radius, Functor &func ) const
+{
+	const int end = m_cellStart[ cell+1 ];
+
+	const fltx4 posX = ReplicateX4( pos.x );
+	const fltx4 posY = ReplicateX4( pos.y );
+	const fltx4 posZ = ReplicateX4( pos.z );
+	const float radiusSqScalar = radius * radius;
+	const fltx4 radiusSq = ReplicateX4( radiusSqScalar );
+
+	for( int i = m_cellStart[ cell ]; i < end; i += 4 )
+	{
+		int mask = GetLaneMask( end - i );
+
+		if ( radiusSqScalar != 0.0f )
+		{
+			fltx4 dx = SubSIMD( LoadUnalignedSIMD( &m_centerX[i] ), posX );
+			fltx4 dy = SubSIMD( LoadUnalignedSIMD( &m_centerY[i] ), posY );
+			fltx4 dz = SubSIMD( LoadUnalignedSIMD( &m_centerZ[i] ), posZ );
+			fltx4 distSq = AddSIMD( AddSIMD( MulSIMD( dx, dx ), MulSIMD( dy, dy ) ), MulSIMD( dz, dz ) );
+
+			mask &= TestSignSIMD( CmpLeSIMD( distSq, radiusSq ) );
+		}
+
+		for( int lane = 0; mask; ++lane, mask >>= 1 )
+		{
+			if ( ( mask & 1 ) && func( m_area[ i + lane ] ) == false )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+#endif // _NAV_GRID_INDEX_H_
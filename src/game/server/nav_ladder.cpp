@@ -157,6 +157,8 @@ void CNavLadder::ConnectTo( CNavArea *area )
 		// connect to bottom
 		m_bottomArea = area;
 	}
+
+	TheNavMesh->OnEditConnectNotify( area );
 }
 
 
@@ -47,6 +47,8 @@ CNavMesh *TheNavMesh = NULL;
 ConVar nav_edit( "nav_edit", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Set to one to interactively edit the Navigation Mesh. Set to zero to leave edit mode." );
 ConVar nav_quicksave( "nav_quicksave", "1", FCVAR_GAMEDLL | FCVAR_CHEAT, "Set to one to skip the time consuming phases of the analysis.  Useful for data collection and testing." );	// TERROR: defaulting to 1, since we don't need the other data
 ConVar nav_show_approach_points( "nav_show_approach_points", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show Approach Points in the Navigation Mesh." );
+ConVar nav_grid_index( "nav_grid_index", "1", FCVAR_GAMEDLL | FCVAR_CHEAT, "Use the flat copy of the nav area grid for spatial queries." );
+ConVar nav_visibility_index( "nav_visibility_index", "1", FCVAR_GAMEDLL | FCVAR_CHEAT, "Use the bitset copy of the nav areas' potentially visible sets for visibility queries." );
 ConVar nav_show_danger( "nav_show_danger", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show current 'danger' levels." );
 ConVar nav_show_player_counts( "nav_show_player_counts", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show current player counts in each area." );
 ConVar nav_show_func_nav_avoid( "nav_show_func_nav_avoid", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show areas of designer-placed bot avoidance due to func_nav_avoid entities" );
@@ -66,6 +68,8 @@ CNavMesh::CNavMesh( void )
 {
 	m_spawnName = NULL;
 	m_gridCellSize = 300.0f;
+	m_isGridIndexDirty = true;
+	m_isVisibilityIndexDirty = true;
 	m_editMode = NORMAL;
 	m_bQuitWhenFinished = false;
 	m_hostThreadModeRestoreValue = 0;
@@ -109,6 +113,14 @@ void CNavMesh::Reset( void )
 	m_currentNode = NULL;
 	ClearWalkableSeeds();
 
+	m_isGenerationThreaded = false;
+	m_isValidatingThreadedSampling = false;
+	m_sampleProbeCache.Purge();
+	m_sampleProbeCount = 0;
+	m_sampleProbeWasted = 0;
+	m_crouchCheckNodes.Purge();
+	m_crouchCheckNodeSet.Purge();
+
 	m_isAnalyzed = false;
 	m_isOutOfDate = false;
 	m_isEditing = false;
@@ -212,8 +224,14 @@ void CNavMesh::DestroyNavigationMesh( bool incremental )
 		m_grid.RemoveAll();
 		m_gridSizeX = 0;
 		m_gridSizeY = 0;
+
+		m_gridIndex.Reset();
+		m_isGridIndexDirty = true;
 	}
 
+	m_visibilityIndex.Reset();
+	m_isVisibilityIndexDirty = true;
+
 	// clear the hash table
 	for( int i=0; i<HASH_TABLE_SIZE; ++i )
 	{
@@ -462,6 +480,78 @@ void CNavMesh::AllocateGrid( float minX, float maxX, float minY, float maxY )
 	m_gridSizeY = (int)((maxY - minY) / m_gridCellSize) + 1;
 
 	m_grid.SetCount( m_gridSizeX * m_gridSizeY );
+
+	m_isGridIndexDirty = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the flat grid index, rebuilding it if the grid has changed since it was built.
+ * Returns NULL if it can't be used now, such as while the mesh is being edited or generated,
+ * when areas change shape without being removed from and added to the grid.
+ */
+const CNavGridIndex *CNavMesh::GetGridIndex( void ) const
+{
+	if ( !nav_grid_index.GetBool() )
+		return NULL;
+
+	if ( m_isEditing || IsGenerating() )
+	{
+		if ( ThreadInMainThread() )
+		{
+			// rebuild once we're done, in case area extents were changed
+			m_isGridIndexDirty = true;
+		}
+		return NULL;
+	}
+
+	if ( m_isGridIndexDirty )
+	{
+		// only the main thread may rebuild it - queries from other threads use the grid until then
+		if ( !ThreadInMainThread() )
+			return NULL;
+
+		m_gridIndex.Build( m_grid );
+		m_isGridIndexDirty = false;
+	}
+
+	return &m_gridIndex;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the bitset copy of the areas' visible sets, rebuilding it if areas have been added or removed
+ * since it was built. Returns NULL if it can't be used now, such as while the mesh is being edited or
+ * generated, when the areas' visibility lists change without areas being added or removed.
+ */
+CNavVisibilityIndex *CNavMesh::GetVisibilityIndex( void ) const
+{
+	if ( !nav_visibility_index.GetBool() )
+		return NULL;
+
+	if ( m_isEditing || IsGenerating() )
+	{
+		if ( ThreadInMainThread() )
+		{
+			// rebuild once we're done, in case visibility was recomputed
+			m_isVisibilityIndexDirty = true;
+		}
+		return NULL;
+	}
+
+	if ( m_isVisibilityIndexDirty )
+	{
+		// only the main thread may rebuild it - queries from other threads use the areas' lists until then
+		if ( !ThreadInMainThread() )
+			return NULL;
+
+		m_visibilityIndex.Build();
+		m_isVisibilityIndexDirty = false;
+	}
+
+	return &m_visibilityIndex;
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -490,6 +580,9 @@ void CNavMesh::AddNavArea( CNavArea *area )
 		}
 	}
 
+	m_isGridIndexDirty = true;
+	m_isVisibilityIndexDirty = true;
+
 	// add to hash table
 	int key = ComputeHashKey( area->GetID() );
 
@@ -537,6 +630,9 @@ void CNavMesh::RemoveNavArea( CNavArea *area )
 		}
 	}
 
+	m_isGridIndexDirty = true;
+	m_isVisibilityIndexDirty = true;
+
 	// remove from hash table
 	int key = ComputeHashKey( area->GetID() );
 
@@ -701,12 +797,21 @@ CNavArea *CNavMesh::GetNavArea( const Vector &pos, float beneathLimit ) const
 	// get list in cell that contains position
 	int x = WorldToGridX( pos.x );
 	int y = WorldToGridY( pos.y );
+
+	Vector testPos = pos + Vector( 0, 0, 5 );
+
+	const CNavGridIndex *gridIndex = GetGridIndex();
+	if ( gridIndex )
+	{
+		// the highest area beneath us, but not too far below
+		return gridIndex->GetHighestArea( x + y*m_gridSizeX, testPos.x, testPos.y, pos.z - beneathLimit, testPos.z );
+	}
+
 	NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
 
 	// search cell list to find correct area
 	CNavArea *use = NULL;
 	float useZ = -99999999.9f;
-	Vector testPos = pos + Vector( 0, 0, 5 );
 
 	FOR_EACH_VEC( (*areaVector), it )
 	{
@@ -769,42 +874,53 @@ CNavArea *CNavMesh::GetNavArea( CBaseEntity *pEntity, int nFlags, float flBeneat
 	// get list in cell that contains position
 	int x = WorldToGridX( testPos.x );
 	int y = WorldToGridY( testPos.y );
-	NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
 
 	// search cell list to find correct area
 	CNavArea *use = NULL;
 	float useZ = -99999999.9f;
 
 	bool bSkipBlockedAreas = ( ( nFlags & GETNAVAREA_ALLOW_BLOCKED_AREAS ) == 0 );
-	FOR_EACH_VEC( (*areaVector), it )
+
+	const CNavGridIndex *gridIndex = GetGridIndex();
+	if ( gridIndex )
+	{
+		// the highest area beneath us, but not too far below
+		use = gridIndex->GetHighestArea( x + y*m_gridSizeX, testPos.x, testPos.y, testPos.z - flBeneathLimit, testPos.z + flStepHeight, bSkipBlockedAreas, pEntity->GetTeamNumber(), &useZ );
+	}
+	else
 	{
-		CNavArea *pArea = (*areaVector)[ it ];
+		NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
 
-		// check if position is within 2D boundaries of this area
-		if ( !pArea->IsOverlapping( testPos ) )
-			continue;
+		FOR_EACH_VEC( (*areaVector), it )
+		{
+			CNavArea *pArea = (*areaVector)[ it ];
 
-		// don't consider blocked areas
-		if ( bSkipBlockedAreas && pArea->IsBlocked( pEntity->GetTeamNumber() ) )
-			continue;
+			// check if position is within 2D boundaries of this area
+			if ( !pArea->IsOverlapping( testPos ) )
+				continue;
 
-		// project position onto area to get Z
-		float z = pArea->GetZ( testPos );
+			// don't consider blocked areas
+			if ( bSkipBlockedAreas && pArea->IsBlocked( pEntity->GetTeamNumber() ) )
+				continue;
 
-		// if area is above us, skip it
-		if ( z > testPos.z + flStepHeight )
-			continue;
+			// project position onto area to get Z
+			float z = pArea->GetZ( testPos );
 
-		// if area is too far below us, skip it
-		if ( z < testPos.z - flBeneathLimit )
-			continue;
+			// if area is above us, skip it
+			if ( z > testPos.z + flStepHeight )
+				continue;
 
-		// if area is lower than the one we have, skip it
-		if ( z <= useZ )
-			continue;
+			// if area is too far below us, skip it
+			if ( z < testPos.z - flBeneathLimit )
+				continue;
+
+			// if area is lower than the one we have, skip it
+			if ( z <= useZ )
+				continue;
 
-		use = pArea;
-		useZ = z;
+			use = pArea;
+			useZ = z;
+		}
 	}
 
 	// Check LOS if necessary
@@ -20,17 +20,23 @@
 #define _NAV_MESH_H_
 
 #include "utlbuffer.h"
+#include "utlhashtable.h"
 #include "filesystem.h"
 #include "GameEventListener.h"
+#include "tier0/fasttimer.h"
 
 #include "nav.h"
 #include "nav_area.h"
 #include "nav_colors.h"
+#include "nav_grid_index.h"
+#include "nav_visibility_index.h"
 
 
 class CNavArea;
 class CBaseEntity; 
 class CBreakable;
+class IPathCost;
+struct NavPathArea;
 
 extern ConVar nav_edit;
 extern ConVar nav_quicksave;
@@ -289,6 +295,15 @@ public:
 	 */
 	virtual bool IsAuthoritative( void ) const { return false; }		
 
+	/**
+	 * (EXTEND) Meshes with a coarse representation of their areas can find a path to a distant goal
+	 * through it, and search the areas for only the first part of that path. Fill in 'areaVector'
+	 * with the areas from the start to either the goal or an intermediate area along the way, and
+	 * set 'reachesGoal' accordingly. Return false to have the caller search the areas as usual.
+	 */
+	virtual bool ComputeCorridorPath( CNavArea *startArea, CNavArea *goalArea, const IPathCost &costFunc, int teamID, CUtlVector< NavPathArea > *areaVector, bool *reachesGoal ) const { return false; }
+	virtual bool IsCorridorPathWorthwhile( const CNavArea *startArea, const CNavArea *goalArea ) const { return false; }	// (EXTEND) cheap test of whether ComputeCorridorPath() is worth trying for these areas
+
 	const CUtlVector< Place > *GetPlacesFromNavFile( bool *hasUnnamedPlaces );	// Reads the used place names from the nav file (can be used to selectively precache before the nav is loaded)
 
 	virtual bool Save( void ) const;									// store Navigation Mesh to a file
@@ -314,6 +329,7 @@ public:
 	virtual void OnEditCreateNotify( CNavArea *newArea );				// invoked when given area has just been added to the mesh in edit mode
 	virtual void OnEditDestroyNotify( CNavArea *deadArea );				// invoked when given area has just been deleted from the mesh in edit mode
 	virtual void OnEditDestroyNotify( CNavLadder *deadLadder );			// invoked when given ladder has just been deleted from the mesh in edit mode
+	virtual void OnEditConnectNotify( CNavArea *area ) { }				// invoked when given area's connections to areas or ladders have just changed
 	virtual void OnNodeAdded( CNavNode *node ) {};						
 
 	// Obstructions
@@ -327,6 +343,9 @@ public:
 	CNavArea *GetNavArea( const Vector &pos, float beneathLimt = 120.0f ) const;	// given a position, return the nav area that IsOverlapping and is *immediately* beneath it
 	CNavArea *GetNavArea( CBaseEntity *pEntity, int nGetNavAreaFlags, float flBeneathLimit = 120.0f ) const;
 	CNavArea *GetNavAreaByID( unsigned int id ) const;
+	CNavArea *GetLoadedNavAreaByID( unsigned int id ) const;			// as GetNavAreaByID, but uses the flat lookup table while the mesh is being bound after Load()
+	CNavVisibilityIndex *GetVisibilityIndex( void ) const;			// return the bitset copy of the areas' visible sets, rebuilding it if needed, or NULL if it can't be used now
+	HidingSpot *GetLoadedHidingSpotByID( unsigned int id ) const;		// as GetHidingSpotByID, but uses the flat lookup table while the mesh is being bound after Load()
 	CNavArea *GetNearestNavArea( const Vector &pos, bool anyZ = false, float maxDist = 10000.0f, bool checkLOS = false, bool checkGround = true, int team = TEAM_ANY ) const;
 	CNavArea *GetNearestNavArea( CBaseEntity *pEntity, int nGetNavAreaFlags = GETNAVAREA_CHECK_GROUND, float maxDist = 10000.0f ) const;
 
@@ -577,6 +596,9 @@ public:
 
 		Extent areaExtent;
 
+		const CNavGridIndex *gridIndex = GetGridIndex();
+		UnvisitedAreaFunctor< Functor > unvisited( func, searchMarker );
+
 		// get list in cell that contains position
 		int startX = WorldToGridX( extent.lo.x );
 		int endX = WorldToGridX( extent.hi.x );
@@ -594,6 +616,15 @@ public:
 					return true;
 				}
 
+				if ( gridIndex )
+				{
+					// test extents in the flat index, and only touch the areas that overlap
+					if ( gridIndex->ForEachAreaOverlapping( iGrid, extent, unvisited ) == false )
+						return false;
+
+					continue;
+				}
+
 				NavAreaVector *areaVector = &m_grid[ iGrid ];
 
 				// find closest area in this cell
@@ -640,6 +671,10 @@ public:
 
 		Extent areaExtent;
 
+		const CNavGridIndex *gridIndex = GetGridIndex();
+		CollectAreaFunctor< NavAreaType > collect( outVector );
+		UnvisitedAreaFunctor< CollectAreaFunctor< NavAreaType > > unvisited( collect, searchMarker );
+
 		// get list in cell that contains position
 		int startX = WorldToGridX( extent.lo.x );
 		int endX = WorldToGridX( extent.hi.x );
@@ -657,6 +692,13 @@ public:
 					return;
 				}
 
+				if ( gridIndex )
+				{
+					// test extents in the flat index, and only touch the areas that overlap
+					gridIndex->ForEachAreaOverlapping( iGrid, extent, unvisited );
+					continue;
+				}
+
 				NavAreaVector *areaVector = &m_grid[ iGrid ];
 
 				// find closest area in this cell
@@ -706,6 +748,9 @@ public:
 			shiftLimit = MAX( m_gridSizeX, m_gridSizeY );	// range 0 means all areas
 		}
 
+		const CNavGridIndex *gridIndex = GetGridIndex();
+		UnvisitedAreaFunctor< Functor > unvisited( func, searchMarker );
+
 		for( int x = originX - shiftLimit; x <= originX + shiftLimit; ++x )
 		{
 			if ( x < 0 || x >= m_gridSizeX )
@@ -716,6 +761,15 @@ public:
 				if ( y < 0 || y >= m_gridSizeY )
 					continue;
 
+				if ( gridIndex )
+				{
+					// test distances in the flat index, and only touch the areas in range
+					if ( gridIndex->ForEachAreaInRadius( x + y*m_gridSizeX, pos, radius, unvisited ) == false )
+						return false;
+
+					continue;
+				}
+
 				NavAreaVector *areaVector = &m_grid[ x + y*m_gridSizeX ];
 
 				// find closest area in this cell
@@ -1096,6 +1150,53 @@ private:
 	int m_gridSizeY;
 	float m_minX;
 	float m_minY;
+
+	mutable CNavGridIndex m_gridIndex;							// flat copy of m_grid for fast queries
+	mutable bool m_isGridIndexDirty;							// true if m_grid has changed since m_gridIndex was built
+	const CNavGridIndex *GetGridIndex( void ) const;			// return the flat grid index, rebuilding it if needed, or NULL if it can't be used now
+
+	mutable CNavVisibilityIndex m_visibilityIndex;				// bitset copy of the areas' potentially visible sets
+	mutable bool m_isVisibilityIndexDirty;						// true if areas may have changed since m_visibilityIndex was built
+
+	// invokes the given functor for areas not yet visited with the given search marker
+	template < typename Functor >
+	class UnvisitedAreaFunctor
+	{
+	public:
+		UnvisitedAreaFunctor( Functor &func, unsigned int searchMarker ) : m_func( func ), m_searchMarker( searchMarker ) { }
+
+		bool operator() ( CNavArea *area )
+		{
+			// skip if we've already visited this area
+			if ( area->m_nearNavSearchMarker == m_searchMarker )
+				return true;
+
+			// mark as visited
+			area->m_nearNavSearchMarker = m_searchMarker;
+
+			return m_func( area );
+		}
+
+	private:
+		Functor &m_func;
+		unsigned int m_searchMarker;
+	};
+
+	template < typename NavAreaType >
+	class CollectAreaFunctor
+	{
+	public:
+		CollectAreaFunctor( CUtlVector< NavAreaType * > *outVector ) : m_outVector( outVector ) { }
+
+		bool operator() ( CNavArea *area )
+		{
+			m_outVector->AddToTail( (NavAreaType *)area );
+			return true;
+		}
+
+	private:
+		CUtlVector< NavAreaType * > *m_outVector;
+	};
 	unsigned int m_areaCount;									// total number of nav areas
 
 	bool m_isLoaded;											// true if a Navigation Mesh has been loaded
@@ -1106,6 +1207,11 @@ private:
 	CNavArea *m_hashTable[ HASH_TABLE_SIZE ];					// hash table to optimize lookup by ID
 	int ComputeHashKey( unsigned int id ) const;				// returns a hash key for the given nav area ID
 
+	CUtlVector< CNavArea * > m_loadAreaByID;					// areas indexed by ID, only while binding a freshly loaded mesh
+	CUtlVector< HidingSpot * > m_loadHidingSpotByID;			// hiding spots indexed by ID, only while binding a freshly loaded mesh
+	void BuildLoadLookupTables( void );
+	void ClearLoadLookupTables( void );
+
 	int WorldToGridX( float wx ) const;							// given X component, return grid index
 	int WorldToGridY( float wy ) const;							// given Y component, return grid index
 	void AllocateGrid( float minX, float maxX, float minY, float maxY );	// clear and reset the grid to the given extents
@@ -1184,6 +1290,55 @@ private:
 	NavDirType m_generationDir;
 	CNavNode *AddNode( const Vector &destPos, const Vector &destNormal, NavDirType dir, CNavNode *source, bool isOnDisplacement, float obstacleHeight, float flObstacleStartDist, float flObstacleEndDist );		// add a nav node and connect it, update current node
 
+	struct SampleProbe											// the outcome of trying to step from a node in one direction
+	{
+		bool m_isValid;											// false if no node should be added
+		bool m_isOnDisplacement;
+		Vector m_to;
+		Vector m_toNormal;
+		float m_obstacleHeight;
+		float m_obstacleStartDist;
+		float m_obstacleEndDist;
+	};
+	bool ProbeSampleStep( const CNavNode *node, NavDirType dir, SampleProbe *probe ) const;	// trace one sampling step from the node without changing anything, return true if a node should be added
+	void GetSampleProbe( CNavNode *node, NavDirType dir, SampleProbe *probe );				// as above, but when threaded, probe all of the node's unvisited directions in parallel and cache them
+
+	struct SampleProbeSet
+	{
+		SampleProbe m_probe[ NUM_DIRECTIONS ];
+		int m_pendingDirs;										// bit for each direction with an unused probe
+	};
+	CUtlHashtable< const CNavNode *, SampleProbeSet > m_sampleProbeCache;
+	int m_sampleProbeCount;										// probes used
+	int m_sampleProbeWasted;									// probes computed in parallel but never used
+
+	CUtlVector< CNavNode * > m_crouchCheckNodes;				// nodes needing CheckCrouch() after threaded sampling
+	CUtlHashtable< CNavNode * > m_crouchCheckNodeSet;
+	void CheckCrouchOfSampledNodes( void );
+
+	struct SampledNodeRecord									// a node as threaded sampling left it, for nav_generate_threaded 2
+	{
+		bool m_isValid;
+		Vector m_pos;
+		int m_attributes;
+		unsigned int m_to[ NUM_DIRECTIONS ];					// ID of the connected node, or 0
+		float m_obstacleHeight[ NUM_DIRECTIONS ];
+	};
+	CUtlVector< SampledNodeRecord > m_threadedSampleRecord;		// by node ID
+	bool m_isValidatingThreadedSampling;						// nav_generate_threaded was 2 when generation began
+	void RecordSampledNodes( void );
+	void RestartSamplingSerially( void );
+	void CompareSampledNodes( void );
+
+	struct SampleProbeJob
+	{
+		const CNavNode *m_node;
+		NavDirType m_dir;
+		SampleProbe *m_probe;
+	};
+	static void ProbeSampleStepJob( SampleProbeJob &job );
+	static void CheckNodeCrouchJob( CNavNode *&node );
+
 	NavLadderVector m_ladders;									// list of ladder navigation representations
 	void BuildLadders( void );
 	void DestroyLadders( void );
@@ -1232,6 +1387,9 @@ private:
 		NUM_GENERATION_STATES
 	}
 	m_generationState;											// the state of the generation process
+	CCycleCount m_generationStateTime[ NUM_GENERATION_STATES ];	// time spent in each state, for reporting
+	bool m_isGenerationThreaded;								// nav_generate_threaded when generation began
+	void ReportGenerationTimes( void ) const;
 	enum GenerationModeType
 	{
 		GENERATE_NONE,
@@ -380,7 +380,7 @@ void CNavNode::CheckCrouch( void )
 
 		if ( !TestForCrouchArea( corner, mins, maxs, &m_groundHeightAboveNode[i] ) )
 		{
-			SetAttributes( NAV_MESH_CROUCH );
+			SetAttributes( GetAttributes() | NAV_MESH_CROUCH );
 			m_crouch[corner] = true;
 		}
 	}
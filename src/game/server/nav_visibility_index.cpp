@@ -0,0 +1,338 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_visibility_index.cpp
+// Compressed bitset copy of the nav areas' potentially visible sets for fast visibility queries
+
+#include "cbase.h"
+#include "nav_mesh.h"
+#include "nav_visibility_index.h"
+#include "team.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavVisibilityIndex::CNavVisibilityIndex( void )
+{
+	Reset();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavVisibilityIndex::Reset( void )
+{
+	m_area.RemoveAll();
+	m_setStart.RemoveAll();
+	m_setStart.AddToTail( 0 );
+
+	m_chunkKey.RemoveAll();
+	m_potentiallyVisible.RemoveAll();
+	m_completelyVisible.RemoveAll();
+
+	for( int t=0; t<MAX_TEAMS; ++t )
+	{
+		m_team[t].m_tickcount = -1;
+		m_team[t].m_isValid = false;
+		m_team[t].m_potentiallyVisible.RemoveAll();
+		m_team[t].m_completelyVisible.RemoveAll();
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Copy the visibility data of TheNavAreas
+ */
+void CNavVisibilityIndex::Build( void )
+{
+	VPROF_BUDGET( "CNavVisibilityIndex::Build", "NextBot" );
+
+	Reset();
+
+	unsigned int maxID = 0;
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		maxID = MAX( maxID, TheNavAreas[ it ]->GetID() );
+	}
+
+	m_area.SetCount( maxID + 1 );
+	V_memset( m_area.Base(), 0, m_area.Count() * sizeof( CNavArea * ) );
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CNavArea *area = TheNavAreas[ it ];
+		if ( area->GetID() )
+		{
+			m_area[ area->GetID() ] = area;
+		}
+	}
+
+	// visitedStamp[id] == viewer ID if area 'id' has already been resolved for that viewer
+	CUtlVector< int > visitedStamp;
+	visitedStamp.SetCount( m_area.Count() );
+	V_memset( visitedStamp.Base(), 0xFF, visitedStamp.Count() * sizeof( int ) );
+
+	m_setStart.EnsureCapacity( m_area.Count() + 1 );
+
+	// area 0 is never used
+	m_setStart.AddToTail( 0 );
+
+	for( int id=1; id<m_area.Count(); ++id )
+	{
+		if ( m_area[ id ] )
+		{
+			BuildSet( m_area[ id ], &visitedStamp );
+		}
+
+		m_setStart.AddToTail( m_chunkKey.Count() );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+struct NavVisibilityEntry
+{
+	unsigned int m_id;
+	bool m_isPotentiallyVisible;
+	bool m_isCompletelyVisible;
+
+	static int Compare( const NavVisibilityEntry *lhs, const NavVisibilityEntry *rhs )
+	{
+		return ( lhs->m_id < rhs->m_id ) ? -1 : ( lhs->m_id > rhs->m_id ) ? 1 : 0;
+	}
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Append the chunks of the given area's visible set, resolving inheritance the way
+ * CNavArea::IsPotentiallyVisible() does: the area's own list overrides the list it inherits from.
+ */
+void CNavVisibilityIndex::BuildSet( CNavArea *area, CUtlVector< int > *visitedStamp )
+{
+	CUtlVectorFixedGrowable< NavVisibilityEntry, 512 > entryVector;
+	const int stamp = area->GetID();
+
+	for( int pass=0; pass<2; ++pass )
+	{
+		const CNavArea::CAreaBindInfoArray *list = &area->m_potentiallyVisibleAreas;
+
+		if ( pass == 1 )
+		{
+			if ( !area->m_inheritVisibilityFrom.area )
+				break;
+
+			list = &area->m_inheritVisibilityFrom.area->m_potentiallyVisibleAreas;
+		}
+
+		for( int i=0; i<list->Count(); ++i )
+		{
+			const CNavArea::AreaBindInfo &info = list->Element( i );
+			if ( !info.area )
+				continue;
+
+			unsigned int id = info.area->GetID();
+			if ( id >= (unsigned int)m_area.Count() || m_area[ id ] != info.area )
+				continue;
+
+			// the first entry for an area decides its visibility, even if it is NOT_VISIBLE
+			if ( visitedStamp->Element( id ) == stamp )
+				continue;
+
+			visitedStamp->Element( id ) = stamp;
+
+			if ( info.attributes == CNavArea::NOT_VISIBLE )
+				continue;
+
+			NavVisibilityEntry &entry = entryVector[ entryVector.AddToTail() ];
+			entry.m_id = id;
+			entry.m_isPotentiallyVisible = true;
+			entry.m_isCompletelyVisible = ( info.attributes & CNavArea::COMPLETELY_VISIBLE ) ? true : false;
+		}
+	}
+
+	entryVector.Sort( &NavVisibilityEntry::Compare );
+
+	FOR_EACH_VEC( entryVector, i )
+	{
+		const NavVisibilityEntry &entry = entryVector[i];
+		unsigned int key = entry.m_id >> 5;
+		uint32 bit = 1u << ( entry.m_id & 31 );
+
+		int setStart = m_setStart.Tail();
+		int last = m_chunkKey.Count() - 1;
+
+		if ( last < setStart || m_chunkKey[ last ] != key )
+		{
+			m_chunkKey.AddToTail( key );
+			m_potentiallyVisible.AddToTail( 0 );
+			m_completelyVisible.AddToTail( 0 );
+			last = m_chunkKey.Count() - 1;
+		}
+
+		if ( entry.m_isPotentiallyVisible )
+			m_potentiallyVisible[ last ] |= bit;
+
+		if ( entry.m_isCompletelyVisible )
+			m_completelyVisible[ last ] |= bit;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+inline bool CNavVisibilityIndex::IsIndexed( const CNavArea *area ) const
+{
+	unsigned int id = area->GetID();
+	return id < (unsigned int)m_area.Count() && m_area[ id ] == area;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the chunk entry of the given area's set with the given key, or -1
+ */
+int CNavVisibilityIndex::FindChunk( unsigned int id, unsigned int key ) const
+{
+	int lo = m_setStart[ id ];
+	int hi = m_setStart[ id+1 ] - 1;
+
+	while( lo <= hi )
+	{
+		int mid = ( lo + hi ) / 2;
+
+		if ( m_chunkKey[ mid ] < key )
+		{
+			lo = mid + 1;
+		}
+		else if ( m_chunkKey[ mid ] > key )
+		{
+			hi = mid - 1;
+		}
+		else
+		{
+			return mid;
+		}
+	}
+
+	return -1;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavVisibilityIndex::IsVisible( const CNavArea *area, const CNavArea *viewedArea, bool completely, bool *isVisible ) const
+{
+	if ( !IsIndexed( area ) || !IsIndexed( viewedArea ) )
+		return false;
+
+	unsigned int viewedID = viewedArea->GetID();
+	int chunk = FindChunk( area->GetID(), viewedID >> 5 );
+
+	if ( chunk < 0 )
+	{
+		*isVisible = false;
+	}
+	else
+	{
+		uint32 bits = completely ? m_completelyVisible[ chunk ] : m_potentiallyVisible[ chunk ];
+		*isVisible = ( bits & ( 1u << ( viewedID & 31 ) ) ) ? true : false;
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * OR together the sets of the areas the team's living players are in
+ */
+void CNavVisibilityIndex::BuildTeamVisibility( int teamIndex )
+{
+	VPROF_BUDGET( "CNavVisibilityIndex::BuildTeamVisibility", "NextBot" );
+
+	TeamVisibility &vis = m_team[ teamIndex ];
+
+	vis.m_tickcount = gpGlobals->tickcount;
+	vis.m_isValid = true;
+
+	int wordCount = ( m_area.Count() + 31 ) / 32;
+	vis.m_potentiallyVisible.SetCount( wordCount );
+	vis.m_completelyVisible.SetCount( wordCount );
+	V_memset( vis.m_potentiallyVisible.Base(), 0, wordCount * sizeof( uint32 ) );
+	V_memset( vis.m_completelyVisible.Base(), 0, wordCount * sizeof( uint32 ) );
+
+	CTeam *team = GetGlobalTeam( teamIndex );
+	if ( !team )
+		return;
+
+	uint32 *potentiallyVisible = vis.m_potentiallyVisible.Base();
+	uint32 *completelyVisible = vis.m_completelyVisible.Base();
+
+	CUtlVectorFixedGrowable< unsigned int, 32 > visitedVector;
+
+	for( int i = 0; i < team->GetNumPlayers(); ++i )
+	{
+		CBasePlayer *player = team->GetPlayer(i);
+		if ( !player->IsAlive() )
+			continue;
+
+		const CNavArea *from = (const CNavArea *)player->GetLastKnownArea();
+		if ( !from )
+			continue;
+
+		if ( !IsIndexed( from ) )
+		{
+			// can't answer for this team until the index is rebuilt
+			vis.m_isValid = false;
+			return;
+		}
+
+		unsigned int id = from->GetID();
+		if ( visitedVector.HasElement( id ) )
+			continue;
+
+		visitedVector.AddToTail( id );
+
+		// an area can always see itself
+		potentiallyVisible[ id >> 5 ] |= 1u << ( id & 31 );
+		completelyVisible[ id >> 5 ] |= 1u << ( id & 31 );
+
+		for( int c = m_setStart[ id ]; c < m_setStart[ id+1 ]; ++c )
+		{
+			potentiallyVisible[ m_chunkKey[c] ] |= m_potentiallyVisible[c];
+			completelyVisible[ m_chunkKey[c] ] |= m_completelyVisible[c];
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavVisibilityIndex::IsVisibleToTeam( const CNavArea *area, int team, bool completely, bool *isVisible )
+{
+	if ( team < 0 || team >= MAX_TEAMS || !IsIndexed( area ) )
+		return false;
+
+	// the unions are rebuilt lazily, which only the main thread may do
+	if ( !ThreadInMainThread() )
+		return false;
+
+	if ( m_team[ team ].m_tickcount != gpGlobals->tickcount )
+	{
+		BuildTeamVisibility( team );
+	}
+
+	const TeamVisibility &vis = m_team[ team ];
+	if ( !vis.m_isValid )
+		return false;
+
+	unsigned int id = area->GetID();
+	uint32 bits = completely ? vis.m_completelyVisible[ id >> 5 ] : vis.m_potentiallyVisible[ id >> 5 ];
+	*isVisible = ( bits & ( 1u << ( id & 31 ) ) ) ? true : false;
+
+	return true;
+}
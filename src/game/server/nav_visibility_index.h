@@ -0,0 +1,84 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_visibility_index.h
+// Compressed bitset copy of the nav areas' potentially visible sets for fast visibility queries
+
+#ifndef _NAV_VISIBILITY_INDEX_H_
+#define _NAV_VISIBILITY_INDEX_H_
+
+#include "shareddefs.h"
+
+class CNavArea;
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A read-only copy of every area's potentially visible set, with the m_inheritVisibilityFrom deltas
+ * already applied, stored as bitsets over area IDs. Each set is split into 32-area chunks, and only
+ * the chunks with a visible area in them are stored, as (chunk key, potentially visible bits,
+ * completely visible bits) entries sorted by key. Since areas near each other tend to have nearby IDs,
+ * a set typically fits in a handful of chunks, and a query is a short binary search and a bit test
+ * instead of a walk over the area's visibility list and the list it inherits from.
+ *
+ * The chunks of all sets are stored back to back, and area ID i owns entries [ m_setStart[i], m_setStart[i+1] ).
+ *
+ * The index also keeps, for each team, the union of the sets of the areas its living players are in.
+ * The union is rebuilt at most once per tick, so "visible to team" queries are a single bit test.
+ *
+ * The index is rebuilt from the areas by CNavMesh whenever their visibility data may have changed.
+ */
+class CNavVisibilityIndex
+{
+public:
+	CNavVisibilityIndex( void );
+
+	void Build( void );										// copy the visibility data of TheNavAreas
+	void Reset( void );
+
+	/**
+	 * If both areas are in the index, return true and set 'isVisible' to whether 'viewedArea' is
+	 * potentially visible (or completely visible if 'completely' is true) from somewhere in 'area',
+	 * as CNavArea::IsPotentiallyVisible() and CNavArea::IsCompletelyVisible() would. Otherwise return false.
+	 */
+	bool IsVisible( const CNavArea *area, const CNavArea *viewedArea, bool completely, bool *isVisible ) const;
+
+	/**
+	 * If the area and the areas of the living players on the given team are in the index, return true
+	 * and set 'isVisible' to whether any of those players can potentially (or completely) see the area,
+	 * as CNavArea::IsPotentiallyVisibleToTeam() and CNavArea::IsCompletelyVisibleToTeam() would.
+	 * Otherwise return false. Only the main thread may use this.
+	 */
+	bool IsVisibleToTeam( const CNavArea *area, int team, bool completely, bool *isVisible );
+
+private:
+	CUtlVector< CNavArea * > m_area;							// areas by ID, NULL for unused IDs
+	CUtlVector< int > m_setStart;								// area ID count + 1 offsets into the chunk arrays
+
+	// chunk arrays
+	CUtlVector< unsigned int > m_chunkKey;						// area ID / 32
+	CUtlVector< uint32 > m_potentiallyVisible;					// bit (area ID % 32) is set if that area is potentially visible
+	CUtlVector< uint32 > m_completelyVisible;					// bit (area ID % 32) is set if that area is completely visible
+
+	struct TeamVisibility
+	{
+		int m_tickcount;										// tick the union was built, or -1
+		bool m_isValid;											// false if a player was in an area not in the index
+		CUtlVector< uint32 > m_potentiallyVisible;				// dense bitsets over area IDs
+		CUtlVector< uint32 > m_completelyVisible;
+	};
+	TeamVisibility m_team[ MAX_TEAMS ];
+
+	int FindChunk( unsigned int id, unsigned int key ) const;	// return the chunk entry of the given area's set with the given key, or -1
+	void BuildSet( CNavArea *area, CUtlVector< int > *visitedStamp );
+	void BuildTeamVisibility( int team );
+
+	bool IsIndexed( const CNavArea *area ) const;
+};
+
+
+#endif // _NAV_VISIBILITY_INDEX_H_
@@ -10,8 +10,8 @@
 #include "igamesystem.h"
 #include "ilagcompensationmanager.h"
 #include "inetchannelinfo.h"
-#include "utllinkedlist.h"
 #include "BaseAnimatingOverlay.h"
+#include "gamevars_shared.h"
 #include "tier0/vprof.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -36,6 +36,15 @@ ConVar sv_lagflushbonecache( "sv_lagflushbonecache", "1", FCVAR_DEVELOPMENTONLY,
 ConVar sv_showlagcompensation( "sv_showlagcompensation", "0", FCVAR_CHEAT, "Show lag compensated hitboxes whenever a player is lag compensated." );
 
 ConVar sv_unlag_fixstuck( "sv_unlag_fixstuck", "0", FCVAR_DEVELOPMENTONLY, "Disallow backtracking a player for lag compensation if it will cause them to become stuck" );
+ConVar sv_unlag_shot_prefilter( "sv_unlag_shot_prefilter", "1", FCVAR_DEVELOPMENTONLY, "Only backtrack players that a shot could possibly hit, when the shot is known" );
+
+// Hitboxes can stick out of the collision bounds, so pad them this much when deciding if a shot could hit a player
+#define LAG_COMPENSATION_HITBOX_SCALE	1.5f
+#define LAG_COMPENSATION_HITBOX_PAD		16.0f
+
+// Players use the first MAX_PLAYERS slots, and entities added with AddAdditionalEntity() the rest
+#define LAG_COMPENSATION_MAX_ADDITIONAL_ENTITIES	64
+#define LAG_COMPENSATION_MAX_SLOTS					( MAX_PLAYERS + LAG_COMPENSATION_MAX_ADDITIONAL_ENTITIES )
 
 //-----------------------------------------------------------------------------
 // Purpose: 
@@ -127,6 +136,105 @@ public:
 };
 
 
+//-----------------------------------------------------------------------------
+// Purpose: A player's lag records, in a fixed size ring buffer ordered by
+//			simulation time. Records are addressed by age, 0 being the newest.
+//-----------------------------------------------------------------------------
+class CLagRecordTrack
+{
+public:
+	CLagRecordTrack() : m_head( 0 ), m_count( 0 ), m_sequence( 0 ), m_breakSequence( -1 ) {}
+
+	int Count() const						{ return m_count; }
+
+	LagRecord &Get( int age )				{ Assert( age >= 0 && age < m_count ); return m_records[ ( m_head - age + m_records.Count() ) % m_records.Count() ]; }
+	const LagRecord &Get( int age ) const	{ Assert( age >= 0 && age < m_count ); return m_records[ ( m_head - age + m_records.Count() ) % m_records.Count() ]; }
+
+	LagRecord &AddToHead()
+	{
+		if ( m_records.Count() == 0 )
+		{
+			// enough for the longest sv_maxunlag, plus the record before it to interpolate from
+			m_records.SetCount( TIME_TO_TICKS( 1.0f ) + 4 );
+			m_head = m_records.Count() - 1;
+		}
+
+		m_head = ( m_head + 1 ) % m_records.Count();
+		m_count = MIN( m_count + 1, m_records.Count() );	// overwrite the oldest if we're full
+		++m_sequence;
+
+		return m_records[ m_head ];
+	}
+
+	void RemoveTail()						{ Assert( m_count > 0 ); --m_count; }
+	void RemoveAll()						{ m_count = 0; m_breakSequence = -1; }
+	void Purge()							{ m_records.Purge(); RemoveAll(); }
+
+	// Backtracking can't reach this record, or any older one
+	void SetBreak( int age )				{ m_breakSequence = MAX( m_breakSequence, m_sequence - 1 - age ); }
+
+	// Return the age of the newest record backtracking can't reach, or Count() if it can reach them all
+	int GetBreakAge() const
+	{
+		int age = m_sequence - 1 - m_breakSequence;
+		return ( m_breakSequence >= 0 && age < m_count ) ? age : m_count;
+	}
+
+	// Return the age of the newest record at or before the given time, or the oldest record if there is none
+	int FindRecord( float flTargetTime ) const
+	{
+		int lo = 0, hi = m_count - 1;
+		while ( lo < hi )
+		{
+			int mid = ( lo + hi ) / 2;
+			if ( Get( mid ).m_flSimulationTime <= flTargetTime )
+			{
+				hi = mid;
+			}
+			else
+			{
+				lo = mid + 1;
+			}
+		}
+
+		return lo;
+	}
+
+private:
+	CUtlVector< LagRecord > m_records;
+	int m_head;								// index of the newest record
+	int m_count;
+	int m_sequence;							// number of records ever added
+	int m_breakSequence;					// sequence number of the newest record backtracking can't reach, or -1
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: The volume a shot can hit, so we only backtrack players it could reach
+//-----------------------------------------------------------------------------
+struct LagCompensationShot_t
+{
+	Vector	m_vecSrc;
+	Vector	m_vecDir;
+	float	m_flMaxSpread;		// per unit of distance along m_vecDir, on each of the right and up axes
+	float	m_flRange;
+
+	// Could the shot hit anything in the given sphere?
+	bool CouldHit( const Vector &vecCenter, float flRadius ) const
+	{
+		Vector vecToCenter = vecCenter - m_vecSrc;
+		float flAlong = DotProduct( vecToCenter, m_vecDir );
+		if ( flAlong < -flRadius || flAlong > m_flRange + flRadius )
+			return false;
+
+		// the spread is a square, so the widest part of the cone is across its diagonal
+		float flTan = m_flMaxSpread * M_SQRT2;
+		float flReach = MAX( flAlong, 0.0f ) * flTan + flRadius * FastSqrt( 1.0f + flTan * flTan );
+		return ( vecToCenter - flAlong * m_vecDir ).LengthSqr() <= flReach * flReach;
+	}
+};
+
+
 //
 // Try to take the player from his current origin to vWantedPos.
 // If it can't get there, leave the player where he is.
@@ -205,28 +313,47 @@ public:
 
 	// Called during player movement to set up/restore after lag compensation
 	void			StartLagCompensation( CBasePlayer *player, CUserCmd *cmd );
+	void			StartLagCompensationForShot( CBasePlayer *player, CUserCmd *cmd, const Vector &vecSrc, const Vector &vecDir, float flMaxSpread, float flRange );
 	void			FinishLagCompensation( CBasePlayer *player );
 
 	bool			IsCurrentlyDoingLagCompensation() const OVERRIDE { return m_isCurrentlyDoingCompensation; }
 
+	void			AddAdditionalEntity( CBaseAnimatingOverlay *pEntity );
+	void			RemoveAdditionalEntity( CBaseAnimatingOverlay *pEntity );
+
 private:
-	void			BacktrackPlayer( CBasePlayer *player, float flTargetTime );
+	void			StartLagCompensation( CBasePlayer *player, CUserCmd *cmd, const LagCompensationShot_t *pShot );
+	void			RecordEntity( CBaseAnimatingOverlay *pEntity, int slot, float flDeadtime );
+	void			BacktrackEntity( CBaseAnimatingOverlay *pEntity, int slot, float flTargetTime, const LagCompensationShot_t *pShot = NULL );
+	void			RestoreEntity( CBaseAnimatingOverlay *pEntity, int slot );
+
+	// Return the player or additional entity using the given slot, or NULL
+	CBaseAnimatingOverlay *GetSlotEntity( int slot ) const
+	{
+		if ( slot < MAX_PLAYERS )
+			return UTIL_PlayerByIndex( slot + 1 );
+
+		return m_AdditionalEntity[ slot - MAX_PLAYERS ];
+	}
 
 	void ClearHistory()
 	{
-		for ( int i=0; i<MAX_PLAYERS; i++ )
-			m_PlayerTrack[i].Purge();
+		for ( int i=0; i<LAG_COMPENSATION_MAX_SLOTS; i++ )
+			m_Track[i].Purge();
 	}
 
-	// keep a list of lag records for each player
-	CUtlFixedLinkedList< LagRecord >	m_PlayerTrack[ MAX_PLAYERS ];
+	// keep a list of lag records for each player and additional entity
+	CLagRecordTrack			m_Track[ LAG_COMPENSATION_MAX_SLOTS ];
+
+	// non-player entities that opted in to lag compensation, by slot - MAX_PLAYERS
+	CHandle< CBaseAnimatingOverlay > m_AdditionalEntity[ LAG_COMPENSATION_MAX_ADDITIONAL_ENTITIES ];
 
 	// Scratchpad for determining what needs to be restored
-	CBitVec<MAX_PLAYERS>	m_RestorePlayer;
+	CBitVec<LAG_COMPENSATION_MAX_SLOTS>	m_RestoreSlot;
 	bool					m_bNeedToRestore;
 	
-	LagRecord				m_RestoreData[ MAX_PLAYERS ];	// player data before we moved him back
-	LagRecord				m_ChangeData[ MAX_PLAYERS ];	// player data where we moved him back
+	LagRecord				m_RestoreData[ LAG_COMPENSATION_MAX_SLOTS ];	// entity data before we moved it back
+	LagRecord				m_ChangeData[ LAG_COMPENSATION_MAX_SLOTS ];		// entity data where we moved it back
 
 	CBasePlayer				*m_pCurrentPlayer;	// The player we are doing lag compensation for
 
@@ -254,95 +381,141 @@ void CLagCompensationManager::FrameUpdatePostEntityThink()
 
 	VPROF_BUDGET( "FrameUpdatePostEntityThink", "CLagCompensationManager" );
 
-	// remove all records before that time:
-	int flDeadtime = gpGlobals->curtime - sv_maxunlag.GetFloat();
+	// remove all records before that time, except the one we'd interpolate from at the edge:
+	float flDeadtime = gpGlobals->curtime - sv_maxunlag.GetFloat();
 
 	// Iterate all active players
 	for ( int i = 1; i <= gpGlobals->maxClients; i++ )
 	{
 		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
 
-		CUtlFixedLinkedList< LagRecord > *track = &m_PlayerTrack[i-1];
-
 		if ( !pPlayer )
 		{
-			if ( track->Count() > 0 )
-			{
-				track->RemoveAll();
-			}
-
+			m_Track[i-1].RemoveAll();
 			continue;
 		}
 
-		Assert( track->Count() < 1000 ); // insanity check
+		RecordEntity( pPlayer, i-1, flDeadtime );
+	}
+
+	// and the other entities that opted in
+	for ( int i = 0; i < LAG_COMPENSATION_MAX_ADDITIONAL_ENTITIES; i++ )
+	{
+		CBaseAnimatingOverlay *pEntity = m_AdditionalEntity[i];
 
-		// remove tail records that are too old
-		intp tailIndex = track->Tail();
-		while ( track->IsValidIndex( tailIndex ) )
+		if ( !pEntity )
 		{
-			LagRecord &tail = track->Element( tailIndex );
-
-			// if tail is within limits, stop
-			if ( tail.m_flSimulationTime >= flDeadtime )
-				break;
-			
-			// remove tail, get new tail
-			track->Remove( tailIndex );
-			tailIndex = track->Tail();
+			m_Track[ MAX_PLAYERS + i ].RemoveAll();
+			continue;
 		}
 
-		// check if head has same simulation time
-		if ( track->Count() > 0 )
-		{
-			LagRecord &head = track->Element( track->Head() );
+		RecordEntity( pEntity, MAX_PLAYERS + i, flDeadtime );
+	}
 
-			// check if player changed simulation time since last time updated
-			if ( head.m_flSimulationTime >= pPlayer->GetSimulationTime() )
-				continue; // don't add new entry for same or older time
-		}
+	//Clear the current player.
+	m_pCurrentPlayer = NULL;
+}
 
-		// add new record to player track
-		LagRecord &record = track->Element( track->AddToHead() );
 
-		record.m_fFlags = 0;
-		if ( pPlayer->IsAlive() )
-		{
-			record.m_fFlags |= LC_ALIVE;
-		}
+//-----------------------------------------------------------------------------
+// Purpose: Add a lag record for the entity in the given slot, if it simulated
+//			since the last one, and drop those older than flDeadtime
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::RecordEntity( CBaseAnimatingOverlay *pEntity, int slot, float flDeadtime )
+{
+	CLagRecordTrack *track = &m_Track[ slot ];
 
-		record.m_flSimulationTime	= pPlayer->GetSimulationTime();
-		record.m_vecAngles			= pPlayer->GetLocalAngles();
-		record.m_vecOrigin			= pPlayer->GetLocalOrigin();
-		record.m_vecMinsPreScaled	= pPlayer->CollisionProp()->OBBMinsPreScaled();
-		record.m_vecMaxsPreScaled	= pPlayer->CollisionProp()->OBBMaxsPreScaled();
+	// remove tail records that are too old
+	while ( track->Count() > 1 )
+	{
+		// if the record after the tail is within limits, stop
+		if ( track->Get( track->Count() - 2 ).m_flSimulationTime >= flDeadtime )
+			break;
 
-		int layerCount = pPlayer->GetNumAnimOverlays();
-		for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
+		track->RemoveTail();
+	}
+
+	// check if head has same simulation time
+	if ( track->Count() > 0 )
+	{
+		LagRecord &head = track->Get( 0 );
+
+		// check if entity changed simulation time since last time updated
+		if ( head.m_flSimulationTime >= pEntity->GetSimulationTime() )
+			return; // don't add new entry for same or older time
+	}
+
+	// add new record to entity track
+	LagRecord &record = track->AddToHead();
+
+	record.m_fFlags = 0;
+	if ( pEntity->IsAlive() )
+	{
+		record.m_fFlags |= LC_ALIVE;
+	}
+	else
+	{
+		// entity must be alive, backtracking loses track here
+		track->SetBreak( 0 );
+	}
+
+	record.m_flSimulationTime	= pEntity->GetSimulationTime();
+	record.m_vecAngles			= pEntity->GetLocalAngles();
+	record.m_vecOrigin			= pEntity->GetLocalOrigin();
+	record.m_vecMinsPreScaled	= pEntity->CollisionProp()->OBBMinsPreScaled();
+	record.m_vecMaxsPreScaled	= pEntity->CollisionProp()->OBBMaxsPreScaled();
+
+	int layerCount = pEntity->GetNumAnimOverlays();
+	for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
+	{
+		CAnimationLayer *currentLayer = pEntity->GetAnimOverlay(layerIndex);
+		if( currentLayer )
 		{
-			CAnimationLayer *currentLayer = pPlayer->GetAnimOverlay(layerIndex);
-			if( currentLayer )
-			{
-				record.m_layerRecords[layerIndex].m_cycle = currentLayer->m_flCycle;
-				record.m_layerRecords[layerIndex].m_order = currentLayer->m_nOrder;
-				record.m_layerRecords[layerIndex].m_sequence = currentLayer->m_nSequence;
-				record.m_layerRecords[layerIndex].m_weight = currentLayer->m_flWeight;
-			}
+			record.m_layerRecords[layerIndex].m_cycle = currentLayer->m_flCycle;
+			record.m_layerRecords[layerIndex].m_order = currentLayer->m_nOrder;
+			record.m_layerRecords[layerIndex].m_sequence = currentLayer->m_nSequence;
+			record.m_layerRecords[layerIndex].m_weight = currentLayer->m_flWeight;
 		}
-		record.m_masterSequence = pPlayer->GetSequence();
-		record.m_masterCycle = pPlayer->GetCycle();
+	}
+	record.m_masterSequence = pEntity->GetSequence();
+	record.m_masterCycle = pEntity->GetCycle();
 
-		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
+	for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
+	{
+		record.m_flPoseParameters[i] = pEntity->GetPoseParameter(i);
+	}
+
+	// if the entity teleported since the previous record, backtracking can't go past it
+	if ( track->Count() > 1 )
+	{
+		Vector delta = track->Get( 1 ).m_vecOrigin - record.m_vecOrigin;
+		if ( delta.Length2DSqr() > m_flTeleportDistanceSqr )
 		{
-			record.m_flPoseParameters[i] = pPlayer->GetPoseParameter(i);
+			track->SetBreak( 1 );
 		}
 	}
-
-	//Clear the current player.
-	m_pCurrentPlayer = NULL;
 }
 
 // Called during player movement to set up/restore after lag compensation
 void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCmd *cmd )
+{
+	StartLagCompensation( player, cmd, NULL );
+}
+
+// As above, but only move back the players a shot could hit: anything within flRange of vecSrc,
+// and within flMaxSpread units per unit of distance of vecDir along its right and up axes
+void CLagCompensationManager::StartLagCompensationForShot( CBasePlayer *player, CUserCmd *cmd, const Vector &vecSrc, const Vector &vecDir, float flMaxSpread, float flRange )
+{
+	LagCompensationShot_t shot;
+	shot.m_vecSrc = vecSrc;
+	shot.m_vecDir = vecDir;
+	shot.m_flMaxSpread = flMaxSpread;
+	shot.m_flRange = flRange;
+
+	StartLagCompensation( player, cmd, sv_unlag_shot_prefilter.GetBool() ? &shot : NULL );
+}
+
+void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCmd *cmd, const LagCompensationShot_t *pShot )
 {
 	Assert( !m_isCurrentlyDoingCompensation );
 
@@ -356,7 +529,7 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 	}
 
 	// Assume no players need to be restored
-	m_RestorePlayer.ClearAll();
+	m_RestoreSlot.ClearAll();
 	m_bNeedToRestore = false;
 
 	m_pCurrentPlayer = player;
@@ -371,8 +544,8 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 
 	// NOTE: Put this here so that it won't show up in single player mode.
 	VPROF_BUDGET( "StartLagCompensation", VPROF_BUDGETGROUP_OTHER_NETWORKING );
-	Q_memset( m_RestoreData, 0, sizeof( m_RestoreData ) );
-	Q_memset( m_ChangeData, 0, sizeof( m_ChangeData ) );
+
+	// m_RestoreData and m_ChangeData are cleared per slot as BacktrackEntity() moves them
 
 	m_isCurrentlyDoingCompensation = true;
 
@@ -433,77 +606,63 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 			continue;
 
 		// Move other player back in time
-		BacktrackPlayer( pPlayer, TICKS_TO_TIME( targettick ) );
+		BacktrackEntity( pPlayer, i-1, TICKS_TO_TIME( targettick ), pShot );
+	}
+
+	// Iterate the other entities that opted in
+	for ( int i = 0; i < LAG_COMPENSATION_MAX_ADDITIONAL_ENTITIES; i++ )
+	{
+		CBaseAnimatingOverlay *pEntity = m_AdditionalEntity[i];
+
+		if ( !pEntity )
+		{
+			continue;
+		}
+
+		// Team members shouldn't be adjusted unless friendly fire is on.
+		if ( !friendlyfire.GetInt() && pEntity->GetTeamNumber() == player->GetTeamNumber() )
+			continue;
+
+		// If this entity hasn't been transmitted to us and acked, then don't bother lag compensating it.
+		if ( pEntityTransmitBits && !pEntityTransmitBits->Get( pEntity->entindex() ) )
+			continue;
+
+		BacktrackEntity( pEntity, MAX_PLAYERS + i, TICKS_TO_TIME( targettick ), pShot );
 	}
 }
 
-void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTargetTime )
+void CLagCompensationManager::BacktrackEntity( CBaseAnimatingOverlay *pEntity, int slot, float flTargetTime, const LagCompensationShot_t *pShot )
 {
 	Vector org;
 	Vector minsPreScaled;
 	Vector maxsPreScaled;
 	QAngle ang;
 
-	VPROF_BUDGET( "BacktrackPlayer", "CLagCompensationManager" );
-	int pl_index = pPlayer->entindex() - 1;
+	VPROF_BUDGET( "BacktrackEntity", "CLagCompensationManager" );
 
-	// get track history of this player
-	CUtlFixedLinkedList< LagRecord > *track = &m_PlayerTrack[ pl_index ];
+	// get track history of this entity
+	CLagRecordTrack *track = &m_Track[ slot ];
 
 	// check if we have at leat one entry
 	if ( track->Count() <= 0 )
 		return;
 
-	intp curr = track->Head();
+	// find the newest record at or before the target time
+	int age = track->FindRecord( flTargetTime );
 
-	LagRecord *prevRecord = NULL;
-	LagRecord *record = NULL;
+	// if the entity died or teleported between then and now, we lost track
+	if ( track->GetBreakAge() <= age )
+		return;
 
-	Vector prevOrg = pPlayer->GetLocalOrigin();
-	
-	// Walk context looking for any invalidating event
-	while( track->IsValidIndex(curr) )
+	Vector delta = track->Get( 0 ).m_vecOrigin - pEntity->GetLocalOrigin();
+	if ( delta.Length2DSqr() > m_flTeleportDistanceSqr )
 	{
-		// remember last record
-		prevRecord = record;
-
-		// get next record
-		record = &track->Element( curr );
-
-		if ( !(record->m_fFlags & LC_ALIVE) )
-		{
-			// player most be alive, lost track
-			return;
-		}
-
-		Vector delta = record->m_vecOrigin - prevOrg;
-		if ( delta.Length2DSqr() > m_flTeleportDistanceSqr )
-		{
-			// lost track, too much difference
-			return; 
-		}
-
-		// did we find a context smaller than target time ?
-		if ( record->m_flSimulationTime <= flTargetTime )
-			break; // hurra, stop
-
-		prevOrg = record->m_vecOrigin;
-
-		// go one step back
-		curr = track->Next( curr );
+		// lost track, too much difference
+		return; 
 	}
 
-	Assert( record );
-
-	if ( !record )
-	{
-		if ( sv_unlag_debug.GetBool() )
-		{
-			DevMsg( "No valid positions in history for BacktrackPlayer client ( %s )\n", pPlayer->GetPlayerName() );
-		}
-
-		return; // that should never happen
-	}
+	LagRecord *record = &track->Get( age );
+	LagRecord *prevRecord = ( age > 0 ) ? &track->Get( age - 1 ) : NULL;
 
 	float frac = 0.0f;
 	if ( prevRecord && 
@@ -537,8 +696,21 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 		maxsPreScaled	= record->m_vecMaxsPreScaled;
 	}
 
+	// Skip entities the shot can't possibly hit at their backtracked position
+	if ( pShot )
+	{
+		float flScale = pEntity->GetModelScale();
+		Vector vecCenter = org + 0.5f * flScale * ( minsPreScaled + maxsPreScaled );
+		float flRadius = 0.5f * flScale * ( maxsPreScaled - minsPreScaled ).Length() * LAG_COMPENSATION_HITBOX_SCALE + LAG_COMPENSATION_HITBOX_PAD;
+
+		if ( !pShot->CouldHit( vecCenter, flRadius ) )
+			return;
+	}
+
 	// See if this is still a valid position for us to teleport to
-	if ( sv_unlag_fixstuck.GetBool() )
+	// Only players are kept out of solids, other entities go wherever their history says
+	CBasePlayer *pPlayer = ToBasePlayer( pEntity );
+	if ( pPlayer && sv_unlag_fixstuck.GetBool() )
 	{
 		// Try to move to the wanted position from our current position.
 		trace_t tr;
@@ -555,19 +727,18 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 			{
 				// If we haven't backtracked this player, do it now
 				// this deliberately ignores WantsLagCompensationOnEntity.
-				if ( !m_RestorePlayer.Get( pHitPlayer->entindex() - 1 ) )
+				if ( !m_RestoreSlot.Get( pHitPlayer->entindex() - 1 ) )
 				{
-					// prevent recursion - save a copy of m_RestorePlayer,
+					// prevent recursion - save a copy of m_RestoreSlot,
 					// pretend that this player is off-limits
-					int pl_index = pPlayer->entindex() - 1;
 
 					// Temp turn this flag on
-					m_RestorePlayer.Set( pl_index );
+					m_RestoreSlot.Set( slot );
 
-					BacktrackPlayer( pHitPlayer, flTargetTime );
+					BacktrackEntity( pHitPlayer, pHitPlayer->entindex() - 1, flTargetTime );
 
 					// Remove the temp flag
-					m_RestorePlayer.Clear( pl_index );
+					m_RestoreSlot.Clear( slot );
 				}				
 			}
 
@@ -596,34 +767,37 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 		}
 	}
 	
-	// See if this represents a change for the player
+	// See if this represents a change for the entity
 	int flags = 0;
-	LagRecord *restore = &m_RestoreData[ pl_index ];
-	LagRecord *change  = &m_ChangeData[ pl_index ];
+	LagRecord *restore = &m_RestoreData[ slot ];
+	LagRecord *change  = &m_ChangeData[ slot ];
+
+	Q_memset( restore, 0, sizeof( LagRecord ) );
+	Q_memset( change, 0, sizeof( LagRecord ) );
 
-	QAngle angdiff = pPlayer->GetLocalAngles() - ang;
-	Vector orgdiff = pPlayer->GetLocalOrigin() - org;
+	QAngle angdiff = pEntity->GetLocalAngles() - ang;
+	Vector orgdiff = pEntity->GetLocalOrigin() - org;
 
 	// Always remember the pristine simulation time in case we need to restore it.
-	restore->m_flSimulationTime = pPlayer->GetSimulationTime();
+	restore->m_flSimulationTime = pEntity->GetSimulationTime();
 
 	if ( angdiff.LengthSqr() > LAG_COMPENSATION_EPS_SQR )
 	{
 		flags |= LC_ANGLES_CHANGED;
-		restore->m_vecAngles = pPlayer->GetLocalAngles();
-		pPlayer->SetLocalAngles( ang );
+		restore->m_vecAngles = pEntity->GetLocalAngles();
+		pEntity->SetLocalAngles( ang );
 		change->m_vecAngles = ang;
 	}
 
 	// Use absolute equality here
-	if ( minsPreScaled != pPlayer->CollisionProp()->OBBMinsPreScaled() || maxsPreScaled != pPlayer->CollisionProp()->OBBMaxsPreScaled() )
+	if ( minsPreScaled != pEntity->CollisionProp()->OBBMinsPreScaled() || maxsPreScaled != pEntity->CollisionProp()->OBBMaxsPreScaled() )
 	{
 		flags |= LC_SIZE_CHANGED;
 
-		restore->m_vecMinsPreScaled = pPlayer->CollisionProp()->OBBMinsPreScaled();
-		restore->m_vecMaxsPreScaled = pPlayer->CollisionProp()->OBBMaxsPreScaled();
+		restore->m_vecMinsPreScaled = pEntity->CollisionProp()->OBBMinsPreScaled();
+		restore->m_vecMaxsPreScaled = pEntity->CollisionProp()->OBBMaxsPreScaled();
 		
-		pPlayer->SetSize( minsPreScaled, maxsPreScaled );
+		pEntity->SetSize( minsPreScaled, maxsPreScaled );
 		
 		change->m_vecMinsPreScaled = minsPreScaled;
 		change->m_vecMaxsPreScaled = maxsPreScaled;
@@ -633,8 +807,8 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	if ( orgdiff.LengthSqr() > LAG_COMPENSATION_EPS_SQR )
 	{
 		flags |= LC_ORIGIN_CHANGED;
-		restore->m_vecOrigin = pPlayer->GetLocalOrigin();
-		pPlayer->SetLocalOrigin( org );
+		restore->m_vecOrigin = pEntity->GetLocalOrigin();
+		pEntity->SetLocalOrigin( org );
 		change->m_vecOrigin = org;
 	}
 
@@ -642,8 +816,8 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	// standing still, but you breathe even on the server.
 	// This is quicker than actually comparing all bazillion floats.
 	flags |= LC_ANIMATION_CHANGED;
-	restore->m_masterSequence = pPlayer->GetSequence();
-	restore->m_masterCycle = pPlayer->GetCycle();
+	restore->m_masterSequence = pEntity->GetSequence();
+	restore->m_masterCycle = pEntity->GetCycle();
 
 	bool interpolationAllowed = false;
 	if( prevRecord && (record->m_masterSequence == prevRecord->m_masterSequence) )
@@ -658,45 +832,45 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	if( frac > 0.0f && interpolationAllowed )
 	{
 		interpolatedMasters = true;
-		pPlayer->SetSequence( Lerp( frac, record->m_masterSequence, prevRecord->m_masterSequence ) );
-		pPlayer->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
+		pEntity->SetSequence( Lerp( frac, record->m_masterSequence, prevRecord->m_masterSequence ) );
+		pEntity->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
 
 		if( record->m_masterCycle > prevRecord->m_masterCycle )
 		{
 			// the older record is higher in frame than the newer, it must have wrapped around from 1 back to 0
 			// add one to the newer so it is lerping from .9 to 1.1 instead of .9 to .1, for example.
 			float newCycle = Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle + 1 );
-			pPlayer->SetCycle(newCycle < 1 ? newCycle : newCycle - 1 );// and make sure .9 to 1.2 does not end up 1.05
+			pEntity->SetCycle(newCycle < 1 ? newCycle : newCycle - 1 );// and make sure .9 to 1.2 does not end up 1.05
 		}
 		else
 		{
-			pPlayer->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
+			pEntity->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
 		}
 
 		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
 		{
 			//don't lerp pose params, just pick the closest
-			pPlayer->SetPoseParameter( i, record->m_flPoseParameters[i] );
+			pEntity->SetPoseParameter( i, record->m_flPoseParameters[i] );
 			//pAnimating->SetPoseParameter( i, Lerp( frac, record->m_flPoseParameters[i], prevRecord->m_flPoseParameters[i] ) );
 		}
 	}
 	if( !interpolatedMasters )
 	{
-		pPlayer->SetSequence(record->m_masterSequence);
-		pPlayer->SetCycle(record->m_masterCycle);
+		pEntity->SetSequence(record->m_masterSequence);
+		pEntity->SetCycle(record->m_masterCycle);
 
 		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
 		{
-			pPlayer->SetPoseParameter( i, record->m_flPoseParameters[i] );
+			pEntity->SetPoseParameter( i, record->m_flPoseParameters[i] );
 		}
 	}
 
 	////////////////////////
 	// Now do all the layers
-	int layerCount = pPlayer->GetNumAnimOverlays();
+	int layerCount = pEntity->GetNumAnimOverlays();
 	for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
 	{
-		CAnimationLayer *currentLayer = pPlayer->GetAnimOverlay(layerIndex);
+		CAnimationLayer *currentLayer = pEntity->GetAnimOverlay(layerIndex);
 		if( currentLayer )
 		{
 			restore->m_layerRecords[layerIndex].m_cycle = currentLayer->m_flCycle;
@@ -746,21 +920,21 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 		return; // we didn't change anything
 
 	if ( sv_lagflushbonecache.GetBool() )
-		pPlayer->InvalidateBoneCache();
+		pEntity->InvalidateBoneCache();
 
 	/*char text[256]; Q_snprintf( text, sizeof(text), "time %.2f", flTargetTime );
-	pPlayer->DrawServerHitboxes( 10 );
+	pEntity->DrawServerHitboxes( 10 );
 	NDebugOverlay::Text( org, text, false, 10 );
-	NDebugOverlay::EntityBounds( pPlayer, 255, 0, 0, 32, 10 ); */
+	NDebugOverlay::EntityBounds( pEntity, 255, 0, 0, 32, 10 ); */
 
-	m_RestorePlayer.Set( pl_index ); //remember that we changed this player
-	m_bNeedToRestore = true;  // we changed at least one player
+	m_RestoreSlot.Set( slot ); //remember that we changed this entity
+	m_bNeedToRestore = true;  // we changed at least one entity
 	restore->m_fFlags = flags; // we need to restore these flags
 	change->m_fFlags = flags; // we have changed these flags
 
 	if( sv_showlagcompensation.GetInt() == 1 )
 	{
-		pPlayer->DrawServerHitboxes(4, true);
+		pEntity->DrawServerHitboxes(4, true);
 	}
 }
 
@@ -777,99 +951,154 @@ void CLagCompensationManager::FinishLagCompensation( CBasePlayer *player )
 		return; // no player was changed at all
 	}
 
-	// Iterate all active players
-	for ( int i = 1; i <= gpGlobals->maxClients; i++ )
+	// Put back everything we moved
+	for ( int slot = m_RestoreSlot.FindNextSetBit( 0 ); slot != -1; slot = m_RestoreSlot.FindNextSetBit( slot + 1 ) )
 	{
-		int pl_index = i - 1;
-		
-		if ( !m_RestorePlayer.Get( pl_index ) )
+		CBaseAnimatingOverlay *pEntity = GetSlotEntity( slot );
+		if ( !pEntity )
 		{
-			// player wasn't changed by lag compensation
 			continue;
 		}
 
-		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
-		if ( !pPlayer )
+		RestoreEntity( pEntity, slot );
+	}
+
+	m_isCurrentlyDoingCompensation = false;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Undo what BacktrackEntity() did to the entity in the given slot,
+//			unless the game moved it since
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::RestoreEntity( CBaseAnimatingOverlay *pEntity, int slot )
+{
+	LagRecord *restore = &m_RestoreData[ slot ];
+	LagRecord *change  = &m_ChangeData[ slot ];
+
+	bool restoreSimulationTime = false;
+
+	if ( restore->m_fFlags & LC_SIZE_CHANGED )
+	{
+		restoreSimulationTime = true;
+
+		// see if simulation made any changes, if no, then do the restore, otherwise,
+		//  leave new values in
+		if ( pEntity->CollisionProp()->OBBMinsPreScaled() == change->m_vecMinsPreScaled &&
+			pEntity->CollisionProp()->OBBMaxsPreScaled() == change->m_vecMaxsPreScaled )
 		{
-			continue;
+			// Restore it
+			pEntity->SetSize( restore->m_vecMinsPreScaled, restore->m_vecMaxsPreScaled );
 		}
+	}
 
-		LagRecord *restore = &m_RestoreData[ pl_index ];
-		LagRecord *change  = &m_ChangeData[ pl_index ];
-
-		bool restoreSimulationTime = false;
+	if ( restore->m_fFlags & LC_ANGLES_CHANGED )
+	{		   
+		restoreSimulationTime = true;
 
-		if ( restore->m_fFlags & LC_SIZE_CHANGED )
+		if ( pEntity->GetLocalAngles() == change->m_vecAngles )
 		{
-			restoreSimulationTime = true;
-	
-			// see if simulation made any changes, if no, then do the restore, otherwise,
-			//  leave new values in
-			if ( pPlayer->CollisionProp()->OBBMinsPreScaled() == change->m_vecMinsPreScaled &&
-				pPlayer->CollisionProp()->OBBMaxsPreScaled() == change->m_vecMaxsPreScaled )
-			{
-				// Restore it
-				pPlayer->SetSize( restore->m_vecMinsPreScaled, restore->m_vecMaxsPreScaled );
-			}
+			pEntity->SetLocalAngles( restore->m_vecAngles );
 		}
+	}
 
-		if ( restore->m_fFlags & LC_ANGLES_CHANGED )
-		{		   
-			restoreSimulationTime = true;
+	if ( restore->m_fFlags & LC_ORIGIN_CHANGED )
+	{
+		restoreSimulationTime = true;
 
-			if ( pPlayer->GetLocalAngles() == change->m_vecAngles )
+		// Okay, let's see if we can do something reasonable with the change
+		Vector delta = pEntity->GetLocalOrigin() - change->m_vecOrigin;
+		
+		// If it moved really far, just leave the entity in the new spot!!!
+		if ( delta.Length2DSqr() < m_flTeleportDistanceSqr )
+		{
+			if ( pEntity->IsPlayer() )
 			{
-				pPlayer->SetLocalAngles( restore->m_vecAngles );
+				RestorePlayerTo( ToBasePlayer( pEntity ), restore->m_vecOrigin + delta );
+			}
+			else
+			{
+				// it was there before we moved it
+				UTIL_SetOrigin( pEntity, restore->m_vecOrigin + delta, true );
 			}
 		}
+	}
 
-		if ( restore->m_fFlags & LC_ORIGIN_CHANGED )
-		{
-			restoreSimulationTime = true;
+	if( restore->m_fFlags & LC_ANIMATION_CHANGED )
+	{
+		restoreSimulationTime = true;
 
-			// Okay, let's see if we can do something reasonable with the change
-			Vector delta = pPlayer->GetLocalOrigin() - change->m_vecOrigin;
-			
-			// If it moved really far, just leave the player in the new spot!!!
-			if ( delta.Length2DSqr() < m_flTeleportDistanceSqr )
+		pEntity->SetSequence(restore->m_masterSequence);
+		pEntity->SetCycle(restore->m_masterCycle);
+
+		int layerCount = pEntity->GetNumAnimOverlays();
+		for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
+		{
+			CAnimationLayer *currentLayer = pEntity->GetAnimOverlay(layerIndex);
+			if( currentLayer )
 			{
-				RestorePlayerTo( pPlayer, restore->m_vecOrigin + delta );
+				currentLayer->m_flCycle = restore->m_layerRecords[layerIndex].m_cycle;
+				currentLayer->m_nOrder = restore->m_layerRecords[layerIndex].m_order;
+				currentLayer->m_nSequence = restore->m_layerRecords[layerIndex].m_sequence;
+				currentLayer->m_flWeight = restore->m_layerRecords[layerIndex].m_weight;
 			}
 		}
 
-		if( restore->m_fFlags & LC_ANIMATION_CHANGED )
+		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
 		{
-			restoreSimulationTime = true;
+			pEntity->SetPoseParameter( i, restore->m_flPoseParameters[i] );
+		}
+	}
 
-			pPlayer->SetSequence(restore->m_masterSequence);
-			pPlayer->SetCycle(restore->m_masterCycle);
+	if ( restoreSimulationTime )
+	{
+		pEntity->SetSimulationTime( restore->m_flSimulationTime );
+	}
+}
 
-			int layerCount = pPlayer->GetNumAnimOverlays();
-			for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
-			{
-				CAnimationLayer *currentLayer = pPlayer->GetAnimOverlay(layerIndex);
-				if( currentLayer )
-				{
-					currentLayer->m_flCycle = restore->m_layerRecords[layerIndex].m_cycle;
-					currentLayer->m_nOrder = restore->m_layerRecords[layerIndex].m_order;
-					currentLayer->m_nSequence = restore->m_layerRecords[layerIndex].m_sequence;
-					currentLayer->m_flWeight = restore->m_layerRecords[layerIndex].m_weight;
-				}
-			}
 
-			for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
-			{
-				pPlayer->SetPoseParameter( i, restore->m_flPoseParameters[i] );
-			}
-		}
+//-----------------------------------------------------------------------------
+// Purpose: Lag compensate a non-player entity for shots from players, like
+//			players are. The entity must be removed before it is deleted.
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::AddAdditionalEntity( CBaseAnimatingOverlay *pEntity )
+{
+	int freeIndex = -1;
+	for ( int i = 0; i < LAG_COMPENSATION_MAX_ADDITIONAL_ENTITIES; i++ )
+	{
+		if ( m_AdditionalEntity[i] == pEntity )
+			return;
 
-		if ( restoreSimulationTime )
+		if ( freeIndex < 0 && !m_AdditionalEntity[i] )
 		{
-			pPlayer->SetSimulationTime( restore->m_flSimulationTime );
+			freeIndex = i;
 		}
 	}
 
-	m_isCurrentlyDoingCompensation = false;
+	if ( freeIndex < 0 )
+	{
+		DevWarning( "CLagCompensationManager: no room to lag compensate %s\n", pEntity->GetDebugName() );
+		return;
+	}
+
+	m_AdditionalEntity[ freeIndex ] = pEntity;
+	m_Track[ MAX_PLAYERS + freeIndex ].RemoveAll();
 }
 
 
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::RemoveAdditionalEntity( CBaseAnimatingOverlay *pEntity )
+{
+	for ( int i = 0; i < LAG_COMPENSATION_MAX_ADDITIONAL_ENTITIES; i++ )
+	{
+		if ( m_AdditionalEntity[i] == pEntity )
+		{
+			m_AdditionalEntity[i] = NULL;
+			m_Track[ MAX_PLAYERS + i ].RemoveAll();
+
+			// don't restore it if it goes away mid-compensation
+			m_RestoreSlot.Clear( MAX_PLAYERS + i );
+			return;
+		}
+	}
+}
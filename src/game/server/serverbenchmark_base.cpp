@@ -9,6 +9,8 @@
 #include "props.h"
 #include "filesystem.h"
 #include "tier0/icommandline.h"
+#include "tier0/vprof.h"
+#include "KeyValues.h"
 
 
 // Server benchmark. Only works on specified maps.
@@ -17,9 +19,13 @@
 // Create 20 players and move them around and have them shoot.
 // At the end, report the # seconds it took to complete the test.
 // Don't start measuring for the first N ticks to account for HD load.
+//
+// Run it with -sv_benchmark on the command line and +map to pick the map. -sv_benchmark 2 writes 
+// sv_benchmark_results.txt and quits when it's done, for running unattended.
 
 static ConVar sv_benchmark_numticks( "sv_benchmark_numticks", "3300", 0, "If > 0, then it only runs the benchmark for this # of ticks." );
 static ConVar sv_benchmark_autovprofrecord( "sv_benchmark_autovprofrecord", "0", 0, "If running a benchmark and this is set, it will record a vprof file over the duration of the benchmark with filename benchmark.vprof." );
+static ConVar sv_benchmark_report( "sv_benchmark_report", "", 0, "If running a benchmark and this is set, it will profile the benchmark and write a KeyValues report with the time per tick spent in each subsystem to this file." );
 
 static float s_flBenchmarkStartWaitSeconds = 3;	// Wait this many seconds after level load before starting the benchmark.
 
@@ -49,6 +55,7 @@ public:
 	CServerBenchmark()
 	{
 		m_BenchmarkState = BENCHMARKSTATE_NOT_RUNNING;
+		m_bProfiling = false;
 		
 		// The benchmark should always have the same seed and do exactly the same thing on the same ticks.
 		m_RandomStream.SetSeed( 1111 ); 
@@ -56,9 +63,17 @@ public:
 
 	virtual bool StartBenchmark()
 	{
-		bool bBenchmark = (CommandLine()->FindParm( "-sv_benchmark" ) != 0);
+		int nBenchmarkMode = 0;
+		int iParm = CommandLine()->FindParm( "-sv_benchmark" );
+		if ( iParm != 0 )
+		{
+			// An optional mode can follow it.
+			nBenchmarkMode = 1;
+			if ( iParm + 1 < CommandLine()->ParmCount() && V_isdigit( CommandLine()->GetParm( iParm + 1 )[0] ) )
+				nBenchmarkMode = clamp( V_atoi( CommandLine()->GetParm( iParm + 1 ) ), 0, 2 );
+		}
 
-		return InternalStartBenchmark( bBenchmark, s_flBenchmarkStartWaitSeconds );
+		return InternalStartBenchmark( nBenchmarkMode, s_flBenchmarkStartWaitSeconds );
 	}
 
 	// nBenchmarkMode: 0 = no benchmark
@@ -87,6 +102,7 @@ public:
 
 		m_nBotsCreated = 0;
 		m_nStartWaitCounter = -1;
+		m_bProfiling = false;
 
 		// Setup the benchmark environment.
 		engine->SetDedicatedServerBenchmarkMode( true );	// Run 1 tick per frame and ignore all timing stuff.
@@ -123,6 +139,7 @@ public:
 				m_BenchmarkState = BENCHMARKSTATE_RUNNING;
 
 				StartVProfRecord();
+				StartProfiling();
 
 				RandomSeed( 0 );
 				m_RandomStream.SetSeed( 0 );
@@ -137,6 +154,7 @@ public:
 		{
 			EndVProfRecord();
 			OutputResults();
+			OutputReport();
 			EndBenchmark();
 			return;
 		}
@@ -165,8 +183,30 @@ public:
 		}
 	}
 
+	void StartProfiling()
+	{
+		if ( sv_benchmark_report.GetString()[0] == '\0' )
+			return;
+
+		// Start() nests, so this is safe even if someone else is already profiling.
+		g_VProfCurrentProfile.Reset();
+		g_VProfCurrentProfile.Start();
+		m_bProfiling = true;
+	}
+
+	void EndProfiling()
+	{
+		if ( m_bProfiling )
+		{
+			g_VProfCurrentProfile.Stop();
+			m_bProfiling = false;
+		}
+	}
+
 	virtual void EndBenchmark( void )
 	{
+		EndProfiling();
+
 		// Write out the results if we're running the build scripts.
 		float flRunTime = Benchmark_ValidTime() - m_fl_ValidTime_BenchmarkStartTime;
 		if ( m_nBenchmarkMode == 2 )
@@ -338,6 +378,104 @@ public:
 		Warning( "--------------------------------------------------------------\n" );
 	}
 
+	// Add up the time of every node in the tree that isn't nested in another one of the same name.
+	static void AccumulateNodeTime( CVProfNode *pNode, const char *pszName, double &flTime, int &nCalls )
+	{
+		if ( !V_strcmp( pNode->GetName(), pszName ) )
+		{
+			flTime += pNode->GetTotalTime();
+			nCalls += pNode->GetTotalCalls();
+			return;
+		}
+
+		for ( CVProfNode *pChild = pNode->GetChild(); pChild; pChild = pChild->GetSibling() )
+		{
+			AccumulateNodeTime( pChild, pszName, flTime, nCalls );
+		}
+	}
+
+	static void AccumulateBudgetGroupTime( CVProfNode *pNode, CUtlVector<double> &groupTimes )
+	{
+		int iGroup = pNode->GetBudgetGroupID();
+		if ( groupTimes.IsValidIndex( iGroup ) )
+		{
+			groupTimes[iGroup] += pNode->GetTotalTimeLessChildren();
+		}
+
+		for ( CVProfNode *pChild = pNode->GetChild(); pChild; pChild = pChild->GetSibling() )
+		{
+			AccumulateBudgetGroupTime( pChild, groupTimes );
+		}
+	}
+
+	// Write the results, and the time per tick of each budget group and of the nodes the game is 
+	// interested in, in a form a script can compare across builds.
+	void OutputReport()
+	{
+		const char *pszFilename = sv_benchmark_report.GetString();
+		if ( !m_bProfiling || pszFilename[0] == '\0' )
+			return;
+
+		int nTicks = MAX( 1, sv_benchmark_numticks.GetInt() );
+		float flRunTime = Benchmark_ValidTime() - m_fl_ValidTime_BenchmarkStartTime;
+
+		KeyValues *pReport = new KeyValues( "ServerBenchmark" );
+		pReport->SetString( "map", STRING( gpGlobals->mapname ) );
+		pReport->SetInt( "ticks", nTicks );
+		pReport->SetFloat( "seconds", flRunTime );
+		pReport->SetFloat( "ticks_per_second", nTicks / flRunTime );
+		pReport->SetFloat( "ms_per_tick", 1000.0f * flRunTime / nTicks );
+		pReport->SetInt( "crc", CalculateBenchmarkCRC() );
+
+		CVProfNode *pRoot = g_VProfCurrentProfile.GetRoot();
+
+		CUtlVector<double> groupTimes;
+		groupTimes.SetCount( g_VProfCurrentProfile.GetNumBudgetGroups() );
+		FOR_EACH_VEC( groupTimes, i )
+		{
+			groupTimes[i] = 0.0;
+		}
+		AccumulateBudgetGroupTime( pRoot, groupTimes );
+
+		KeyValues *pGroups = pReport->FindKey( "budget_groups", true );
+		FOR_EACH_VEC( groupTimes, i )
+		{
+			if ( groupTimes[i] > 0.0 )
+			{
+				pGroups->SetFloat( g_VProfCurrentProfile.GetBudgetGroupName( i ), groupTimes[i] / nTicks );
+			}
+		}
+
+		CUtlVector<const char*> nodeNames;
+		nodeNames.AddToTail( "CServerGameDLL::GameFrame" );
+		CServerBenchmarkHook::s_pBenchmarkHook->GetReportNodeNames( nodeNames );
+
+		KeyValues *pNodes = pReport->FindKey( "nodes", true );
+		FOR_EACH_VEC( nodeNames, i )
+		{
+			double flTime = 0.0;
+			int nCalls = 0;
+			AccumulateNodeTime( pRoot, nodeNames[i], flTime, nCalls );
+
+			KeyValues *pNode = pNodes->FindKey( nodeNames[i], true );
+			pNode->SetFloat( "ms_per_tick", flTime / nTicks );
+			pNode->SetFloat( "calls_per_tick", (float)nCalls / nTicks );
+		}
+
+		CServerBenchmarkHook::s_pBenchmarkHook->AddReportResults( pReport );
+
+		if ( pReport->SaveToFile( filesystem, pszFilename, "DEFAULT_WRITE_PATH" ) )
+		{
+			Msg( "Wrote benchmark report to %s.\n", pszFilename );
+		}
+		else
+		{
+			Warning( "Can't write benchmark report to %s.\n", pszFilename );
+		}
+
+		pReport->deleteThis();
+	}
+
 	int CalculateBenchmarkCRC()
 	{
 		int crc = 0;
@@ -389,6 +527,7 @@ private:
 	int m_nLastPhysicsForceTick;
 
 	int m_nBotsCreated;
+	bool m_bProfiling;
 	CUtlVector< EHANDLE > m_PhysicsObjects;
 
 	CUtlVector<char*> m_PhysicsModelNames;
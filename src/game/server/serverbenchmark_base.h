@@ -10,6 +10,8 @@
 #pragma once
 #endif
 
+class KeyValues;
+
 
 // The base server code calls into this.
 class IServerBenchmark
@@ -56,6 +58,12 @@ public:
 	// If you want to manage the bots yourself, you can return NULL here.
 	virtual CBasePlayer* CreateBot() = 0;
 
+	// Names of vprof nodes whose time should be broken out in the benchmark report (see sv_benchmark_report).
+	virtual void GetReportNodeNames( CUtlVector<const char*> &nodeNames ) {}
+
+	// Add game-specific results to the benchmark report.
+	virtual void AddReportResults( KeyValues *pReport ) {}
+
 private:
 	friend class CServerBenchmark;
 	static CServerBenchmarkHook *s_pBenchmarkHook; // There can be only one!!
@@ -216,6 +216,17 @@ void CTFBotMvMEngineerIdle::TryToDetonateStaleNest()
 }
 
 
+//---------------------------------------------------------------------------------------------
+// There is nothing to do until we look for a nest again, unless we are attacked
+void CTFBotMvMEngineerIdle::SleepUntilNextHintSearch( CTFBot *me ) const
+{
+	if ( me->GetVisionInterface()->GetPrimaryKnownThreat( true ) )
+		return;
+
+	me->SleepUntil( NEXTBOT_WAKE_ON_INJURED | NEXTBOT_WAKE_ON_AREA_OCCUPANCY, m_findHintTimer.GetRemainingTime() );
+}
+
+
 //---------------------------------------------------------------------------------------------
 ActionResult< CTFBot >	CTFBotMvMEngineerIdle::Update( CTFBot *me, float interval )
 {
@@ -237,6 +248,7 @@ ActionResult< CTFBot >	CTFBotMvMEngineerIdle::Update( CTFBot *me, float interval
 		if ( m_findHintTimer.HasStarted() && !m_findHintTimer.IsElapsed() )
 		{
 			// too soon
+			SleepUntilNextHintSearch( me );
 			return Continue();
 		}
 
@@ -249,6 +261,7 @@ ActionResult< CTFBot >	CTFBotMvMEngineerIdle::Update( CTFBot *me, float interval
 		if ( !CTFBotMvMEngineerHintFinder::FindHint( bShouldCheckForBlockingObject, !bShouldTeleportToHint, &newNest ) )
 		{
 			// try again next time
+			SleepUntilNextHintSearch( me );
 			return Continue();
 		}
 
@@ -39,6 +39,7 @@ private:
 	CHandle< CTFBotHintEngineerNest > m_nestHint;
 
 	void TakeOverStaleNest( CBaseTFBotHintEntity* pHint, CTFBot *me );
+	void SleepUntilNextHintSearch( CTFBot *me ) const;
 	bool ShouldAdvanceNestSpot( CTFBot *me );
 
 	void TryToDetonateStaleNest();
@@ -50,6 +50,13 @@ ActionResult< CTFBot > CTFBotNavEntWait::Update( CTFBot *me, float interval )
 		return Done( "Wait time elapsed" );
 	}
 
+	if ( me->GetVisionInterface()->GetPrimaryKnownThreat( true ) == NULL )
+	{
+		// nothing to do but wait - don't bother updating until something happens
+		const float maxSleepTime = 1.0f;
+		me->SleepUntil( NEXTBOT_WAKE_ON_INJURED | NEXTBOT_WAKE_ON_CONTACT | NEXTBOT_WAKE_ON_AREA_OCCUPANCY, MIN( m_timer.GetRemainingTime(), maxSleepTime ) );
+	}
+
 	return Continue();
 }
 
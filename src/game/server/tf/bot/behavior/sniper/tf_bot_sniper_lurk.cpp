@@ -27,6 +27,7 @@ extern ConVar tf_bot_debug_sniper;
 extern float SkewedRandomValue( void );
 
 ConVar tf_bot_sniper_patience_duration( "tf_bot_sniper_patience_duration", "10", FCVAR_CHEAT, "How long a Sniper bot will wait without seeing an enemy before picking a new spot" );
+ConVar tf_bot_sniper_max_sleep_duration( "tf_bot_sniper_max_sleep_duration", "2", FCVAR_CHEAT, "Longest a Sniper bot waiting at its spot with nothing to shoot will go without updating" );
 ConVar tf_bot_sniper_target_linger_duration( "tf_bot_sniper_target_linger_duration", "2", FCVAR_CHEAT, "How long a Sniper bot will keep toward at a target it just lost sight of" );
 ConVar tf_bot_sniper_allow_opportunistic( "tf_bot_sniper_allow_opportunistic", "1", FCVAR_NONE, "If set, Snipers will stop on their way to their preferred lurking spot to snipe at opportunistic targets" );
 
@@ -203,6 +204,11 @@ ActionResult< CTFBot >	CTFBotSniperLurk::Update( CTFBot *me, float interval )
 				// zoom in and stand still
 				me->PressAltFireButton();
 			}
+			else if ( m_isAtHome && threat == NULL )
+			{
+				// nothing to do but watch from here - sleep until something happens or we get bored
+				me->SleepUntil( NEXTBOT_WAKE_ON_INJURED | NEXTBOT_WAKE_ON_SOUND | NEXTBOT_WAKE_ON_AREA_OCCUPANCY, MIN( m_boredTimer.GetRemainingTime(), tf_bot_sniper_max_sleep_duration.GetFloat() ) );
+			}
 		}
 	}
 	else 
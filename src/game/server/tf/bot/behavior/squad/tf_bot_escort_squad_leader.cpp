@@ -12,6 +12,7 @@
 
 ConVar tf_bot_squad_escort_range( "tf_bot_squad_escort_range", "500", FCVAR_CHEAT );
 ConVar tf_bot_formation_debug( "tf_bot_formation_debug", "0", FCVAR_CHEAT );
+ConVar tf_bot_formation_repath_tolerance( "tf_bot_formation_repath_tolerance", "100", FCVAR_CHEAT, "How far a squad member's formation spot can move from the end of its path before it repaths" );
 
 
 //---------------------------------------------------------------------------------------------
@@ -26,6 +27,8 @@ CTFBotEscortSquadLeader::CTFBotEscortSquadLeader( Action< CTFBot > *actionToDoAf
 ActionResult< CTFBot >	CTFBotEscortSquadLeader::OnStart( CTFBot *me, Action< CTFBot > *priorAction )
 {
 	m_formationForward = vec3_origin;
+	m_isApproachingFormationSpot = false;
+	m_isFormationPathTooLong = false;
 
 	return Continue();
 }
@@ -273,30 +276,62 @@ ActionResult< CTFBot > CTFBotEscortSquadLeader::Update( CTFBot *me, float interv
 		{
 			m_pathTimer.Start( RandomFloat( 0.1f, 0.2f ) );
 
-			me->SetBrokenFormation( false );
+			// The leader does the pathfinding for the squad. If nothing is in our way, steer straight
+			// to our spot beside it, and only compute a path of our own when our spot has moved away from it.
+			const bool isSharing = squad->IsSharingPerception();
 
-			CTFBotPathCost cost( me, FASTEST_ROUTE );
-			if ( m_formationPath.Compute( me, myFormationSpot, cost ) == false )
+			m_isApproachingFormationSpot = isSharing && IsFormationSpotDirectlyReachable( me, myFormationSpot );
+
+			if ( m_isApproachingFormationSpot )
 			{
-				// no path back to formation
-				me->SetBrokenFormation( true );
+				m_formationPath.Invalidate();
+				m_isFormationPathTooLong = false;
 			}
-
-			// if we have a long path to get back in formation, we've broken ranks
-			const float tooFar = 750.0f;
-			if ( m_formationPath.GetLength() > tooFar )
+			else if ( !isSharing || !m_formationPath.IsValid() || 
+					  ( m_formationPath.GetEndPosition() - myFormationSpot ).IsLengthGreaterThan( tf_bot_formation_repath_tolerance.GetFloat() ) )
 			{
-				me->SetBrokenFormation( true );
+				CTFBotPathCost cost( me, FASTEST_ROUTE );
+				bool isPathFound = m_formationPath.Compute( me, myFormationSpot, cost );
+
+				// if we have no path, or a long path, to get back in formation, we've broken ranks
+				const float tooFar = 750.0f;
+				m_isFormationPathTooLong = !isPathFound || m_formationPath.GetLength() > tooFar;
 			}
+
+			me->SetBrokenFormation( m_isFormationPathTooLong );
 		}
 
-		m_formationPath.Update( me );
+		if ( m_isApproachingFormationSpot )
+		{
+			me->GetLocomotionInterface()->Approach( myFormationSpot );
+		}
+		else
+		{
+			m_formationPath.Update( me );
+		}
 	}
 
 	return Continue();
 }
 
 
+//---------------------------------------------------------------------------------------------
+// Return true if we can walk straight to our formation spot without falling or being blocked
+bool CTFBotEscortSquadLeader::IsFormationSpotDirectlyReachable( CTFBot *me, const Vector &formationSpot ) const
+{
+	const float maxDirectRange = 300.0f;
+	if ( me->IsRangeGreaterThan( formationSpot, maxDirectRange ) )
+		return false;
+
+	ILocomotion *mover = me->GetLocomotionInterface();
+
+	if ( !mover->IsPotentiallyTraversable( me->GetAbsOrigin(), formationSpot, ILocomotion::IMMEDIATELY ) )
+		return false;
+
+	return !mover->HasPotentialGap( me->GetAbsOrigin(), formationSpot );
+}
+
+
 //---------------------------------------------------------------------------------------------
 void CTFBotEscortSquadLeader::OnEnd( CTFBot *me, Action< CTFBot > *nextAction )
 {
@@ -30,6 +30,10 @@ private:
 
 	PathFollower m_formationPath;
 	CountdownTimer m_pathTimer;
+	bool m_isApproachingFormationSpot;		// nothing is in the way, so steer straight to our spot without a path
+	bool m_isFormationPathTooLong;
+
+	bool IsFormationSpotDirectlyReachable( CTFBot *me, const Vector &formationSpot ) const;
 
 	const Vector &GetFormationForwardVector( CTFBot *me );
 	Vector m_formationForward;
@@ -9,6 +9,7 @@
 #include "tf_gamerules.h"
 #include "tf_weapon_pipebomblauncher.h"
 #include "NextBot/NavMeshEntities/func_nav_prerequisite.h"
+#include "tf_threat_field.h"
 
 #include "bot/tf_bot.h"
 #include "bot/tf_bot_manager.h"
@@ -115,34 +116,50 @@ void CTFBotTacticalMonitor::MonitorArmedStickyBombs( CTFBot *me )
 
 
 //-----------------------------------------------------------------------------------------
-void CTFBotTacticalMonitor::AvoidBumpingEnemies( CTFBot *me )
+class CFindClosestNoticeableEnemy
 {
-	if ( me->GetDifficulty() < CTFBot::HARD )
-		return;
-
-	const float avoidRange = 200.0f;
+public:
+	CFindClosestNoticeableEnemy( CTFBot *me, float avoidRange ) : m_me( me ), m_closestEnemy( NULL ), m_closestRangeSq( avoidRange * avoidRange ) { }
 
-	CUtlVector< CTFPlayer * > enemyVector;
-	CollectPlayers( &enemyVector, GetEnemyTeam( me->GetTeamNumber() ), COLLECT_ONLY_LIVING_PLAYERS );
-
-	CTFPlayer *closestEnemy = NULL;
-	float closestRangeSq = avoidRange * avoidRange;
-
-	for( int i=0; i<enemyVector.Count(); ++i )
+	bool operator() ( const CTFThreatField::Threat &threat )
 	{
-		CTFPlayer *enemy = enemyVector[i];
+		CTFPlayer *enemy = threat.m_player;
+
+		if ( !enemy->IsAlive() )
+			return true;
 
 		if ( enemy->m_Shared.IsStealthed() || enemy->m_Shared.InCond( TF_COND_DISGUISED ) )
-			continue;
+			return true;
 
-		float rangeSq = ( enemy->GetAbsOrigin() - me->GetAbsOrigin() ).LengthSqr();
-		if ( rangeSq < closestRangeSq )
+		float rangeSq = ( enemy->GetAbsOrigin() - m_me->GetAbsOrigin() ).LengthSqr();
+		if ( rangeSq < m_closestRangeSq )
 		{
-			closestEnemy = enemy;
-			closestRangeSq = rangeSq;
+			m_closestEnemy = enemy;
+			m_closestRangeSq = rangeSq;
 		}
+
+		return true;
 	}
 
+	CTFBot *m_me;
+	CTFPlayer *m_closestEnemy;
+	float m_closestRangeSq;
+};
+
+
+//-----------------------------------------------------------------------------------------
+void CTFBotTacticalMonitor::AvoidBumpingEnemies( CTFBot *me )
+{
+	if ( me->GetDifficulty() < CTFBot::HARD )
+		return;
+
+	const float avoidRange = 200.0f;
+
+	// only visit the enemies near me, rather than the whole enemy team
+	CFindClosestNoticeableEnemy findClosest( me, avoidRange );
+	TheTFThreatField().ForEachThreatInRadius( GetEnemyTeam( me->GetTeamNumber() ), me->WorldSpaceCenter(), avoidRange + me->CollisionProp()->BoundingRadius(), findClosest );
+
+	CTFPlayer *closestEnemy = findClosest.m_closestEnemy;
 	if ( !closestEnemy )
 		return;
 
@@ -14,6 +14,7 @@
 #include "tf_bot_manager.h"
 #include "tf_bot_vision.h"
 #include "tf_team.h"
+#include "tf_threat_field.h"
 #include "bot/map_entities/tf_bot_generator.h"
 #include "trigger_area_capture.h"
 #include "GameEventListener.h"
@@ -1468,6 +1469,42 @@ void CTFBot::Touch( CBaseEntity *pOther )
 }
 
 
+//-----------------------------------------------------------------------------------------------------
+class CTFBotAvoidTeammates
+{
+public:
+	CTFBotAvoidTeammates( CTFBot *me, float tooClose ) : m_me( me ), m_tooClose( tooClose ), m_avoidVector( vec3_origin ) { }
+
+	bool operator() ( const CTFThreatField::Threat &threat )
+	{
+		CTFPlayer *them = threat.m_player;
+
+		if ( m_me->IsSelf( them ) || !them->IsAlive() )
+			return true;
+
+		if ( m_me->IsPlayerClass( TF_CLASS_MEDIC ) && !them->IsPlayerClass( TF_CLASS_MEDIC ) )
+		{
+			// medics only avoid other medics, so they stay with their patient
+			return true;
+		}
+
+		Vector between = m_me->GetAbsOrigin() - them->GetAbsOrigin();
+		if ( between.IsLengthLessThan( m_tooClose ) )
+		{
+			float range = between.NormalizeInPlace();
+
+			m_avoidVector += ( 1.0f - ( range / m_tooClose ) ) * between;
+		}
+
+		return true;
+	}
+
+	CTFBot *m_me;
+	float m_tooClose;
+	Vector m_avoidVector;
+};
+
+
 //-----------------------------------------------------------------------------------------------------
 // Avoid penetrating teammates
 void CTFBot::AvoidPlayers( CUserCmd *pCmd )
@@ -1479,9 +1516,6 @@ void CTFBot::AvoidPlayers( CUserCmd *pCmd )
 	Vector forward, right;
 	EyeVectors( &forward, &right );
 
-	CUtlVector< CTFPlayer * > playerVector;
-	CollectPlayers( &playerVector, GetTeamNumber(), COLLECT_ONLY_LIVING_PLAYERS );
-
 	Vector avoidVector = vec3_origin;
 
 	float tooClose = 50.0f;
@@ -1491,44 +1525,16 @@ void CTFBot::AvoidPlayers( CUserCmd *pCmd )
 		tooClose = 150.0f;
 	}
 
-	for( int i=0; i<playerVector.Count(); ++i )
+	// Don't push around the flag (bomb) carrier.
+	// We need this for MvM mode so friendly bots don't
+	// move the bomb jumper and cause him to restart.
+	// If I'm a non-Medic in a Squad, I'm part of a formation.
+	if ( !HasTheFlag() && ( IsPlayerClass( TF_CLASS_MEDIC ) || !IsInASquad() ) )
 	{
-		CTFPlayer *them = playerVector[i];
-
-		if ( IsSelf( them ) )
-		{
-			continue;
-		}
-
-		if ( HasTheFlag() )
-		{
-			// Don't push around the flag (bomb) carrier.
-			// We need this for MvM mode so friendly bots don't
-			// move the bomb jumper and cause him to restart.
-			continue;
-		}
-
-		if ( IsPlayerClass( TF_CLASS_MEDIC ) )
-		{
-			if ( !them->IsPlayerClass( TF_CLASS_MEDIC ) )
-			{
-				// medics only avoid other medics, so they stay with their patient
-				continue;
-			}
-		}
-		else if ( IsInASquad() )
-		{
-			// if I'm a non-Medic in a Squad, I'm part of a formation
-			continue;
-		}
-
-		Vector between = GetAbsOrigin() - them->GetAbsOrigin();
-		if ( between.IsLengthLessThan( tooClose ) )
-		{
-			float range = between.NormalizeInPlace();
-
-			avoidVector += ( 1.0f - ( range / tooClose ) ) * between;
-		}
+		// only visit the teammates near me, rather than the whole team
+		CTFBotAvoidTeammates avoid( this, tooClose );
+		TheTFThreatField().ForEachThreatInRadius( GetTeamNumber(), WorldSpaceCenter(), tooClose + CollisionProp()->BoundingRadius(), avoid );
+		avoidVector = avoid.m_avoidVector;
 	}
 
 	if ( avoidVector.IsZero() )
@@ -4455,6 +4461,20 @@ void CTFBot::RemoveTag( const char *tag )
 }
 
 
+//---------------------------------------------------------------------------------------------
+uint32 CTFBot::GetTagsHash( void ) const
+{
+	uint32 hash = 0;
+
+	for( int i=0; i<m_tags.Count(); ++i )
+	{
+		hash = hash * 31 + HashStringCaseless( m_tags[i] );
+	}
+
+	return hash;
+}
+
+
 //---------------------------------------------------------------------------------------------
 // TODO: Make this an efficient lookup/match
 bool CTFBot::HasTag( const char *tag )
@@ -4989,3 +5009,33 @@ float CTFBot::GetUberDeployDelayDuration()
 	
 	return -1.f;
 }
+
+
+//---------------------------------------------------------------------------------------------
+/**
+ * Paths are shared between bots whose costs would be identical (see IPathCost::GetCacheKind)
+ */
+uint32 CTFBotPathCost::GetCacheKind( void ) const
+{
+	// safest routes depend on the current combat, and default routes on a random preference unique to each bot
+	if ( m_routeType == SAFEST_ROUTE || ( m_routeType == DEFAULT_ROUTE && !m_me->IsMiniBoss() ) )
+		return 0;
+
+	// spies avoid their teammates and enemy buildings, and trainees avoid the point
+	if ( m_me->IsPlayerClass( TF_CLASS_SPY ) || TFGameRules()->IsInTraining() )
+		return 0;
+
+	// the remaining costs depend on our team, our movement limits, and whatever func_nav_cost entities look at
+	uint32 kind = m_me->GetTeamNumber();
+	kind = kind * 31 + m_me->GetPlayerClass()->GetClassIndex();
+	kind = kind * 31 + m_me->GetMission();
+	kind = kind * 31 + ( m_me->HasTheFlag() ? 1 : 0 );
+	kind = kind * 31 + ( TFGameRules()->RoundHasBeenWon() ? 1 : 0 );
+	kind = kind * 31 + (uint32)m_stepHeight;
+	kind = kind * 31 + (uint32)m_maxJumpHeight;
+	kind = kind * 31 + (uint32)m_maxDropHeight;
+	kind = kind * 31 + m_me->GetTagsHash();
+
+	// zero means "not cacheable"
+	return ( kind != 0 ) ? kind : 1;
+}
@@ -386,6 +386,7 @@ public:
 	void AddTag( const char *tag );
 	void RemoveTag( const char *tag );
 	bool HasTag( const char *tag );
+	uint32 GetTagsHash( void ) const;				// return a hash of our tags, for quickly telling whether two bots have the same tags
 	void ScriptGetAllTags( HSCRIPT hTable );
 
 	Action< CTFBot > *OpportunisticallyUseWeaponAbilities( void );
@@ -1062,6 +1063,13 @@ public:
 		}
 	}
 
+	virtual uint32 GetCacheKind( void ) const;
+
+	virtual IPathCost *Clone( void ) const
+	{
+		return new CTFBotPathCost( *this );
+	}
+
 	CTFBot *m_me;
 	RouteType m_routeType;
 	float m_stepHeight;
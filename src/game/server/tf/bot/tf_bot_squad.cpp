@@ -7,6 +7,8 @@
 #include "tf_bot.h"
 #include "tf_bot_squad.h"
 
+ConVar tf_bot_squad_share_perception( "tf_bot_squad_share_perception", "1", FCVAR_CHEAT, "If nonzero, TFBot squad members share what they see, scan for themselves less often, and steer directly to their formation spots when nothing is in the way" );
+
 
 //----------------------------------------------------------------------
 CTFBotSquad::CTFBotSquad( void )
@@ -14,6 +16,7 @@ CTFBotSquad::CTFBotSquad( void )
 	m_leader = NULL;
 	m_formationSize = -1.0f;
 	m_bShouldPreserveSquad = false;
+	m_sightingGeneration = 0;
 }
 
 
@@ -277,6 +280,142 @@ bool CTFBotSquad::IsInFormation( void ) const
 	return true;
 }
 
+//----------------------------------------------------------------------
+bool CTFBotSquad::IsSharingPerception( void ) const
+{
+	return tf_bot_squad_share_perception.GetBool() && GetMemberCount() > 1;
+}
+
+
+//----------------------------------------------------------------------
+// Given the interval at which a lone bot scans for visible entities, return
+// how often the given member needs to scan for itself. The leader scans as often
+// as a lone bot, and the rest of the squad takes turns, so together they scan 
+// about as often as one bot does.
+float CTFBotSquad::GetVisionScanInterval( CTFBot *bot, float interval ) const
+{
+	if ( !IsSharingPerception() || IsLeader( bot ) )
+		return interval;
+
+	return interval * ( GetMemberCount() - 1 );
+}
+
+
+//----------------------------------------------------------------------
+class CShareSightings : public IVision::IForEachKnownEntity
+{
+public:
+	CShareSightings( CTFBot *me, CUtlVector< CBaseEntity * > *visibleVector ) : m_me( me ), m_visibleVector( visibleVector ) { }
+
+	virtual bool Inspect( const CKnownEntity &known )
+	{
+		if ( known.IsVisibleInFOVNow() && m_me->IsEnemy( known.GetEntity() ) )
+		{
+			m_visibleVector->AddToTail( known.GetEntity() );
+		}
+
+		return true;
+	}
+
+	CTFBot *m_me;
+	CUtlVector< CBaseEntity * > *m_visibleVector;
+};
+
+
+//----------------------------------------------------------------------
+// Record the enemies the given member can see right now. The sightings are
+// good until the member looks again, 'lifetime' seconds from now.
+void CTFBotSquad::ShareSightings( CTFBot *bot, float lifetime )
+{
+	// forget sightings that have expired
+	for( int i=0; i<m_sightingVector.Count(); ++i )
+	{
+		const Sighting &sighting = m_sightingVector[i];
+		if ( sighting.m_entity == NULL || gpGlobals->curtime - sighting.m_timestamp > sighting.m_lifetime )
+		{
+			m_sightingVector.FastRemove( i );
+			--i;
+		}
+	}
+
+	CUtlVector< CBaseEntity * > visibleVector;
+	CShareSightings share( bot, &visibleVector );
+	bot->GetVisionInterface()->ForEachKnownEntity( share );
+
+	if ( visibleVector.Count() > 0 )
+	{
+		++m_sightingGeneration;
+	}
+
+	FOR_EACH_VEC( visibleVector, v )
+	{
+		int i;
+		for( i=0; i<m_sightingVector.Count(); ++i )
+		{
+			if ( m_sightingVector[i].m_entity == visibleVector[v] )
+				break;
+		}
+
+		if ( i == m_sightingVector.Count() )
+		{
+			i = m_sightingVector.AddToTail();
+			m_sightingVector[i].m_entity = visibleVector[v];
+			m_sightingVector[i].m_lifetime = lifetime;
+		}
+		else
+		{
+			// keep it until whoever looks last looks again
+			m_sightingVector[i].m_lifetime = MAX( m_sightingVector[i].m_lifetime - ( gpGlobals->curtime - m_sightingVector[i].m_timestamp ), lifetime );
+		}
+
+		m_sightingVector[i].m_timestamp = gpGlobals->curtime;
+	}
+}
+
+
+//----------------------------------------------------------------------
+// Collect the enemies the squad has seen recently, that the given member could 
+// see itself. The member's own line of sight isn't checked - they are close to 
+// whoever saw them, and it checks its line of fire before shooting anyway.
+void CTFBotSquad::CollectSightings( CTFBot *bot, CUtlVector< CBaseEntity * > *visibleVector ) const
+{
+	IVision *vision = bot->GetVisionInterface();
+
+	FOR_EACH_VEC( m_sightingVector, i )
+	{
+		const Sighting &sighting = m_sightingVector[i];
+
+		CBaseEntity *entity = sighting.m_entity;
+		if ( entity == NULL || !entity->IsAlive() )
+			continue;
+
+		if ( gpGlobals->curtime - sighting.m_timestamp > sighting.m_lifetime )
+			continue;
+
+		if ( vision->IsIgnored( entity ) || !vision->IsPotentiallyAbleToSee( entity, IVision::USE_FOV ) )
+			continue;
+
+		visibleVector->AddToTail( entity );
+	}
+}
+
+
+//----------------------------------------------------------------------
+// Make the given member aware of the enemies the squad has seen recently, if it 
+// could see them itself, between the member's own scans
+void CTFBotSquad::ApplySightings( CTFBot *bot ) const
+{
+	CUtlVector< CBaseEntity * > visibleVector;
+	CollectSightings( bot, &visibleVector );
+
+	IVision *vision = bot->GetVisionInterface();
+	FOR_EACH_VEC( visibleVector, i )
+	{
+		vision->AddVisibleEntity( visibleVector[i] );
+	}
+}
+
+
 //----------------------------------------------------------------------
 // Tell all members to leave the squad and then delete itself
 void CTFBotSquad::DisbandAndDeleteSquad( void )
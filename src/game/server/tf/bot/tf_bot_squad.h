@@ -78,6 +78,15 @@ public:
 	void SetShouldPreserveSquad( bool bShouldPreserveSquad ) { m_bShouldPreserveSquad = bShouldPreserveSquad; }
 	bool ShouldPreserveSquad() const { return m_bShouldPreserveSquad; }
 
+	// Shared perception. Members tell the squad what they see, and the squad tells the
+	// rest of its members, so members other than the leader can scan for themselves less often.
+	bool IsSharingPerception( void ) const;					// return true if members share what they see and leave pathfinding to the leader
+	float GetVisionScanInterval( CTFBot *bot, float interval ) const;	// given a lone bot's scan interval, return how often the given member needs to scan for itself
+	void ShareSightings( CTFBot *bot, float lifetime );		// record the enemies the given member can see right now, until it looks again 'lifetime' seconds from now
+	void CollectSightings( CTFBot *bot, CUtlVector< CBaseEntity * > *visibleVector ) const;	// collect the enemies the squad has recently seen, that the given member could also see
+	void ApplySightings( CTFBot *bot ) const;				// make the given member aware of enemies the squad has recently seen, that it could also see
+	int GetSightingGeneration( void ) const					{ return m_sightingGeneration; }	// changes whenever a member shares new sightings
+
 private:
 	friend class CTFBot;
 
@@ -89,6 +98,15 @@ private:
 
 	float m_formationSize;
 	bool m_bShouldPreserveSquad;
+
+	struct Sighting
+	{
+		CHandle< CBaseEntity > m_entity;
+		float m_timestamp;
+		float m_lifetime;
+	};
+	CUtlVector< Sighting > m_sightingVector;
+	int m_sightingGeneration;
 };
 
 inline bool CTFBotSquad::IsMember( CTFBot *bot ) const
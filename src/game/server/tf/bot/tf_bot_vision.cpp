@@ -11,8 +11,10 @@
 #include "tf_player.h"
 #include "tf_gamerules.h"
 #include "tf_obj_sentrygun.h"
+#include "tf_threat_field.h"
 
 ConVar tf_bot_choose_target_interval( "tf_bot_choose_target_interval", "0.3f", FCVAR_CHEAT, "How often, in seconds, a TFBot can reselect his target" );
+ConVar tf_bot_mvm_vision_scan_interval( "tf_bot_mvm_vision_scan_interval", "0.5", FCVAR_CHEAT, "How often, in seconds, a robot in MvM rescans for visible entities" );
 ConVar tf_bot_sniper_choose_target_interval( "tf_bot_sniper_choose_target_interval", "3.0f", FCVAR_CHEAT, "How often, in seconds, a zoomed-in Sniper can reselect his target" );
 
 
@@ -20,74 +22,147 @@ ConVar tf_bot_sniper_choose_target_interval( "tf_bot_sniper_choose_target_interv
 // Update internal state
 void CTFBotVision::Update( void )
 {
+	CTFBot *me = (CTFBot *)GetBot()->GetEntity();
+	if ( !me )
+		return;
+
+	// squads share what they see, so their members can take turns scanning
+	CTFBotSquad *squad = GetSharingSquad();
+
+	float scanInterval = 0.0f;
+
 	if ( TFGameRules()->IsMannVsMachineMode() )
 	{
-		// Throttle vision update rate of robots in MvM for perf at the expense of reaction times
+		// Throttle vision update rate of robots in MvM for perf at the expense of reaction times.
+		// Line-of-sight results are batched and shared between robots, so this can be fairly short.
 		if ( !m_scanTimer.IsElapsed() )
 		{
+			// take what the rest of the squad has seen since we last looked
+			if ( squad && squad->GetSightingGeneration() != m_sightingGeneration )
+			{
+				m_sightingGeneration = squad->GetSightingGeneration();
+				squad->ApplySightings( me );
+			}
 			return;
 		}
 
-		m_scanTimer.Start( RandomFloat( 0.9f, 1.1f ) );
+		scanInterval = tf_bot_mvm_vision_scan_interval.GetFloat();
+		if ( squad )
+		{
+			scanInterval = squad->GetVisionScanInterval( me, scanInterval );
+		}
+
+		m_scanTimer.Start( RandomFloat( 0.9f * scanInterval, 1.1f * scanInterval ) );
 	}
 
+	// this includes the squad's sightings, through CollectSharedVisibleEntities()
 	IVision::Update();
 
-	CTFBot *me = (CTFBot *)GetBot()->GetEntity();
-	if ( !me )
-		return;
+	if ( squad )
+	{
+		squad->ShareSightings( me, 1.1f * scanInterval );
+		m_sightingGeneration = squad->GetSightingGeneration();
+	}
 
 	// forget spies we have lost sight of
-	CUtlVector< CTFPlayer * > playerVector;
-	CollectPlayers( &playerVector, GetEnemyTeam( me->GetTeamNumber() ), COLLECT_ONLY_LIVING_PLAYERS );
+	const CTFThreatField &threatField = TheTFThreatField();
+	const int enemyTeam = GetEnemyTeam( me->GetTeamNumber() );
 
-	for( int i=0; i<playerVector.Count(); ++i )
+	for( int i=0; i<threatField.GetThreatCount( enemyTeam ); ++i )
 	{
-		if ( !playerVector[i]->IsPlayerClass( TF_CLASS_SPY ) )
+		const CTFThreatField::Threat &threat = threatField.GetThreat( enemyTeam, i );
+
+		// if a hidden spy changes disguises, we no longer recognize him
+		if ( !threat.HasFlag( CTFThreatField::THREAT_SPY ) || !threat.HasFlag( CTFThreatField::THREAT_DISGUISING ) )
 			continue;
 
-		const CKnownEntity *known = GetKnown( playerVector[i] );
+		const CKnownEntity *known = GetKnown( threat.m_player );
 
 		if ( !known || !known->IsVisibleRecently() )
 		{
-			// if a hidden spy changes disguises, we no longer recognize him
-			if ( playerVector[i]->m_Shared.InCond( TF_COND_DISGUISING ) )
-			{
-				me->ForgetSpy( playerVector[i] );				
-			}
+			me->ForgetSpy( threat.m_player );
 		}
 	}
 }
 
 
 //------------------------------------------------------------------------------------------
-void CTFBotVision::CollectPotentiallyVisibleEntities( CUtlVector< CBaseEntity * > *potentiallyVisible )
+// Return our squad if it shares what its members see, or NULL
+CTFBotSquad *CTFBotVision::GetSharingSquad( void ) const
 {
-	VPROF_BUDGET( "CTFBotVision::CollectPotentiallyVisibleEntities", "NextBot" );
+	CTFBot *me = (CTFBot *)GetBot()->GetEntity();
+	CTFBotSquad *squad = me ? me->GetSquad() : NULL;
 
-	potentiallyVisible->RemoveAll();
+	return ( squad && squad->IsSharingPerception() ) ? squad : NULL;
+}
 
-	// include all players
-	for( int i=1; i<=gpGlobals->maxClients; ++i )
+
+//------------------------------------------------------------------------------------------
+// Count the enemies our squad has recently seen as visible to us too
+void CTFBotVision::CollectSharedVisibleEntities( CUtlVector< CBaseEntity * > *sharedVisible )
+{
+	CTFBotSquad *squad = GetSharingSquad();
+	if ( squad )
 	{
-		CBasePlayer *player = UTIL_PlayerByIndex( i );
+		CTFBot *me = (CTFBot *)GetBot()->GetEntity();
+		squad->CollectSightings( me, sharedVisible );
+	}
+}
 
-		if ( player == NULL )
-			continue;
 
-		if ( FNullEnt( player->edict() ) )
-			continue;
+//------------------------------------------------------------------------------------------
+// Snapshot this tick's line-of-sight queries, unless our throttled scan won't happen this update
+bool CTFBotVision::PrepareSense( void )
+{
+	if ( TFGameRules()->IsMannVsMachineMode() && !m_scanTimer.IsElapsed() )
+	{
+		return false;
+	}
 
-		if ( !player->IsPlayer() )
-			continue;
+	return IVision::PrepareSense();
+}
 
-		if ( !player->IsConnected() )
-			continue;
 
-		if ( !player->IsAlive() )
-			continue;
+//------------------------------------------------------------------------------------------
+class CollectPlayersInVisionRange
+{
+public:
+	CollectPlayersInVisionRange( CUtlVector< CBaseEntity * > *potentiallyVisible ) : m_potentiallyVisible( potentiallyVisible ) { }
+
+	bool operator() ( const CTFThreatField::Threat &threat )
+	{
+		// the snapshot is from the start of the tick
+		if ( threat.m_player->IsAlive() )
+		{
+			m_potentiallyVisible->AddToTail( threat.m_player );
+		}
 
-		potentiallyVisible->AddToTail( player );
+		return true;
+	}
+
+	CUtlVector< CBaseEntity * > *m_potentiallyVisible;
+};
+
+
+//------------------------------------------------------------------------------------------
+void CTFBotVision::CollectPotentiallyVisibleEntities( CUtlVector< CBaseEntity * > *potentiallyVisible )
+{
+	VPROF_BUDGET( "CTFBotVision::CollectPotentiallyVisibleEntities", "NextBot" );
+
+	potentiallyVisible->RemoveAll();
+
+	// include all players we could possibly see from here - anyone beyond our vision range can't be visible.
+	// Vision range spans too many cells for the grid, so this range checks the snapshot of each team.
+	CBaseCombatCharacter *me = GetBot()->GetEntity();
+	const Vector myCenter = me->WorldSpaceCenter();
+	const float range = GetMaxVisionRange() + me->CollisionProp()->BoundingRadius();
+
+	const CTFThreatField &threatField = TheTFThreatField();
+	CollectPlayersInVisionRange collect( potentiallyVisible );
+
+	for( int team=0; team<TF_TEAM_COUNT; ++team )
+	{
+		threatField.ForEachThreatInRadius( team, myCenter, range, collect );
 	}
 
 	// include sentry guns
@@ -8,23 +8,28 @@
 
 #include "NextBotVisionInterface.h"
 
+class CTFBotSquad;
+
 //----------------------------------------------------------------------------
 class CTFBotVision : public IVision
 {
 public:
 	CTFBotVision( INextBot *bot ) : IVision( bot )
 	{
+		m_sightingGeneration = -1;
 	}
 
 	virtual ~CTFBotVision() { }
 
 	virtual void Update( void );								// update internal state
+	virtual bool PrepareSense( void );							// snapshot this tick's line-of-sight queries
 
 	/**
 	 * Populate "potentiallyVisible" with the set of all entities we could potentially see. 
 	 * Entities in this set will be tested for visibility/recognition in IVision::Update()
 	 */
 	virtual void CollectPotentiallyVisibleEntities( CUtlVector< CBaseEntity * > *potentiallyVisible );
+	virtual void CollectSharedVisibleEntities( CUtlVector< CBaseEntity * > *sharedVisible );	// our squad's recent sightings
 
 	virtual bool IsIgnored( CBaseEntity *subject ) const;		// return true to completely ignore this entity (may not be in sight when this is called)
 	virtual bool IsVisibleEntityNoticed( CBaseEntity *subject ) const;		// return true if we 'notice' the subject, even though we have LOS to it
@@ -38,6 +43,9 @@ private:
 	void UpdatePotentiallyVisibleNPCVector( void );
 
 	CountdownTimer m_scanTimer;
+	int m_sightingGeneration;									// the squad's sighting generation when we last took its sightings
+
+	CTFBotSquad *GetSharingSquad( void ) const;
 };
 
 
@@ -8,6 +8,7 @@
 #include "tf_gamerules.h"
 #include "halloween_base_boss.h"
 #include "tf_gamestats.h"
+#include "ilagcompensationmanager.h"
 
 
 //-----------------------------------------------------------------------------------------------------
@@ -43,6 +44,8 @@ void CHalloweenBaseBoss::Spawn( void )
 		TFGameRules()->AddActiveBoss( this );
 	}
 
+	lagcompensation->AddAdditionalEntity( this );
+
 	// track how many players were playing when boss spawned
 	CUtlVector< CTFPlayer * > playerVector;
 	CollectPlayers( &playerVector, TF_TEAM_RED );
@@ -69,6 +72,8 @@ void CHalloweenBaseBoss::UpdateOnRemove()
 		TFGameRules()->RemoveActiveBoss( this );
 	}
 
+	lagcompensation->RemoveAdditionalEntity( this );
+
 	BaseClass::UpdateOnRemove();
 }
 
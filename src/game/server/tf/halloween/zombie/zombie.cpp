@@ -10,6 +10,7 @@
 #include "nav_mesh/tf_nav_area.h"
 #include "NextBot/Path/NextBotChasePath.h"
 #include "particle_parse.h"
+#include "ilagcompensationmanager.h"
 
 #include "zombie.h"
 #include "zombie_behavior/zombie_spawn.h"
@@ -157,6 +158,8 @@ void CZombie::Spawn( void )
 
 	BaseClass::Spawn();
 
+	lagcompensation->AddAdditionalEntity( this );
+
 	const int health = 50;
 	SetHealth( health );
 	SetMaxHealth( health );
@@ -331,6 +334,8 @@ void CZombie::UpdateOnRemove()
 
 	UTIL_Remove( m_hHat );
 
+	lagcompensation->RemoveAdditionalEntity( this );
+
 	BaseClass::UpdateOnRemove();
 }
 
@@ -412,8 +412,19 @@ CTFNavArea::CTFNavArea( void )
 	m_wanderCount = 0;
 	m_combatIntensity = 0.0f;
 	m_distanceToBombTarget = 0.0f;
+	m_clusterID = -1;
+	m_clusterAreaIndex = -1;
 	m_TFMark = 0;
 	m_invasionSearchMarker = (unsigned int)-1;
+
+	for( int i=0; i<TF_TEAM_COUNT; ++i )
+	{
+		m_distanceFromSpawnRoom[i] = -1.0f;
+		m_pendingDistanceFromSpawnRoom[i] = -1.0f;
+		m_incursionParent[i] = NULL;
+		m_isIncursionExpandable[i] = false;
+		m_isIncursionQueued[i] = false;
+	}
 	m_hScriptInstance = NULL;
 }
 
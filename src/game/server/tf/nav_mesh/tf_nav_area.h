@@ -129,6 +129,8 @@ public:
 	// Distance for MvM bomb delivery
 	float GetTravelDistanceToBombTarget( void ) const;
 
+	int GetClusterID( void ) const;								// return the index of the nav cluster this area belongs to, -1 if none
+
 	//- Script access to nav functions ------------------------------------------------------------------
 	DECLARE_ENT_SCRIPTDESC();
 	HSCRIPT GetScriptInstance();
@@ -175,8 +177,15 @@ public:
 
 private:
 	friend class CTFNavMesh;
+	friend class CTFNavClusterGraph;
 
 	float m_distanceFromSpawnRoom[ TF_TEAM_COUNT ];
+
+	// incursion distances being updated by CTFNavMesh, copied to m_distanceFromSpawnRoom once the update is complete
+	float m_pendingDistanceFromSpawnRoom[ TF_TEAM_COUNT ];
+	CTFNavArea *m_incursionParent[ TF_TEAM_COUNT ];			// the area the pending distance was reached from
+	bool m_isIncursionExpandable[ TF_TEAM_COUNT ];			// whether the pending distances pass through this area
+	bool m_isIncursionQueued[ TF_TEAM_COUNT ];
 	CUtlVector< CTFNavArea * > m_invasionAreaVector[ TF_TEAM_COUNT ];	// use our team as index to get list of areas the enemy is invading from
 	unsigned int m_invasionSearchMarker;
 
@@ -196,6 +205,9 @@ private:
 
 	float m_distanceToBombTarget;
 
+	int m_clusterID;						// index of the nav cluster containing this area
+	int m_clusterAreaIndex;					// index of this area within its cluster
+
 	EHANDLE m_hDoor;
 
 	HSCRIPT	m_hScriptInstance;
@@ -349,6 +361,11 @@ inline void CTFNavArea::SetAttributeTF( int flags )
 	m_attributeFlags |= flags;
 }
 
+inline int CTFNavArea::GetClusterID( void ) const
+{
+	return m_clusterID;
+}
+
 inline void CTFNavArea::ClearAttributeTF( int flags )
 {
 	m_attributeFlags &= ~flags;
@@ -0,0 +1,968 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// tf_nav_cluster.cpp
+// Coarse cluster graph over the TF nav mesh for long distance pathing
+
+#include "cbase.h"
+#include "nav_mesh.h"
+#include "nav_ladder.h"
+#include "tf_nav_area.h"
+#include "tf_nav_cluster.h"
+#include "utlbuffer.h"
+#include "utlpriorityqueue.h"
+#include "Path/NextBotPath.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar tf_nav_cluster_max_size( "tf_nav_cluster_max_size", "1500", FCVAR_CHEAT, "Maximum distance from the seed area of a nav cluster to any of its areas" );
+ConVar tf_nav_cluster_max_areas( "tf_nav_cluster_max_areas", "48", FCVAR_CHEAT, "Maximum number of nav areas in a nav cluster" );
+ConVar tf_nav_cluster_path( "tf_nav_cluster_path", "1", FCVAR_CHEAT, "Path to distant goals through the nav clusters, searching the areas of only a few clusters at a time" );
+ConVar tf_nav_cluster_path_min_clusters( "tf_nav_cluster_path_min_clusters", "4", FCVAR_CHEAT, "Only path through the nav clusters if the corridor crosses at least this many clusters" );
+ConVar tf_nav_cluster_path_min_range( "tf_nav_cluster_path_min_range", "2500", FCVAR_CHEAT, "Only path through the nav clusters if the goal is at least this far away in a straight line" );
+ConVar tf_nav_cluster_refine_count( "tf_nav_cluster_refine_count", "3", FCVAR_CHEAT, "How many clusters along the corridor to search the areas of at a time" );
+ConVar tf_nav_cluster_draw( "tf_nav_cluster_draw", "0", FCVAR_CHEAT, "Draw nav clusters and the links between their portal areas" );
+
+
+//-------------------------------------------------------------------------
+/**
+ * Invoke functor( CTFNavArea *adjArea, float length ) for each area directly reachable
+ * from the given area, following the same connections as NavAreaBuildPath()
+ */
+template < typename Functor >
+static void ForEachAreaConnection( const CTFNavArea *area, Functor &func )
+{
+	for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+	{
+		const NavConnectVector *adjVector = area->GetAdjacentAreas( (NavDirType)dir );
+		FOR_EACH_VEC( (*adjVector), i )
+		{
+			const NavConnect &connect = adjVector->Element( i );
+			float length = ( connect.length > 0.0f ) ? connect.length : ( connect.area->GetCenter() - area->GetCenter() ).Length();
+
+			func( static_cast< CTFNavArea * >( connect.area ), length );
+		}
+	}
+
+	const NavLadderConnectVector *upVector = area->GetLadders( CNavLadder::LADDER_UP );
+	FOR_EACH_VEC( (*upVector), i )
+	{
+		const CNavLadder *ladder = upVector->Element( i ).ladder;
+
+		// do not use BEHIND connection, as its very hard to get to when going up a ladder
+		CNavArea *topArea[] = { ladder->m_topForwardArea, ladder->m_topLeftArea, ladder->m_topRightArea };
+		for( int t=0; t<ARRAYSIZE( topArea ); ++t )
+		{
+			if ( topArea[t] )
+			{
+				func( static_cast< CTFNavArea * >( topArea[t] ), ladder->m_length );
+			}
+		}
+	}
+
+	const NavLadderConnectVector *downVector = area->GetLadders( CNavLadder::LADDER_DOWN );
+	FOR_EACH_VEC( (*downVector), i )
+	{
+		const CNavLadder *ladder = downVector->Element( i ).ladder;
+		if ( ladder->m_bottomArea )
+		{
+			func( static_cast< CTFNavArea * >( ladder->m_bottomArea ), ladder->m_length );
+		}
+	}
+
+	if ( area->GetElevator() )
+	{
+		const NavConnectVector &elevatorVector = area->GetElevatorAreas();
+		FOR_EACH_VEC( elevatorVector, i )
+		{
+			CNavArea *elevatorArea = elevatorVector[i].area;
+			func( static_cast< CTFNavArea * >( elevatorArea ), ( elevatorArea->GetCenter() - area->GetCenter() ).Length() );
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------
+CTFNavClusterGraph::CTFNavClusterGraph( void )
+{
+	m_navAreaCount = 0;
+	m_isBound = false;
+	m_isDirty = false;
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavClusterGraph::Reset( void )
+{
+	m_portalVector.Purge();
+	m_clusterVector.Purge();
+	m_portalTable.Purge();
+
+	m_navAreaCount = 0;
+	m_isBound = false;
+	m_isDirty = false;
+
+	m_loadedAreaID.Purge();
+	m_loadedAreaCluster.Purge();
+	m_loadedPortalDistance.Purge();
+	m_loadedPortalID.Purge();
+	m_loadedClusterPortalCount.Purge();
+}
+
+
+//-------------------------------------------------------------------------
+bool CTFNavClusterGraph::IsValid( void ) const
+{
+	return m_isBound && !m_isDirty;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Build or bind the cluster data if the mesh has changed since it was last built
+ */
+void CTFNavClusterGraph::Update( void )
+{
+	if ( IsValid() || TheNavAreas.Count() == 0 )
+		return;
+
+	// data loaded with the mesh is stale once the mesh has been edited
+	if ( !m_isDirty && m_loadedAreaID.Count() > 0 && Bind() )
+		return;
+
+	Build();
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Partition the current mesh into clusters
+ */
+void CTFNavClusterGraph::Build( void )
+{
+	VPROF_BUDGET( "CTFNavClusterGraph::Build", "NextBot" );
+
+	Reset();
+
+	AssignClusters();
+	BuildPortals();
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		ComputePortalDistances( c );
+	}
+
+	m_navAreaCount = TheNavAreas.Count();
+	m_isBound = true;
+
+	DevMsg( "Nav mesh divided into %d clusters with %d portal areas\n", m_clusterVector.Count(), m_portalVector.Count() );
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Grow each cluster breadth-first from an unassigned seed area until it
+ * reaches the maximum size or area count
+ */
+void CTFNavClusterGraph::AssignClusters( void )
+{
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+		area->m_clusterID = -1;
+		area->m_clusterAreaIndex = -1;
+	}
+
+	const float maxRangeSq = tf_nav_cluster_max_size.GetFloat() * tf_nav_cluster_max_size.GetFloat();
+	const int maxAreaCount = MAX( tf_nav_cluster_max_areas.GetInt(), 1 );
+
+	struct GrowCluster
+	{
+		GrowCluster( Cluster *cluster, int clusterID, const Vector &seedPos, float maxRangeSq, int maxAreaCount )
+		{
+			m_cluster = cluster;
+			m_clusterID = clusterID;
+			m_seedPos = seedPos;
+			m_maxRangeSq = maxRangeSq;
+			m_maxAreaCount = maxAreaCount;
+		}
+
+		void Add( CTFNavArea *area )
+		{
+			area->m_clusterID = m_clusterID;
+			area->m_clusterAreaIndex = m_cluster->m_areaVector.AddToTail( area );
+		}
+
+		void operator() ( CTFNavArea *adjArea, float length )
+		{
+			if ( adjArea->m_clusterID >= 0 || m_cluster->m_areaVector.Count() >= m_maxAreaCount )
+				return;
+
+			if ( ( adjArea->GetCenter() - m_seedPos ).LengthSqr() > m_maxRangeSq )
+				return;
+
+			Add( adjArea );
+		}
+
+		Cluster *m_cluster;
+		int m_clusterID;
+		Vector m_seedPos;
+		float m_maxRangeSq;
+		int m_maxAreaCount;
+	};
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CTFNavArea *seedArea = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+
+		if ( seedArea->m_clusterID >= 0 )
+			continue;
+
+		int clusterID = m_clusterVector.AddToTail();
+		Cluster *cluster = &m_clusterVector[ clusterID ];
+
+		GrowCluster grow( cluster, clusterID, seedArea->GetCenter(), maxRangeSq, maxAreaCount );
+		grow.Add( seedArea );
+
+		// the area vector doubles as the breadth-first queue
+		for( int i=0; i<cluster->m_areaVector.Count() && cluster->m_areaVector.Count() < maxAreaCount; ++i )
+		{
+			ForEachAreaConnection( cluster->m_areaVector[i], grow );
+		}
+	}
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		Cluster &cluster = m_clusterVector[c];
+
+		cluster.m_center = vec3_origin;
+		for( int i=0; i<cluster.m_areaVector.Count(); ++i )
+		{
+			cluster.m_center += cluster.m_areaVector[i]->GetCenter();
+		}
+		cluster.m_center /= (float)cluster.m_areaVector.Count();
+	}
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Every area with a connection into a different cluster is a portal,
+ * and the connection becomes a link between the two portals
+ */
+void CTFNavClusterGraph::BuildPortals( void )
+{
+	m_portalVector.RemoveAll();
+	m_portalTable.RemoveAll();
+
+	struct AddLinks
+	{
+		AddLinks( CTFNavClusterGraph *graph )
+		{
+			m_graph = graph;
+			m_area = NULL;
+		}
+
+		int AddPortal( CTFNavArea *area )
+		{
+			UtlHashHandle_t h = m_graph->m_portalTable.Find( area );
+			if ( h != m_graph->m_portalTable.InvalidHandle() )
+				return m_graph->m_portalTable.Element( h );
+
+			int p = m_graph->m_portalVector.AddToTail();
+			Portal &portal = m_graph->m_portalVector[p];
+			portal.m_area = area;
+			portal.m_cluster = area->m_clusterID;
+			portal.m_localIndex = m_graph->m_clusterVector[ area->m_clusterID ].m_portalVector.AddToTail( p );
+
+			m_graph->m_portalTable.Insert( area, p );
+
+			return p;
+		}
+
+		void operator() ( CTFNavArea *adjArea, float length )
+		{
+			if ( adjArea->m_clusterID < 0 || adjArea->m_clusterID == m_area->m_clusterID )
+				return;
+
+			int from = AddPortal( m_area );
+			int to = AddPortal( adjArea );
+
+			PortalLink link;
+			link.m_portal = to;
+			link.m_length = length;
+			m_graph->m_portalVector[ from ].m_linkVector.AddToTail( link );
+
+			CUtlVector< int > &adjacentClusterVector = m_graph->m_clusterVector[ m_area->m_clusterID ].m_adjacentClusterVector;
+			if ( !adjacentClusterVector.HasElement( adjArea->m_clusterID ) )
+			{
+				adjacentClusterVector.AddToTail( adjArea->m_clusterID );
+			}
+		}
+
+		CTFNavClusterGraph *m_graph;
+		CTFNavArea *m_area;
+	};
+
+	AddLinks addLinks( this );
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		m_clusterVector[c].m_portalVector.RemoveAll();
+		m_clusterVector[c].m_adjacentClusterVector.RemoveAll();
+	}
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		const Cluster &cluster = m_clusterVector[c];
+
+		for( int i=0; i<cluster.m_areaVector.Count(); ++i )
+		{
+			addLinks.m_area = cluster.m_areaVector[i];
+			ForEachAreaConnection( addLinks.m_area, addLinks );
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Compute the travel distances within the given cluster between each pair of its portals
+ */
+void CTFNavClusterGraph::ComputePortalDistances( int c )
+{
+	Cluster &cluster = m_clusterVector[c];
+	const int portalCount = cluster.m_portalVector.Count();
+
+	cluster.m_portalDistance.SetCount( portalCount * portalCount );
+
+	CUtlVector< float > distanceVector;
+	for( int from=0; from<portalCount; ++from )
+	{
+		ComputeDistancesInCluster( m_portalVector[ cluster.m_portalVector[ from ] ].m_area, &distanceVector );
+
+		for( int to=0; to<portalCount; ++to )
+		{
+			const CTFNavArea *toArea = m_portalVector[ cluster.m_portalVector[ to ] ].m_area;
+			cluster.m_portalDistance[ from * portalCount + to ] = distanceVector[ toArea->m_clusterAreaIndex ];
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Travel distances from 'sourceArea' to every area in its cluster, staying inside the cluster.
+ * Clusters are small, so a simple O(N^2) Dijkstra is fine.
+ */
+void CTFNavClusterGraph::ComputeDistancesInCluster( const CTFNavArea *sourceArea, CUtlVector< float > *distanceVector ) const
+{
+	const Cluster &cluster = m_clusterVector[ sourceArea->m_clusterID ];
+	const int areaCount = cluster.m_areaVector.Count();
+
+	distanceVector->SetCount( areaCount );
+
+	CUtlVector< bool > isDone;
+	isDone.SetCount( areaCount );
+
+	for( int i=0; i<areaCount; ++i )
+	{
+		distanceVector->Element( i ) = -1.0f;
+		isDone[i] = false;
+	}
+
+	distanceVector->Element( sourceArea->m_clusterAreaIndex ) = 0.0f;
+
+	struct Relax
+	{
+		void operator() ( CTFNavArea *adjArea, float length )
+		{
+			if ( adjArea->m_clusterID != m_clusterID )
+				return;
+
+			float &adjDistance = m_distanceVector->Element( adjArea->m_clusterAreaIndex );
+			if ( adjDistance < 0.0f || m_distance + length < adjDistance )
+			{
+				adjDistance = m_distance + length;
+			}
+		}
+
+		CUtlVector< float > *m_distanceVector;
+		int m_clusterID;
+		float m_distance;
+	};
+
+	Relax relax;
+	relax.m_distanceVector = distanceVector;
+	relax.m_clusterID = sourceArea->m_clusterID;
+
+	while( true )
+	{
+		int closest = -1;
+		for( int i=0; i<areaCount; ++i )
+		{
+			if ( !isDone[i] && distanceVector->Element( i ) >= 0.0f )
+			{
+				if ( closest < 0 || distanceVector->Element( i ) < distanceVector->Element( closest ) )
+				{
+					closest = i;
+				}
+			}
+		}
+
+		if ( closest < 0 )
+			break;
+
+		isDone[ closest ] = true;
+		relax.m_distance = distanceVector->Element( closest );
+		ForEachAreaConnection( cluster.m_areaVector[ closest ], relax );
+	}
+}
+
+
+//-------------------------------------------------------------------------
+int CTFNavClusterGraph::GetPortal( const CNavArea *area ) const
+{
+	UtlHashHandle_t h = m_portalTable.Find( area );
+	return ( h == m_portalTable.InvalidHandle() ) ? -1 : m_portalTable.Element( h );
+}
+
+
+//-------------------------------------------------------------------------
+struct PortalOpenEntry
+{
+	float m_totalCost;
+	int m_node;
+};
+
+static bool IsLowerPriorityPortal( const PortalOpenEntry &lhs, const PortalOpenEntry &rhs )
+{
+	// the priority queue keeps the greatest priority at its head, and we want the least cost there
+	return lhs.m_totalCost > rhs.m_totalCost;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Find the sequence of clusters to travel through from the start area to the goal area,
+ * using an A* search over the portal areas.
+ * Distances from the portals to the goal are approximated by the distances from the goal to the portals.
+ */
+bool CTFNavClusterGraph::ComputeCorridor( CNavArea *startArea, CNavArea *goalArea, int teamID, CUtlVector< CorridorStep > *corridor ) const
+{
+	VPROF_BUDGET( "CTFNavClusterGraph::ComputeCorridor", "NextBot" );
+
+	corridor->RemoveAll();
+
+	if ( !IsValid() || !startArea || !goalArea )
+		return false;
+
+	CTFNavArea *start = static_cast< CTFNavArea * >( startArea );
+	CTFNavArea *goal = static_cast< CTFNavArea * >( goalArea );
+
+	if ( start->m_clusterID < 0 || goal->m_clusterID < 0 || start->m_clusterID == goal->m_clusterID )
+		return false;
+
+	CUtlVector< float > startDistance, goalDistance;
+	ComputeDistancesInCluster( start, &startDistance );
+	ComputeDistancesInCluster( goal, &goalDistance );
+
+	// nodes are the portals, plus one for the goal area
+	const int portalCount = m_portalVector.Count();
+	const int goalNode = portalCount;
+
+	CUtlVector< float > costSoFar;
+	CUtlVector< int > parent;
+	CUtlVector< bool > isClosed;
+	costSoFar.SetCount( portalCount + 1 );
+	parent.SetCount( portalCount + 1 );
+	isClosed.SetCount( portalCount + 1 );
+
+	for( int i=0; i<=portalCount; ++i )
+	{
+		costSoFar[i] = -1.0f;
+		parent[i] = -1;
+		isClosed[i] = false;
+	}
+
+	CUtlPriorityQueue< PortalOpenEntry > openList( 0, 0, IsLowerPriorityPortal );
+	const Vector &goalPos = goal->GetCenter();
+
+	// relax a node, adding it to the open list if its cost improved
+	struct Visit
+	{
+		void operator() ( int node, int fromNode, float cost, const Vector &nodePos )
+		{
+			if ( m_costSoFar->Element( node ) >= 0.0f && m_costSoFar->Element( node ) <= cost )
+				return;
+
+			m_costSoFar->Element( node ) = cost;
+			m_parent->Element( node ) = fromNode;
+
+			PortalOpenEntry entry;
+			entry.m_totalCost = cost + ( nodePos - m_goalPos ).Length();
+			entry.m_node = node;
+			m_openList->Insert( entry );
+		}
+
+		CUtlVector< float > *m_costSoFar;
+		CUtlVector< int > *m_parent;
+		CUtlPriorityQueue< PortalOpenEntry > *m_openList;
+		Vector m_goalPos;
+	};
+
+	Visit visit;
+	visit.m_costSoFar = &costSoFar;
+	visit.m_parent = &parent;
+	visit.m_openList = &openList;
+	visit.m_goalPos = goalPos;
+
+	// seed the search with the portals reachable from the start area within its cluster
+	const Cluster &startCluster = m_clusterVector[ start->m_clusterID ];
+	for( int i=0; i<startCluster.m_portalVector.Count(); ++i )
+	{
+		const Portal &portal = m_portalVector[ startCluster.m_portalVector[i] ];
+		float distance = startDistance[ portal.m_area->m_clusterAreaIndex ];
+		if ( distance >= 0.0f )
+		{
+			visit( startCluster.m_portalVector[i], -1, distance, portal.m_area->GetCenter() );
+		}
+	}
+
+	while( openList.Count() )
+	{
+		PortalOpenEntry entry = openList.ElementAtHead();
+		openList.RemoveAtHead();
+
+		if ( isClosed[ entry.m_node ] )
+			continue;
+
+		isClosed[ entry.m_node ] = true;
+
+		if ( entry.m_node == goalNode )
+			break;
+
+		const Portal &portal = m_portalVector[ entry.m_node ];
+
+		if ( portal.m_area->IsBlocked( teamID ) )
+			continue;
+
+		const float cost = costSoFar[ entry.m_node ];
+		const Cluster &cluster = m_clusterVector[ portal.m_cluster ];
+
+		// reach the goal itself from within its cluster
+		if ( portal.m_cluster == goal->m_clusterID )
+		{
+			float distance = goalDistance[ portal.m_area->m_clusterAreaIndex ];
+			if ( distance >= 0.0f )
+			{
+				visit( goalNode, entry.m_node, cost + distance, goalPos );
+			}
+		}
+
+		// cross into adjacent clusters
+		for( int i=0; i<portal.m_linkVector.Count(); ++i )
+		{
+			const PortalLink &link = portal.m_linkVector[i];
+			if ( !isClosed[ link.m_portal ] )
+			{
+				visit( link.m_portal, entry.m_node, cost + link.m_length, m_portalVector[ link.m_portal ].m_area->GetCenter() );
+			}
+		}
+
+		// travel to the other portals of this cluster
+		for( int i=0; i<cluster.m_portalVector.Count(); ++i )
+		{
+			int other = cluster.m_portalVector[i];
+			if ( other == entry.m_node || isClosed[ other ] )
+				continue;
+
+			float distance = cluster.GetPortalDistance( portal.m_localIndex, i );
+			if ( distance >= 0.0f )
+			{
+				visit( other, entry.m_node, cost + distance, m_portalVector[ other ].m_area->GetCenter() );
+			}
+		}
+	}
+
+	if ( !isClosed[ goalNode ] )
+		return false;
+
+	// walk back from the goal to collect the portal chain
+	CUtlVector< int > portalChain;
+	for( int node = parent[ goalNode ]; node >= 0; node = parent[ node ] )
+	{
+		portalChain.AddToHead( node );
+	}
+
+	CorridorStep step;
+	step.m_cluster = start->m_clusterID;
+	step.m_entryArea = start;
+	corridor->AddToTail( step );
+
+	for( int i=0; i<portalChain.Count(); ++i )
+	{
+		const Portal &portal = m_portalVector[ portalChain[i] ];
+		if ( portal.m_cluster != corridor->Tail().m_cluster )
+		{
+			step.m_cluster = portal.m_cluster;
+			step.m_entryArea = portal.m_area;
+			corridor->AddToTail( step );
+		}
+	}
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Only allow a search to enter areas in a set of clusters
+ */
+class CTFNavClusterFilter : public IPathSearchFilter
+{
+public:
+	virtual bool IsAllowed( const CNavArea *area ) const
+	{
+		return m_clusterVector.HasElement( static_cast< const CTFNavArea * >( area )->GetClusterID() );
+	}
+
+	CUtlVector< int > m_clusterVector;
+};
+
+
+//-------------------------------------------------------------------------
+/**
+ * Reject the areas ComputePath() would, without searching
+ */
+bool CTFNavClusterGraph::IsPathWorthwhile( const CNavArea *startArea, const CNavArea *goalArea ) const
+{
+	if ( !tf_nav_cluster_path.GetBool() || !IsValid() || !startArea || !goalArea )
+		return false;
+
+	const CTFNavArea *start = static_cast< const CTFNavArea * >( startArea );
+	const CTFNavArea *goal = static_cast< const CTFNavArea * >( goalArea );
+
+	if ( start->m_clusterID < 0 || goal->m_clusterID < 0 || start->m_clusterID == goal->m_clusterID )
+		return false;
+
+	// the corridor to an adjacent cluster is two clusters long
+	if ( tf_nav_cluster_path_min_clusters.GetInt() > 2 && m_clusterVector[ start->m_clusterID ].m_adjacentClusterVector.HasElement( goal->m_clusterID ) )
+		return false;
+
+	if ( ( goal->GetCenter() - start->GetCenter() ).IsLengthLessThan( tf_nav_cluster_path_min_range.GetFloat() ) )
+		return false;
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * If the goal is several clusters away, search the areas of the first few clusters along the corridor to it
+ */
+bool CTFNavClusterGraph::ComputePath( CNavArea *startArea, CNavArea *goalArea, const IPathCost &costFunc, int teamID, CUtlVector< NavPathArea > *areaVector, bool *reachesGoal ) const
+{
+	VPROF_BUDGET( "CTFNavClusterGraph::ComputePath", "NextBot" );
+
+	if ( !IsPathWorthwhile( startArea, goalArea ) )
+		return false;
+
+	CUtlVector< CorridorStep > corridor;
+	if ( !ComputeCorridor( startArea, goalArea, teamID, &corridor ) )
+		return false;
+
+	if ( corridor.Count() < tf_nav_cluster_path_min_clusters.GetInt() )
+		return false;
+
+	// search the first few clusters, heading for the area where the corridor enters the next one
+	int refineCount = MAX( tf_nav_cluster_refine_count.GetInt(), 1 );
+
+	CTFNavClusterFilter filter;
+	CNavArea *targetArea;
+
+	if ( refineCount >= corridor.Count() - 1 )
+	{
+		refineCount = corridor.Count();
+		targetArea = goalArea;
+	}
+	else
+	{
+		targetArea = corridor[ refineCount ].m_entryArea;
+
+		// allow the target area's cluster so the search can enter it
+		++refineCount;
+	}
+
+	for( int i=0; i<refineCount; ++i )
+	{
+		filter.m_clusterVector.AddToTail( corridor[i].m_cluster );
+	}
+
+	NextBotPathSearch search;
+	search.SetFilter( &filter );
+	search.Begin( startArea, targetArea, targetArea->GetCenter(), costFunc, teamID );
+	search.Step( costFunc );
+
+	if ( search.GetStatus() != NextBotPathSearch::SEARCH_SUCCEEDED )
+	{
+		// the corridor doesn't hold up at the area level - let the caller search the whole mesh
+		return false;
+	}
+
+	search.BuildAreaPath( areaVector );
+	*reachesGoal = ( targetArea == goalArea );
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Store the cluster data in the nav file:
+ *   cluster count
+ *   area count, followed by ( area ID, cluster ) for each area in cluster order
+ *   for each cluster: portal count, portal area IDs, and the portal distance matrix
+ */
+void CTFNavClusterGraph::Save( CUtlBuffer &fileBuffer ) const
+{
+	if ( !IsValid() )
+	{
+		fileBuffer.PutInt( 0 );
+		fileBuffer.PutInt( 0 );
+		return;
+	}
+
+	fileBuffer.PutInt( m_clusterVector.Count() );
+
+	fileBuffer.PutInt( m_navAreaCount );
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		const Cluster &cluster = m_clusterVector[c];
+		for( int i=0; i<cluster.m_areaVector.Count(); ++i )
+		{
+			fileBuffer.PutUnsignedInt( cluster.m_areaVector[i]->GetID() );
+			fileBuffer.PutInt( c );
+		}
+	}
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		const Cluster &cluster = m_clusterVector[c];
+
+		fileBuffer.PutInt( cluster.m_portalVector.Count() );
+		for( int i=0; i<cluster.m_portalVector.Count(); ++i )
+		{
+			fileBuffer.PutUnsignedInt( m_portalVector[ cluster.m_portalVector[i] ].m_area->GetID() );
+		}
+
+		for( int i=0; i<cluster.m_portalDistance.Count(); ++i )
+		{
+			fileBuffer.PutFloat( cluster.m_portalDistance[i] );
+		}
+	}
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Load the cluster data from the nav file. The areas have not been bound yet,
+ * so the data is kept by area ID until the next Update().
+ */
+void CTFNavClusterGraph::Load( CUtlBuffer &fileBuffer )
+{
+	Reset();
+
+	int clusterCount = fileBuffer.GetInt();
+	int areaCount = fileBuffer.GetInt();
+
+	if ( !fileBuffer.IsValid() || clusterCount < 0 || areaCount < 0 || clusterCount > areaCount )
+	{
+		Warning( "Nav cluster data is corrupt\n" );
+		Reset();
+		return;
+	}
+
+	if ( areaCount != TheNavAreas.Count() )
+	{
+		// stale data from a different mesh - it will be rebuilt after the mesh has loaded
+		Reset();
+		return;
+	}
+
+	m_loadedAreaID.EnsureCapacity( areaCount );
+	m_loadedAreaCluster.EnsureCapacity( areaCount );
+	for( int i=0; i<areaCount; ++i )
+	{
+		m_loadedAreaID.AddToTail( fileBuffer.GetUnsignedInt() );
+		m_loadedAreaCluster.AddToTail( fileBuffer.GetInt() );
+	}
+
+	for( int c=0; c<clusterCount; ++c )
+	{
+		int portalCount = fileBuffer.GetInt();
+		if ( !fileBuffer.IsValid() || portalCount < 0 || portalCount > areaCount )
+		{
+			Warning( "Nav cluster data is corrupt\n" );
+			Reset();
+			return;
+		}
+
+		m_loadedClusterPortalCount.AddToTail( portalCount );
+
+		for( int i=0; i<portalCount; ++i )
+		{
+			m_loadedPortalID.AddToTail( fileBuffer.GetUnsignedInt() );
+		}
+
+		for( int i=0; i<portalCount * portalCount; ++i )
+		{
+			m_loadedPortalDistance.AddToTail( fileBuffer.GetFloat() );
+		}
+	}
+
+	if ( !fileBuffer.IsValid() )
+	{
+		Warning( "Nav cluster data is corrupt\n" );
+		Reset();
+	}
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Resolve the loaded area IDs into areas, and use the loaded portal distances for each
+ * cluster whose portals still match the mesh. Return false if the data doesn't fit the mesh.
+ */
+bool CTFNavClusterGraph::Bind( void )
+{
+	CUtlVector< unsigned int > loadedAreaID, loadedPortalID;
+	CUtlVector< int > loadedAreaCluster, loadedClusterPortalCount;
+	CUtlVector< float > loadedPortalDistance;
+
+	loadedAreaID.Swap( m_loadedAreaID );
+	loadedAreaCluster.Swap( m_loadedAreaCluster );
+	loadedPortalID.Swap( m_loadedPortalID );
+	loadedClusterPortalCount.Swap( m_loadedClusterPortalCount );
+	loadedPortalDistance.Swap( m_loadedPortalDistance );
+
+	Reset();
+
+	if ( loadedAreaID.Count() != TheNavAreas.Count() )
+		return false;
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+		area->m_clusterID = -1;
+		area->m_clusterAreaIndex = -1;
+	}
+
+	m_clusterVector.SetCount( loadedClusterPortalCount.Count() );
+
+	for( int i=0; i<loadedAreaID.Count(); ++i )
+	{
+		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavMesh->GetNavAreaByID( loadedAreaID[i] ) );
+		int c = loadedAreaCluster[i];
+
+		if ( !area || area->m_clusterID >= 0 || !m_clusterVector.IsValidIndex( c ) )
+			return false;
+
+		area->m_clusterID = c;
+		area->m_clusterAreaIndex = m_clusterVector[c].m_areaVector.AddToTail( area );
+	}
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		Cluster &cluster = m_clusterVector[c];
+
+		if ( cluster.m_areaVector.Count() == 0 )
+			return false;
+
+		cluster.m_center = vec3_origin;
+		for( int i=0; i<cluster.m_areaVector.Count(); ++i )
+		{
+			cluster.m_center += cluster.m_areaVector[i]->GetCenter();
+		}
+		cluster.m_center /= (float)cluster.m_areaVector.Count();
+	}
+
+	// portals follow from the connections, so rebuild them and keep the stored distances where they still apply
+	BuildPortals();
+
+	int portalOffset = 0;
+	int distanceOffset = 0;
+	int recomputeCount = 0;
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		Cluster &cluster = m_clusterVector[c];
+		const int loadedCount = loadedClusterPortalCount[c];
+
+		bool isMatch = ( loadedCount == cluster.m_portalVector.Count() );
+		for( int i=0; isMatch && i<loadedCount; ++i )
+		{
+			isMatch = ( m_portalVector[ cluster.m_portalVector[i] ].m_area->GetID() == loadedPortalID[ portalOffset + i ] );
+		}
+
+		if ( isMatch )
+		{
+			cluster.m_portalDistance.CopyArray( loadedPortalDistance.Base() + distanceOffset, loadedCount * loadedCount );
+		}
+		else
+		{
+			ComputePortalDistances( c );
+			++recomputeCount;
+		}
+
+		portalOffset += loadedCount;
+		distanceOffset += loadedCount * loadedCount;
+	}
+
+	m_navAreaCount = TheNavAreas.Count();
+	m_isBound = true;
+
+	if ( recomputeCount > 0 )
+	{
+		DevMsg( "Nav cluster data: recomputed portal distances for %d of %d clusters\n", recomputeCount, m_clusterVector.Count() );
+	}
+
+	return true;
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Draw clusters and the links between their portal areas
+ */
+void CTFNavClusterGraph::Draw( void ) const
+{
+	if ( !IsValid() )
+		return;
+
+	for( int c=0; c<m_clusterVector.Count(); ++c )
+	{
+		const Cluster &cluster = m_clusterVector[c];
+
+		// spread neighboring cluster indices across the color wheel
+		int r = ( c * 97 ) % 200 + 55;
+		int g = ( c * 151 ) % 200 + 55;
+		int b = ( c * 211 ) % 200 + 55;
+
+		for( int i=0; i<cluster.m_areaVector.Count(); ++i )
+		{
+			cluster.m_areaVector[i]->DrawFilled( r, g, b, 100, NDEBUG_PERSIST_TILL_NEXT_SERVER );
+		}
+
+		NDebugOverlay::Text( cluster.m_center, CFmtStr( "%d", c ), false, NDEBUG_PERSIST_TILL_NEXT_SERVER );
+	}
+
+	for( int p=0; p<m_portalVector.Count(); ++p )
+	{
+		const Portal &portal = m_portalVector[p];
+		for( int i=0; i<portal.m_linkVector.Count(); ++i )
+		{
+			const Portal &to = m_portalVector[ portal.m_linkVector[i].m_portal ];
+			NDebugOverlay::HorzArrow( portal.m_area->GetCenter(), to.m_area->GetCenter(), 3.0f, 255, 255, 0, 255, true, NDEBUG_PERSIST_TILL_NEXT_SERVER );
+		}
+	}
+}
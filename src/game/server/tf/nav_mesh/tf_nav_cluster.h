@@ -0,0 +1,126 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// tf_nav_cluster.h
+// Coarse cluster graph over the TF nav mesh for long distance pathing
+
+#ifndef TF_NAV_CLUSTER_H
+#define TF_NAV_CLUSTER_H
+
+#include "utlhashtable.h"
+
+class CNavArea;
+class CTFNavArea;
+class CUtlBuffer;
+class IPathCost;
+struct NavPathArea;
+
+
+//-------------------------------------------------------------------------
+/**
+ * The nav mesh divided into clusters of nearby, connected areas. Connections between
+ * clusters pass through "portal" areas on their borders, and the travel distance between
+ * each pair of portals in a cluster is precomputed.
+ *
+ * A search over the portals finds a corridor of clusters between two distant areas while
+ * touching only a few hundred nodes. The area-level path is then refined a few clusters at
+ * a time, with the search restricted to the corridor.
+ */
+class CTFNavClusterGraph
+{
+public:
+	CTFNavClusterGraph( void );
+
+	void Build( void );										// partition the current mesh into clusters
+	void Reset( void );										// discard all cluster data
+	void Update( void );									// build or bind cluster data if the mesh has changed
+	void MarkDirty( void )									{ m_isDirty = true; }	// the mesh has been edited - rebuild on the next Update()
+
+	bool IsValid( void ) const;								// true if the cluster data matches the current mesh
+	int GetClusterCount( void ) const						{ return m_clusterVector.Count(); }
+
+	void Save( CUtlBuffer &fileBuffer ) const;
+	void Load( CUtlBuffer &fileBuffer );					// areas are bound by ID on the next Update(), once the mesh has finished loading
+
+	// one step along a corridor, entering the given cluster at the given area
+	struct CorridorStep
+	{
+		int m_cluster;
+		CTFNavArea *m_entryArea;
+	};
+
+	/**
+	 * Find the sequence of clusters to travel through from the start area to the goal area.
+	 * The first step is the start area's cluster and the last step is the goal area's cluster.
+	 * Returns false if the areas are in the same cluster or no corridor exists.
+	 */
+	bool ComputeCorridor( CNavArea *startArea, CNavArea *goalArea, int teamID, CUtlVector< CorridorStep > *corridor ) const;
+
+	/**
+	 * If the goal is several clusters away, search the areas of the first few clusters along the corridor to it.
+	 * Fill in 'areaVector' with the areas from the start to either the goal or the entry area of the next
+	 * cluster of the corridor, and set 'reachesGoal' accordingly. Return false if the corridor can't be used.
+	 */
+	bool ComputePath( CNavArea *startArea, CNavArea *goalArea, const IPathCost &costFunc, int teamID, CUtlVector< NavPathArea > *areaVector, bool *reachesGoal ) const;
+
+	/**
+	 * Return false if ComputePath() would reject these areas anyway: the corridor is turned off, the
+	 * areas are in the same or adjacent clusters, or the goal is close. This is cheap, so callers use
+	 * it to skip the corridor search, and copying their cost function for it, on short paths.
+	 */
+	bool IsPathWorthwhile( const CNavArea *startArea, const CNavArea *goalArea ) const;
+
+	void Draw( void ) const;								// draw clusters and portals for debugging
+
+private:
+	struct PortalLink
+	{
+		int m_portal;										// portal in the adjacent cluster
+		float m_length;
+	};
+
+	struct Portal
+	{
+		CTFNavArea *m_area;
+		int m_cluster;
+		int m_localIndex;									// index of this portal within its cluster
+		CUtlVector< PortalLink > m_linkVector;
+	};
+	CUtlVector< Portal > m_portalVector;
+
+	struct Cluster
+	{
+		CUtlVector< CTFNavArea * > m_areaVector;
+		CUtlVector< int > m_portalVector;					// indices into CTFNavClusterGraph::m_portalVector
+		CUtlVector< float > m_portalDistance;				// portal count squared travel distances between this cluster's portals, -1 if unreachable within the cluster
+		CUtlVector< int > m_adjacentClusterVector;			// clusters one of our portals links to
+		Vector m_center;
+
+		float GetPortalDistance( int from, int to ) const	{ return m_portalDistance[ from * m_portalVector.Count() + to ]; }
+	};
+	CUtlVector< Cluster > m_clusterVector;
+
+	CUtlHashtable< const void *, int, PointerHashFunctor, PointerEqualFunctor > m_portalTable;	// area -> index into m_portalVector
+
+	void AssignClusters( void );
+	void BuildPortals( void );
+	void ComputePortalDistances( int cluster );
+
+	// travel distances from 'sourceArea' to every area in its cluster, in cluster area order
+	void ComputeDistancesInCluster( const CTFNavArea *sourceArea, CUtlVector< float > *distanceVector ) const;
+
+	int GetPortal( const CNavArea *area ) const;
+
+	int m_navAreaCount;										// the size of the mesh the clusters were built for
+	bool m_isBound;
+	bool m_isDirty;											// the mesh has been edited since the clusters were built or loaded
+
+	// data loaded from the nav file, waiting to be bound to the areas
+	CUtlVector< unsigned int > m_loadedAreaID;
+	CUtlVector< int > m_loadedAreaCluster;
+	CUtlVector< float > m_loadedPortalDistance;
+	CUtlVector< unsigned int > m_loadedPortalID;
+	CUtlVector< int > m_loadedClusterPortalCount;
+	bool Bind( void );
+};
+
+
+#endif // TF_NAV_CLUSTER_H
@@ -17,6 +17,7 @@
 #include "props.h"
 #include "filters.h"
 #include "NextBotUtil.h"
+#include "Path/NextBotPathSearch.h"
 #include "doors.h"
 #include "props.h"
 #include "BasePropDoor.h"
@@ -29,10 +30,14 @@ ConVar tf_show_blocked_areas( "tf_show_blocked_areas", "0", FCVAR_CHEAT, "Highli
 ConVar tf_show_incursion_flow( "tf_show_incursion_flow", "0", FCVAR_CHEAT );
 ConVar tf_show_incursion_flow_range( "tf_show_incursion_flow_range", "150", FCVAR_CHEAT, "1 = red, 2 = blue" );
 ConVar tf_show_incursion_flow_gradient( "tf_show_incursion_flow_gradient", "0", FCVAR_CHEAT, "1 = red, 2 = blue" );
+ConVar tf_nav_incursion_update_budget( "tf_nav_incursion_update_budget", "0", FCVAR_CHEAT, "Maximum number of areas the incursion distance update expands per frame (0 = no limit). Bots use the previous distances until the update is complete." );
+ConVar tf_nav_invasion_update_budget( "tf_nav_invasion_update_budget", "0", FCVAR_CHEAT, "Maximum number of areas whose invasion areas are recomputed per frame (0 = no limit)" );
 ConVar tf_show_mesh_decoration( "tf_show_mesh_decoration", "0", FCVAR_CHEAT, "Highlight special areas" );
 ConVar tf_show_mesh_decoration_manual( "tf_show_mesh_decoration_manual", "0", FCVAR_CHEAT, "Highlight special areas marked by hand" );
 // Method 1 & 2 should be exactly the same for tf_show_sentry_danger.
 ConVar tf_show_sentry_danger( "tf_show_sentry_danger", "0", FCVAR_CHEAT, "Show sentry danger areas. 1:Use m_sentryAreas. 2:Check all nav areas." );
+extern ConVar tf_nav_cluster_draw;
+
 ConVar tf_show_actor_potential_visibility( "tf_show_actor_potential_visibility", "0", FCVAR_CHEAT );
 ConVar tf_show_control_points( "tf_show_control_points", "0", FCVAR_CHEAT );
 ConVar tf_show_bomb_drop_areas( "tf_show_bomb_drop_areas", "0", FCVAR_CHEAT );
@@ -455,6 +460,15 @@ CTFNavMesh::CTFNavMesh( void )
 	m_priorBotCount = 0;
 
 	m_recomputeInternalDataTimer.Invalidate();
+
+	for( int i=0; i<TF_TEAM_COUNT; ++i )
+	{
+		m_incursionSpawnArea[i] = NULL;
+	}
+	m_isIncursionUpdatePending = false;
+	m_incursionAreaCount = 0;
+	m_invasionAreaCursor = -1;
+	m_incursionVersion = 0;
 }
 
 
@@ -465,6 +479,92 @@ CTFNavArea *CTFNavMesh::CreateArea( void ) const
 }
 
 
+//-------------------------------------------------------------------------
+/**
+ * Find paths to distant goals through the cluster graph, searching the areas of only a few clusters at a time
+ */
+bool CTFNavMesh::ComputeCorridorPath( CNavArea *startArea, CNavArea *goalArea, const IPathCost &costFunc, int teamID, CUtlVector< NavPathArea > *areaVector, bool *reachesGoal ) const
+{
+	return m_clusterGraph.ComputePath( startArea, goalArea, costFunc, teamID, areaVector, reachesGoal );
+}
+
+
+//-------------------------------------------------------------------------
+bool CTFNavMesh::IsCorridorPathWorthwhile( const CNavArea *startArea, const CNavArea *goalArea ) const
+{
+	return m_clusterGraph.IsPathWorthwhile( startArea, goalArea );
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Invoked when given area has just been added to the mesh in edit mode
+ */
+void CTFNavMesh::OnEditCreateNotify( CNavArea *newArea )
+{
+	m_clusterGraph.MarkDirty();
+
+	CNavMesh::OnEditCreateNotify( newArea );
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Invoked when given area has just been deleted from the mesh in edit mode
+ */
+void CTFNavMesh::OnEditDestroyNotify( CNavArea *deadArea )
+{
+	m_clusterGraph.MarkDirty();
+
+	CNavMesh::OnEditDestroyNotify( deadArea );
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Invoked when given ladder has just been deleted from the mesh in edit mode
+ */
+void CTFNavMesh::OnEditDestroyNotify( CNavLadder *deadLadder )
+{
+	m_clusterGraph.MarkDirty();
+
+	CNavMesh::OnEditDestroyNotify( deadLadder );
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Invoked when given area's connections to areas or ladders have just changed, such as by nav_connect
+ * and nav_disconnect. These keep the area count, so the cluster graph must be told to rebuild.
+ */
+void CTFNavMesh::OnEditConnectNotify( CNavArea *area )
+{
+	m_clusterGraph.MarkDirty();
+}
+
+
+//-------------------------------------------------------------------------
+/**
+ * Destroy Navigation Mesh data and revert to initial state
+ */
+void CTFNavMesh::Reset( void )
+{
+	m_clusterGraph.Reset();
+
+	// discard any incursion update in progress, since it refers to the areas about to be destroyed
+	for( int i=0; i<TF_TEAM_COUNT; ++i )
+	{
+		m_incursionSpawnArea[i] = NULL;
+		m_incursionQueue[i].RemoveAll();
+	}
+	m_isIncursionUpdatePending = false;
+	m_incursionAreaCount = 0;
+	m_invasionAreaCursor = -1;
+
+	CNavMesh::Reset();
+}
+
+
 //-------------------------------------------------------------------------
 /**
  * Invoked on each game frame
@@ -476,6 +576,13 @@ void CTFNavMesh::Update( void )
 	if ( !TheNavAreas.Count() )
 		return;
 
+	// bind cluster data loaded with the mesh, or rebuild it if the mesh has changed,
+	// once generation is done (PostCustomAnalysis() builds it then)
+	if ( !IsGenerating() )
+	{
+		m_clusterGraph.Update();
+	}
+
 	UpdateDebugDisplay();
 
 	if ( TheNextBots().GetNextBotCount() > 0 )
@@ -493,6 +600,12 @@ void CTFNavMesh::Update( void )
 			RecomputeInternalData();
 		}
 
+		// continue incursion updates spread over several frames
+		if ( UpdateIncursionDistances( tf_nav_incursion_update_budget.GetInt() ) )
+		{
+			UpdateInvasionAreas( tf_nav_invasion_update_budget.GetInt() );
+		}
+
 		if ( TFGameRules()->GetGameType() == TF_GAMETYPE_ESCORT && m_watchCartTimer.IsElapsed() )
 		{
 			// the cart may have moved, recompute new sniper spots
@@ -629,6 +742,9 @@ void CTFNavMesh::OnBlockedAreasChanged( void )
 {
 	VPROF_BUDGET( "CTFNavMesh::OnBlockedAreasChanged", "NextBot" );
 
+	// shared paths may go through areas that are now blocked, or around ones that are now open
+	TheNextBotPathCache().Invalidate();
+
 	if ( TheNextBots().GetNextBotCount() == 0 )
 		return;
 
@@ -636,6 +752,26 @@ void CTFNavMesh::OnBlockedAreasChanged( void )
 }
 
 
+//-------------------------------------------------------------------------
+void CTFNavMesh::OnAreaBlocked( CNavArea *area )
+{
+	CNavMesh::OnAreaBlocked( area );
+
+	// shared paths may go through this area
+	TheNextBotPathCache().Invalidate();
+}
+
+
+//-------------------------------------------------------------------------
+void CTFNavMesh::OnAreaUnblocked( CNavArea *area )
+{
+	CNavMesh::OnAreaUnblocked( area );
+
+	// shared paths may go the long way around this area
+	TheNextBotPathCache().Invalidate();
+}
+
+
 //-------------------------------------------------------------------------
 void TestAndBlockOverlappingAreas( CBaseEntity *entity )
 {
@@ -1128,8 +1264,7 @@ void CTFNavMesh::RecomputeInternalData( void )
 	RemoveAllMeshDecoration();
 	DecorateMesh();
 	ComputeBlockedAreas();			// relies on DecorateMesh() being complete
-	ComputeIncursionDistances();
-	ComputeInvasionAreas();
+	ComputeIncursionDistances( m_recomputeReason == RESET );	// also updates invasion areas once complete
 	ComputeLegalBombDropAreas();
 	ComputeBombTargetDistance();	// for MvM
 
@@ -1215,6 +1350,9 @@ void CTFNavMesh::RecomputeInternalData( void )
 		}
 	}
 
+	// blocked attributes may have changed
+	TheNextBotPathCache().Invalidate();
+
 	m_recomputeInternalDataTimer.Invalidate();
 }
 
@@ -1383,7 +1521,7 @@ void CTFNavMesh::BeginCustomAnalysis( bool bIncremental )
 // invoked when custom analysis step is complete
 void CTFNavMesh::PostCustomAnalysis( void )
 {
-
+	m_clusterGraph.Build();
 }
 
 
@@ -1402,7 +1540,8 @@ unsigned int CTFNavMesh::GetSubVersionNumber( void ) const
 {
 	// 1: initial implementation
 	// 2: added TF-specific attribute flags
-	return 2;
+	// 3: added nav cluster graph
+	return 3;
 }
 
 
@@ -1412,7 +1551,7 @@ unsigned int CTFNavMesh::GetSubVersionNumber( void ) const
  */
 void CTFNavMesh::SaveCustomData( CUtlBuffer &fileBuffer ) const
 {
-
+	m_clusterGraph.Save( fileBuffer );
 }
 
 
@@ -1422,31 +1561,40 @@ void CTFNavMesh::SaveCustomData( CUtlBuffer &fileBuffer ) const
  */
 void CTFNavMesh::LoadCustomData( CUtlBuffer &fileBuffer, unsigned int subVersion )
 {
-
+	if ( subVersion >= 3 )
+	{
+		m_clusterGraph.Load( fileBuffer );
+	}
+	else
+	{
+		// older meshes have no cluster data - it will be built after the mesh has loaded
+		m_clusterGraph.Reset();
+	}
 }
 
 
 //-------------------------------------------------------------------------
 /**
- * Recompute travel distance from each team's spawn room for each nav area
+ * Begin updating travel distance from each team's spawn room for each nav area.
+ * If 'isFullUpdate' is false, only areas affected by changes in blocked status are revisited.
  */
-void CTFNavMesh::ComputeIncursionDistances( void )
+void CTFNavMesh::ComputeIncursionDistances( bool isFullUpdate )
 {
 	VPROF_BUDGET( "CTFNavMesh::ComputeIncursionDistances", "NextBot" );
 
-	// invalidate all travel distances
-	FOR_EACH_VEC( TheNavAreas, it )
+	if ( m_incursionAreaCount != TheNavAreas.Count() )
 	{
-		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+		// the mesh has changed since the last search
+		isFullUpdate = true;
+		m_incursionAreaCount = TheNavAreas.Count();
+	}
 
-		for( int i=0; i<TF_TEAM_COUNT; ++i )
-		{
-			area->m_distanceFromSpawnRoom[i] = -1.0f;
-		}
+	CTFNavArea *spawnAreaVector[ TF_TEAM_COUNT ];
+	for( int i=0; i<TF_TEAM_COUNT; ++i )
+	{
+		spawnAreaVector[i] = NULL;
 	}
 
-	bool isRedComputed = false;
-	bool isBlueComputed = false;
 	for ( int i=0; i<IFuncRespawnRoomAutoList::AutoList().Count(); ++i )
 	{
 		CFuncRespawnRoom *spawnRoom = static_cast< CFuncRespawnRoom* >( IFuncRespawnRoomAutoList::AutoList()[i] );
@@ -1468,194 +1616,404 @@ void CTFNavMesh::ComputeIncursionDistances( void )
 			if ( spawnSpot->IsDisabled() )
 				continue;
 
-			if ( spawnSpot->GetTeamNumber() == TF_TEAM_RED && isRedComputed )
-				continue;
-
-			if ( spawnSpot->GetTeamNumber() == TF_TEAM_BLUE && isBlueComputed )
+			int team = spawnSpot->GetTeamNumber();
+			if ( team < 0 || team >= TF_TEAM_COUNT || spawnAreaVector[ team ] )
 				continue;
 
 			if ( spawnRoom->PointIsWithin( spawnSpot->GetAbsOrigin() ) )
 			{
-				// found a valid spawn spot in an active spawn room, compute travel distances throughout the nav mesh
+				// found a valid spawn spot in an active spawn room, travel distances are measured from here
 				CTFNavArea *spawnArea = static_cast< CTFNavArea * >( TheTFNavMesh()->GetNearestNavArea( spawnSpot ) );
 				if ( spawnArea )
 				{
-					ComputeIncursionDistances( spawnArea, spawnSpot->GetTeamNumber() );
-
-					if ( spawnSpot->GetTeamNumber() == TF_TEAM_RED )
-					{
-						isRedComputed = true;
-					}
-					else
-					{
-						isBlueComputed = true;
-					}
-
+					spawnAreaVector[ team ] = spawnArea;
 					break;
 				}
 			}
 		}
 	}
 
-	if ( !isRedComputed )
+	if ( !spawnAreaVector[ TF_TEAM_RED ] )
 	{
 		Warning( "Can't compute incursion distances from the Red spawn room(s). Bots will perform poorly. This is caused by either a missing func_respawnroom, or missing info_player_teamspawn entities within the func_respawnroom.\n" );
 	}
 
-	if ( !isBlueComputed )
+	if ( !spawnAreaVector[ TF_TEAM_BLUE ] )
 	{
 		Warning( "Can't compute incursion distances from the Blue spawn room(s). Bots will perform poorly. This is caused by either a missing func_respawnroom, or missing info_player_teamspawn entities within the func_respawnroom.\n" );
 	}
 
-	if ( !TFGameRules()->IsMannVsMachineMode() )
+	for( int team=0; team<TF_TEAM_COUNT; ++team )
 	{
-		// In Raid mode, the Red (bot) team has no spawn room.
-		// So, we'll assume the Red incursion distance is the inverse of the Blue incursion distance for now.
-		// @TODO: Use the Boss battle room as the anchor for computing Red incursion distances
-		float maxBlueIncursionDistance = 0.0f;
-
-		for( int i=0; i<TheNavAreas.Count(); ++i )
+		if ( isFullUpdate || spawnAreaVector[ team ] != m_incursionSpawnArea[ team ] )
 		{
-			CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ i ] );
-
-			if ( area->GetIncursionDistance( TF_TEAM_BLUE ) > maxBlueIncursionDistance )
-			{
-				maxBlueIncursionDistance = area->GetIncursionDistance( TF_TEAM_BLUE );
-			}
+			// the spawn room moved - every distance for this team is measured from a new place
+			StartIncursionSearch( spawnAreaVector[ team ], team );
 		}
-
-		for( int i=0; i<TheNavAreas.Count(); ++i )
+		else if ( spawnAreaVector[ team ] )
 		{
-			CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ i ] );
-
-			if ( area->GetIncursionDistance( TF_TEAM_BLUE ) >= 0.0f )
-			{
-				area->m_distanceFromSpawnRoom[ TF_TEAM_RED ] = maxBlueIncursionDistance - area->GetIncursionDistance( TF_TEAM_BLUE );
-			}
+			RepairIncursionSearch( team );
 		}
 	}
+
+	m_isIncursionUpdatePending = true;
+
+	UpdateIncursionDistances( tf_nav_incursion_update_budget.GetInt() );
 }
 
 
 //--------------------------------------------------------------------------------------------------------
 /**
- * Flood-fill outwards, marking flow distance as we go.
- * When we reach an area, stop if it already has a lesser travel distance
+ * Return true if the incursion search passes through the given area
  */
-void CTFNavMesh::ComputeIncursionDistances( CTFNavArea *spawnArea, int team )
+bool CTFNavMesh::IsIncursionExpandable( CTFNavArea *area, int team ) const
 {
-	if ( spawnArea == NULL || team < 0 || team >= TF_TEAM_COUNT )
+#ifdef TF_RAID_MODE
+	// TODO: Raid mode ignores blocked areas for now (cap gates break this)
+	if ( TFGameRules()->IsRaidMode()  )
+		return true;
+#endif // TF_RAID_MODE
+
+	// TODO: Ditto for Mann Vs Machine mode
+	if ( TFGameRules()->IsMannVsMachineMode() )
+		return true;
+
+	// ignore spawn room exits, since they presumably will be open
+	// ignore setup gates, since they will be open after the setup time
+	if ( area->HasAttributeTF( TF_NAV_SPAWN_ROOM_EXIT | TF_NAV_BLUE_SETUP_GATE | TF_NAV_RED_SETUP_GATE ) )
+		return true;
+
+	// don't pass through blocked areas
+	return !area->IsBlocked( team );
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+void CTFNavMesh::QueueIncursionArea( CTFNavArea *area, int team )
+{
+	if ( !area->m_isIncursionQueued[ team ] )
 	{
-		return;
+		area->m_isIncursionQueued[ team ] = true;
+		m_incursionQueue[ team ].Insert( area );
 	}
+}
 
-	CNavArea::ClearSearchLists();
 
-	spawnArea->m_distanceFromSpawnRoom[ team ] = 0.0f;
-	spawnArea->AddToOpenList();
-	spawnArea->Mark();
-	spawnArea->SetParent( NULL );
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Discard the team's pending travel distances and flood-fill outwards from the given spawn area
+ */
+void CTFNavMesh::StartIncursionSearch( CTFNavArea *spawnArea, int team )
+{
+	m_incursionSpawnArea[ team ] = spawnArea;
+	m_incursionQueue[ team ].RemoveAll();
 
-	CUtlVectorFixedGrowable< const NavConnect *, 64 > adjAreaVector;
-	//TFNavAttributeType teamSpawnRoom = ( team == TF_TEAM_RED ) ? TF_NAV_SPAWN_ROOM_RED : TF_NAV_SPAWN_ROOM_BLUE;
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
 
-	while( !CNavArea::IsOpenListEmpty() )
+		area->m_pendingDistanceFromSpawnRoom[ team ] = -1.0f;
+		area->m_incursionParent[ team ] = NULL;
+		area->m_isIncursionQueued[ team ] = false;
+		area->m_isIncursionExpandable[ team ] = IsIncursionExpandable( area, team );
+	}
+
+	if ( spawnArea )
 	{
-		// get next area to check
-		CTFNavArea *area = static_cast< CTFNavArea * >( CNavArea::PopOpenList() );
-		
-		bool bIgnoreBlockedAreas = false;
+		spawnArea->m_pendingDistanceFromSpawnRoom[ team ] = 0.0f;
+		QueueIncursionArea( spawnArea, team );
+	}
+}
 
-#ifdef TF_RAID_MODE
-		// TODO: Raid mode ignores blocked areas for now (cap gates break this)
-		if ( TFGameRules()->IsRaidMode()  )
-		{
-			bIgnoreBlockedAreas = true;
-		}
-#endif // TF_RAID_MODE
 
-		// TODO: Ditto for Mann Vs Machine mode
-		if ( TFGameRules()->IsMannVsMachineMode() )
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Revisit only the areas whose blocked status changed since the team's last search.
+ * Areas reached through a newly blocked area lose their distance, and are re-reached from their
+ * neighbors. Newly unblocked areas are expanded again, which shortens paths through them.
+ */
+void CTFNavMesh::RepairIncursionSearch( int team )
+{
+	CUtlVector< CTFNavArea * > invalidVector;
+	CUtlVector< CTFNavArea * > openedVector;
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+
+		bool isExpandable = IsIncursionExpandable( area, team );
+		if ( isExpandable == area->m_isIncursionExpandable[ team ] )
+			continue;
+
+		area->m_isIncursionExpandable[ team ] = isExpandable;
+
+		if ( isExpandable )
 		{
-			bIgnoreBlockedAreas = true;
+			openedVector.AddToTail( area );
 		}
-
-		if ( !bIgnoreBlockedAreas )
+		else
 		{
-			// ignore spawn room exits, since they presumably will be open
-			// ignore setup gates, since they will be open after the setup time
-			if ( !area->HasAttributeTF( TF_NAV_SPAWN_ROOM_EXIT | TF_NAV_BLUE_SETUP_GATE | TF_NAV_RED_SETUP_GATE ) && area->IsBlocked( team ) )
-			{
-				// don't pass through blocked areas
-				continue;
-			}
+			// the area itself is still reachable, but the paths through it are gone
+			InvalidateIncursionSubtree( area, team, &invalidVector );
 		}
+	}
 
-		// explore adjacent floor areas
-		adjAreaVector.RemoveAll();
+	// areas that lost their distance may still be reachable from a neighbor
+	FOR_EACH_VEC( invalidVector, it )
+	{
+		CTFNavArea *area = invalidVector[ it ];
 
 		for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
 		{
-			// collect all OUTGOING links from this area to adjacent areas
 			const NavConnectVector *adjVector = area->GetAdjacentAreas( (NavDirType)dir );
 			FOR_EACH_VEC( (*adjVector), bit )
 			{
-				adjAreaVector.AddToTail( &(*adjVector)[ bit ] );
+				CTFNavArea *adjArea = static_cast< CTFNavArea * >( (*adjVector)[ bit ].area );
+
+				if ( adjArea->m_pendingDistanceFromSpawnRoom[ team ] >= 0.0f )
+				{
+					QueueIncursionArea( adjArea, team );
+				}
+			}
+
+			// include areas that connect TO this area via a one-way link
+			const NavConnectVector *incomingVector = area->GetIncomingConnections( (NavDirType)dir );
+			FOR_EACH_VEC( (*incomingVector), bit )
+			{
+				CTFNavArea *adjArea = static_cast< CTFNavArea * >( (*incomingVector)[ bit ].area );
+
+				if ( adjArea->m_pendingDistanceFromSpawnRoom[ team ] >= 0.0f )
+				{
+					QueueIncursionArea( adjArea, team );
+				}
 			}
 		}
+	}
 
-		FOR_EACH_VEC( adjAreaVector, vit )
+	FOR_EACH_VEC( openedVector, it )
+	{
+		CTFNavArea *area = openedVector[ it ];
+
+		if ( area->m_pendingDistanceFromSpawnRoom[ team ] >= 0.0f )
 		{
-			const NavConnect *connect = adjAreaVector[ vit ];
-			CTFNavArea *adjArea = static_cast< CTFNavArea * >( connect->area );
+			QueueIncursionArea( area, team );
+		}
+	}
+}
 
-			if ( area->ComputeAdjacentConnectionHeightChange( adjArea ) > TF_PLAYER_JUMP_HEIGHT )
+
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Clear the pending distance of every area whose shortest path from the spawn room passes through the given area
+ */
+void CTFNavMesh::InvalidateIncursionSubtree( CTFNavArea *area, int team, CUtlVector< CTFNavArea * > *invalidVector )
+{
+	CUtlVectorFixedGrowable< CTFNavArea *, 64 > stack;
+	stack.AddToTail( area );
+
+	while( stack.Count() )
+	{
+		CTFNavArea *parent = stack.Tail();
+		stack.RemoveMultipleFromTail( 1 );
+
+		for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+		{
+			const NavConnectVector *adjVector = parent->GetAdjacentAreas( (NavDirType)dir );
+			FOR_EACH_VEC( (*adjVector), bit )
 			{
-				// don't go up ledges too high to jump
-				continue;
+				CTFNavArea *adjArea = static_cast< CTFNavArea * >( (*adjVector)[ bit ].area );
+
+				if ( adjArea->m_incursionParent[ team ] == parent )
+				{
+					adjArea->m_pendingDistanceFromSpawnRoom[ team ] = -1.0f;
+					adjArea->m_incursionParent[ team ] = NULL;
+
+					invalidVector->AddToTail( adjArea );
+					stack.AddToTail( adjArea );
+				}
 			}
+		}
+	}
+}
 
-			// compute travel distance
-			float newTravelDistance = 0.0f;
 
-			// travel distance is zero in all areas of our spawn room
-			// if ( !adjArea->HasAttributeTF( teamSpawnRoom ) )
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Flood-fill outwards from the queued areas, marking flow distance as we go.
+ * When we reach an area, stop if it already has a lesser travel distance.
+ * Return true if the search is complete and the new distances have been committed.
+ */
+bool CTFNavMesh::UpdateIncursionDistances( int maxAreaCount )
+{
+	if ( !m_isIncursionUpdatePending )
+		return true;
+
+	if ( m_incursionAreaCount != TheNavAreas.Count() )
+	{
+		// the mesh was edited during the update - start over
+		ComputeIncursionDistances( true );
+		return false;
+	}
+
+	VPROF_BUDGET( "CTFNavMesh::UpdateIncursionDistances", "NextBot" );
+
+	int expandedCount = 0;
+
+	for( int team=0; team<TF_TEAM_COUNT; ++team )
+	{
+		CUtlQueue< CTFNavArea * > &queue = m_incursionQueue[ team ];
+
+		while( !queue.IsEmpty() )
+		{
+			if ( maxAreaCount > 0 && expandedCount >= maxAreaCount )
 			{
-				float between = connect->length;
-				newTravelDistance = area->m_distanceFromSpawnRoom[ team ] + between;
+				// continue next frame
+				return false;
 			}
 
-			float adjacentTravelDistance = adjArea->m_distanceFromSpawnRoom[ team ];
+			// get next area to check
+			CTFNavArea *area = queue.RemoveAtHead();
+			area->m_isIncursionQueued[ team ] = false;
 
-			if ( adjacentTravelDistance < 0.0f || adjacentTravelDistance > newTravelDistance )
-			{
-				adjArea->m_distanceFromSpawnRoom[ team ] = newTravelDistance;
-				adjArea->Mark();
-				adjArea->SetParent( area );
+			if ( area->m_pendingDistanceFromSpawnRoom[ team ] < 0.0f || !area->m_isIncursionExpandable[ team ] )
+				continue;
 
-				if ( !adjArea->IsOpen() )
+			++expandedCount;
+
+			// explore adjacent floor areas, along OUTGOING links from this area
+			for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+			{
+				const NavConnectVector *adjVector = area->GetAdjacentAreas( (NavDirType)dir );
+				FOR_EACH_VEC( (*adjVector), bit )
 				{
-					// Since we're doing a breadth-first search, this area will end up at the end of the list.
-					// Adding it to the tail explicitly saves us a bunch of list traversals.
-					adjArea->AddToOpenListTail();
+					const NavConnect &connect = (*adjVector)[ bit ];
+					CTFNavArea *adjArea = static_cast< CTFNavArea * >( connect.area );
+
+					if ( area->ComputeAdjacentConnectionHeightChange( adjArea ) > TF_PLAYER_JUMP_HEIGHT )
+					{
+						// don't go up ledges too high to jump
+						continue;
+					}
+
+					// compute travel distance
+					float newTravelDistance = area->m_pendingDistanceFromSpawnRoom[ team ] + connect.length;
+					float adjacentTravelDistance = adjArea->m_pendingDistanceFromSpawnRoom[ team ];
+
+					if ( adjacentTravelDistance < 0.0f || adjacentTravelDistance > newTravelDistance )
+					{
+						adjArea->m_pendingDistanceFromSpawnRoom[ team ] = newTravelDistance;
+						adjArea->m_incursionParent[ team ] = area;
+
+						QueueIncursionArea( adjArea, team );
+					}
 				}
 			}
 		}
 	}
+
+	CommitIncursionDistances();
+
+	return true;
 }
 
 
 //--------------------------------------------------------------------------------------------------------
-void CTFNavMesh::ComputeInvasionAreas( void )
+/**
+ * Copy the completed travel distances to all areas at once, so bots never see a partial update
+ */
+void CTFNavMesh::CommitIncursionDistances( void )
 {
-	VPROF_BUDGET( "CTFNavMesh::ComputeInvasionAreas", "NextBot" );
+	VPROF_BUDGET( "CTFNavMesh::CommitIncursionDistances", "NextBot" );
+
+	m_isIncursionUpdatePending = false;
+
+	// In Raid mode, the Red (bot) team has no spawn room.
+	// So, we'll assume the Red incursion distance is the inverse of the Blue incursion distance for now.
+	// @TODO: Use the Boss battle room as the anchor for computing Red incursion distances
+	bool isRedInverted = !TFGameRules()->IsMannVsMachineMode();
+	float maxBlueIncursionDistance = 0.0f;
+
+	if ( isRedInverted )
+	{
+		FOR_EACH_VEC( TheNavAreas, it )
+		{
+			CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+
+			if ( area->m_pendingDistanceFromSpawnRoom[ TF_TEAM_BLUE ] > maxBlueIncursionDistance )
+			{
+				maxBlueIncursionDistance = area->m_pendingDistanceFromSpawnRoom[ TF_TEAM_BLUE ];
+			}
+		}
+	}
+
+	bool isChanged = false;
 
 	FOR_EACH_VEC( TheNavAreas, it )
 	{
 		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ it ] );
+
+		for( int team=0; team<TF_TEAM_COUNT; ++team )
+		{
+			float distance = area->m_pendingDistanceFromSpawnRoom[ team ];
+
+			if ( isRedInverted && team == TF_TEAM_RED && area->m_pendingDistanceFromSpawnRoom[ TF_TEAM_BLUE ] >= 0.0f )
+			{
+				distance = maxBlueIncursionDistance - area->m_pendingDistanceFromSpawnRoom[ TF_TEAM_BLUE ];
+			}
+
+			if ( area->m_distanceFromSpawnRoom[ team ] != distance )
+			{
+				area->m_distanceFromSpawnRoom[ team ] = distance;
+				isChanged = true;
+			}
+		}
+	}
+
+	if ( isChanged )
+	{
+		++m_incursionVersion;
+
+		// invasion areas depend on incursion distances
+		m_invasionAreaCursor = 0;
+		UpdateInvasionAreas( tf_nav_invasion_update_budget.GetInt() );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Recompute the invasion areas of up to maxAreaCount areas, continuing where the last call left off.
+ * Return true if all areas are up to date.
+ */
+bool CTFNavMesh::UpdateInvasionAreas( int maxAreaCount )
+{
+	if ( m_invasionAreaCursor < 0 )
+		return true;
+
+	VPROF_BUDGET( "CTFNavMesh::UpdateInvasionAreas", "NextBot" );
+
+	int end = TheNavAreas.Count();
+	if ( maxAreaCount > 0 )
+	{
+		end = MIN( end, m_invasionAreaCursor + maxAreaCount );
+	}
+
+	for( ; m_invasionAreaCursor < end; ++m_invasionAreaCursor )
+	{
+		CTFNavArea *area = static_cast< CTFNavArea * >( TheNavAreas[ m_invasionAreaCursor ] );
 		
 		area->ComputeInvasionAreaVectors();
 	}
+
+	if ( m_invasionAreaCursor < TheNavAreas.Count() )
+	{
+		// continue next frame
+		return false;
+	}
+
+	m_invasionAreaCursor = -1;
+
+	return true;
 }
 
 
@@ -1946,6 +2304,11 @@ void CTFNavMesh::UpdateDebugDisplay( void ) const
 		return;
 
 
+	if ( tf_nav_cluster_draw.GetBool() )
+	{
+		m_clusterGraph.Draw();
+	}
+
 	if ( tf_show_in_combat_areas.GetBool() )
 	{
 		FOR_EACH_VEC( TheNavAreas, it )
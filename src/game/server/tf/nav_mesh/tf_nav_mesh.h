@@ -6,8 +6,10 @@
 #ifndef TF_NAV_MESH_H
 #define TF_NAV_MESH_H
 
+#include "utlqueue.h"
 #include "nav_mesh.h"
 #include "tf_nav_area.h"
+#include "tf_nav_cluster.h"
 #include "tf_obj_teleporter.h"
 
 #define TF_PLAYER_JUMP_HEIGHT	45.0f			// non crouch-jumping
@@ -40,6 +42,7 @@ public:
 	virtual CTFNavArea *CreateArea( void ) const;						// CNavArea factory
 
 	virtual void Update( void );										// invoked on each game frame
+	virtual void Reset( void );											// destroy Navigation Mesh data and revert to initial state
 
 	virtual unsigned int GetSubVersionNumber( void ) const;									// returns sub-version number of data format used by derived classes
 	virtual void SaveCustomData( CUtlBuffer &fileBuffer ) const;							// store custom mesh data for derived classes
@@ -48,6 +51,11 @@ public:
 	virtual void OnServerActivate( void );								// (EXTEND) invoked when server loads a new map
 	virtual void OnRoundRestart( void );								// invoked when a game round restarts
 
+	virtual void OnEditCreateNotify( CNavArea *newArea );				// invoked when given area has just been added to the mesh in edit mode
+	virtual void OnEditDestroyNotify( CNavArea *deadArea );				// invoked when given area has just been deleted from the mesh in edit mode
+	virtual void OnEditDestroyNotify( CNavLadder *deadLadder );			// invoked when given ladder has just been deleted from the mesh in edit mode
+	virtual void OnEditConnectNotify( CNavArea *area );					// invoked when given area's connections to areas or ladders have just changed
+
 	virtual void FireGameEvent( IGameEvent *event );
 
 	/**
@@ -58,6 +66,10 @@ public:
 
 	virtual unsigned int GetGenerationTraceMask( void ) const;			// return the mask used by traces when generating the mesh
 
+	// find paths to distant goals through the cluster graph
+	virtual bool ComputeCorridorPath( CNavArea *startArea, CNavArea *goalArea, const IPathCost &costFunc, int teamID, CUtlVector< NavPathArea > *areaVector, bool *reachesGoal ) const;
+	virtual bool IsCorridorPathWorthwhile( const CNavArea *startArea, const CNavArea *goalArea ) const;
+
 	void OnObjectChanged();
 	bool IsSentryGunHere( CTFNavArea *area ) const;						// return true if a Sentry Gun has been built in the given area
 
@@ -110,15 +122,34 @@ public:
 
 	virtual void OnDoorCreated( CBaseEntity *door );					// invoked when a door is created
 
+	virtual void OnAreaBlocked( CNavArea *area );						// invoked when the area becomes blocked
+	virtual void OnAreaUnblocked( CNavArea *area );						// invoked when the area becomes un-blocked
+
+	const CTFNavClusterGraph &GetClusterGraph( void ) const				{ return m_clusterGraph; }	// coarse graph of area clusters for long distance pathing
+
+	unsigned int GetIncursionVersion( void ) const						{ return m_incursionVersion; }	// changes whenever new incursion distances are committed
+
 protected:
 	virtual void BeginCustomAnalysis( bool bIncremental );
 	virtual void PostCustomAnalysis( void );							// invoked when custom analysis step is complete
 	virtual void EndCustomAnalysis();
 
 private:
-	void ComputeIncursionDistances( void );					// recompute travel distance from each team's spawn room for each nav area
-	void ComputeIncursionDistances( CTFNavArea *spawnArea, int team );
-	void ComputeInvasionAreas( void );
+	/**
+	 * Travel distances from each team's spawn room are updated incrementally - when areas become blocked
+	 * or unblocked, only the areas whose shortest path from the spawn room changed are revisited. The
+	 * update may be spread over several frames, and bots use the previous distances until it is complete.
+	 */
+	void ComputeIncursionDistances( bool isFullUpdate );	// begin updating travel distance from each team's spawn room for each nav area
+	void StartIncursionSearch( CTFNavArea *spawnArea, int team );		// discard the team's pending distances and search from the given area
+	void RepairIncursionSearch( int team );								// revisit areas whose blocked status has changed since the last search
+	void InvalidateIncursionSubtree( CTFNavArea *area, int team, CUtlVector< CTFNavArea * > *invalidVector );
+	void QueueIncursionArea( CTFNavArea *area, int team );
+	bool IsIncursionExpandable( CTFNavArea *area, int team ) const;	// return true if the incursion search passes through the given area
+	bool UpdateIncursionDistances( int maxAreaCount );					// expand up to maxAreaCount queued areas (0 = all), return true when done
+	void CommitIncursionDistances( void );								// make the pending distances visible to bots
+
+	bool UpdateInvasionAreas( int maxAreaCount );						// recompute invasion areas of up to maxAreaCount areas (0 = all), return true when done
 	void ComputeLegalBombDropAreas( void );
 	void ComputeBombTargetDistance();
 
@@ -150,6 +181,15 @@ private:
 
 	CountdownTimer m_watchCartTimer;
 
+	CTFNavClusterGraph m_clusterGraph;
+
+	CTFNavArea *m_incursionSpawnArea[ TF_TEAM_COUNT ];		// the area each team's pending distances are measured from
+	CUtlQueue< CTFNavArea * > m_incursionQueue[ TF_TEAM_COUNT ];
+	bool m_isIncursionUpdatePending;
+	int m_incursionAreaCount;								// the size of the mesh the pending distances were computed for
+	int m_invasionAreaCursor;								// the next area to recompute invasion areas for, -1 if none
+	unsigned int m_incursionVersion;
+
 	int m_priorBotCount;
 };
 
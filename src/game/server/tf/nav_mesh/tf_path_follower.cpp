@@ -81,6 +81,15 @@ void CTFPathFollower::Update( INextBot *bot )
 		return;
 	}
 
+	if ( IsTimeToRefineCorridor( bot ) )
+	{
+		// we're nearing the end of a path along part of a corridor - extend it towards the goal
+		if ( !RefineCorridorPath( bot ) || !IsValid() || m_goal == NULL )
+		{
+			return;
+		}
+	}
+
 	// check if we've reached the end of the path
 	const float nearRange = 25.0f;
 	if ( mover->IsOnGround() && ( GetEndPosition() - mover->GetFeet() ).AsVector2D().IsLengthLessThan( nearRange ) )
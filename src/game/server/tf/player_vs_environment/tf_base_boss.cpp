@@ -6,6 +6,7 @@
 #include "entity_currencypack.h"
 #include "tf_gamestats.h"
 #include "tf_player.h"
+#include "ilagcompensationmanager.h"
 
 LINK_ENTITY_TO_CLASS( base_boss, CTFBaseBoss );
 
@@ -180,6 +181,9 @@ void CTFBaseBoss::Spawn( void )
 		TFGameRules()->AddActiveBoss( this );
 	}
 
+	// bosses are big, moving targets
+	lagcompensation->AddAdditionalEntity( this );
+
 	m_lastHealthPercentage = 1.0f;
 	m_damagePoseParameter = -1;
 
@@ -430,6 +434,8 @@ void CTFBaseBoss::UpdateOnRemove()
 		TFGameRules()->RemoveActiveBoss( this );
 	}
 
+	lagcompensation->RemoveAdditionalEntity( this );
+
 	BaseClass::UpdateOnRemove();
 }
 
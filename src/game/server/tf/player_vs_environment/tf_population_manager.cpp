@@ -10,6 +10,7 @@
 #include "tf_mann_vs_machine_stats.h"
 #include "tf_shareddefs.h"
 #include "filesystem.h"
+#include "checksum_crc.h"
 #include "tf_obj_sentrygun.h"
 #include "tf_objective_resource.h"
 #include "econ_entity_creation.h"
@@ -44,6 +45,7 @@ ConVar tf_mvm_missioncyclefile( "tf_mvm_missioncyclefile", "tf_mvm_missioncycle.
 
 ConVar tf_populator_debug( "tf_populator_debug", "0", TF_MVM_FCVAR_CHEAT );
 ConVar tf_populator_active_buffer_range( "tf_populator_active_buffer_range", "3000", FCVAR_CHEAT, "Populate the world this far ahead of lead raider, and this far behind last raider" );
+ConVar tf_mvm_popfile_cache( "tf_mvm_popfile_cache", "1", FCVAR_NONE, "Cache population files in binary form, keyed by a checksum of their source. 0 = off, 1 = in memory and on disk, 2 = in memory only" );
 
 ConVar tf_mvm_default_sentry_buster_damage_dealt_threshold( "tf_mvm_default_sentry_buster_damage_dealt_threshold", "3000", FCVAR_CHEAT | FCVAR_DEVELOPMENTONLY );
 ConVar tf_mvm_default_sentry_buster_kill_threshold( "tf_mvm_default_sentry_buster_kill_threshold", "15", FCVAR_CHEAT | FCVAR_DEVELOPMENTONLY );
@@ -1071,6 +1073,9 @@ void CPopulationManager::StartCurrentWave( void )
 
 	m_nRespecsAwardedInWave = 0;
 
+	// the invaders' surroundings are collected afresh each wave
+	TheSpawnTheater().Reset();
+
 	FOR_EACH_MAP( m_PlayerBuybackPoints, i )
 	{
 		m_PlayerBuybackPoints[i] = tf_mvm_buybacks_per_wave.GetInt();
@@ -2012,6 +2017,240 @@ void CPopulationManager::PostInitialize( void )
 	}
 }
 
+//-------------------------------------------------------------------------
+// Population file cache
+//
+// Population files are kept as binary KeyValues with their #base files
+// already merged in, keyed by a checksum of the source files. The cache
+// lives in memory across mission changes and wave jumps, and on disk
+// across map loads, so only the checksum is computed from the source text.
+// The memory cache holds the most recently used files, up to
+// POPFILE_CACHE_MAX_ENTRIES, since the mission list scan reads every
+// population file for the map.
+//-------------------------------------------------------------------------
+#define POPFILE_CACHE_DIRECTORY		"cache/population"
+#define POPFILE_CACHE_MAGIC			(('B'<<24)|('P'<<16)|('O'<<8)|'P')
+#define POPFILE_CACHE_VERSION		1
+#define POPFILE_CACHE_MAX_ENTRIES	16
+
+struct PopfileCacheEntry
+{
+	CUtlString m_path;
+	CRC32_t m_checksum;
+	CUtlBuffer m_data;						// binary KeyValues
+};
+static CUtlVector< PopfileCacheEntry * > s_popfileCache;		// least recently used first
+
+//-------------------------------------------------------------------------
+// Add the given file and all the files it includes with #base or #include
+// to the checksum. Included paths are relative to the including file, as in KeyValues.
+static bool ChecksumPopulationFile( const char *pszFullPath, CRC32_t *pChecksum, int nDepth = 0 )
+{
+	if ( nDepth > 8 )
+		return false;
+
+	CUtlBuffer buf( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	if ( !filesystem->ReadFile( pszFullPath, "GAME", buf ) )
+		return false;
+
+	CRC32_ProcessBuffer( pChecksum, buf.Base(), buf.TellPut() );
+
+	char szLine[ 1024 ];
+	while ( buf.IsValid() && buf.GetBytesRemaining() > 0 )
+	{
+		buf.GetLine( szLine, sizeof( szLine ) );
+
+		const char *pszToken = szLine;
+		while ( *pszToken == ' ' || *pszToken == '\t' )
+			++pszToken;
+
+		if ( Q_strnicmp( pszToken, "#base", 5 ) == 0 )
+		{
+			pszToken += 5;
+		}
+		else if ( Q_strnicmp( pszToken, "#include", 8 ) == 0 )
+		{
+			pszToken += 8;
+		}
+		else
+		{
+			continue;
+		}
+
+		while ( *pszToken == ' ' || *pszToken == '\t' || *pszToken == '"' )
+			++pszToken;
+
+		char szInclude[ MAX_PATH ];
+		int len = 0;
+		while ( pszToken[ len ] && pszToken[ len ] != '"' && pszToken[ len ] != '\r' && pszToken[ len ] != '\n' && len < MAX_PATH - 1 )
+		{
+			szInclude[ len ] = pszToken[ len ];
+			++len;
+		}
+		while ( len > 0 && ( szInclude[ len-1 ] == ' ' || szInclude[ len-1 ] == '\t' ) )
+			--len;
+		szInclude[ len ] = '\0';
+
+		if ( len == 0 )
+			continue;
+
+		char szIncludePath[ MAX_PATH ];
+		Q_ExtractFilePath( pszFullPath, szIncludePath, sizeof( szIncludePath ) );
+		Q_strncat( szIncludePath, szInclude, sizeof( szIncludePath ), COPY_ALL_CHARACTERS );
+
+		// a missing #base file is skipped by KeyValues, so it only needs to change the checksum
+		if ( !ChecksumPopulationFile( szIncludePath, pChecksum, nDepth + 1 ) )
+		{
+			CRC32_ProcessBuffer( pChecksum, szIncludePath, Q_strlen( szIncludePath ) );
+		}
+	}
+
+	return true;
+}
+
+//-------------------------------------------------------------------------
+static void GetPopulationCacheFilename( const char *pszFullPath, char *pszCacheFilename, int nSize )
+{
+	char szName[ MAX_PATH ];
+	Q_strncpy( szName, pszFullPath, sizeof( szName ) );
+
+	for( char *c = szName; *c; ++c )
+	{
+		if ( *c == '/' || *c == '\\' || *c == ':' )
+		{
+			*c = '_';
+		}
+	}
+
+	Q_snprintf( pszCacheFilename, nSize, "%s/%s.bin", POPFILE_CACHE_DIRECTORY, szName );
+}
+
+//-------------------------------------------------------------------------
+// Return the KeyValues for the given population file, from the cache if it
+// matches the source. The caller owns the returned KeyValues.
+static KeyValues *LoadPopulationFile( const char *pszFullPath )
+{
+	KeyValues *values = new KeyValues( "Population" );
+
+	CRC32_t checksum;
+	CRC32_Init( &checksum );
+
+	if ( tf_mvm_popfile_cache.GetInt() <= 0 || !ChecksumPopulationFile( pszFullPath, &checksum ) )
+	{
+		if ( !values->LoadFromFile( filesystem, pszFullPath, "GAME" ) )
+		{
+			values->deleteThis();
+			return NULL;
+		}
+		return values;
+	}
+
+	CRC32_Final( &checksum );
+
+	// already cached in memory?
+	PopfileCacheEntry *entry = NULL;
+	FOR_EACH_VEC( s_popfileCache, i )
+	{
+		if ( !Q_stricmp( s_popfileCache[i]->m_path, pszFullPath ) )
+		{
+			// most recently used
+			entry = s_popfileCache[i];
+			s_popfileCache.Remove( i );
+			s_popfileCache.AddToTail( entry );
+			break;
+		}
+	}
+
+	if ( entry && entry->m_checksum == checksum )
+	{
+		entry->m_data.SeekGet( CUtlBuffer::SEEK_HEAD, 0 );
+		if ( values->ReadAsBinary( entry->m_data ) )
+		{
+			return values;
+		}
+	}
+
+	if ( entry == NULL )
+	{
+		// make room by discarding the least recently used files
+		while ( s_popfileCache.Count() >= POPFILE_CACHE_MAX_ENTRIES )
+		{
+			delete s_popfileCache[0];
+			s_popfileCache.Remove( 0 );
+		}
+
+		entry = new PopfileCacheEntry;
+		entry->m_path = pszFullPath;
+		s_popfileCache.AddToTail( entry );
+	}
+
+	entry->m_checksum = checksum;
+	entry->m_data.Purge();
+
+	char szCacheFilename[ MAX_PATH ];
+	GetPopulationCacheFilename( pszFullPath, szCacheFilename, sizeof( szCacheFilename ) );
+
+	// cached on disk?
+	bool bUseDisk = ( tf_mvm_popfile_cache.GetInt() == 1 );
+	if ( bUseDisk )
+	{
+		CUtlBuffer fileBuffer;
+		if ( filesystem->ReadFile( szCacheFilename, "MOD", fileBuffer ) &&
+			 fileBuffer.GetUnsignedInt() == POPFILE_CACHE_MAGIC &&
+			 fileBuffer.GetUnsignedInt() == POPFILE_CACHE_VERSION &&
+			 fileBuffer.GetUnsignedInt() == checksum &&
+			 fileBuffer.IsValid() )
+		{
+			entry->m_data.Put( fileBuffer.PeekGet(), fileBuffer.GetBytesRemaining() );
+
+			if ( values->ReadAsBinary( entry->m_data ) )
+			{
+				return values;
+			}
+
+			entry->m_data.Purge();
+		}
+	}
+
+	// parse the source and cache the result
+	if ( !values->LoadFromFile( filesystem, pszFullPath, "GAME" ) )
+	{
+		values->deleteThis();
+		return NULL;
+	}
+
+	if ( !values->WriteAsBinary( entry->m_data ) )
+	{
+		entry->m_data.Purge();
+		return values;
+	}
+
+	if ( bUseDisk )
+	{
+		CUtlBuffer fileBuffer;
+		fileBuffer.PutUnsignedInt( POPFILE_CACHE_MAGIC );
+		fileBuffer.PutUnsignedInt( POPFILE_CACHE_VERSION );
+		fileBuffer.PutUnsignedInt( checksum );
+		fileBuffer.Put( entry->m_data.Base(), entry->m_data.TellPut() );
+
+		filesystem->CreateDirHierarchy( POPFILE_CACHE_DIRECTORY, "MOD" );
+		if ( !filesystem->WriteFile( szCacheFilename, "MOD", fileBuffer ) )
+		{
+			DevMsg( "Can't write population cache file %s\n", szCacheFilename );
+		}
+	}
+
+	return values;
+}
+
+CON_COMMAND_F( tf_mvm_popfile_cache_clear, "Discard population files cached in memory", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	s_popfileCache.PurgeAndDeleteElements();
+}
+
 //-------------------------------------------------------------------------
 // Purpose : 
 //-------------------------------------------------------------------------
@@ -2027,9 +2266,8 @@ bool CPopulationManager::IsValidPopfile( CUtlString fullPath )
 		return false;
 	}
 
-	KeyValues *values = new KeyValues( "Population" );
-
-	if ( !values->LoadFromFile( filesystem, pszFullPath, "GAME" ) )
+	KeyValues *values = LoadPopulationFile( pszFullPath );
+	if ( !values )
 		return false;
 
 	for ( KeyValues *data = values->GetFirstSubKey(); data != NULL; data = data->GetNextKey() )
@@ -2065,11 +2303,10 @@ bool CPopulationManager::Parse( void )
 	//if ( m_bIsInitialized )
 //		return true;
 
-	KeyValues *values = new KeyValues( "Population" );
-	if ( !values->LoadFromFile( filesystem, m_popfileFull, "GAME" ) )
+	KeyValues *values = LoadPopulationFile( m_popfileFull );
+	if ( !values )
 	{
 		Warning( "Can't open %s.\n", m_popfileFull );
-		values->deleteThis();
 		return false;
 	}
 
@@ -450,6 +450,9 @@ CTFBotSpawner::CTFBotSpawner( IPopulator *populator ) : IPopulationSpawner( popu
 	m_flAutoJumpMin = m_flAutoJumpMax = 0.f; // default AutoJumpMin/Max
 
 	m_defaultAttributes.Reset();
+
+	static int nextTemplateID = 0;
+	m_templateID = ++nextTemplateID;
 }
 
 static void ParseCharacterAttributes( CTFBot::EventChangeAttributes_t& event, KeyValues *data )
@@ -927,6 +930,129 @@ bool CTFBotSpawner::ParseEventChangeAttributes( KeyValues *data )
 }
 
 
+//-----------------------------------------------------------------------
+// CTFBotSpawnerPool
+//-----------------------------------------------------------------------
+CTFBotSpawnerPool &TheTFBotSpawnerPool( void )
+{
+	static CTFBotSpawnerPool pool;
+	return pool;
+}
+
+//-----------------------------------------------------------------------
+CTFBotSpawnerPool::CTFBotSpawnerPool( void )
+{
+	for( int i=0; i<=MAX_PLAYERS; ++i )
+	{
+		m_bot[i] = NULL;
+		m_botTemplateID[i] = 0;
+	}
+
+	ResetStats();
+}
+
+//-----------------------------------------------------------------------
+// Return a dead bot to reuse, preferring one last set up by the given template
+CTFBot *CTFBotSpawnerPool::Acquire( int templateID, bool *isSameTemplate )
+{
+	*isSameTemplate = false;
+
+	CTFBot *anyBot = NULL;
+
+	CTeam *deadTeam = GetGlobalTeam( TEAM_SPECTATOR );
+	for( int i=0; i<deadTeam->GetNumPlayers(); ++i )
+	{
+		if ( !deadTeam->GetPlayer(i)->IsBot() )
+			continue;
+
+		CTFBot *bot = (CTFBot *)deadTeam->GetPlayer(i);
+
+		int index = bot->entindex();
+		if ( index > 0 && index <= MAX_PLAYERS && m_bot[ index ] == bot && m_botTemplateID[ index ] == templateID )
+		{
+			++m_hitCount;
+			*isSameTemplate = true;
+			return bot;
+		}
+
+		if ( anyBot == NULL )
+		{
+			anyBot = bot;
+		}
+	}
+
+	if ( anyBot )
+	{
+		++m_reuseCount;
+	}
+	else
+	{
+		++m_missCount;
+	}
+
+	return anyBot;
+}
+
+//-----------------------------------------------------------------------
+void CTFBotSpawnerPool::OnBotSpawned( CTFBot *bot, int templateID )
+{
+	int index = bot->entindex();
+	if ( index > 0 && index <= MAX_PLAYERS )
+	{
+		m_bot[ index ] = bot;
+		m_botTemplateID[ index ] = templateID;
+	}
+}
+
+//-----------------------------------------------------------------------
+void CTFBotSpawnerPool::ResetStats( void )
+{
+	m_hitCount = 0;
+	m_reuseCount = 0;
+	m_missCount = 0;
+}
+
+//-----------------------------------------------------------------------
+void CTFBotSpawnerPool::PrintStats( void ) const
+{
+	int total = m_hitCount + m_reuseCount + m_missCount;
+
+	Msg( "TFBot spawner pool: %d requests, %d same template hits, %d other template reuses, %d misses (%.0f%% hit rate)\n",
+		 total, m_hitCount, m_reuseCount, m_missCount, total ? 100.0f * m_hitCount / total : 0.0f );
+}
+
+CON_COMMAND_F( tf_mvm_bot_pool_stats, "Show how often TFBot spawners reuse dead bots they set up before. Use 'reset' to clear the counters.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	TheTFBotSpawnerPool().PrintStats();
+
+	if ( args.ArgC() > 1 && FStrEq( args[1], "reset" ) )
+	{
+		TheTFBotSpawnerPool().ResetStats();
+	}
+}
+
+//-----------------------------------------------------------------------
+// Return the robot model to use for the given class, or NULL if it isn't installed.
+// Checking the filesystem is slow, so the result is remembered for each model.
+static const char *GetInstalledBotModel( int nClassIndex, bool bIsMiniBoss )
+{
+	enum { MODEL_UNKNOWN, MODEL_INSTALLED, MODEL_MISSING };
+	static int s_botModelState[ 2 ][ TF_LAST_NORMAL_CLASS ];
+
+	const char *pszModel = bIsMiniBoss ? g_szBotBossModels[ nClassIndex ] : g_szBotModels[ nClassIndex ];
+	int &state = s_botModelState[ bIsMiniBoss ? 1 : 0 ][ nClassIndex ];
+
+	if ( state == MODEL_UNKNOWN )
+	{
+		state = g_pFullFileSystem->FileExists( pszModel ) ? MODEL_INSTALLED : MODEL_MISSING;
+	}
+
+	return ( state == MODEL_INSTALLED ) ? pszModel : NULL;
+}
+
 //-----------------------------------------------------------------------
 bool CTFBotSpawner::Spawn( const Vector &rawHere, EntityHandleVector_t *result )
 {
@@ -989,17 +1115,12 @@ bool CTFBotSpawner::Spawn( const Vector &rawHere, EntityHandleVector_t *result )
 	}
 
 
-	// find dead bot we can re-use
-	CTeam *deadTeam = GetGlobalTeam( TEAM_SPECTATOR );
-	for( int i=0; i<deadTeam->GetNumPlayers(); ++i )
+	// find dead bot we can re-use, preferably one we set up before
+	bool isSameTemplate = false;
+	newBot = TheTFBotSpawnerPool().Acquire( m_templateID, &isSameTemplate );
+	if ( newBot )
 	{
-		if ( !deadTeam->GetPlayer(i)->IsBot() )
-			continue;
-
-		// reuse this guy
-		newBot = (CTFBot *)deadTeam->GetPlayer(i);
 		newBot->ClearAllAttributes();
-		break;
 	}
 
 	if ( newBot == NULL )
@@ -1098,8 +1219,11 @@ bool CTFBotSpawner::Spawn( const Vector &rawHere, EntityHandleVector_t *result )
 			g_internalSpawnPoint->Spawn();
 		}
 
-		// set name
-		engine->SetFakeClientConVarValue( newBot->edict(), "name", m_name.IsEmpty() ? "TFBot" : m_name.Get() );
+		if ( !isSameTemplate )
+		{
+			// set name
+			engine->SetFakeClientConVarValue( newBot->edict(), "name", m_name.IsEmpty() ? "TFBot" : m_name.Get() );
+		}
 
 		g_internalSpawnPoint->SetAbsOrigin( here );
 		g_internalSpawnPoint->SetLocalAngles( vec3_angle );
@@ -1118,10 +1242,13 @@ bool CTFBotSpawner::Spawn( const Vector &rawHere, EntityHandleVector_t *result )
 		newBot->HandleCommand_JoinClass( GetPlayerClassData( m_class )->m_szClassName );
 		newBot->GetPlayerClass()->SetClassIconName( GetClassIcon() );
 
-		newBot->ClearEventChangeAttributes();
-		for ( int i=0; i<m_eventChangeAttributes.Count(); ++i )
+		if ( !isSameTemplate )
 		{
-			newBot->AddEventChangeAttributes( &m_eventChangeAttributes[i] );
+			newBot->ClearEventChangeAttributes();
+			for ( int i=0; i<m_eventChangeAttributes.Count(); ++i )
+			{
+				newBot->AddEventChangeAttributes( &m_eventChangeAttributes[i] );
+			}
 		}
 
 		// Request to Add in Endless
@@ -1267,21 +1394,28 @@ bool CTFBotSpawner::Spawn( const Vector &rawHere, EntityHandleVector_t *result )
 			// use the nifty new robot model
 			if ( nClassIndex >= TF_CLASS_SCOUT && nClassIndex <= TF_CLASS_ENGINEER )
 			{
-				if ( ( m_scale >= tf_mvm_miniboss_scale.GetFloat() || newBot->IsMiniBoss() ) && g_pFullFileSystem->FileExists( g_szBotBossModels[ nClassIndex ] ) )
+				const char *pszModel = NULL;
+				if ( m_scale >= tf_mvm_miniboss_scale.GetFloat() || newBot->IsMiniBoss() )
 				{
-					newBot->GetPlayerClass()->SetCustomModel( g_szBotBossModels[ nClassIndex ], USE_CLASS_ANIMATIONS );
-					newBot->UpdateModel();
-					newBot->SetBloodColor( DONT_BLEED );
+					pszModel = GetInstalledBotModel( nClassIndex, true );
 				}
-				else if ( g_pFullFileSystem->FileExists( g_szBotModels[ nClassIndex ] ) )
+
+				if ( pszModel == NULL )
 				{
-					newBot->GetPlayerClass()->SetCustomModel( g_szBotModels[ nClassIndex ], USE_CLASS_ANIMATIONS );
+					pszModel = GetInstalledBotModel( nClassIndex, false );
+				}
+
+				if ( pszModel )
+				{
+					newBot->GetPlayerClass()->SetCustomModel( pszModel, USE_CLASS_ANIMATIONS );
 					newBot->UpdateModel();
 					newBot->SetBloodColor( DONT_BLEED );
 				}
 			}
 		}
 
+		TheTFBotSpawnerPool().OnBotSpawned( newBot, m_templateID );
+
 		if ( result )
 		{
 			result->AddToTail( newBot );
@@ -187,8 +187,40 @@ public:
 
 	CTFBot::EventChangeAttributes_t m_defaultAttributes;
 	CUtlVector< CTFBot::EventChangeAttributes_t > m_eventChangeAttributes;
+
+	int m_templateID;								// unique to this spawner, see CTFBotSpawnerPool
+};
+
+
+//-----------------------------------------------------------------------
+// The dead bots on the spectator team, waiting to be spawned again.
+// Each bot remembers the TFBot spawner that last set it up, so the
+// spawner can take back one of its own bots and skip the setup that
+// would be identical to last time.
+class CTFBotSpawnerPool
+{
+public:
+	CTFBotSpawnerPool( void );
+
+	// return a dead bot to reuse, preferring one last set up by the given template, or NULL if none are available
+	CTFBot *Acquire( int templateID, bool *isSameTemplate );
+
+	void OnBotSpawned( CTFBot *bot, int templateID );	// the given bot has been set up by the given template
+
+	void ResetStats( void );
+	void PrintStats( void ) const;
+
+private:
+	CHandle< CTFBot > m_bot[ MAX_PLAYERS + 1 ];			// indexed by entindex
+	int m_botTemplateID[ MAX_PLAYERS + 1 ];
+
+	int m_hitCount;				// reused a bot last set up by the same template
+	int m_reuseCount;			// reused a bot set up by a different template
+	int m_missCount;			// no dead bot was available
 };
 
+extern CTFBotSpawnerPool &TheTFBotSpawnerPool( void );
+
 //-----------------------------------------------------------------------
 class CTankSpawner : public IPopulationSpawner
 {
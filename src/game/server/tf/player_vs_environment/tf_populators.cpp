@@ -299,31 +299,137 @@ SpawnLocationResult CSpawnLocation::FindSpawnLocation( Vector& vSpawnPosition )
 }
 
 //-----------------------------------------------------------------------
-CTFNavArea *CSpawnLocation::SelectSpawnArea( void ) const
+// CPopulatorSpawnTheater
+//-----------------------------------------------------------------------
+CPopulatorSpawnTheater &TheSpawnTheater( void )
 {
-	VPROF_BUDGET( "CSpawnLocation::SelectSpawnArea", "NextBot" );
+	static CPopulatorSpawnTheater theater;
+	return theater;
+}
 
-	if ( m_relative == UNDEFINED )
+//-----------------------------------------------------------------------
+CPopulatorSpawnTheater::CPopulatorSpawnTheater( void )
+{
+	Reset();
+}
+
+//-----------------------------------------------------------------------
+void CPopulatorSpawnTheater::Reset( void )
+{
+	m_invaderVector.RemoveAll();
+	m_areaVector.RemoveAll();
+	m_areaRefCount.RemoveAll();
+
+	m_navAreaCount = 0;
+	m_incursionVersion = 0;
+	m_range = 0.0f;
+}
+
+//-----------------------------------------------------------------------
+// Order areas by increasing incursion distance. Ties are broken by ID
+// so each area has a unique position and can be found again to remove it.
+bool CPopulatorSpawnTheater::CAreaIncursionLess::Less( const CTFNavArea *a, const CTFNavArea *b, void *pCtx )
+{
+	float aDistance = a->GetIncursionDistance( TF_TEAM_BLUE );
+	float bDistance = b->GetIncursionDistance( TF_TEAM_BLUE );
+
+	if ( aDistance != bDistance )
 	{
-		return NULL;
+		return aDistance < bDistance;
 	}
 
-#ifdef TF_RAID_MODE
-	CTFPlayer *farRaider = g_pRaidLogic->GetFarthestAlongRaider();
+	return a->GetID() < b->GetID();
+}
 
-	if ( !farRaider )
+//-----------------------------------------------------------------------
+// Collect the areas surrounding the given invader into the theater
+void CPopulatorSpawnTheater::AddInvaderAreas( Invader *invader )
+{
+	CUtlVector< CNavArea * > nearbyAreaVector;
+	CollectSurroundingAreas( &nearbyAreaVector, invader->m_area, m_range );
+
+	invader->m_areaVector.RemoveAll();
+	invader->m_areaVector.EnsureCapacity( nearbyAreaVector.Count() );
+
+	for( int i=0; i<nearbyAreaVector.Count(); ++i )
 	{
-		return NULL;
+		CTFNavArea *area = (CTFNavArea *)nearbyAreaVector[i];
+		invader->m_areaVector.AddToTail( area );
+
+		UtlHashHandle_t h = m_areaRefCount.Find( area );
+		if ( h == m_areaRefCount.InvalidHandle() )
+		{
+			m_areaRefCount.Insert( area, 1 );
+			m_areaVector.Insert( area );
+		}
+		else
+		{
+			++m_areaRefCount.Element( h );
+		}
 	}
-#endif // TF_RAID_MODE
+}
 
-	//
-	// Collect all areas surrounding the invading team and
-	// build a vector sorted by increasing incursion distance
-	//
-	CUtlSortVector< CTFNavArea *, CTFNavAreaIncursionLess > theaterAreaVector;
+//-----------------------------------------------------------------------
+// Remove the areas surrounding the given invader, unless another invader also surrounds them
+void CPopulatorSpawnTheater::RemoveInvaderAreas( Invader *invader )
+{
+	for( int i=0; i<invader->m_areaVector.Count(); ++i )
+	{
+		CTFNavArea *area = invader->m_areaVector[i];
+
+		UtlHashHandle_t h = m_areaRefCount.Find( area );
+		if ( h == m_areaRefCount.InvalidHandle() )
+			continue;
+
+		if ( --m_areaRefCount.Element( h ) <= 0 )
+		{
+			m_areaRefCount.Remove( area );
+
+			// incursion distances may have changed since the last sort, so fall back to a linear search
+			int which = m_areaVector.Find( area );
+			if ( which == m_areaVector.InvalidIndex() )
+			{
+				which = m_areaVector.FindUnsorted( area );
+			}
+
+			Assert( which != m_areaVector.InvalidIndex() );
+			if ( which != m_areaVector.InvalidIndex() )
+			{
+				m_areaVector.Remove( which );
+			}
+		}
+	}
 
-	CTFNavArea::MakeNewTFMarker();
+	invader->m_areaVector.RemoveAll();
+}
+
+//-----------------------------------------------------------------------
+// Bring the theater up to date with the invading team. Only invaders
+// that have entered a new nav area since the last update are revisited.
+void CPopulatorSpawnTheater::Update( void )
+{
+	VPROF_BUDGET( "CPopulatorSpawnTheater::Update", "NextBot" );
+
+	if ( m_navAreaCount != TheNavAreas.Count() || m_range != tf_populator_active_buffer_range.GetFloat() )
+	{
+		// the mesh or the theater size has changed - start over
+		Reset();
+
+		m_navAreaCount = TheNavAreas.Count();
+		m_range = tf_populator_active_buffer_range.GetFloat();
+	}
+
+	if ( m_incursionVersion != TheTFNavMesh()->GetIncursionVersion() )
+	{
+		// areas are sorted by incursion distance
+		m_incursionVersion = TheTFNavMesh()->GetIncursionVersion();
+		m_areaVector.RedoSort( true );
+	}
+
+	for( int i=0; i<m_invaderVector.Count(); ++i )
+	{
+		m_invaderVector[i].m_isPresent = false;
+	}
 
 	CTeam *team = GetGlobalTeam( TF_TEAM_BLUE );
 	for( int t=0; t<team->GetNumPlayers(); ++t )
@@ -337,82 +443,141 @@ CTFNavArea *CSpawnLocation::SelectSpawnArea( void ) const
 		if ( bot && bot->HasAttribute( CTFBot::IS_NPC ) )
 			continue;
 
-		if ( teamMember->GetLastKnownArea() == NULL )
+		CTFNavArea *area = (CTFNavArea *)teamMember->GetLastKnownArea();
+		if ( area == NULL )
 			continue;
 
-		// collect areas surrounding this invader
-		CUtlVector< CNavArea * > nearbyAreaVector;
-		CollectSurroundingAreas( &nearbyAreaVector, teamMember->GetLastKnownArea(), tf_populator_active_buffer_range.GetFloat() );
-
-		for( int i=0; i<nearbyAreaVector.Count(); ++i )
+		Invader *invader = NULL;
+		for( int i=0; i<m_invaderVector.Count(); ++i )
 		{
-			CTFNavArea *area = (CTFNavArea *)nearbyAreaVector[i];
-
-			if ( !area->IsTFMarked() )
-			{		
-				area->TFMark();
-
-				if ( area->IsPotentiallyVisibleToTeam( TF_TEAM_BLUE ) )
-					continue;
+			if ( m_invaderVector[i].m_player == teamMember )
+			{
+				invader = &m_invaderVector[i];
+				break;
+			}
+		}
 
-				if ( !area->IsValidForWanderingPopulation() )
-					continue;
+		if ( invader == NULL )
+		{
+			invader = &m_invaderVector[ m_invaderVector.AddToTail() ];
+			invader->m_player = teamMember;
+			invader->m_area = NULL;
+		}
 
-				theaterAreaVector.Insert( area );
+		invader->m_isPresent = true;
 
-				if ( tf_populator_debug.GetBool() )
-				{
-					TheTFNavMesh()->AddToSelectedSet( area );
-				}
-			}
+		if ( invader->m_area != area )
+		{
+			// this invader has moved - recollect the areas around them
+			RemoveInvaderAreas( invader );
+			invader->m_area = area;
+			AddInvaderAreas( invader );
 		}
 	}
 
-	if ( theaterAreaVector.Count() == 0 )
+	// remove invaders that have died or left the team
+	for( int i=m_invaderVector.Count()-1; i>=0; --i )
 	{
-		if ( tf_populator_debug.GetBool() ) 
+		if ( !m_invaderVector[i].m_isPresent )
 		{
-			DevMsg( "%3.2f: SelectSpawnArea: Empty theater!\n", gpGlobals->curtime );
+			RemoveInvaderAreas( &m_invaderVector[i] );
+			m_invaderVector.Remove( i );
 		}
-		return NULL;
 	}
+}
 
-	const int maxRetries = 5;
-	CTFNavArea *spawnArea = NULL;
+//-----------------------------------------------------------------------
+// Return true if spawning in the given theater area right now won't be seen
+static bool IsSpawnableTheaterArea( CTFNavArea *area )
+{
+	return !area->IsPotentiallyVisibleToTeam( TF_TEAM_BLUE ) && area->IsValidForWanderingPopulation();
+}
 
-	for( int r=0; r<maxRetries; ++r )
+//-----------------------------------------------------------------------
+// Choose an index into 'count' areas sorted from behind to ahead
+int CSpawnLocation::SelectTheaterIndex( int count ) const
+{
+	int which = 0;
+
+	switch( m_relative )
 	{
-		int which = 0;
+	case AHEAD:
+		// areas are sorted from behind to ahead - weight the selection to choose ahead
+		which = SkewedRandomValue() * count;
+		break;
 
-		switch( m_relative )
-		{
-		case AHEAD:
-			// areas are sorted from behind to ahead - weight the selection to choose ahead
-			which = SkewedRandomValue() * theaterAreaVector.Count();
-			break;
+	case BEHIND:
+		// areas are sorted from behind to ahead - weight the selection to choose behind
+		which = ( 1.0f - SkewedRandomValue() ) * count;
+		break;
 
-		case BEHIND:
-			// areas are sorted from behind to ahead - weight the selection to choose behind
-			which = ( 1.0f - SkewedRandomValue() ) * theaterAreaVector.Count();
-			break;
+	case ANYWHERE:
+		// choose any valid area at random
+		which = RandomFloat( 0.0f, 1.0f ) * count;
+		break;
+	}
 
-		case ANYWHERE:
-			// choose any valid area at random
-			which = RandomFloat( 0.0f, 1.0f ) * theaterAreaVector.Count();
-			break;
-		}
+	if ( which >= count )
+		which = count-1;
 
-		if ( which >= theaterAreaVector.Count() )
-			which = theaterAreaVector.Count()-1;
+	return which;
+}
 
-		spawnArea = theaterAreaVector[ which ];
+//-----------------------------------------------------------------------
+CTFNavArea *CSpawnLocation::SelectSpawnArea( void ) const
+{
+	VPROF_BUDGET( "CSpawnLocation::SelectSpawnArea", "NextBot" );
 
-		// well behaved spawn area
-		return spawnArea;
-		
+	if ( m_relative == UNDEFINED )
+	{
+		return NULL;
 	}
 
-	return NULL;
+#ifdef TF_RAID_MODE
+	CTFPlayer *farRaider = g_pRaidLogic->GetFarthestAlongRaider();
+
+	if ( !farRaider )
+	{
+		return NULL;
+	}
+#endif // TF_RAID_MODE
+
+	//
+	// The theater holds all areas surrounding the invading team,
+	// sorted by increasing incursion distance
+	//
+	CPopulatorSpawnTheater &theater = TheSpawnTheater();
+	theater.Update();
+
+	// visibility changes constantly, so filter the theater at the time of the draw,
+	// keeping the behind to ahead order the skewed selection depends on
+	CUtlVector< CTFNavArea * > spawnableAreaVector;
+	spawnableAreaVector.EnsureCapacity( theater.GetAreaCount() );
+	for( int i=0; i<theater.GetAreaCount(); ++i )
+	{
+		CTFNavArea *area = theater.GetArea(i);
+
+		if ( IsSpawnableTheaterArea( area ) )
+		{
+			spawnableAreaVector.AddToTail( area );
+
+			if ( tf_populator_debug.GetBool() )
+			{
+				TheTFNavMesh()->AddToSelectedSet( area );
+			}
+		}
+	}
+
+	if ( spawnableAreaVector.Count() == 0 )
+	{
+		if ( tf_populator_debug.GetBool() ) 
+		{
+			DevMsg( "%3.2f: SelectSpawnArea: Empty theater!\n", gpGlobals->curtime );
+		}
+		return NULL;
+	}
+
+	return spawnableAreaVector[ SelectTheaterIndex( spawnableAreaVector.Count() ) ];
 }
 
 //-----------------------------------------------------------------------
@@ -7,6 +7,7 @@
 #define TF_POPULATORS_H
 
 #include "tf_population_manager.h"
+#include "utlhashtable.h"
 
 class KeyValues;
 class IPopulator;
@@ -15,6 +16,51 @@ class CPopulationManager;
 class CWave;
 class CSpawnLocation;
 
+//-----------------------------------------------------------------------
+// The nav areas surrounding the invading team, where "Ahead", "Behind",
+// and "Anywhere" spawns are placed. Areas are kept sorted by incursion
+// distance, and only the areas around invaders that have moved to a
+// new nav area are recollected.
+class CPopulatorSpawnTheater
+{
+public:
+	CPopulatorSpawnTheater( void );
+
+	void Reset( void );
+	void Update( void );						// bring the theater up to date with the invading team
+
+	int GetAreaCount( void ) const				{ return m_areaVector.Count(); }
+	CTFNavArea *GetArea( int i ) const			{ return m_areaVector[i]; }		// areas are sorted from behind to ahead
+
+private:
+	struct Invader
+	{
+		CHandle< CTFPlayer > m_player;
+		CTFNavArea *m_area;						// the area m_areaVector was collected around
+		CUtlVector< CTFNavArea * > m_areaVector;
+		bool m_isPresent;
+	};
+	CUtlVector< Invader > m_invaderVector;
+
+	void AddInvaderAreas( Invader *invader );
+	void RemoveInvaderAreas( Invader *invader );
+
+	class CAreaIncursionLess
+	{
+	public:
+		bool Less( const CTFNavArea *a, const CTFNavArea *b, void *pCtx );
+	};
+	CUtlSortVector< CTFNavArea *, CAreaIncursionLess > m_areaVector;
+	CUtlHashtable< const void *, int, PointerHashFunctor, PointerEqualFunctor > m_areaRefCount;	// the number of invaders surrounded by each area
+
+	int m_navAreaCount;							// the state of the nav mesh the theater was built for
+	unsigned int m_incursionVersion;
+	float m_range;
+};
+
+extern CPopulatorSpawnTheater &TheSpawnTheater( void );
+
+
 //-----------------------------------------------------------------------
 class CSpawnLocation
 {
@@ -29,6 +75,7 @@ public:
 
 private:
 	CTFNavArea *SelectSpawnArea( void ) const;
+	int SelectTheaterIndex( int count ) const;
 
 	RelativePositionType m_relative;
 	TFTeamSpawnVector_t m_teamSpawnVector;
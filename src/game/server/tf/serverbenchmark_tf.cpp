@@ -10,9 +10,14 @@
 #include "tf_bot_temp.h"
 #include "entity_tfstart.h"
 #include "tf_player.h"
+#include "tf_gamerules.h"
+#include "tf_objective_resource.h"
+#include "player_vs_environment/tf_population_manager.h"
+#include "KeyValues.h"
 
 
 static ConVar sv_benchmark_freeroam( "sv_benchmark_freeroam", "0", 0, "Allow the local player to move freely in the benchmark. Only used for debugging. Don't use for real benchmarks because it will make the timing inconsistent." );
+static ConVar sv_benchmark_mvm_popfile( "sv_benchmark_mvm_popfile", "", 0, "On a Mann vs. Machine map, the population file the benchmark plays (as for tf_mvm_popfile). Empty plays the map's default mission." );
 
 
 class CTFServerBenchmark : public CServerBenchmarkHook
@@ -31,6 +36,13 @@ public:
 
 		m_nBotsCreated = 0;
 		m_bSetupLocalPlayer = false;
+		m_bSetupMission = false;
+		m_nWavesStarted = 0;
+	}
+
+	bool IsMannVsMachine() const
+	{
+		return TFGameRules() && TFGameRules()->IsMannVsMachineMode();
 	}
 
 	virtual void GetPhysicsModelNames( CUtlVector<char*> &modelNames )
@@ -134,10 +146,87 @@ public:
 		}
 
 		RespawnDeadPlayers();
-		MoveRedPlayersToBlueArea();
+
+		if ( IsMannVsMachine() )
+		{
+			// The robots come to the defenders, so leave them where they are.
+			UpdateMission();
+		}
+		else
+		{
+			MoveRedPlayersToBlueArea();
+		}
+
 		AddSentries();
 	}
 
+	// In Mann vs. Machine, the defenders are puppet bots and the invaders come from the real 
+	// population manager, so this runs the same mission code a live server does.
+	void UpdateMission()
+	{
+		if ( !g_pPopulationManager || !TFObjectiveResource() )
+			return;
+
+		if ( !m_bSetupMission )
+		{
+			m_bSetupMission = true;
+
+			const char *pszPopfile = sv_benchmark_mvm_popfile.GetString();
+			if ( pszPopfile[0] )
+			{
+				CUtlString fullPath;
+				if ( !g_pPopulationManager->FindPopulationFileByShortName( pszPopfile, fullPath ) || !g_pPopulationManager->IsValidPopfile( fullPath ) )
+					Error( "Server benchmark: Can't find population file %s.", pszPopfile );
+
+				if ( V_strcmp( g_pPopulationManager->GetPopulationFilename(), fullPath ) )
+				{
+					g_pPopulationManager->SetPopulationFilename( fullPath );
+					g_pPopulationManager->ResetMap();
+				}
+			}
+		}
+
+		// Nobody readies up during a benchmark, so start each wave as soon as all the defenders are in.
+		if ( m_nBotsCreated < tf_mvm_defenders_team_size.GetInt() )
+			return;
+
+		if ( TFGameRules()->State_Get() == GR_STATE_GAME_OVER || TFGameRules()->State_Get() == GR_STATE_TEAM_WIN )
+			return;
+
+		if ( TFObjectiveResource()->GetMannVsMachineIsBetweenWaves() && g_pPopulationManager->GetTotalWaveCount() > 0 )
+		{
+			g_pPopulationManager->StartCurrentWave();
+			++m_nWavesStarted;
+		}
+	}
+
+	virtual void GetReportNodeNames( CUtlVector<const char*> &nodeNames )
+	{
+		nodeNames.AddToTail( "NextBotManager::UpdateSensePhase" );
+		nodeNames.AddToTail( "INextBot::Update" );
+		nodeNames.AddToTail( "IVision::Update" );
+		nodeNames.AddToTail( "PathFollower::Update" );
+		nodeNames.AddToTail( "Path::Compute(goal)" );
+		nodeNames.AddToTail( "NextBotPathCache::Compute" );
+		nodeNames.AddToTail( "CMissionPopulator::Update" );		// CPopulationManager::Update
+		nodeNames.AddToTail( "CWaveSpawnPopulator::Update" );
+		nodeNames.AddToTail( "CAttributeManager::AttribHookValue" );
+		nodeNames.AddToTail( "CAttributeManager::ApplyAttributeFloatWrapper" );
+		nodeNames.AddToTail( "Physics_SimulateEntity" );
+		nodeNames.AddToTail( "CTFPlayer::PlayerRunCommand" );
+	}
+
+	virtual void AddReportResults( KeyValues *pReport )
+	{
+		if ( !IsMannVsMachine() || !g_pPopulationManager )
+			return;
+
+		pReport->SetString( "mvm_popfile", g_pPopulationManager->GetPopulationFilename() );
+		pReport->SetInt( "mvm_wave", g_pPopulationManager->GetWaveNumber() + 1 );
+		pReport->SetInt( "mvm_wave_count", g_pPopulationManager->GetTotalWaveCount() );
+		pReport->SetInt( "mvm_waves_started", m_nWavesStarted );
+	}
+
 	void RespawnDeadPlayers()
 	{
 		for ( int i = 1; i <= gpGlobals->maxClients; i++ )
@@ -158,6 +247,10 @@ public:
 		{
 			int iTeam = (iTeamIteration == 0) ? TF_TEAM_BLUE : TF_TEAM_RED;
 
+			// The invaders' engineers are run by the mission.
+			if ( iTeam == TF_TEAM_PVE_INVADERS && IsMannVsMachine() )
+				continue;
+
 			// Get the current # of sentries.
 			int nSentries = 0;
 			CBaseEntity *pSpot = gEntList.FindEntityByClassname( NULL, pSentryClassName );
@@ -208,6 +301,9 @@ public:
 
 	virtual CBasePlayer* CreateBot()
 	{
+		if ( IsMannVsMachine() )
+			return CreateDefenderBot();
+
 		int iTeam = (g_pServerBenchmark->RandomInt( 0, 1 ) == 1) ? TF_TEAM_BLUE : TF_TEAM_RED;
 		if ( m_nBotsCreated == 0 )
 			iTeam = TF_TEAM_BLUE;
@@ -224,9 +320,31 @@ public:
 		return pPlayer;
 	}
 
+	// Fill the defending team with a fixed lineup, engineers first so they'll build sentries.
+	CBasePlayer* CreateDefenderBot()
+	{
+		if ( m_nBotsCreated >= tf_mvm_defenders_team_size.GetInt() )
+			return NULL;
+
+		static const int s_DefenderClasses[] = 
+		{
+			TF_CLASS_ENGINEER, TF_CLASS_SOLDIER, TF_CLASS_HEAVYWEAPONS, TF_CLASS_MEDIC, TF_CLASS_DEMOMAN, TF_CLASS_PYRO
+		};
+		int iClass = s_DefenderClasses[ m_nBotsCreated % ARRAYSIZE( s_DefenderClasses ) ];
+
+		CBasePlayer *pPlayer = BotPutInServer( false, false, TF_TEAM_PVE_DEFENDERS, iClass, NULL );
+		if ( !pPlayer )
+			Error( "Server benchmark: Can't create bot." );
+
+		++m_nBotsCreated;
+		return pPlayer;
+	}
+
 private:
 	int m_nBotsCreated;
 	bool m_bSetupLocalPlayer;
+	bool m_bSetupMission;
+	int m_nWavesStarted;
 	
 	Vector m_vLocalPlayerOrigin;
 	QAngle m_vLocalPlayerEyeAngles;
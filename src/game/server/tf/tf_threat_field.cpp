@@ -0,0 +1,141 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-tick snapshot of the living players on each team, for proximity queries
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "tf_player.h"
+#include "tf_threat_field.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+// how far a player might move between the snapshot and a query later in the same tick
+#define TF_THREAT_FIELD_MOVE_TOLERANCE	50.0f
+
+
+//-----------------------------------------------------------------------------
+CTFThreatField &CTFThreatField::GetInstance( void )
+{
+	static CTFThreatField field;
+	return field;
+}
+
+
+//-----------------------------------------------------------------------------
+CTFThreatField &TheTFThreatField( void )
+{
+	CTFThreatField &field = CTFThreatField::GetInstance();
+	field.Update();
+	return field;
+}
+
+
+//-----------------------------------------------------------------------------
+CTFThreatField::CTFThreatField( void )
+{
+	Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+void CTFThreatField::Reset( void )
+{
+	m_tick = -1;
+
+	for( int team=0; team<TF_TEAM_COUNT; ++team )
+	{
+		m_threatVector[ team ].RemoveAll();
+		m_maxRadius[ team ] = 0.0f;
+	}
+
+	m_cellTable.RemoveAll();
+}
+
+
+//-----------------------------------------------------------------------------
+void CTFThreatField::Update( void )
+{
+	if ( m_tick == gpGlobals->tickcount )
+		return;
+
+	Build();
+
+	m_tick = gpGlobals->tickcount;
+}
+
+
+//-----------------------------------------------------------------------------
+int CTFThreatField::CompareThreatCells( const Threat *a, const Threat *b )
+{
+	int cellA = GetCellKey( 0, GetCellCoordinate( a->m_center.x ), GetCellCoordinate( a->m_center.y ) );
+	int cellB = GetCellKey( 0, GetCellCoordinate( b->m_center.x ), GetCellCoordinate( b->m_center.y ) );
+
+	return cellA - cellB;
+}
+
+
+//-----------------------------------------------------------------------------
+void CTFThreatField::Build( void )
+{
+	VPROF_BUDGET( "CTFThreatField::Build", VPROF_BUDGETGROUP_GAME );
+
+	Reset();
+
+	CUtlVector< CTFPlayer * > playerVector;
+	CollectPlayers( &playerVector, TEAM_ANY, COLLECT_ONLY_LIVING_PLAYERS );
+
+	FOR_EACH_VEC( playerVector, i )
+	{
+		CTFPlayer *player = playerVector[i];
+
+		int team = player->GetTeamNumber();
+		if ( team < 0 || team >= TF_TEAM_COUNT )
+			continue;
+
+		Threat &threat = m_threatVector[ team ][ m_threatVector[ team ].AddToTail() ];
+
+		threat.m_player = player;
+		threat.m_center = player->WorldSpaceCenter();
+		threat.m_radius = player->CollisionProp()->BoundingRadius() + TF_THREAT_FIELD_MOVE_TOLERANCE;
+
+		// the state bots check when forgetting spies they have lost sight of
+		threat.m_flags = 0;
+
+		if ( player->IsPlayerClass( TF_CLASS_SPY ) )
+			threat.m_flags |= THREAT_SPY;
+
+		if ( player->m_Shared.InCond( TF_COND_DISGUISING ) )
+			threat.m_flags |= THREAT_DISGUISING;
+
+		m_maxRadius[ team ] = MAX( m_maxRadius[ team ], threat.m_radius );
+	}
+
+	// bucket each team's threats by cell
+	for( int team=0; team<TF_TEAM_COUNT; ++team )
+	{
+		CUtlVector< Threat > &threatVector = m_threatVector[ team ];
+		threatVector.Sort( CompareThreatCells );
+
+		CellRange range;
+		range.m_start = 0;
+
+		for( int i=0; i<threatVector.Count(); ++i )
+		{
+			int cell = GetCellKey( team, GetCellCoordinate( threatVector[i].m_center.x ), GetCellCoordinate( threatVector[i].m_center.y ) );
+
+			if ( i+1 < threatVector.Count() )
+			{
+				int nextCell = GetCellKey( team, GetCellCoordinate( threatVector[i+1].m_center.x ), GetCellCoordinate( threatVector[i+1].m_center.y ) );
+				if ( nextCell == cell )
+					continue;
+			}
+
+			range.m_end = i+1;
+			m_cellTable.Insert( cell, range );
+			range.m_start = i+1;
+		}
+	}
+}
@@ -0,0 +1,196 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-tick snapshot of the living players on each team, for proximity queries
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef TF_THREAT_FIELD_H
+#define TF_THREAT_FIELD_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "utlhashtable.h"
+#include "tf_shareddefs.h"
+
+class CTFPlayer;
+
+#define TF_THREAT_FIELD_CELL_SIZE		512.0f			// short range queries, such as crowd avoidance, touch 1-4 cells
+#define TF_THREAT_FIELD_HALF_WIDTH		64				// cells on each side of the origin, enough to cover MAX_COORD_INTEGER
+#define TF_THREAT_FIELD_MAX_QUERY_CELLS	9				// queries covering more cells than this scan the team instead
+
+//-----------------------------------------------------------------------------
+// The living players on each team, gathered once per tick instead of by every bot
+// that looks for nearby players. The players of each team are bucketed into a coarse
+// grid, so short range queries, such as bots avoiding teammates or finding the closest
+// enemy to back away from, only visit the players in the nearby cells. Long range
+// queries, such as for vision, would cover most of a team's players anyway, so they
+// just range check the team's list.
+//
+// Positions are those at the time of the snapshot, so callers should use them to
+// cull candidates, and make their final range and visibility checks against the
+// players themselves.
+//-----------------------------------------------------------------------------
+class CTFThreatField
+{
+public:
+	CTFThreatField( void );
+
+	static CTFThreatField &GetInstance( void );	// the threat field as last built, without bringing it up to date
+
+	enum ThreatFlags
+	{
+		THREAT_SPY						= 0x01,
+		THREAT_DISGUISING				= 0x02,
+	};
+
+	struct Threat
+	{
+		CTFPlayer *m_player;
+		Vector m_center;					// WorldSpaceCenter()
+		float m_radius;						// bounding radius around m_center, plus some slack for movement during the tick
+		int m_flags;
+
+		bool HasFlag( int flag ) const		{ return ( m_flags & flag ) ? true : false; }
+
+		bool IsWithinRange( const Vector &pos, float range ) const
+		{
+			float reach = range + m_radius;
+			return ( m_center - pos ).LengthSqr() <= reach * reach;
+		}
+	};
+
+	void Update( void );					// rebuild the snapshot if it is not from this tick
+	void Reset( void );
+
+	int GetThreatCount( int team ) const;
+	const Threat &GetThreat( int team, int i ) const;
+
+	/**
+	 * Invoke func( const Threat &threat ) for each living player on the given team whose
+	 * bounding sphere came within 'radius' of 'pos' at the time of the snapshot.
+	 * If the functor returns false, stop processing and return false.
+	 */
+	template < typename Functor >
+	bool ForEachThreatInRadius( int team, const Vector &pos, float radius, Functor &func ) const;
+
+private:
+	int m_tick;								// tick the snapshot was taken, or -1
+
+	CUtlVector< Threat > m_threatVector[ TF_TEAM_COUNT ];	// sorted by cell
+	float m_maxRadius[ TF_TEAM_COUNT ];
+
+	struct CellRange
+	{
+		int m_start;
+		int m_end;
+	};
+	CUtlHashtable< int, CellRange > m_cellTable;			// cell key -> range of m_threatVector for the key's team
+
+	static int GetCellCoordinate( float value );
+	static int GetCellKey( int team, int x, int y );
+	static int CompareThreatCells( const Threat *a, const Threat *b );
+
+	void Build( void );
+};
+
+
+//-----------------------------------------------------------------------------
+inline int CTFThreatField::GetCellCoordinate( float value )
+{
+	// cells beyond the edge of the world are folded into the last one
+	return clamp( (int)floor( value / TF_THREAT_FIELD_CELL_SIZE ), -TF_THREAT_FIELD_HALF_WIDTH, TF_THREAT_FIELD_HALF_WIDTH - 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+inline int CTFThreatField::GetCellKey( int team, int x, int y )
+{
+	const int width = 2 * TF_THREAT_FIELD_HALF_WIDTH;
+	return ( team * width + y + TF_THREAT_FIELD_HALF_WIDTH ) * width + x + TF_THREAT_FIELD_HALF_WIDTH;
+}
+
+
+//-----------------------------------------------------------------------------
+inline int CTFThreatField::GetThreatCount( int team ) const
+{
+	if ( team < 0 || team >= TF_TEAM_COUNT )
+		return 0;
+
+	return m_threatVector[ team ].Count();
+}
+
+
+//-----------------------------------------------------------------------------
+inline const CTFThreatField::Threat &CTFThreatField::GetThreat( int team, int i ) const
+{
+	return m_threatVector[ team ][ i ];
+}
+
+
+//-----------------------------------------------------------------------------
+template < typename Functor >
+inline bool CTFThreatField::ForEachThreatInRadius( int team, const Vector &pos, float radius, Functor &func ) const
+{
+	if ( team < 0 || team >= TF_TEAM_COUNT )
+		return true;
+
+	const CUtlVector< Threat > &threatVector = m_threatVector[ team ];
+	if ( threatVector.Count() == 0 )
+		return true;
+
+	// cells whose threats might be within 'radius'
+	const float reach = radius + m_maxRadius[ team ];
+
+	int loX = GetCellCoordinate( pos.x - reach );
+	int hiX = GetCellCoordinate( pos.x + reach );
+	int loY = GetCellCoordinate( pos.y - reach );
+	int hiY = GetCellCoordinate( pos.y + reach );
+
+	// long range queries, or ones covering more cells than there are threats, just test them all
+	const int cellCount = ( hiX - loX + 1 ) * ( hiY - loY + 1 );
+	if ( cellCount > TF_THREAT_FIELD_MAX_QUERY_CELLS || cellCount >= threatVector.Count() )
+	{
+		FOR_EACH_VEC( threatVector, i )
+		{
+			const Threat &threat = threatVector[i];
+			if ( !threat.IsWithinRange( pos, radius ) )
+				continue;
+
+			if ( func( threat ) == false )
+				return false;
+		}
+
+		return true;
+	}
+
+	for( int y = loY; y <= hiY; ++y )
+	{
+		for( int x = loX; x <= hiX; ++x )
+		{
+			UtlHashHandle_t h = m_cellTable.Find( GetCellKey( team, x, y ) );
+			if ( h == m_cellTable.InvalidHandle() )
+				continue;
+
+			const CellRange &range = m_cellTable.Element( h );
+			for( int i = range.m_start; i < range.m_end; ++i )
+			{
+				const Threat &threat = threatVector[i];
+				if ( !threat.IsWithinRange( pos, radius ) )
+					continue;
+
+				if ( func( threat ) == false )
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+extern CTFThreatField &TheTFThreatField( void );		// the threat field, updated to the current tick
+
+
+#endif // TF_THREAT_FIELD_H
@@ -11,6 +11,7 @@
 #include "saverestore_utlvector.h"
 #include "fmtstr.h"
 #include "KeyValues.h"
+#include "utlcommon.h"
 #include "econ_item_system.h"
 
 #if defined( TF_DLL ) || defined( TF_CLIENT_DLL )
@@ -20,6 +21,9 @@
 #define PROVIDER_PARITY_BITS		6
 #define PROVIDER_PARITY_MASK		((1<<PROVIDER_PARITY_BITS)-1)
 
+#define ATTRIB_CACHE_INITIAL_SIZE	16						// must be a power of two
+#define ATTRIB_CACHE_MAX_ITEMS		256						// item references we'll hold on to before we stop caching item lists
+
 //==================================================================================================================
 // ATTRIBUTE MANAGER SAVE/LOAD & NETWORKING
 //===================================================================================================================
@@ -129,6 +133,8 @@ CAttributeManager::CAttributeManager()
 {
 	m_nCalls = 0;
 	m_nCurrentTick = 0;
+	m_nCachedResults = 0;
+	m_iCacheGeneration = 1;
 }
 
 #ifdef CLIENT_DLL
@@ -256,7 +262,7 @@ void CAttributeManager::ClearCache( void )
 	if ( m_bPreventLoopback )
 		return;
 
-	m_CachedResults.Purge();
+	InvalidateCachedResults();
 
 	m_bPreventLoopback = true;
 
@@ -286,6 +292,25 @@ void CAttributeManager::ClearCache( void )
 #endif
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Throw away our own cached results, without touching anyone else's
+//-----------------------------------------------------------------------------
+void CAttributeManager::InvalidateCachedResults( void )
+{
+	VPROF_INCREMENT_COUNTER( "CAttributeManager cache invalidations", 1 );
+
+	m_nCachedResults = 0;
+	m_CachedItems.RemoveAll();
+
+	// Entries from older generations are treated as empty slots. If we ever wrap around
+	// we have to really clear the table so ancient entries can't come back to life.
+	if ( ++m_iCacheGeneration == 0 )
+	{
+		m_CachedResults.Purge();
+		m_iCacheGeneration = 1;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -298,6 +323,162 @@ int	CAttributeManager::GetGlobalCacheVersion() const
 #endif 
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Have we requested a global attribute cache flush?
+//-----------------------------------------------------------------------------
+void CAttributeManager::CheckGlobalCacheVersion( void )
+{
+	const int iGlobalCacheVersion = GetGlobalCacheVersion();
+	if ( m_iCacheVersion != iGlobalCacheVersion )
+	{
+		// Every manager (including the client's) checks the global version itself before
+		// using its cache, so there's no need to push the flush out to receivers and owners.
+		InvalidateCachedResults();
+		m_iCacheVersion = iGlobalCacheVersion;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Return the live cached result for the hook, if we have one
+//-----------------------------------------------------------------------------
+CAttributeManager::cached_attribute_t *CAttributeManager::FindCachedResult( string_t iszAttribHook )
+{
+	if ( m_nCachedResults == 0 )
+		return NULL;
+
+	// Hook strings are pooled, so the pointer identifies the hook. Live entries are always
+	// contiguous from their home slot, so the first stale slot ends the probe.
+	const int iMask = m_CachedResults.Count() - 1;
+	for ( int i = PointerHashFunctor()( STRING( iszAttribHook ) ) & iMask; ; i = ( i + 1 ) & iMask )
+	{
+		cached_attribute_t &entry = m_CachedResults[i];
+		if ( entry.iGeneration != m_iCacheGeneration )
+			return NULL;
+
+		if ( entry.iAttribHook == iszAttribHook )
+			return &entry;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Claim a slot for a hook that isn't in the cache
+//-----------------------------------------------------------------------------
+CAttributeManager::cached_attribute_t *CAttributeManager::AddCachedResult( string_t iszAttribHook )
+{
+	// Keep the table at most half full so probes stay short
+	if ( ( m_nCachedResults + 1 ) * 2 > m_CachedResults.Count() )
+	{
+		GrowCachedResults();
+	}
+
+	const int iMask = m_CachedResults.Count() - 1;
+	int i = PointerHashFunctor()( STRING( iszAttribHook ) ) & iMask;
+	while ( m_CachedResults[i].iGeneration == m_iCacheGeneration )
+	{
+		Assert( m_CachedResults[i].iAttribHook != iszAttribHook );
+		i = ( i + 1 ) & iMask;
+	}
+
+	cached_attribute_t &entry = m_CachedResults[i];
+	entry.iAttribHook = iszAttribHook;
+	entry.iGeneration = m_iCacheGeneration;
+	entry.iFirstItem = -1;
+	entry.nItems = 0;
+	++m_nCachedResults;
+
+	return &entry;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Double the size of the cache table, keeping the live entries
+//-----------------------------------------------------------------------------
+void CAttributeManager::GrowCachedResults( void )
+{
+	CUtlVector<cached_attribute_t> oldResults;
+	oldResults.Swap( m_CachedResults );
+
+	const int iNewSize = oldResults.Count() ? oldResults.Count() * 2 : ATTRIB_CACHE_INITIAL_SIZE;
+	m_CachedResults.SetCount( iNewSize );
+	FOR_EACH_VEC( m_CachedResults, i )
+	{
+		m_CachedResults[i].iGeneration = 0;
+	}
+
+	m_nCachedResults = 0;
+	FOR_EACH_VEC( oldResults, i )
+	{
+		const cached_attribute_t &oldEntry = oldResults[i];
+		if ( oldEntry.iGeneration != m_iCacheGeneration )
+			continue;
+
+		cached_attribute_t *pEntry = AddCachedResult( oldEntry.iAttribHook );
+		*pEntry = oldEntry;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Remember which items contributed to a cached result
+//-----------------------------------------------------------------------------
+void CAttributeManager::SetCachedItems( cached_attribute_t *pEntry, const CUtlVector<CBaseEntity*> &itemList )
+{
+	// Results for other inputs that got overwritten leave their items behind until the next
+	// invalidation, so stop recording item lists if something is churning through them.
+	if ( m_CachedItems.Count() + itemList.Count() > ATTRIB_CACHE_MAX_ITEMS )
+	{
+		pEntry->iFirstItem = -1;
+		pEntry->nItems = 0;
+		return;
+	}
+
+	pEntry->iFirstItem = m_CachedItems.Count();
+	pEntry->nItems = itemList.Count();
+	FOR_EACH_VEC( itemList, i )
+	{
+		m_CachedItems.AddToTail( itemList[i] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Add the items that contributed to a cached result to the list. Returns
+//			false if the entry doesn't know its items, or one of them has gone away.
+//-----------------------------------------------------------------------------
+bool CAttributeManager::GetCachedItems( const cached_attribute_t *pEntry, CUtlVector<CBaseEntity*> *pItemList ) const
+{
+	if ( pEntry->iFirstItem < 0 )
+		return false;
+
+	for ( int i = 0; i < pEntry->nItems; ++i )
+	{
+		if ( !m_CachedItems[ pEntry->iFirstItem + i ].Get() )
+			return false;
+	}
+
+	for ( int i = 0; i < pEntry->nItems; ++i )
+	{
+		CBaseEntity *pItem = m_CachedItems[ pEntry->iFirstItem + i ].Get();
+		if ( !pItemList->HasElement( pItem ) )
+		{
+			pItemList->AddToTail( pItem );
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Append items the list doesn't already have, as the attribute iterators do
+//-----------------------------------------------------------------------------
+static void AddUniqueItems( const CUtlVector<CBaseEntity*> &itemList, CUtlVector<CBaseEntity*> *pItemList )
+{
+	FOR_EACH_VEC( itemList, i )
+	{
+		if ( !pItemList->HasElement( itemList[i] ) )
+		{
+			pItemList->AddToTail( itemList[i] );
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Return true if this entity is providing attributes to the specified entity
 //-----------------------------------------------------------------------------
@@ -344,44 +525,42 @@ float CAttributeManager::ApplyAttributeFloatWrapper( float flValue, CBaseEntity
 	++m_nCalls;
 #endif
 
-	// Have we requested a global attribute cache flush?
-	const int iGlobalCacheVersion = GetGlobalCacheVersion();
-	if ( m_iCacheVersion != iGlobalCacheVersion )
+	CheckGlobalCacheVersion();
+
+	cached_attribute_t *pEntry = FindCachedResult( iszAttribHook );
+	if ( pEntry && pEntry->in.fl == flValue && ( !pItemList || GetCachedItems( pEntry, pItemList ) ) )
 	{
-		ClearCache();
-		m_iCacheVersion = iGlobalCacheVersion;
+		VPROF_INCREMENT_COUNTER( "CAttributeManager cache hits", 1 );
+		return pEntry->out.fl;
 	}
 
-	// We can't cache off item references so if we asked for them we need to execute the whole slow path.
-	if ( !pItemList )
+	VPROF_INCREMENT_COUNTER( "CAttributeManager cache misses", 1 );
+
+	// Wasn't in cache, or it was for a different input value (i.e. crit chance). Do the work. If we
+	// asked for item references, collect them separately so we can remember which items contributed.
+	CUtlVector<CBaseEntity*> itemList;
+	float flResult = ApplyAttributeFloat( flValue, pInitiator, iszAttribHook, pItemList ? &itemList : NULL );
+
+	// Only keep one result per hook to prevent stacking up entries for different requests. Look
+	// the hook up again, since the table may have been reallocated while we were working.
+	pEntry = FindCachedResult( iszAttribHook );
+	if ( !pEntry )
 	{
-		int iCount = m_CachedResults.Count();
-		for ( int i = iCount-1; i >= 0; i-- )
-		{
-			if ( m_CachedResults[i].iAttribHook == iszAttribHook )
-			{
-				if ( m_CachedResults[i].in.fl == flValue )
-					return m_CachedResults[i].out.fl;
-
-				// We've got a cached result for a different flIn value. Remove the cached result to
-				// prevent stacking up entries for different requests (i.e. crit chance)
-				m_CachedResults.Remove(i);
-				break;
-			}
-		}
+		pEntry = AddCachedResult( iszAttribHook );
 	}
 
-	// Wasn't in cache, or we need item references. Do the work.
-	float flResult = ApplyAttributeFloat( flValue, pInitiator, iszAttribHook, pItemList );
+	pEntry->in.fl = flValue;
+	pEntry->out.fl = flResult;
 
-	// Add it to our cache if we didn't ask for item references. We could add the result value here
-	// even if we did but we'd need to walk the cache to search for an old entry to overwrite first.
-	if ( !pItemList )
+	if ( pItemList )
 	{
-		int iIndex = m_CachedResults.AddToTail();
-		m_CachedResults[iIndex].in.fl = flValue;
-		m_CachedResults[iIndex].out.fl = flResult;
-		m_CachedResults[iIndex].iAttribHook = iszAttribHook;
+		SetCachedItems( pEntry, itemList );
+		AddUniqueItems( itemList, pItemList );
+	}
+	else
+	{
+		pEntry->iFirstItem = -1;
+		pEntry->nItems = 0;
 	}
 
 	return flResult;
@@ -392,46 +571,40 @@ float CAttributeManager::ApplyAttributeFloatWrapper( float flValue, CBaseEntity
 //-----------------------------------------------------------------------------
 string_t CAttributeManager::ApplyAttributeStringWrapper( string_t iszValue, CBaseEntity *pInitiator, string_t iszAttribHook, CUtlVector<CBaseEntity*> *pItemList /*= NULL*/ )
 {
-	// Have we requested a global attribute cache flush?
-	const int iGlobalCacheVersion = GetGlobalCacheVersion();
-	if ( m_iCacheVersion != iGlobalCacheVersion )
+	CheckGlobalCacheVersion();
+
+	cached_attribute_t *pEntry = FindCachedResult( iszAttribHook );
+	if ( pEntry && pEntry->in.isz == iszValue && ( !pItemList || GetCachedItems( pEntry, pItemList ) ) )
 	{
-		ClearCache();
-		m_iCacheVersion = iGlobalCacheVersion;
+		VPROF_INCREMENT_COUNTER( "CAttributeManager cache hits", 1 );
+		return pEntry->out.isz;
 	}
 
-	// We can't cache off item references so if we asked for them we need to execute the whole slow path.
-	if ( !pItemList )
+	VPROF_INCREMENT_COUNTER( "CAttributeManager cache misses", 1 );
+
+	// Wasn't in cache, or it was for a different input value. Do the work.
+	CUtlVector<CBaseEntity*> itemList;
+	string_t iszOut = ApplyAttributeString( iszValue, pInitiator, iszAttribHook, pItemList ? &itemList : NULL );
+
+	// Look again, the table may have been reallocated while we were working
+	pEntry = FindCachedResult( iszAttribHook );
+	if ( !pEntry )
 	{
-		int iCount = m_CachedResults.Count();
-		for ( int i = iCount-1; i >= 0; i-- )
-		{
-			if ( m_CachedResults[i].iAttribHook == iszAttribHook )
-			{
-				if ( m_CachedResults[i].in.isz == iszValue )
-				{
-					return m_CachedResults[i].out.isz;
-				}
-
-				// We've got a cached result for a different flIn value. Remove the cached result to
-				// prevent stacking up entries for different requests (i.e. crit chance)
-				m_CachedResults.Remove(i);
-				break;
-			}
-		}
+		pEntry = AddCachedResult( iszAttribHook );
 	}
 
-	// Wasn't in cache, or we need item references. Do the work.
-	string_t iszOut = ApplyAttributeString( iszValue, pInitiator, iszAttribHook, pItemList );
+	pEntry->in.isz = iszValue;
+	pEntry->out.isz = iszOut;
 
-	// Add it to our cache if we didn't ask for item references. We could add the result value here
-	// even if we did but we'd need to walk the cache to search for an old entry to overwrite first.
-	if ( !pItemList )
+	if ( pItemList )
+	{
+		SetCachedItems( pEntry, itemList );
+		AddUniqueItems( itemList, pItemList );
+	}
+	else
 	{
-		int iIndex = m_CachedResults.AddToTail();
-		m_CachedResults[iIndex].in.isz = iszValue;
-		m_CachedResults[iIndex].out.isz = iszOut;
-		m_CachedResults[iIndex].iAttribHook = iszAttribHook;
+		pEntry->iFirstItem = -1;
+		pEntry->nItems = 0;
 	}
 
 	return iszOut;
@@ -200,13 +200,21 @@ public:
 
 private:
 	void	ClearCache();
+	void	InvalidateCachedResults();
 	int		GetGlobalCacheVersion() const;
+	void	CheckGlobalCacheVersion();
 
 	virtual float	ApplyAttributeFloatWrapper( float flValue, CBaseEntity *pInitiator, string_t iszAttribHook, CUtlVector<CBaseEntity*> *pItemList = NULL );
 	virtual string_t ApplyAttributeStringWrapper( string_t iszValue, CBaseEntity *pInitiator, string_t iszAttribHook, CUtlVector<CBaseEntity*> *pItemList = NULL );
 
 	// Cached attribute results
-	// We cache off requests for data, and wipe the cache whenever our providers change.
+	// We cache off requests for data, one result per hook, in an open-addressed table keyed by the
+	// hook string. Entries are stamped with the generation they were computed in, so invalidating
+	// the cache whenever our providers change is just a generation bump rather than a purge.
+	// Invalidation is still for the whole table, not per provider: a provider change can add a hook
+	// class the provider never contributed before, so invalidating only the entries it touched would
+	// mean tracking every provider's old and new hook classes. Provider changes are rare next to
+	// hook lookups, so we just recompute the hooks that get asked for again.
 	union cached_attribute_types
 	{
 		float fl;
@@ -216,10 +224,22 @@ private:
 	struct cached_attribute_t
 	{
 		string_t	iAttribHook;
+		unsigned int				iGeneration;				// entry is live if this matches m_iCacheGeneration
 		cached_attribute_types		in;
 		cached_attribute_types		out;
+		int							iFirstItem;					// items that contributed to the result, in m_CachedItems, or -1 if not recorded
+		int							nItems;
 	};
-	CUtlVector<cached_attribute_t>	m_CachedResults;
+	CUtlVector<cached_attribute_t>	m_CachedResults;				// power of two sized, linear probing
+	CUtlVector<EHANDLE>				m_CachedItems;
+	int								m_nCachedResults;				// live entries in m_CachedResults
+	unsigned int					m_iCacheGeneration;
+
+	cached_attribute_t *FindCachedResult( string_t iszAttribHook );
+	cached_attribute_t *AddCachedResult( string_t iszAttribHook );
+	void	GrowCachedResults();
+	void	SetCachedItems( cached_attribute_t *pEntry, const CUtlVector<CBaseEntity*> &itemList );
+	bool	GetCachedItems( const cached_attribute_t *pEntry, CUtlVector<CBaseEntity*> *pItemList ) const;
 
 #ifdef CLIENT_DLL
 public:
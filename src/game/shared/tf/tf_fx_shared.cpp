@@ -225,9 +225,23 @@ void FX_FireBullets( CTFWeaponBase *pWpn, int iPlayer, const Vector &vecOrigin,
 	// Fire bullets, calculate impacts & effects.
 	StartGroupingSounds();
 
+	// Get the shooting angles.
+	Vector vecShootForward, vecShootRight, vecShootUp;
+	AngleVectors( vecAngles, &vecShootForward, &vecShootRight, &vecShootUp );
+
 #if !defined (CLIENT_DLL)
-	// Move other players back to history positions based on local player's lag
-	lagcompensation->StartLagCompensation( pPlayer, pPlayer->GetCurrentCommand() );
+	// The spread patterns below keep each bullet within this many multiples of flSpread of the aim direction,
+	// on each axis: 1.07 for the fixed patterns, and twice the variance for random spread.
+	float flMaxSpreadScale = 1.1f;
+	if ( pWpn )
+	{
+		float flFirstShotMult = 0.f;
+		CALL_ATTRIB_HOOK_FLOAT_ON_OTHER( pWpn, flFirstShotMult, mult_spread_scale_first_shot );
+		flMaxSpreadScale = MAX( flMaxSpreadScale, 2.0f * flFirstShotMult );
+	}
+
+	// Move other players back to history positions based on local player's lag, skipping those this shot can't reach
+	lagcompensation->StartLagCompensationForShot( pPlayer, pPlayer->GetCurrentCommand(), vecOrigin, vecShootForward, flSpread * flMaxSpreadScale, pWeaponInfo->GetWeaponData( iMode ).m_flRange );
 	
 	// PASSTIME custom lag compensation for the ball; see also tf_weapon_flamethrower.cpp
 	// it would be better if all entities could opt-in to this, or a way for lagcompensation to handle non-players automatically
@@ -237,10 +251,6 @@ void FX_FireBullets( CTFWeaponBase *pWpn, int iPlayer, const Vector &vecOrigin,
 	}
 #endif
 
-	// Get the shooting angles.
-	Vector vecShootForward, vecShootRight, vecShootUp;
-	AngleVectors( vecAngles, &vecShootForward, &vecShootRight, &vecShootUp );
-
 	// Initialize the static firing information.
 	FireBulletsInfo_t fireInfo;
 	fireInfo.m_vecSrc = vecOrigin;
@@ -114,6 +114,7 @@
 	#include "econ_game_account_server.h"
 	#include "tf_logic_halloween_2014.h"
 	#include "tf_obj_sentrygun.h"
+	#include "tf_threat_field.h"
 	#include "entity_halloween_pickup.h"
 	#include "entity_rune.h"
 	#include "func_powerupvolume.h"
@@ -8008,6 +8009,7 @@ void CTFGameRules::LevelShutdown()
 		tf_training_client_message.Revert();
 	}
 	TheTFBots().LevelShutdown();
+	CTFThreatField::GetInstance().Reset();		// not TheTFThreatField(), which would snapshot the players first
 	hide_server.Revert();
 
 	DuelMiniGame_LevelShutdown();
@@ -1366,6 +1366,190 @@ void WorldSpaceSlerp(
 
 
 
+static ConVar anim_simd_blend( "anim_simd_blend", "1", FCVAR_REPLICATED, "Blend bones four at a time with SIMD in SlerpBones() and BlendBones()." );
+
+//-----------------------------------------------------------------------------
+// Purpose: Load the quaternions of four bones and transpose them, so each
+//			register holds one component of all four.
+//-----------------------------------------------------------------------------
+static FORCEINLINE void LoadQuaternionsSoA( const Quaternion *q, const int *pBones, fltx4 &x, fltx4 &y, fltx4 &z, fltx4 &w )
+{
+	x = LoadUnalignedSIMD( q[ pBones[0] ].Base() );
+	y = LoadUnalignedSIMD( q[ pBones[1] ].Base() );
+	z = LoadUnalignedSIMD( q[ pBones[2] ].Base() );
+	w = LoadUnalignedSIMD( q[ pBones[3] ].Base() );
+	TransposeSIMD( x, y, z, w );
+}
+
+static FORCEINLINE void StoreQuaternionsSoA( Quaternion *q, const int *pBones, fltx4 x, fltx4 y, fltx4 z, fltx4 w )
+{
+	TransposeSIMD( x, y, z, w );
+	StoreUnalignedSIMD( q[ pBones[0] ].Base(), x );
+	StoreUnalignedSIMD( q[ pBones[1] ].Base(), y );
+	StoreUnalignedSIMD( q[ pBones[2] ].Base(), z );
+	StoreUnalignedSIMD( q[ pBones[3] ].Base(), w );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: As QuaternionAlign( p, q, q ) on four quaternions at once, for the
+//			lanes set in alignMask
+//-----------------------------------------------------------------------------
+static FORCEINLINE void QuaternionAlignSoA( const fltx4 &px, const fltx4 &py, const fltx4 &pz, const fltx4 &pw, fltx4 &qx, fltx4 &qy, fltx4 &qz, fltx4 &qw, const fltx4 &alignMask )
+{
+	fltx4 dx = SubSIMD( px, qx ), dy = SubSIMD( py, qy ), dz = SubSIMD( pz, qz ), dw = SubSIMD( pw, qw );
+	fltx4 sx = AddSIMD( px, qx ), sy = AddSIMD( py, qy ), sz = AddSIMD( pz, qz ), sw = AddSIMD( pw, qw );
+
+	fltx4 a = MaddSIMD( dx, dx, MaddSIMD( dy, dy, MaddSIMD( dz, dz, MulSIMD( dw, dw ) ) ) );
+	fltx4 b = MaddSIMD( sx, sx, MaddSIMD( sy, sy, MaddSIMD( sz, sz, MulSIMD( sw, sw ) ) ) );
+
+	fltx4 flip = AndSIMD( CmpGtSIMD( a, b ), alignMask );
+	qx = MaskedAssign( flip, NegSIMD( qx ), qx );
+	qy = MaskedAssign( flip, NegSIMD( qy ), qy );
+	qz = MaskedAssign( flip, NegSIMD( qz ), qz );
+	qw = MaskedAssign( flip, NegSIMD( qw ), qw );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The lanes of bones that QuaternionSlerp() / QuaternionBlend() align
+//-----------------------------------------------------------------------------
+static FORCEINLINE fltx4 BoneAlignMaskSoA( const CStudioHdr *pStudioHdr, const int *pBones )
+{
+	float flAlign[4];
+	for ( int k = 0; k < 4; k++ )
+	{
+		flAlign[k] = ( pStudioHdr->boneFlags( pBones[k] ) & BONE_FIXED_ALIGNMENT ) ? 0.0f : 1.0f;
+	}
+	return CmpGtSIMD( LoadUnalignedSIMD( flAlign ), Four_Zeros );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The non-delta part of SlerpBones(), four bones at a time. Each bone
+//			gets the result of QuaternionSlerp( q2[i], q1[i], 1 - pS2[i] ).
+//			Bones it blends have their weight cleared, so the caller's scalar
+//			loop handles just the leftovers, and groups where two quaternions
+//			are nearly opposite, which take a special case in
+//			QuaternionSlerpNoAlign().
+//-----------------------------------------------------------------------------
+static void SlerpBonesSIMD( const CStudioHdr *pStudioHdr, Quaternion *q1, Vector *pos1, const QuaternionAligned *q2, const Vector *pos2, float *pS2, int nBoneCount )
+{
+	int *pBones = (int *)stackalloc( nBoneCount * sizeof(int) );
+	int nBones = 0;
+	for ( int i = 0; i < nBoneCount; i++ )
+	{
+		if ( pS2[i] > 0.0f )
+		{
+			pBones[ nBones++ ] = i;
+		}
+	}
+
+	const fltx4 epsilon = ReplicateX4( 0.000001f );
+
+	for ( int n = 0; n + 4 <= nBones; n += 4 )
+	{
+		const int *pGroup = &pBones[n];
+
+		// p = q2 and q = q1, as in QuaternionSlerp( q2[i], q1[i], s1, q3 ), with t = s1
+		fltx4 px, py, pz, pw, qx, qy, qz, qw;
+		LoadQuaternionsSoA( q2, pGroup, px, py, pz, pw );
+		LoadQuaternionsSoA( q1, pGroup, qx, qy, qz, qw );
+
+		QuaternionAlignSoA( px, py, pz, pw, qx, qy, qz, qw, BoneAlignMaskSoA( pStudioHdr, pGroup ) );
+
+		fltx4 cosom = MaddSIMD( px, qx, MaddSIMD( py, qy, MaddSIMD( pz, qz, MulSIMD( pw, qw ) ) ) );
+
+		// leave nearly opposite quaternions to the scalar code
+		if ( TestSignSIMD( CmpLeSIMD( AddSIMD( Four_Ones, cosom ), epsilon ) ) )
+			continue;
+
+		float flS2[4] = { pS2[ pGroup[0] ], pS2[ pGroup[1] ], pS2[ pGroup[2] ], pS2[ pGroup[3] ] };
+		fltx4 s2 = LoadUnalignedSIMD( flS2 );
+		fltx4 t = SubSIMD( Four_Ones, s2 );
+
+		// linear blend where the quaternions are nearly equal, as QuaternionSlerpNoAlign() does
+		fltx4 sclp = s2;
+		fltx4 sclq = t;
+
+		fltx4 slerpMask = CmpGtSIMD( SubSIMD( Four_Ones, cosom ), epsilon );
+		if ( TestSignSIMD( slerpMask ) )
+		{
+			fltx4 omega = ArcCosSIMD( MinSIMD( cosom, Four_Ones ) );
+			fltx4 sinom = MaskedAssign( slerpMask, SinSIMD( omega ), Four_Ones );
+
+			fltx4 slerpP = DivSIMD( SinSIMD( MulSIMD( s2, omega ) ), sinom );
+			fltx4 slerpQ = DivSIMD( SinSIMD( MulSIMD( t, omega ) ), sinom );
+
+			sclp = MaskedAssign( slerpMask, slerpP, sclp );
+			sclq = MaskedAssign( slerpMask, slerpQ, sclq );
+		}
+
+		StoreQuaternionsSoA( q1, pGroup,
+			MaddSIMD( sclp, px, MulSIMD( sclq, qx ) ),
+			MaddSIMD( sclp, py, MulSIMD( sclq, qy ) ),
+			MaddSIMD( sclp, pz, MulSIMD( sclq, qz ) ),
+			MaddSIMD( sclp, pw, MulSIMD( sclq, qw ) ) );
+
+		for ( int k = 0; k < 4; k++ )
+		{
+			int i = pGroup[k];
+			float s1 = 1.0f - pS2[i];
+			pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * pS2[i];
+			pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * pS2[i];
+			pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * pS2[i];
+
+			pS2[i] = 0.0f;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: BlendBones() on the bones in pBones, four at a time. Each bone gets
+//			the result of QuaternionBlend( q2[i], q1[i], s1 ). Returns the
+//			number of bones blended, which is nBones rounded down to a
+//			multiple of four.
+//-----------------------------------------------------------------------------
+static int BlendBonesSIMD( const CStudioHdr *pStudioHdr, Quaternion *q1, Vector *pos1, const Quaternion *q2, const Vector *pos2, float s, const int *pBones, int nBones )
+{
+	const float s1 = 1.0f - s;
+	const fltx4 sclp = ReplicateX4( s );
+	const fltx4 sclq = ReplicateX4( s1 );
+
+	int n;
+	for ( n = 0; n + 4 <= nBones; n += 4 )
+	{
+		const int *pGroup = &pBones[n];
+
+		// p = q2 and q = q1, as in QuaternionBlend( q2[i], q1[i], s1, q3 )
+		fltx4 px, py, pz, pw, qx, qy, qz, qw;
+		LoadQuaternionsSoA( q2, pGroup, px, py, pz, pw );
+		LoadQuaternionsSoA( q1, pGroup, qx, qy, qz, qw );
+
+		QuaternionAlignSoA( px, py, pz, pw, qx, qy, qz, qw, BoneAlignMaskSoA( pStudioHdr, pGroup ) );
+
+		fltx4 rx = MaddSIMD( sclp, px, MulSIMD( sclq, qx ) );
+		fltx4 ry = MaddSIMD( sclp, py, MulSIMD( sclq, qy ) );
+		fltx4 rz = MaddSIMD( sclp, pz, MulSIMD( sclq, qz ) );
+		fltx4 rw = MaddSIMD( sclp, pw, MulSIMD( sclq, qw ) );
+
+		// normalize, leaving zero length results alone as QuaternionNormalize() does
+		fltx4 radius = SqrtSIMD( MaddSIMD( rx, rx, MaddSIMD( ry, ry, MaddSIMD( rz, rz, MulSIMD( rw, rw ) ) ) ) );
+		fltx4 nonZero = CmpGtSIMD( radius, Four_Zeros );
+		fltx4 iradius = MaskedAssign( nonZero, DivSIMD( Four_Ones, MaskedAssign( nonZero, radius, Four_Ones ) ), Four_Ones );
+
+		StoreQuaternionsSoA( q1, pGroup, MulSIMD( rx, iradius ), MulSIMD( ry, iradius ), MulSIMD( rz, iradius ), MulSIMD( rw, iradius ) );
+
+		for ( int k = 0; k < 4; k++ )
+		{
+			int i = pGroup[k];
+			pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * s;
+			pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * s;
+			pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * s;
+		}
+	}
+
+	return n;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: blend together q1,pos1 with q2,pos2.  Return result in q1,pos1.  
 //			0 returns q1, pos1.  1 returns q2, pos2
@@ -1475,6 +1659,11 @@ void SlerpBones(
 		return;
 	}
 
+	if ( anim_simd_blend.GetBool() )
+	{
+		SlerpBonesSIMD( pStudioHdr, q1, pos1, q2, pos2, pS2, nBoneCount );
+	}
+
 	QuaternionAligned q3;
 	for (i = 0; i < nBoneCount; i++)
 	{
@@ -1586,7 +1775,12 @@ void BlendBones(
 	float s2 = s;
 	float s1 = 1.0 - s2;
 
-	for (i = 0; i < pStudioHdr->numbones(); i++)
+	// collect the bones to blend
+	int nBoneCount = pStudioHdr->numbones();
+	int *pBones = (int *)stackalloc( nBoneCount * sizeof(int) );
+	int nBones = 0;
+
+	for (i = 0; i < nBoneCount; i++)
 	{
 		// skip unused bones
 		if (!(pStudioHdr->boneFlags(i) & boneMask))
@@ -1605,23 +1799,36 @@ void BlendBones(
 
 		if (j >= 0 && seqdesc.weight( j ) > 0.0)
 		{
-			if (pStudioHdr->boneFlags(i) & BONE_FIXED_ALIGNMENT)
-			{
-				QuaternionBlendNoAlign( q2[i], q1[i], s1, q3 );
-			}
-			else
-			{
-				QuaternionBlend( q2[i], q1[i], s1, q3 );
-			}
-			q1[i][0] = q3[0];
-			q1[i][1] = q3[1];
-			q1[i][2] = q3[2];
-			q1[i][3] = q3[3];
-			pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * s2;
-			pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * s2;
-			pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * s2;
+			pBones[ nBones++ ] = i;
 		}
 	}
+
+	int n = 0;
+	if ( anim_simd_blend.GetBool() )
+	{
+		n = BlendBonesSIMD( pStudioHdr, q1, pos1, q2, pos2, s2, pBones, nBones );
+	}
+
+	for ( ; n < nBones; n++ )
+	{
+		i = pBones[n];
+
+		if (pStudioHdr->boneFlags(i) & BONE_FIXED_ALIGNMENT)
+		{
+			QuaternionBlendNoAlign( q2[i], q1[i], s1, q3 );
+		}
+		else
+		{
+			QuaternionBlend( q2[i], q1[i], s1, q3 );
+		}
+		q1[i][0] = q3[0];
+		q1[i][1] = q3[1];
+		q1[i][2] = q3[2];
+		q1[i][3] = q3[3];
+		pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * s2;
+		pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * s2;
+		pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * s2;
+	}
 }
 
 